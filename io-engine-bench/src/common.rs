@@ -1 +1,13 @@
 pub use io_engine_tests::*;
+
+/// Infer the build type from the `OUT_DIR` and `SRCDIR`.
+pub fn build_type() -> String {
+    let out_dir = env!("OUT_DIR");
+    let src_dir = env!("SRCDIR");
+    let prefix = format!("{src_dir}/target/");
+    let target = out_dir.replace(&prefix, "");
+    let splits = target.split('/').take(1).collect::<Vec<_>>();
+    let build = splits.first().expect("build type not found");
+    assert!(!build.is_empty());
+    build.to_string()
+}
@@ -8,30 +8,21 @@ use std::sync::Arc;
 
 #[allow(unused)]
 mod common;
-use common::compose::{
-    rpc::v0::{
-        mayastor,
-        mayastor::{BdevShareRequest, BdevUri, CreateNexusRequest, Null},
-        GrpcConnect,
+use common::{
+    build_type,
+    compose::{
+        rpc::v0::{
+            mayastor,
+            mayastor::{BdevShareRequest, BdevUri, CreateNexusRequest, Null},
+            GrpcConnect,
+        },
+        Binary,
+        Builder,
+        ComposeTest,
+        MayastorTest,
     },
-    Binary,
-    Builder,
-    ComposeTest,
-    MayastorTest,
 };
 
-/// Infer the build type from the `OUT_DIR` and `SRCDIR`.
-fn build_type() -> String {
-    let out_dir = env!("OUT_DIR");
-    let src_dir = env!("SRCDIR");
-    let prefix = format!("{src_dir}/target/");
-    let target = out_dir.replace(&prefix, "");
-    let splits = target.split('/').take(1).collect::<Vec<_>>();
-    let build = splits.first().expect("build type not found");
-    assert!(!build.is_empty());
-    build.to_string()
-}
-
 /// Create a new compose test cluster.
 async fn new_compose() -> Arc<ComposeTest> {
     common::composer_init();
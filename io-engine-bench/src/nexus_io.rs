@@ -0,0 +1,152 @@
+use criterion::{
+    criterion_group,
+    criterion_main,
+    BenchmarkId,
+    Criterion,
+    Throughput,
+};
+use io_engine::{
+    bdev::{device_create, nexus::nexus_create},
+    bench::IoLogWriter,
+    core::{MayastorCliArgs, UntypedBdevHandle},
+};
+use once_cell::sync::OnceCell;
+use std::time::{Duration, Instant};
+
+#[allow(unused)]
+mod common;
+use common::{build_type, compose::MayastorTest};
+
+/// Size of the nexus children, in MiB.
+const CHILD_SIZE_MB: u64 = 64;
+/// Size of the benchmarked I/Os.
+const IO_SIZE: u64 = 4096;
+/// Kinds of children: malloc children copy the data, null children do not,
+/// which leaves the nexus and bdev layer overhead alone.
+const CHILD_KINDS: [&str; 2] = ["malloc", "null"];
+/// Numbers of replicas of the benchmarked nexuses.
+const REPLICAS: [usize; 3] = [1, 2, 3];
+
+/// Get the in-binary environment, shared by all benchmarks of this binary.
+fn get_ms() -> &'static MayastorTest<'static> {
+    static MAYASTOR: OnceCell<MayastorTest> = OnceCell::new();
+    MAYASTOR.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Name of the nexus with the given kind and number of children.
+fn nexus_name(kind: &str, replicas: usize) -> String {
+    format!("nexus-{kind}-{replicas}")
+}
+
+/// Create a nexus for every kind of children and number of replicas.
+async fn create_nexuses(ms: &MayastorTest<'static>) {
+    ms.spawn(async move {
+        for kind in CHILD_KINDS {
+            for replicas in REPLICAS {
+                let name = nexus_name(kind, replicas);
+                let mut children = Vec::with_capacity(replicas);
+                for i in 0 .. replicas {
+                    let uri =
+                        format!("{kind}:///{name}-{i}?size_mb={CHILD_SIZE_MB}");
+                    device_create(&uri).await.unwrap();
+                    children.push(uri);
+                }
+                nexus_create(
+                    &name,
+                    (CHILD_SIZE_MB - 4) * 1024 * 1024,
+                    None,
+                    &children,
+                )
+                .await
+                .unwrap();
+            }
+        }
+    })
+    .await
+}
+
+/// Issues `iters` reads or writes to the given bdev one after the other from
+/// the reactor, and returns the time it took.
+async fn run_io(
+    ms: &MayastorTest<'static>,
+    name: String,
+    read: bool,
+    iters: u64,
+) -> Duration {
+    ms.spawn(async move {
+        let h = UntypedBdevHandle::open(&name, true, false).unwrap();
+        let mut buf = h.dma_malloc(IO_SIZE).unwrap();
+        let num_ios = h.get_bdev().size_in_bytes() / IO_SIZE;
+
+        let start = Instant::now();
+        for i in 0 .. iters {
+            let offset = (i % num_ios) * IO_SIZE;
+            if read {
+                h.read_at(offset, &mut buf).await.unwrap();
+            } else {
+                h.write_at(offset, &buf).await.unwrap();
+            }
+        }
+        let elapsed = start.elapsed();
+
+        h.close();
+        elapsed
+    })
+    .await
+}
+
+/// Benchmark the latency of queue depth 1 nexus I/Os over children of
+/// different kinds, with different numbers of replicas.
+fn nexus_io_benchmark(c: &mut Criterion) {
+    let runtime = tokio::runtime::Runtime::new().unwrap();
+    let ms = get_ms();
+    runtime.block_on(create_nexuses(ms));
+
+    for (op, read) in [("read", true), ("write", false)] {
+        let mut group =
+            c.benchmark_group(format!("{}/nexus_io/{op}", build_type()));
+        group.throughput(Throughput::Bytes(IO_SIZE));
+
+        for kind in CHILD_KINDS {
+            for replicas in REPLICAS {
+                let name = nexus_name(kind, replicas);
+                group.bench_function(BenchmarkId::new(kind, replicas), |b| {
+                    b.to_async(&runtime).iter_custom(|iters| {
+                        run_io(ms, name.clone(), read, iters)
+                    })
+                });
+            }
+        }
+    }
+}
+
+/// Benchmark the cost of logging a write into an I/O log, as done for every
+/// write of a nexus while one of its children is out of sync.
+fn io_log_benchmark(c: &mut Criterion) {
+    let runtime = tokio::runtime::Runtime::new().unwrap();
+    let ms = get_ms();
+
+    let mut group = c.benchmark_group(format!("{}/io_log", build_type()));
+    group.throughput(Throughput::Elements(1));
+    group.bench_function("log_io", |b| {
+        b.to_async(&runtime).iter_custom(|iters| {
+            ms.spawn(async move {
+                let blk_len = 512;
+                let io_blks = IO_SIZE / blk_len;
+                let num_blocks = CHILD_SIZE_MB * 1024 * 1024 / blk_len;
+
+                let log = IoLogWriter::new("bench", num_blocks, blk_len);
+
+                let start = Instant::now();
+                for i in 0 .. iters {
+                    let lbn = (i * io_blks) % num_blocks;
+                    log.log_write(lbn, io_blks);
+                }
+                start.elapsed()
+            })
+        })
+    });
+}
+
+criterion_group!(benches, nexus_io_benchmark, io_log_benchmark);
+criterion_main!(benches);
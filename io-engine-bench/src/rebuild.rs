@@ -0,0 +1,104 @@
+use criterion::{
+    criterion_group,
+    criterion_main,
+    BenchmarkId,
+    Criterion,
+    Throughput,
+};
+use io_engine::{
+    bdev::device_create,
+    core::{segment_map::SegmentMap, MayastorCliArgs},
+    rebuild::{BdevRebuildJob, RebuildState},
+};
+use once_cell::sync::OnceCell;
+use std::time::{Duration, Instant};
+
+#[allow(unused)]
+mod common;
+use common::{build_type, compose::MayastorTest};
+
+/// Size of the rebuilt devices, in MiB.
+const DEV_SIZE_MB: u64 = 256;
+/// Block size of the rebuilt devices.
+const BLK_LEN: u64 = 512;
+/// Segment size, same as the rebuild segment size.
+const SEG_SIZE: u64 = 64 * 1024;
+
+const SRC_URI: &str = "malloc:///rebuild_src?size_mb=256";
+const DST_URI: &str = "malloc:///rebuild_dst?size_mb=256";
+
+/// Get the in-binary environment.
+fn get_ms() -> &'static MayastorTest<'static> {
+    static MAYASTOR: OnceCell<MayastorTest> = OnceCell::new();
+    MAYASTOR.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Creates a partial rebuild map with every `stride`-th segment dirty.
+fn rebuild_map(stride: u64) -> SegmentMap {
+    let num_blocks = DEV_SIZE_MB * 1024 * 1024 / BLK_LEN;
+    let seg_blks = SEG_SIZE / BLK_LEN;
+    let mut map = SegmentMap::new(num_blocks, BLK_LEN, SEG_SIZE);
+    (0 .. num_blocks)
+        .step_by((seg_blks * stride) as usize)
+        .for_each(|lbn| map.set(lbn, seg_blks, true));
+    map
+}
+
+/// Runs `iters` rebuilds between the source and destination devices, full
+/// or partial after a map with every `stride`-th segment dirty, and returns
+/// the time they took.
+async fn run_rebuilds(
+    ms: &MayastorTest<'static>,
+    stride: Option<u64>,
+    iters: u64,
+) -> Duration {
+    ms.spawn(async move {
+        let mut elapsed = Duration::ZERO;
+        for _ in 0 .. iters {
+            let mut builder = BdevRebuildJob::builder();
+            if let Some(stride) = stride {
+                builder = builder.with_bitmap(rebuild_map(stride));
+            }
+
+            let start = Instant::now();
+            let job = builder.build(SRC_URI, DST_URI).await.unwrap();
+            let state = job.start().await.unwrap().await.unwrap();
+            elapsed += start.elapsed();
+
+            assert_eq!(state, RebuildState::Completed);
+        }
+        elapsed
+    })
+    .await
+}
+
+/// Benchmark the segment copy rate of full and partial rebuilds between two
+/// malloc devices.
+fn rebuild_benchmark(c: &mut Criterion) {
+    let runtime = tokio::runtime::Runtime::new().unwrap();
+    let ms = get_ms();
+
+    runtime.block_on(ms.spawn(async {
+        device_create(SRC_URI).await.unwrap();
+        device_create(DST_URI).await.unwrap();
+    }));
+
+    let mut group = c.benchmark_group(format!("{}/rebuild", build_type()));
+    // A full rebuild of the device takes a while.
+    group.sample_size(10);
+
+    for (name, stride) in [("full", None), ("partial_1_in_10", Some(10))] {
+        let bytes = match stride {
+            Some(stride) => rebuild_map(stride).count_dirty_blks() * BLK_LEN,
+            None => DEV_SIZE_MB * 1024 * 1024,
+        };
+        group.throughput(Throughput::Bytes(bytes));
+        group.bench_function(BenchmarkId::new("copy", name), |b| {
+            b.to_async(&runtime)
+                .iter_custom(|iters| run_rebuilds(ms, stride, iters))
+        });
+    }
+}
+
+criterion_group!(benches, rebuild_benchmark);
+criterion_main!(benches);
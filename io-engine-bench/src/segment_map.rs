@@ -0,0 +1,123 @@
+use criterion::{
+    black_box,
+    criterion_group,
+    criterion_main,
+    BatchSize,
+    BenchmarkId,
+    Criterion,
+    Throughput,
+};
+use io_engine::{
+    bench::{segment_map_dirty_blks, segment_map_merge},
+    core::segment_map::SegmentMap,
+};
+
+#[allow(unused)]
+mod common;
+use common::build_type;
+
+/// Block size of the mapped device.
+const BLK_LEN: u64 = 512;
+/// Segment size, same as the rebuild segment size.
+const SEG_SIZE: u64 = 64 * 1024;
+/// Size of a logged I/O, in blocks.
+const IO_BLKS: u64 = 4096 / BLK_LEN;
+
+/// Sizes of the mapped devices.
+const DEV_SIZES: [(&str, u64); 2] = [
+    ("10GiB", 10 * 1024 * 1024 * 1024),
+    ("1TiB", 1024 * 1024 * 1024 * 1024),
+];
+
+/// Minimal xorshift generator, so that random offsets cost next to nothing
+/// compared to the map operations being measured.
+struct XorShift(u64);
+impl XorShift {
+    fn next(&mut self) -> u64 {
+        self.0 ^= self.0 << 13;
+        self.0 ^= self.0 >> 7;
+        self.0 ^= self.0 << 17;
+        self.0
+    }
+}
+
+fn new_map(dev_size: u64) -> SegmentMap {
+    SegmentMap::new(dev_size / BLK_LEN, BLK_LEN, SEG_SIZE)
+}
+
+/// Creates a map with every `stride`-th segment dirty.
+fn dirty_map(dev_size: u64, stride: u64) -> SegmentMap {
+    let mut map = new_map(dev_size);
+    let seg_blks = SEG_SIZE / BLK_LEN;
+    let num_blocks = dev_size / BLK_LEN;
+    (0 .. num_blocks)
+        .step_by((seg_blks * stride) as usize)
+        .for_each(|lbn| map.set(lbn, 1, true));
+    map
+}
+
+/// Benchmark marking written blocks as dirty, as the I/O log does.
+fn set_benchmark(c: &mut Criterion) {
+    let mut group =
+        c.benchmark_group(format!("{}/segment_map/set", build_type()));
+    group.throughput(Throughput::Elements(1));
+
+    for (name, dev_size) in DEV_SIZES {
+        let num_ios = dev_size / BLK_LEN / IO_BLKS;
+
+        group.bench_function(BenchmarkId::new("sequential", name), |b| {
+            let mut map = new_map(dev_size);
+            let mut io = 0;
+            b.iter(|| {
+                map.set(black_box(io * IO_BLKS), IO_BLKS, true);
+                io = (io + 1) % num_ios;
+            })
+        });
+
+        group.bench_function(BenchmarkId::new("random", name), |b| {
+            let mut map = new_map(dev_size);
+            let mut rng = XorShift(0x2545_f491_4f6c_dd1d);
+            b.iter(|| {
+                let io = rng.next() % num_ios;
+                map.set(black_box(io * IO_BLKS), IO_BLKS, true);
+            })
+        });
+    }
+}
+
+/// Benchmark merging the per-core maps of an I/O log, and iterating over the
+/// dirty segments of the result, as a partial rebuild does.
+fn merge_benchmark(c: &mut Criterion) {
+    let mut group = c.benchmark_group(format!("{}/segment_map", build_type()));
+
+    for (name, dev_size) in DEV_SIZES {
+        // Sparse: 1 segment out of 1000 is dirty; dense: 1 out of 2.
+        for (density, stride) in [("sparse", 1000), ("dense", 2)] {
+            let id = format!("{name}/{density}");
+            let a = dirty_map(dev_size, stride);
+            let b = dirty_map(dev_size, stride + 1);
+
+            group.bench_function(BenchmarkId::new("merge", &id), |bench| {
+                bench.iter_batched(
+                    || a.clone(),
+                    |a| segment_map_merge(a, black_box(&b)),
+                    BatchSize::LargeInput,
+                )
+            });
+
+            group.bench_function(
+                BenchmarkId::new("dirty_blks", &id),
+                |bench| {
+                    bench.iter_batched(
+                        || a.clone(),
+                        |a| segment_map_dirty_blks(a).fold(0, |acc, b| acc ^ b),
+                        BatchSize::LargeInput,
+                    )
+                },
+            );
+        }
+    }
+}
+
+criterion_group!(benches, set_benchmark, merge_benchmark);
+criterion_main!(benches);
@@ -0,0 +1,132 @@
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use io_engine::{
+    core::{
+        LogicalVolume,
+        MayastorCliArgs,
+        SnapshotOps,
+        SnapshotParams,
+        UntypedBdev,
+    },
+    lvs::{Lvol, Lvs},
+    pool_backend::PoolArgs,
+};
+use once_cell::sync::OnceCell;
+use std::time::{Duration, Instant};
+
+#[allow(unused)]
+mod common;
+use common::{build_type, compose::MayastorTest};
+
+const POOL_NAME: &str = "bench_pool";
+const POOL_DISK: &str = "malloc:///bench_pool_disk?size_mb=512";
+const LVOL_NAME: &str = "bench_lvol";
+const LVOL_SIZE: u64 = 16 * 1024 * 1024;
+
+/// Numbers of existing snapshots of the volume, for which the creation of
+/// one more snapshot is measured.
+const SNAPSHOT_COUNTS: [u64; 4] = [0, 16, 64, 128];
+
+/// Get the in-binary environment.
+fn get_ms() -> &'static MayastorTest<'static> {
+    static MAYASTOR: OnceCell<MayastorTest> = OnceCell::new();
+    MAYASTOR.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Looks up the benchmarked volume. Must be called on the reactor.
+fn lookup_lvol() -> Lvol {
+    Lvol::try_from(UntypedBdev::lookup_by_name(LVOL_NAME).unwrap()).unwrap()
+}
+
+/// Creates a snapshot of the given volume.
+async fn create_snapshot(lvol: &Lvol, name: String) -> Lvol {
+    let params = SnapshotParams::new(
+        Some(format!("{name}_entity")),
+        Some(lvol.uuid()),
+        Some(uuid::Uuid::new_v4().to_string()),
+        Some(name),
+        Some(uuid::Uuid::new_v4().to_string()),
+        Some(chrono::Utc::now().to_string()),
+        false,
+    );
+    lvol.create_snapshot(params).await.unwrap()
+}
+
+/// Creates the pool and the benchmarked volume.
+async fn create_lvol(ms: &MayastorTest<'static>) {
+    ms.spawn(async {
+        let pool = Lvs::create_or_import(PoolArgs {
+            name: POOL_NAME.to_string(),
+            disks: vec![POOL_DISK.to_string()],
+            uuid: None,
+            cluster_size: None,
+        })
+        .await
+        .unwrap();
+        pool.create_lvol(
+            LVOL_NAME,
+            LVOL_SIZE,
+            Some(&uuid::Uuid::new_v4().to_string()),
+            true,
+            None,
+        )
+        .await
+        .unwrap();
+    })
+    .await
+}
+
+/// Creates snapshots of the volume until it has the given number of them.
+async fn add_snapshots(ms: &MayastorTest<'static>, from: u64, to: u64) {
+    ms.spawn(async move {
+        let lvol = lookup_lvol();
+        for i in from .. to {
+            create_snapshot(&lvol, format!("{LVOL_NAME}_snap{i}")).await;
+        }
+    })
+    .await
+}
+
+/// Creates `iters` snapshots of the volume, and returns the time it took.
+/// Every snapshot is destroyed right after its creation, out of the measured
+/// time, so that the volume keeps the same number of snapshots.
+async fn run_snapshots(ms: &MayastorTest<'static>, iters: u64) -> Duration {
+    ms.spawn(async move {
+        let lvol = lookup_lvol();
+        let mut elapsed = Duration::ZERO;
+        for i in 0 .. iters {
+            let name = format!("{LVOL_NAME}_bench{i}");
+            let start = Instant::now();
+            let snapshot = create_snapshot(&lvol, name).await;
+            elapsed += start.elapsed();
+
+            snapshot.destroy_snapshot().await.unwrap();
+        }
+        elapsed
+    })
+    .await
+}
+
+/// Benchmark the creation of a volume snapshot, as the number of snapshots
+/// of the volume grows.
+fn snapshot_benchmark(c: &mut Criterion) {
+    let runtime = tokio::runtime::Runtime::new().unwrap();
+    let ms = get_ms();
+    runtime.block_on(create_lvol(ms));
+
+    let mut group = c.benchmark_group(format!("{}/snapshot", build_type()));
+    group.sample_size(20);
+
+    let mut count = 0;
+    for n in SNAPSHOT_COUNTS {
+        runtime.block_on(add_snapshots(ms, count, n));
+        count = n;
+
+        group.bench_function(BenchmarkId::new("create", n), |b| {
+            b.to_async(&runtime)
+                .iter_custom(|iters| run_snapshots(ms, iters))
+        });
+    }
+}
+
+criterion_group!(benches, snapshot_benchmark);
+criterion_main!(benches);
@@ -9,17 +9,22 @@ use std::{
 };
 
 use async_trait::async_trait;
+use futures::channel::oneshot;
 use nix::errno::Errno;
 use once_cell::sync::{Lazy, OnceCell};
 
 use spdk_rs::{
+    ffihelper::{cb_arg, done_cb},
     libspdk::{
         spdk_bdev_comparev_blocks,
         spdk_bdev_flush,
         spdk_bdev_free_io,
         spdk_bdev_io,
+        spdk_bdev_io_get_seek_offset,
         spdk_bdev_readv_blocks_with_flags,
         spdk_bdev_reset,
+        spdk_bdev_seek_data,
+        spdk_bdev_seek_hole,
         spdk_bdev_unmap_blocks,
         spdk_bdev_write_zeroes_blocks,
         spdk_bdev_writev_blocks,
@@ -227,6 +232,78 @@ struct SpdkBlockDeviceHandle {
     handle: UntypedBdevHandle,
 }
 
+impl SpdkBlockDeviceHandle {
+    /// Returns the lvol behind this handle, as snapshots are supported only
+    /// for LVOLs.
+    fn replica_lvol(&self) -> Result<Lvol, CoreError> {
+        let bdev = self.handle.get_bdev();
+        if bdev.driver() != "lvol" {
+            return Err(CoreError::NotSupported {
+                source: Errno::ENXIO,
+            });
+        }
+
+        Lvol::try_from(bdev).map_err(|_e| CoreError::BdevNotFound {
+            name: bdev.name().to_string(),
+        })
+    }
+
+    /// Seeks the next allocated (`IoType::SeekData`) or unallocated
+    /// (`IoType::SeekHole`) block at or after the given offset, for the bdevs
+    /// which support it, like lvols.
+    /// The unallocated blocks of an lvol with a parent blob, i.e. a clone or
+    /// an lvol with a snapshot, read the data of its ancestors, which the lvol
+    /// seek does not report: the allocation of such lvols is not supported.
+    async fn seek(
+        &self,
+        io_type: IoType,
+        offset_blocks: u64,
+    ) -> Result<u64, CoreError> {
+        let backed = Lvol::try_from(self.handle.get_bdev())
+            .map_or(false, |lvol| lvol.has_parent_blob());
+        if backed || !self.device.io_type_supported(io_type) {
+            return Err(CoreError::NotSupported {
+                source: Errno::EOPNOTSUPP,
+            });
+        }
+
+        let (s, r) = oneshot::channel::<Option<u64>>();
+        let (desc, chan) = self.handle.io_tuple();
+        let rc = unsafe {
+            if matches!(io_type, IoType::SeekData) {
+                spdk_bdev_seek_data(
+                    desc,
+                    chan,
+                    offset_blocks,
+                    Some(bdev_seek_completion),
+                    cb_arg(s),
+                )
+            } else {
+                spdk_bdev_seek_hole(
+                    desc,
+                    chan,
+                    offset_blocks,
+                    Some(bdev_seek_completion),
+                    cb_arg(s),
+                )
+            }
+        };
+
+        if rc < 0 {
+            return Err(CoreError::SeekDispatch {
+                source: Errno::from_i32(-rc),
+                offset: offset_blocks,
+            });
+        }
+
+        r.await.expect("Failed awaiting at seek()").ok_or(
+            CoreError::SeekFailed {
+                offset: offset_blocks,
+            },
+        )
+    }
+}
+
 impl TryFrom<Arc<UntypedDescriptorGuard>> for SpdkBlockDeviceHandle {
     type Error = CoreError;
 
@@ -563,6 +640,14 @@ impl BlockDeviceHandle for SpdkBlockDeviceHandle {
         }
     }
 
+    async fn seek_data(&self, offset_blocks: u64) -> Result<u64, CoreError> {
+        self.seek(IoType::SeekData, offset_blocks).await
+    }
+
+    async fn seek_hole(&self, offset_blocks: u64) -> Result<u64, CoreError> {
+        self.seek(IoType::SeekHole, offset_blocks).await
+    }
+
     /// NVMe commands are not applicable for non-NVMe devices.
     async fn nvme_admin_custom(&self, opcode: u8) -> Result<(), CoreError> {
         Err(CoreError::NvmeAdminDispatch {
@@ -619,6 +704,23 @@ impl BlockDeviceHandle for SpdkBlockDeviceHandle {
 
         Ok(0)
     }
+
+    async fn snapshot_txn_ids(&self) -> Result<Vec<String>, CoreError> {
+        Ok(self.replica_lvol()?.snapshot_txn_ids())
+    }
+
+    async fn snapshot_delta(
+        &self,
+        snapshot_idx: u32,
+        granularity: u32,
+    ) -> Result<Vec<u8>, CoreError> {
+        self.replica_lvol()?
+            .snapshot_delta_bitmap(snapshot_idx as usize, granularity as u64)
+            .ok_or(CoreError::NotSupported {
+                source: Errno::ENOENT,
+            })
+    }
+
     // Flush the io in buffer to disk, for the Local Block Device.
     fn flush_io(
         &self,
@@ -740,6 +842,20 @@ fn free_bdev_io_ctx(ctx: *mut IoCtx) {
     pool.put(ctx);
 }
 
+extern "C" fn bdev_seek_completion(
+    bio: *mut spdk_bdev_io,
+    success: bool,
+    ctx: *mut c_void,
+) {
+    let offset = if success {
+        Some(unsafe { spdk_bdev_io_get_seek_offset(bio) })
+    } else {
+        None
+    };
+    unsafe { spdk_bdev_free_io(bio) };
+    done_cb(ctx, offset);
+}
+
 extern "C" fn bdev_io_completion(
     child_bio: *mut spdk_bdev_io,
     success: bool,
@@ -1,6 +1,9 @@
 #![allow(clippy::vec_box)]
 
-use std::{pin::Pin, sync::atomic::AtomicBool};
+use std::{
+    pin::Pin,
+    sync::atomic::{AtomicBool, AtomicU32},
+};
 
 use crate::core::VerboseError;
 use events_api::event::EventAction;
@@ -13,18 +16,25 @@ mod nexus_bdev_rebuild;
 mod nexus_bdev_snapshot;
 mod nexus_channel;
 mod nexus_child;
+mod nexus_integrity;
 mod nexus_io;
+mod nexus_io_latency;
 mod nexus_io_log;
+mod nexus_io_log_persistence;
 mod nexus_io_subsystem;
 mod nexus_iter;
 mod nexus_module;
 mod nexus_nbd;
 mod nexus_persistence;
+mod nexus_qos;
+mod nexus_read_cache;
+mod nexus_read_policy;
 mod nexus_share;
 
 use crate::{
     bdev::nexus::nexus_iter::NexusIterMut,
     eventing::{Event, EventMetaGen, EventWithMeta},
+    rebuild::RebuildBudget,
 };
 pub(crate) use nexus_bdev::NEXUS_PRODUCT_ID;
 pub use nexus_bdev::{
@@ -52,7 +62,15 @@ pub use nexus_child::{
     NexusChild,
 };
 use nexus_io::{NexusBio, NioCtx};
-use nexus_io_log::{IOLog, IOLogChannel};
+pub use nexus_io_latency::{
+    ChildIoLatency,
+    ChildIoLatencySummary,
+    NexusFreezeLatency,
+    NexusFreezeLatencySummary,
+    NexusIoLatency,
+    NexusIoLatencySummary,
+};
+pub(crate) use nexus_io_log::{IOLog, IOLogChannel};
 use nexus_io_subsystem::NexusIoSubsystem;
 pub use nexus_io_subsystem::NexusPauseState;
 pub use nexus_iter::{
@@ -69,6 +87,9 @@ pub(crate) use nexus_module::{NexusModule, NEXUS_MODULE_NAME};
 pub(crate) use nexus_nbd::{NbdDisk, NbdError};
 pub(crate) use nexus_persistence::PersistOp;
 pub use nexus_persistence::{ChildInfo, NexusInfo};
+pub use nexus_qos::{NexusQos, NexusQosStats};
+pub use nexus_read_cache::NexusReadCacheStats;
+pub use nexus_read_policy::{read_policy, set_read_policy, ReadPolicy};
 pub(crate) use nexus_share::NexusPtpl;
 
 pub use nexus_bdev_snapshot::{
@@ -88,6 +109,9 @@ struct NexusShareArgs {
     cntlid_min: u16,
     /// TODO
     cntlid_max: u16,
+    /// Listen over RDMA as well, if the target has the RDMA transport.
+    #[serde(default)]
+    rdma: bool,
 }
 
 /// TODO
@@ -97,6 +121,111 @@ struct NexusShareReply {
     uri: String,
 }
 
+/// Arguments of the rebuild budget json-rpc method. When both the nexus and
+/// the child URI are given, the budget of the child's rebuild job is set,
+/// otherwise the budget shared by all rebuild jobs of the node.
+#[derive(Deserialize)]
+struct NexusRebuildBudgetArgs {
+    /// Nexus uuid.
+    #[serde(default)]
+    nexus: Option<String>,
+    /// URI of the child being rebuilt.
+    #[serde(default)]
+    uri: Option<String>,
+    /// Budget to set; the current budget is returned when omitted.
+    #[serde(default)]
+    budget: Option<RebuildBudget>,
+}
+
+/// Reply of the rebuild budget json-rpc method.
+#[derive(Serialize)]
+struct NexusRebuildBudgetReply {
+    /// Budget shared by all rebuild jobs of the node.
+    node: RebuildBudget,
+    /// Budget of the rebuild job, if one was given.
+    job: Option<RebuildBudget>,
+}
+
+/// Arguments of the I/O latency json-rpc method.
+#[derive(Deserialize)]
+struct NexusIoLatencyArgs {
+    /// Nexus name; all nexuses when omitted.
+    #[serde(default)]
+    name: Option<String>,
+    /// Reset the histograms after collecting them.
+    #[serde(default)]
+    reset: bool,
+}
+
+/// I/O latency histograms of a nexus, as returned by the I/O latency json-rpc
+/// method.
+#[derive(Serialize)]
+struct NexusIoLatencyReply {
+    /// Nexus name.
+    name: String,
+    /// Nexus uuid.
+    uuid: String,
+    /// Per I/O type and per child latency histograms.
+    #[serde(flatten)]
+    latency: NexusIoLatencySummary,
+}
+
+/// Arguments of the integrity checking json-rpc method.
+#[derive(Deserialize)]
+struct NexusIntegrityArgs {
+    /// Nexus uuid.
+    uuid: String,
+    /// Whether to enable integrity checking; the current setting is
+    /// returned when omitted.
+    #[serde(default)]
+    enable: Option<bool>,
+}
+
+/// Reply of the integrity checking json-rpc method.
+#[derive(Serialize)]
+struct NexusIntegrityReply {
+    /// Whether integrity checking is enabled.
+    enabled: bool,
+}
+
+/// Arguments of the QoS json-rpc method.
+#[derive(Deserialize)]
+struct NexusQosArgs {
+    /// Nexus uuid.
+    uuid: String,
+    /// New QoS settings; settings without any limit remove the limits. The
+    /// current settings are returned when omitted.
+    #[serde(default)]
+    qos: Option<NexusQos>,
+}
+
+/// Reply of the QoS json-rpc method.
+#[derive(Serialize)]
+struct NexusQosReply {
+    /// Current QoS settings, if limits are set.
+    qos: Option<NexusQos>,
+    /// Throttling statistics since the settings were applied.
+    stats: NexusQosStats,
+}
+
+/// Arguments of the read cache json-rpc method.
+#[derive(Deserialize)]
+struct NexusReadCacheArgs {
+    /// Nexus uuid.
+    uuid: String,
+    /// New size of the read cache in MiB, zero to remove it. The current
+    /// cache is kept when omitted.
+    #[serde(default)]
+    size_mb: Option<u64>,
+}
+
+/// Reply of the read cache json-rpc method.
+#[derive(Serialize)]
+struct NexusReadCacheReply {
+    /// Statistics of the read cache, if any.
+    cache: Option<NexusReadCacheStats>,
+}
+
 /// public function which simply calls register module
 pub fn register_module(register_json: bool) {
     nexus_module::register_module();
@@ -106,9 +235,21 @@ pub fn register_module(register_json: bool) {
     }
 
     use crate::{
-        core::{Share, ShareProps, UntypedBdev},
+        core::{
+            dma_arena_stats,
+            startup_phases,
+            DmaArenaClassStats,
+            ReactorPollStats,
+            Reactors,
+            Share,
+            ShareProps,
+            StartupPhase,
+            UntypedBdev,
+        },
         jsonrpc::{jsonrpc_register, Code, JsonRpcError, Result},
+        rebuild::{node_rebuild_budget, set_node_rebuild_budget},
     };
+    use spdk_rs::libspdk::spdk_get_ticks_hz;
 
     jsonrpc_register(
         "nexus_share",
@@ -126,7 +267,7 @@ pub fn register_module(register_json: bool) {
                     let mut bdev = Pin::new(&mut bdev);
                     match proto.as_str() {
                         "nvmf" => {
-                            let share = ShareProps::new().with_range(Some((args.cntlid_min, args.cntlid_max))).with_ana(true);
+                            let share = ShareProps::new().with_range(Some((args.cntlid_min, args.cntlid_max))).with_ana(true).with_rdma(args.rdma);
                             bdev.as_mut().share_nvmf(Some(share))
                                 .await
                                 .map_err(|e| {
@@ -153,6 +294,198 @@ pub fn register_module(register_json: bool) {
             Box::pin(f.boxed_local())
         },
     );
+
+    jsonrpc_register(
+        "nexus_rebuild_budget",
+        |args: NexusRebuildBudgetArgs| -> Pin<Box<dyn Future<Output = Result<NexusRebuildBudgetReply>>>> {
+            let f = async move {
+                let job = match (args.nexus, args.uri) {
+                    (Some(nexus), Some(uri)) => {
+                        let Some(nexus) = nexus_lookup_uuid_mut(&nexus) else {
+                            return Err(JsonRpcError {
+                                code: Code::NotFound,
+                                message: format!("nexus '{nexus}' not found"),
+                            });
+                        };
+                        let res = match args.budget {
+                            Some(budget) => nexus
+                                .set_rebuild_budget(&uri, budget)
+                                .await
+                                .map(|_| budget),
+                            None => match nexus.rebuild_job(&uri) {
+                                Ok(rj) => Ok(rj.stats().await.budget),
+                                Err(e) => Err(e),
+                            },
+                        };
+                        Some(res.map_err(|e| JsonRpcError {
+                            code: Code::InternalError,
+                            message: e.verbose(),
+                        })?)
+                    }
+                    (None, None) => {
+                        if let Some(budget) = args.budget {
+                            set_node_rebuild_budget(budget);
+                        }
+                        None
+                    }
+                    _ => {
+                        return Err(JsonRpcError {
+                            code: Code::InvalidParams,
+                            message: "both nexus and uri must be given"
+                                .to_string(),
+                        });
+                    }
+                };
+
+                Ok(NexusRebuildBudgetReply {
+                    node: node_rebuild_budget(),
+                    job,
+                })
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "nexus_integrity",
+        |args: NexusIntegrityArgs| -> Pin<Box<dyn Future<Output = Result<NexusIntegrityReply>>>> {
+            let f = async move {
+                let Some(mut nexus) = nexus_lookup_uuid_mut(&args.uuid) else {
+                    return Err(JsonRpcError {
+                        code: Code::NotFound,
+                        message: format!("nexus '{}' not found", args.uuid),
+                    });
+                };
+                if let Some(enable) = args.enable {
+                    nexus.as_mut().set_integrity(enable).await.map_err(|e| {
+                        JsonRpcError {
+                            code: Code::InternalError,
+                            message: e.verbose(),
+                        }
+                    })?;
+                }
+                Ok(NexusIntegrityReply {
+                    enabled: nexus.integrity_enabled(),
+                })
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "nexus_qos",
+        |args: NexusQosArgs| -> Pin<Box<dyn Future<Output = Result<NexusQosReply>>>> {
+            let f = async move {
+                let Some(mut nexus) = nexus_lookup_uuid_mut(&args.uuid) else {
+                    return Err(JsonRpcError {
+                        code: Code::NotFound,
+                        message: format!("nexus '{}' not found", args.uuid),
+                    });
+                };
+                if let Some(qos) = args.qos {
+                    nexus.as_mut().set_qos(Some(qos)).await.map_err(|e| {
+                        JsonRpcError {
+                            code: Code::InternalError,
+                            message: e.verbose(),
+                        }
+                    })?;
+                }
+                Ok(NexusQosReply {
+                    qos: nexus.qos(),
+                    stats: nexus.qos_stats(),
+                })
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "nexus_read_cache",
+        |args: NexusReadCacheArgs| -> Pin<Box<dyn Future<Output = Result<NexusReadCacheReply>>>> {
+            let f = async move {
+                let Some(mut nexus) = nexus_lookup_uuid_mut(&args.uuid) else {
+                    return Err(JsonRpcError {
+                        code: Code::NotFound,
+                        message: format!("nexus '{}' not found", args.uuid),
+                    });
+                };
+                if let Some(size_mb) = args.size_mb {
+                    nexus.as_mut().set_read_cache(size_mb).await.map_err(
+                        |e| JsonRpcError {
+                            code: Code::InternalError,
+                            message: e.verbose(),
+                        },
+                    )?;
+                }
+                Ok(NexusReadCacheReply {
+                    cache: nexus.read_cache_stats(),
+                })
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "dma_arena_stats",
+        |_: ()| -> Pin<Box<dyn Future<Output = Result<Vec<DmaArenaClassStats>>>>> {
+            let f = async move { Ok(dma_arena_stats()) };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "reactor_stats",
+        |_: ()| -> Pin<Box<dyn Future<Output = Result<Vec<ReactorPollStats>>>>> {
+            let f = async move {
+                Ok(Reactors::iter().map(|r| r.poll_stats()).collect())
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "startup_phases",
+        |_: ()| -> Pin<Box<dyn Future<Output = Result<Vec<StartupPhase>>>>> {
+            let f = async move { Ok(startup_phases()) };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "nexus_io_latency",
+        |args: NexusIoLatencyArgs| -> Pin<Box<dyn Future<Output = Result<Vec<NexusIoLatencyReply>>>>> {
+            let f = async move {
+                let nexuses: Vec<_> = match &args.name {
+                    Some(name) => match nexus_lookup(name) {
+                        Some(n) => vec![n],
+                        None => {
+                            return Err(JsonRpcError {
+                                code: Code::NotFound,
+                                message: format!("nexus '{name}' not found"),
+                            });
+                        }
+                    },
+                    None => nexus_iter().collect(),
+                };
+
+                let tick_rate = unsafe { spdk_get_ticks_hz() };
+                let mut reply = Vec::with_capacity(nexuses.len());
+                for nexus in nexuses {
+                    let latency = nexus.io_latency().await;
+                    if args.reset {
+                        nexus.reset_io_latency().await;
+                    }
+                    reply.push(NexusIoLatencyReply {
+                        name: nexus.name.clone(),
+                        uuid: nexus.uuid().to_string(),
+                        latency: latency.summary(tick_rate),
+                    });
+                }
+                Ok(reply)
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
 }
 
 /// called during shutdown so that all nexus children are in Destroying state
@@ -202,6 +535,18 @@ pub async fn shutdown_nexuses() {
 /// Enables/disables partial rebuild.
 pub static ENABLE_PARTIAL_REBUILD: AtomicBool = AtomicBool::new(true);
 
+/// Enables/disables saving the I/O logs of out-of-sync children to the
+/// persistent store on nexus shutdown, so that they can be partially rebuilt
+/// after a restart.
+pub static ENABLE_IO_LOG_PERSISTENCE: AtomicBool = AtomicBool::new(false);
+
+/// Enables/disables end-to-end integrity checking of the I/O of new nexuses.
+pub static ENABLE_NEXUS_INTEGRITY: AtomicBool = AtomicBool::new(false);
+
+/// Maximum number of adjacent small writes coalesced into a single write per
+/// child. Zero or one disables write coalescing.
+pub static NEXUS_WRITE_BATCH: AtomicU32 = AtomicU32::new(0);
+
 /// Enables/disables nexus reset logic.
 pub static ENABLE_NEXUS_RESET: AtomicBool = AtomicBool::new(false);
 
@@ -13,7 +13,7 @@ use std::{
     ops::Deref,
     os::raw::c_void,
     pin::Pin,
-    sync::atomic::Ordering,
+    sync::{atomic::Ordering, Arc},
 };
 
 use crossbeam::atomic::AtomicCell;
@@ -32,6 +32,8 @@ use super::{
     NexusBio,
     NexusChannel,
     NexusChild,
+    NexusFreezeLatency,
+    NexusIoLatency,
     NexusModule,
     PersistOp,
 };
@@ -40,8 +42,12 @@ use crate::{
     bdev::{
         device_destroy,
         nexus::{
+            nexus_integrity::IntegrityMap,
+            nexus_io_log_persistence::PendingIoLogs,
             nexus_io_subsystem::NexusPauseState,
             nexus_persistence::PersistentNexusInfo,
+            nexus_qos::QosLimiter,
+            nexus_read_cache::ReadCache,
             NexusIoSubsystem,
             ENABLE_NEXUS_RESET,
         },
@@ -274,6 +280,14 @@ pub struct Nexus<'n> {
     initiators: parking_lot::Mutex<HashSet<String>>,
     /// Information associated with the persisted NexusInfo structure.
     pub(super) nexus_info: futures::lock::Mutex<PersistentNexusInfo>,
+    /// Restored I/O logs of the children yet to be added.
+    pub(super) pending_io_logs: PendingIoLogs,
+    /// Checksum table for integrity checking, if enabled.
+    pub(super) integrity: parking_lot::Mutex<Option<Arc<IntegrityMap>>>,
+    /// Rate limiter of the nexus I/O, if QoS limits are set.
+    pub(super) qos: parking_lot::Mutex<Option<Arc<QosLimiter>>>,
+    /// Read cache of the nexus, if set up.
+    pub(super) read_cache: parking_lot::Mutex<Option<Arc<ReadCache>>>,
     /// Nexus I/O subsystem.
     io_subsystem: Option<NexusIoSubsystem<'n>>,
     /// TODO
@@ -284,6 +298,11 @@ pub struct Nexus<'n> {
     pub(crate) shutdown_requested: AtomicCell<bool>,
     /// Last child I/O error.
     pub(super) last_error: IoCompletionStatus,
+    /// Durations of the I/O freezes of the nexus.
+    pub(super) freeze_latency: parking_lot::Mutex<NexusFreezeLatency>,
+    /// Ticks at which I/O submissions were frozen on the channels, or zero
+    /// if they are not.
+    pub(super) io_frozen_at: AtomicCell<u64>,
     /// Prevent auto-Unpin.
     _pin: PhantomPinned,
 }
@@ -385,12 +404,18 @@ impl<'n> Nexus<'n> {
             nexus_info: futures::lock::Mutex::new(PersistentNexusInfo::new(
                 nexus_info_key,
             )),
+            pending_io_logs: Default::default(),
+            integrity: parking_lot::Mutex::new(None),
+            qos: parking_lot::Mutex::new(None),
+            read_cache: parking_lot::Mutex::new(None),
             io_subsystem: None,
             nexus_uuid: Default::default(),
             event_sink: None,
             rebuild_history: parking_lot::Mutex::new(Vec::new()),
             shutdown_requested: AtomicCell::new(false),
             last_error: IoCompletionStatus::Success,
+            freeze_latency: Default::default(),
+            io_frozen_at: AtomicCell::new(0),
             _pin: Default::default(),
         };
 
@@ -543,6 +568,35 @@ impl<'n> Nexus<'n> {
         bdev.stats_async().await
     }
 
+    /// Collects the I/O latency histograms of all I/O channels of the nexus,
+    /// and the I/O freeze durations of the nexus.
+    pub async fn io_latency(&self) -> NexusIoLatency {
+        let latency = parking_lot::Mutex::new(NexusIoLatency::default());
+
+        if self.has_io_device {
+            self.traverse_io_channels_async(&latency, |channel, latency| {
+                latency.lock().merge(channel.io_latency());
+            })
+            .await;
+        }
+
+        let mut latency = latency.into_inner();
+        latency.freeze.merge(&self.freeze_latency.lock());
+        latency
+    }
+
+    /// Resets the I/O latency histograms of all I/O channels of the nexus,
+    /// and the I/O freeze durations of the nexus.
+    pub async fn reset_io_latency(&self) {
+        self.freeze_latency.lock().reset();
+        if self.has_io_device {
+            self.traverse_io_channels_async((), |channel, _| {
+                channel.reset_io_latency();
+            })
+            .await;
+        }
+    }
+
     /// TODO
     pub fn req_size(&self) -> u64 {
         self.req_size
@@ -824,6 +878,11 @@ impl<'n> Nexus<'n> {
 
         nex.as_mut().setup_nexus_bdev(false).await?;
 
+        // Restore the I/O logs saved at the last shutdown before any I/O
+        // channel is created.
+        nex.load_io_logs().await;
+        nex.init_integrity();
+
         // Register the bdev with SPDK and set the callbacks for io channel
         // creation.
         nex.register_io_device(Some(&nex.name));
@@ -887,6 +946,8 @@ impl<'n> Nexus<'n> {
     ) -> Result<(), Error> {
         info!("{:?}: destroying nexus...", self);
 
+        let was_shutdown = *self.state.lock() == NexusState::Shutdown;
+
         self.as_mut().unshare_nexus().await?;
 
         // wait for all rebuild jobs to be cancelled before proceeding with the
@@ -896,6 +957,14 @@ impl<'n> Nexus<'n> {
             self.as_mut().cancel_rebuild_jobs(&child).await;
         }
 
+        // Keep the I/O logs for the next instance of this nexus only if it is
+        // meant to be recreated; logs saved by a previous shutdown are kept.
+        if sigterm {
+            self.save_io_logs().await;
+        } else if !was_shutdown {
+            self.delete_io_logs().await;
+        }
+
         self.close_children().await;
 
         // Persist the fact that the nexus destruction has completed.
@@ -1088,7 +1157,9 @@ impl<'n> Nexus<'n> {
             self.as_mut().cancel_rebuild_jobs(&child).await;
         }
 
-        // Step 3: Close all nexus children.
+        // Step 3: Save the I/O logs of out-of-sync children, now that the I/O
+        // is paused, and close all nexus children.
+        self.save_io_logs().await;
         self.close_children().await;
 
         // Step 4: Mark nexus as being properly shutdown in ETCd.
@@ -23,7 +23,11 @@
 //! When reconfiguring the nexus, we traverse all our children, create new IO
 //! channels for all children that are in the open state.
 
-use std::{cmp::min, pin::Pin};
+use std::{
+    cmp::min,
+    pin::Pin,
+    sync::atomic::{AtomicUsize, Ordering},
+};
 
 use futures::channel::oneshot;
 use snafu::ResultExt;
@@ -32,6 +36,7 @@ use super::{
     nexus_err,
     nexus_lookup,
     nexus_lookup_mut,
+    nexus_read_policy::now_ticks,
     ChildState,
     ChildSyncState,
     Error,
@@ -229,6 +234,10 @@ impl<'n> Nexus<'n> {
                 // Register event listener for newly added child.
                 child.set_event_listener(self.get_event_sink());
 
+                // Let the child resume with the I/O log saved at the last
+                // shutdown of the nexus, if any.
+                self.restore_child_io_log(&child);
+
                 unsafe {
                     self.as_mut().child_add_unsafe(child);
                 }
@@ -822,8 +831,9 @@ impl<'n> Nexus<'n> {
         // We must start I/O log _before_ changing the state of the child.
         // Otherwise, any reconfiguration (Nexus::reconfigure()) that may run
         // in parallel, would skip connecting both child's device as a writer
-        // and child's I/O log.
-        let has_io_log = c.start_io_log();
+        // and child's I/O log. A child which cannot be onlined again is not
+        // to be partially rebuilt, and gets no I/O log.
+        let has_io_log = reason.is_recoverable() && c.start_io_log();
 
         // Fail and retire an open child.
         if Ok(ChildState::Open)
@@ -883,11 +893,13 @@ impl<'n> Nexus<'n> {
         }
     }
 
-    /// Returns list of I/O log channels of all children for the current core.
+    /// Returns list of I/O log channels of all children for the current core,
+    /// including the restored logs of the children yet to be added.
     pub(super) fn io_log_channels(&self) -> Vec<IOLogChannel> {
         self.children_iter()
             .filter(|c| !c.is_rebuilding())
             .filter_map(|c| c.io_log_channel())
+            .chain(self.pending_io_log_channels())
             .collect()
     }
 
@@ -982,20 +994,20 @@ impl<'n> Nexus<'n> {
         // resubmit and succeeded (if any healthy children are left).
         //
         // Device disconnection is done in two steps (detach, than disconnect)
-        // in order to prevent an I/O race when retiring a device.
-        self.detach_device(&dev).await;
-
-        // Disconnect the devices with failed controllers _before_ pause,
-        // otherwise pause would stuck. Keep all controoled that are _not_
-        // failed (e.g., in the case I/O failed due to ENOSPC).
-        self.traverse_io_channels_async((), |channel, _| {
-            channel.disconnect_detached_devices(|h| h.is_ctrlr_failed());
-        })
-        .await;
-
-        // Disconnect, destroy and close the device. The subsystem must be
-        // paused to do this properly.
-        {
+        // in order to prevent an I/O race when retiring a device. The race
+        // only exists on the channels with I/O in flight: the others
+        // disconnect the device right away.
+        let busy = self.detach_and_disconnect_device(&dev).await;
+
+        if busy == 0 && !matches!(self.status(), NexusStatus::Faulted) {
+            // Fast path: no channel holds the device anymore, so it can be
+            // destroyed without pausing the whole nexus. A faulted nexus
+            // still goes through the pause, to be left frozen on resume.
+            debug!("{self:?}: retire: no I/O in flight, not pausing");
+            self.child_retire_destroy_device(&dev).await;
+        } else {
+            // Disconnect, destroy and close the device. The subsystem must be
+            // paused to do this properly.
             debug!("{self:?}: retire: pausing...");
             let res = self.as_mut().pause().await;
             match &res {
@@ -1099,6 +1111,49 @@ impl<'n> Nexus<'n> {
         debug!("{self:?}: '{dev}' detached from all I/O channels");
     }
 
+    /// Detaches the device's handles from all I/O channels, and disconnects
+    /// them at once on the channels with no I/O in flight. The detached
+    /// handles of failed controllers are disconnected on all channels, as
+    /// they would otherwise prevent the nexus from pausing.
+    ///
+    /// Returns the number of channels which still hold detached handles,
+    /// which must be disconnected by a `disconnect_all_detached_devices()`
+    /// call once the nexus is paused.
+    async fn detach_and_disconnect_device(&self, dev: &str) -> usize {
+        if !self.has_io_device {
+            return 0;
+        }
+
+        debug!("{self:?}: detaching and disconnecting '{dev}'...");
+
+        let busy = AtomicUsize::new(0);
+        self.traverse_io_channels_async(
+            (dev, &busy),
+            |channel, (dev, busy)| {
+                channel.detach_device(dev);
+
+                // Keep the controllers that are _not_ failed (e.g., in the case
+                // I/O failed due to ENOSPC) while I/Os may still use them.
+                let idle = channel.ios_in_flight() == 0;
+                channel.disconnect_detached_devices(|h| {
+                    idle || h.is_ctrlr_failed()
+                });
+
+                if channel.has_detached_devices() {
+                    busy.fetch_add(1, Ordering::Relaxed);
+                }
+            },
+        )
+        .await;
+
+        let busy = busy.into_inner();
+        debug!(
+            "{self:?}: '{dev}' detached from all I/O channels, \
+            {busy} channel(s) with I/O in flight"
+        );
+        busy
+    }
+
     /// Disconnects all the detached devices on all I/O channels by dropping
     /// their handles.
     pub(crate) async fn disconnect_all_detached_devices(&self) {
@@ -1144,11 +1199,23 @@ impl<'n> Nexus<'n> {
 
         debug!("{self:?}: set I/O mode to {mode:?} ...");
 
+        if matches!(mode, IoMode::Freeze) {
+            let _ = self.io_frozen_at.compare_exchange(0, now_ticks());
+        }
+
         self.traverse_io_channels_async(mode, |channel, mode| {
             channel.set_io_mode(*mode);
         })
         .await;
 
+        if matches!(mode, IoMode::Normal) {
+            let frozen_at = self.io_frozen_at.swap(0);
+            if frozen_at != 0 {
+                let ticks = now_ticks().saturating_sub(frozen_at);
+                self.freeze_latency.lock().io_freeze.record(ticks);
+            }
+        }
+
         debug!("{self:?}: set I/O mode to {mode:?}: done");
     }
 
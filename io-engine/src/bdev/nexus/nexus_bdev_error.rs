@@ -222,6 +222,18 @@ pub enum Error {
     UpdateShareProperties { source: CoreError, name: String },
     #[snafu(display("failed to save nexus state {}", name))]
     SaveStateFailed { source: StoreError, name: String },
+    #[snafu(display(
+        "Failed to set up read cache of nexus {}: {}",
+        name,
+        reason
+    ))]
+    ReadCache { name: String, reason: String },
+    #[snafu(display(
+        "Failed to set up integrity checking of nexus {}: {}",
+        name,
+        reason
+    ))]
+    Integrity { name: String, reason: String },
 }
 
 impl From<NvmfError> for Error {
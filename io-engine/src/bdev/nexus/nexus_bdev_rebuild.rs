@@ -1,6 +1,9 @@
 use futures::channel::oneshot::Receiver;
 use snafu::ResultExt;
-use std::{marker::PhantomData, sync::Arc};
+use std::{
+    marker::PhantomData,
+    sync::{atomic::Ordering, Arc},
+};
 
 use super::{
     nexus_err,
@@ -17,13 +20,17 @@ use crate::{
     core::{Reactors, VerboseError},
     eventing::{EventMetaGen, EventWithMeta},
     rebuild::{
+        snapshot_delta_map,
         HistoryRecord,
         NexusRebuildJob,
         NexusRebuildJobStarter,
+        RebuildBudget,
         RebuildError,
         RebuildJobOptions,
+        RebuildMap,
         RebuildState,
         RebuildStats,
+        RebuildVerifyMethod,
         RebuildVerifyMode,
     },
 };
@@ -144,9 +151,18 @@ impl<'n> Nexus<'n> {
         // As this is done after the reconfiguration, any new write I/Os will
         // now reach the destination child, and no rebuild will be required
         // for them.
-        let map = self
+        // Without an I/O log, e.g. after a long outage, fall back to the
+        // blocks written since the newest snapshot common to both children.
+        let map = match self
             .lookup_child(&dst_child_uri)
-            .and_then(|c| c.stop_io_log());
+            .and_then(|c| c.stop_io_log())
+        {
+            Some(map) => Some(map),
+            None => {
+                self.snapshot_delta_map(&src_child_uri, &dst_child_uri)
+                    .await
+            }
+        };
 
         starter
             .start(self.rebuild_job_mut(&dst_child_uri)?, map)
@@ -157,6 +173,35 @@ impl<'n> Nexus<'n> {
             })
     }
 
+    /// Creates a rebuild map of the blocks written since the newest snapshot
+    /// common to the source and destination children, if their replicas,
+    /// local or remote, share a nexus snapshot.
+    async fn snapshot_delta_map(
+        &self,
+        src_child_uri: &str,
+        dst_child_uri: &str,
+    ) -> Option<RebuildMap> {
+        if !super::ENABLE_PARTIAL_REBUILD.load(Ordering::SeqCst) {
+            return None;
+        }
+
+        let src = self
+            .lookup_child(src_child_uri)?
+            .get_io_handle_nonblock()
+            .await;
+        let dst = self
+            .lookup_child(dst_child_uri)?
+            .get_io_handle_nonblock()
+            .await;
+        let (Ok(src), Ok(dst)) = (src, dst) else {
+            return None;
+        };
+
+        let map = snapshot_delta_map(&*src, &*dst).await?;
+        info!("{self:?}: rebuilding '{dst_child_uri}' from snapshot delta");
+        Some(map)
+    }
+
     /// TODO
     async fn create_rebuild_job(
         &self,
@@ -184,8 +229,28 @@ impl<'n> Nexus<'n> {
             _ => RebuildVerifyMode::None,
         };
 
+        let verify_method =
+            match std::env::var("NEXUS_REBUILD_VERIFY_METHOD").as_deref() {
+                Ok("crc32c") => RebuildVerifyMethod::Crc32c,
+                _ => RebuildVerifyMethod::Compare,
+            };
+
+        let verify_interval = std::env::var("NEXUS_REBUILD_VERIFY_INTERVAL")
+            .ok()
+            .and_then(|v| v.parse::<u64>().ok())
+            .unwrap_or(1);
+
+        if !matches!(verify_mode, RebuildVerifyMode::None) {
+            info!(
+                "{self:?}: rebuild verification of '{dst_child_uri}': \
+                {verify_method:?}, every {verify_interval} segment(s)"
+            );
+        }
+
         let opts = RebuildJobOptions {
             verify_mode,
+            verify_method,
+            verify_interval,
         };
 
         NexusRebuildJob::new_starter(
@@ -282,6 +347,22 @@ impl<'n> Nexus<'n> {
         })
     }
 
+    /// Sets the bandwidth and IOPS budget of a rebuild job.
+    pub async fn set_rebuild_budget(
+        &self,
+        dst_uri: &str,
+        budget: RebuildBudget,
+    ) -> Result<(), Error> {
+        let name = self.name.clone();
+        let rj = self.rebuild_job_mut(dst_uri)?;
+        rj.set_budget(budget)
+            .await
+            .context(nexus_err::RebuildOperation {
+                job: dst_uri.to_owned(),
+                name,
+            })
+    }
+
     /// Returns the state of a rebuild job for the given destination.
     pub fn rebuild_state(&self, dst_uri: &str) -> Result<RebuildState, Error> {
         let rj = self.rebuild_job(dst_uri)?;
@@ -2,27 +2,93 @@
 //! IO is driven by means of so called channels.
 use std::{
     cell::UnsafeCell,
+    collections::VecDeque,
     fmt::{Debug, Display, Formatter},
     pin::Pin,
-    sync::atomic::Ordering,
+    sync::{atomic::Ordering, Arc},
+    time::Duration,
 };
 
-use super::{FaultReason, IOLogChannel, Nexus, NexusBio};
+use super::{
+    nexus_integrity::IntegrityMap,
+    nexus_io::WriteBatch,
+    nexus_qos::{
+        qos_backlog_add,
+        qos_backlog_remove,
+        qos_release_share,
+        QosLimiter,
+        QOS_POLL_PERIOD,
+    },
+    nexus_read_cache::ReadCache,
+    nexus_read_policy::{now_ticks, read_policy, ReadPolicy, ReaderStats},
+    FaultReason,
+    IOLogChannel,
+    Nexus,
+    NexusBio,
+    NexusIoLatency,
+};
+
+use crate::core::{
+    BlockDeviceHandle,
+    CoreError,
+    Cores,
+    IoType,
+    StatsShmKind,
+    StatsShmSlot,
+};
+use spdk_rs::{Poller, PollerBuilder, Thread};
 
-use crate::core::{BlockDeviceHandle, CoreError, Cores};
-use spdk_rs::Thread;
+/// Period of the retries of the I/Os waiting for resources, when no I/O
+/// completes on their channel to trigger them.
+const NOMEM_RETRY_PERIOD: Duration = Duration::from_micros(100);
 
 /// I/O channel, per core.
 #[repr(C)]
 pub struct NexusChannel<'n> {
     writers: Vec<Box<dyn BlockDeviceHandle>>,
     readers: Vec<Box<dyn BlockDeviceHandle>>,
+    reader_stats: Vec<ReaderStats>,
+    /// Identifier to give to the next new reader of the channel. Reads
+    /// record the identifier of their reader, so that their completions
+    /// account into the statistics of that reader whatever the changes of
+    /// the readers list in the meantime.
+    next_reader_id: u32,
     detached: Vec<Box<dyn BlockDeviceHandle>>,
     io_logs: Vec<IOLogChannel>,
+    /// Checksum table of the nexus, if integrity checking is enabled.
+    integrity: Option<Arc<IntegrityMap>>,
+    /// Rate limiter of the nexus, if QoS limits are set.
+    qos: Option<Arc<QosLimiter>>,
+    /// Reads and writes held back by the QoS limits, in submission order,
+    /// with the tick count they were queued at.
+    throttled_ios: VecDeque<(NexusBio<'n>, u64)>,
+    /// Poller releasing the throttled I/Os, created on the first throttled
+    /// I/O.
+    qos_poller: Option<Poller<'n>>,
+    /// Read cache of the nexus, if set up.
+    read_cache: Option<Arc<ReadCache>>,
     previous_reader: UnsafeCell<usize>,
     fail_fast: u32,
     io_mode: IoMode,
     frozen_ios: Vec<NexusBio<'n>>,
+    /// I/Os whose submission failed for lack of resources, in submission
+    /// order, waiting to be submitted again.
+    nomem_ios: VecDeque<NexusBio<'n>>,
+    /// Poller retrying the I/Os waiting for resources, created on the first
+    /// such I/O.
+    nomem_poller: Option<Poller<'n>>,
+    /// Latency histograms of the I/Os completed on this channel.
+    io_latency: NexusIoLatency,
+    /// Shared memory statistics record of this channel, if exported.
+    stats_shm: Option<StatsShmSlot>,
+    /// Writes held back to be coalesced, not yet submitted.
+    write_batch: Option<WriteBatch<'n>>,
+    /// Number of nexus writes submitted to the children and not yet
+    /// completed.
+    writes_in_flight: u32,
+    /// Number of nexus I/Os of any type submitted to the children and not
+    /// yet completed.
+    ios_in_flight: u32,
     nexus: Pin<&'n mut Nexus<'n>>,
     core: u32,
     is_io_chan: bool,
@@ -62,6 +128,12 @@ pub enum DrEvent {
     ChildUnplug,
     /// Child rebuild event.
     ChildRebuild,
+    /// Integrity checking enabled or disabled.
+    IntegrityChange,
+    /// QoS limits set or removed.
+    QosChange,
+    /// Read cache set up or removed.
+    ReadCacheChange,
 }
 
 impl Display for DrEvent {
@@ -72,6 +144,9 @@ impl Display for DrEvent {
             match self {
                 Self::ChildUnplug => "unplug",
                 Self::ChildRebuild => "rebuild",
+                Self::IntegrityChange => "integrity change",
+                Self::QosChange => "QoS change",
+                Self::ReadCacheChange => "read cache change",
             }
         )
     }
@@ -112,16 +187,36 @@ impl<'n> NexusChannel<'n> {
             );
         }
 
+        let stats_shm = if is_io_chan {
+            StatsShmSlot::new(StatsShmKind::Nexus, &nexus.name)
+        } else {
+            None
+        };
+
         let mut res = Self {
             writers: Vec::new(),
             readers: Vec::new(),
+            reader_stats: Vec::new(),
+            next_reader_id: 1,
             detached: Vec::new(),
             io_logs: nexus.io_log_channels(),
+            integrity: nexus.integrity_map(),
+            qos: nexus.qos_limiter(),
+            throttled_ios: VecDeque::new(),
+            qos_poller: None,
+            read_cache: nexus.read_cache(),
             previous_reader: UnsafeCell::new(0),
             nexus: unsafe { nexus.pinned_mut() },
             fail_fast: 0,
             io_mode: IoMode::Normal,
             frozen_ios: Vec::new(),
+            nomem_ios: VecDeque::new(),
+            nomem_poller: None,
+            io_latency: NexusIoLatency::default(),
+            stats_shm,
+            write_batch: None,
+            writes_in_flight: 0,
+            ios_in_flight: 0,
             core: Cores::current(),
             is_io_chan,
         };
@@ -145,8 +240,26 @@ impl<'n> NexusChannel<'n> {
         );
         self.writers.clear();
         self.readers.clear();
+        self.reader_stats.clear();
         self.detached.clear();
         self.io_logs.clear();
+
+        self.qos_poller = None;
+        if !self.throttled_ios.is_empty() {
+            if let Some(qos) = &self.qos {
+                qos.dequeued(self.throttled_ios.len() as u64, 0);
+                qos_backlog_remove(qos.weight());
+            }
+            self.throttled_ios.drain(..).for_each(|(io, _)| io.fail());
+        }
+
+        self.nomem_poller = None;
+        self.nomem_ios.drain(..).for_each(|io| io.fail());
+
+        // No write is left in flight to submit the pending write batch.
+        if let Some(batch) = self.write_batch.take() {
+            batch.fail();
+        }
     }
 
     /// Returns reference to channel's Nexus.
@@ -190,28 +303,201 @@ impl<'n> NexusChannel<'n> {
         self.io_logs.iter().for_each(f)
     }
 
-    /// Very simplistic routine to rotate between children for read operations
-    /// note that the channels can be None during a reconfigure; this is usually
-    /// not the case but a side effect of using the async. As we poll
+    /// Selects a reader for a read operation according to the current read
+    /// policy, excluding the reader with the given identifier, if not zero,
+    /// and returns its index along with its handle. When excluding a
+    /// reader, the round-robin policy also skips the failed readers, as the
+    /// other policies always do.
+    /// Note that the channels can be None during a reconfigure; this is
+    /// usually not the case but a side effect of using the async. As we poll
     /// threads more often depending on what core we are on etc, we might be
     /// "awaiting' while the thread is already trying to submit IO.
-    pub(crate) fn select_reader(&self) -> Option<&dyn BlockDeviceHandle> {
+    pub(crate) fn select_reader(
+        &self,
+        exclude: u32,
+    ) -> Option<(usize, &dyn BlockDeviceHandle)> {
         if self.readers.is_empty() {
-            None
+            return None;
+        }
+
+        let other = |s: &ReaderStats| s.id() != exclude;
+        let idx = match read_policy() {
+            ReadPolicy::RoundRobin if exclude == 0 => Some(self.next_reader()),
+            ReadPolicy::RoundRobin => self.min_reader(other, |_| 0),
+            ReadPolicy::LeastOutstanding => {
+                self.min_reader(other, |s| s.outstanding() as u64)
+            }
+            ReadPolicy::MinLatency => {
+                self.min_reader(other, |s| s.expected_ticks())
+            }
+            ReadPolicy::PreferLocal => self
+                .min_reader(
+                    |s| other(s) && s.is_local(),
+                    |s| s.outstanding() as u64,
+                )
+                .or_else(|| self.min_reader(other, |s| s.outstanding() as u64)),
+        }?;
+
+        Some((idx, self.readers[idx].as_ref()))
+    }
+
+    /// Very simplistic routine to rotate between readers.
+    #[inline(always)]
+    fn next_reader(&self) -> usize {
+        unsafe {
+            let idx = &mut *self.previous_reader.get();
+            if *idx < self.readers.len() - 1 {
+                *idx += 1;
+            } else {
+                *idx = 0;
+            }
+            *idx
+        }
+    }
+
+    /// Finds the reader with the minimal cost among the readers matching the
+    /// given filter and not having failed submissions. The scan starts at a
+    /// rotating position, so that readers with equal costs are used evenly.
+    #[inline(always)]
+    fn min_reader<F, C>(&self, filter: F, cost: C) -> Option<usize>
+    where
+        F: Fn(&ReaderStats) -> bool,
+        C: Fn(&ReaderStats) -> u64,
+    {
+        let n = self.readers.len();
+        let start = self.next_reader();
+
+        (0 .. n)
+            .map(|i| (start + i) % n)
+            .filter(|&i| {
+                let s = &self.reader_stats[i];
+                !s.is_failed() && filter(s)
+            })
+            .min_by_key(|&i| cost(&self.reader_stats[i]))
+    }
+
+    /// Returns the identifier of the reader at the given index.
+    #[inline(always)]
+    pub(super) fn reader_id(&self, idx: usize) -> u32 {
+        self.reader_stats[idx].id()
+    }
+
+    /// Accounts a read I/O submitted to the reader at the given index.
+    #[inline(always)]
+    pub(super) fn reader_submitted(&self, idx: usize) {
+        self.reader_stats[idx].submitted();
+    }
+
+    /// Accounts a failed read submission to the reader at the given index.
+    #[inline(always)]
+    pub(super) fn reader_submission_failed(&self, idx: usize) {
+        self.reader_stats[idx].submission_failed();
+    }
+
+    /// Accounts a read which returned corrupted data from the reader with
+    /// the given identifier, and returns the number of readers left to
+    /// retry the read on.
+    pub(super) fn reader_verify_failed(&self, id: u32) -> usize {
+        if let Some(s) = self.reader_stats.iter().find(|s| s.id() == id) {
+            s.verify_failed();
+        }
+        self.reader_stats.iter().filter(|s| !s.is_failed()).count()
+    }
+
+    /// Accounts a completed read I/O, submitted at `start_ticks` to the
+    /// reader with the given identifier. Completions of readers removed
+    /// from the channel in the meantime are not accounted.
+    #[inline(always)]
+    pub(super) fn reader_completed(&mut self, id: u32, start_ticks: u64) {
+        if let Some(s) = self.reader_stats.iter().find(|s| s.id() == id) {
+            let sample = now_ticks().saturating_sub(start_ticks);
+            s.completed(sample);
+            self.io_latency.record_child_read(s.latency_idx(), sample);
+        }
+    }
+
+    /// Records the latency of a completed nexus I/O of the given size.
+    #[inline(always)]
+    pub(super) fn record_io_latency(
+        &mut self,
+        io_type: IoType,
+        num_bytes: u64,
+        ticks: u64,
+    ) {
+        self.io_latency.record(io_type, ticks);
+        if let Some(shm) = &self.stats_shm {
+            shm.account(io_type, 1, num_bytes, ticks);
+        }
+    }
+
+    /// Returns the latency histograms of this channel.
+    pub(super) fn io_latency(&self) -> &NexusIoLatency {
+        &self.io_latency
+    }
+
+    /// Resets the latency histograms of this channel.
+    pub(super) fn reset_io_latency(&mut self) {
+        self.io_latency.reset();
+    }
+
+    /// Returns the number of nexus writes in flight on this channel.
+    #[inline(always)]
+    pub(super) fn writes_in_flight(&self) -> u32 {
+        self.writes_in_flight
+    }
+
+    /// Accounts nexus writes submitted to the children.
+    #[inline(always)]
+    pub(super) fn writes_submitted(&mut self, n: u32) {
+        self.writes_in_flight += n;
+    }
+
+    /// Accounts a completed nexus write. Returns the pending write batch
+    /// once no more writes are in flight, as there is then no completion
+    /// left to trigger its submission.
+    #[inline(always)]
+    pub(super) fn write_completed(&mut self) -> Option<WriteBatch<'n>> {
+        debug_assert!(self.writes_in_flight > 0);
+        self.writes_in_flight = self.writes_in_flight.saturating_sub(1);
+        if self.writes_in_flight == 0 {
+            self.write_batch.take()
         } else {
-            let idx = unsafe {
-                let idx = &mut *self.previous_reader.get();
-                if *idx < self.readers.len() - 1 {
-                    *idx += 1;
-                } else {
-                    *idx = 0;
-                }
-                *idx
-            };
-            Some(self.readers[idx].as_ref())
+            None
         }
     }
 
+    /// Returns the number of nexus I/Os in flight on this channel.
+    #[inline(always)]
+    pub(super) fn ios_in_flight(&self) -> u32 {
+        self.ios_in_flight
+    }
+
+    /// Accounts nexus I/Os submitted to the children.
+    #[inline(always)]
+    pub(super) fn ios_submitted(&mut self, n: u32) {
+        self.ios_in_flight += n;
+    }
+
+    /// Accounts a nexus I/O whose child I/Os have all completed.
+    #[inline(always)]
+    pub(super) fn io_completed(&mut self) {
+        debug_assert!(self.ios_in_flight > 0);
+        self.ios_in_flight = self.ios_in_flight.saturating_sub(1);
+    }
+
+    /// Takes the pending write batch, if any.
+    #[inline(always)]
+    pub(super) fn take_write_batch(&mut self) -> Option<WriteBatch<'n>> {
+        self.write_batch.take()
+    }
+
+    /// Sets the pending write batch.
+    #[inline(always)]
+    pub(super) fn set_write_batch(&mut self, batch: WriteBatch<'n>) {
+        debug_assert!(self.write_batch.is_none());
+        self.write_batch = Some(batch);
+    }
+
     /// Detaches a child device from this I/O channel, moving the device's
     /// handles to the list of detached devices to disconnect later.
     ///
@@ -226,6 +512,7 @@ impl<'n> NexusChannel<'n> {
             .position(|c| c.get_device().device_name() == device_name)
         {
             let t = self.readers.remove(d);
+            self.reader_stats.remove(d);
             self.detached.push(t);
         }
 
@@ -246,6 +533,12 @@ impl<'n> NexusChannel<'n> {
         }
     }
 
+    /// Determines if this channel has detached device handles left to
+    /// disconnect.
+    pub(super) fn has_detached_devices(&self) -> bool {
+        !self.detached.is_empty()
+    }
+
     /// Disconnects previously detached device handles by dropping them.
     /// Devices to drop are filtered by the given predicate: true to drop
     /// a device, false to keep it.
@@ -292,6 +585,9 @@ impl<'n> NexusChannel<'n> {
         }
 
         self.reconnect_io_logs();
+        self.integrity = self.nexus().integrity_map();
+        self.reconnect_qos();
+        self.read_cache = self.nexus().read_cache();
 
         if is_channel_debug_enabled() {
             debug!("{self:?}: after reconnection:");
@@ -310,6 +606,7 @@ impl<'n> NexusChannel<'n> {
 
         let mut writers = Vec::new();
         let mut readers = Vec::new();
+        let mut reader_info = Vec::new();
 
         // iterate over all our children which are in the healthy state
         self.nexus()
@@ -319,6 +616,10 @@ impl<'n> NexusChannel<'n> {
                 (Ok(w), Ok(r)) => {
                     writers.push(w);
                     readers.push(r);
+                    reader_info.push((
+                        c.uri().to_string(),
+                        c.is_local().unwrap_or(false),
+                    ));
 
                     debug!("{self:?}: connecting child device : {c:?}");
                 }
@@ -351,8 +652,170 @@ impl<'n> NexusChannel<'n> {
                 });
         }
 
+        // Keep the latency histograms of the children still in the nexus.
+        let uris: Vec<String> = self
+            .nexus()
+            .children_iter()
+            .map(|c| c.uri().to_string())
+            .collect();
+        self.io_latency
+            .retain_children(|uri| uris.iter().any(|u| u == uri));
+
+        // Keep the statistics of the readers still connected, so that the
+        // reads in flight on them are accounted when they complete.
+        let mut old_stats = std::mem::take(&mut self.reader_stats);
+        let reader_stats = reader_info
+            .iter()
+            .map(|(uri, is_local)| {
+                let latency_idx = self.io_latency.child_index(uri);
+                match old_stats.iter().position(|s| s.uri() == uri) {
+                    Some(i) => {
+                        old_stats.swap_remove(i).reconnected(latency_idx)
+                    }
+                    None => {
+                        let id = self.next_reader_id;
+                        self.next_reader_id = id.wrapping_add(1).max(1);
+                        ReaderStats::new(id, uri, *is_local, latency_idx)
+                    }
+                }
+            })
+            .collect();
+
         self.writers = writers;
         self.readers = readers;
+        self.reader_stats = reader_stats;
+    }
+
+    /// Returns the checksum table of the nexus, if integrity checking is
+    /// enabled.
+    #[inline(always)]
+    pub(super) fn integrity(&self) -> Option<&IntegrityMap> {
+        self.integrity.as_deref()
+    }
+
+    /// Switches to the current rate limiter of the nexus. The throttled I/Os
+    /// are moved to the new limiter, or released if the limits were removed.
+    fn reconnect_qos(&mut self) {
+        let qos = self.nexus().qos_limiter();
+        let same = match (&self.qos, &qos) {
+            (Some(a), Some(b)) => Arc::ptr_eq(a, b),
+            (None, None) => true,
+            _ => false,
+        };
+        if same {
+            return;
+        }
+
+        let n = self.throttled_ios.len() as u64;
+        if n > 0 {
+            if let Some(old) = &self.qos {
+                old.dequeued(n, 0);
+                qos_backlog_remove(old.weight());
+            }
+        }
+
+        self.qos = qos;
+
+        match &self.qos {
+            Some(qos) => {
+                if n > 0 {
+                    qos.queued(n, false);
+                    qos_backlog_add(qos.weight());
+                }
+            }
+            None => {
+                self.qos_poller = None;
+                self.throttled_ios
+                    .drain(..)
+                    .for_each(|(io, _)| io.submit_throttled());
+            }
+        }
+    }
+
+    /// Holds back the given read or write if it exceeds the QoS limits of
+    /// the nexus, or if earlier I/Os are already held back. Returns true if
+    /// the I/O was queued, to be submitted by the QoS poller.
+    pub(super) fn qos_throttle(&mut self, io: &NexusBio<'n>) -> bool {
+        let Some(qos) = &self.qos else {
+            return false;
+        };
+
+        let io_type = io.io_type();
+        if !QosLimiter::is_limited(io_type) {
+            return false;
+        }
+
+        let now = now_ticks();
+        let was_idle = self.throttled_ios.is_empty();
+        if was_idle && qos.admit(io_type, io.num_bytes(), now) {
+            return false;
+        }
+
+        trace!("{io:?}: throttling I/O");
+        qos.queued(1, true);
+        if was_idle {
+            qos_backlog_add(qos.weight());
+        }
+
+        self.throttled_ios.push_back((io.clone(), now));
+
+        if self.qos_poller.is_none() {
+            let chan = self as *mut Self;
+            self.qos_poller = Some(
+                PollerBuilder::new()
+                    .with_interval(QOS_POLL_PERIOD)
+                    .with_poll_fn(move |_| unsafe {
+                        (*chan).release_throttled()
+                    })
+                    .build(),
+            );
+        }
+
+        true
+    }
+
+    /// Submits the throttled I/Os the QoS limits admit, in order, up to the
+    /// share of this channel of the release budget of the core. The QoS
+    /// poller is stopped once all the throttled I/Os are released.
+    fn release_throttled(&mut self) -> i32 {
+        let Some(qos) = self.qos.clone() else {
+            return 0;
+        };
+
+        let now = now_ticks();
+        let mut released = 0;
+        let share = qos_release_share(qos.weight());
+
+        while released < share {
+            let Some((io, _)) = self.throttled_ios.front() else {
+                break;
+            };
+            if !qos.admit(io.io_type(), io.num_bytes(), now) {
+                break;
+            }
+
+            let (io, queued_at) = self.throttled_ios.pop_front().unwrap();
+            qos.dequeued(1, now.saturating_sub(queued_at));
+            io.submit_throttled();
+            released += 1;
+        }
+
+        if self.throttled_ios.is_empty() {
+            if released > 0 {
+                qos_backlog_remove(qos.weight());
+            }
+            // Nothing is held back any more: stop polling until the next
+            // I/O is throttled.
+            self.qos_poller = None;
+        }
+
+        (released > 0) as i32
+    }
+
+    /// Returns the read cache of the nexus, if set up.
+    #[inline(always)]
+    pub(super) fn read_cache(&self) -> Option<&ReadCache> {
+        self.read_cache.as_deref()
     }
 
     /// Reconnects all active I/O logs.
@@ -422,6 +885,56 @@ impl<'n> NexusChannel<'n> {
         self.frozen_ios.push(io)
     }
 
+    /// Parks a Nexus I/O whose submission failed for lack of resources. It
+    /// is submitted again after the next I/O completion on this channel, or
+    /// by the retry poller if none comes. The retry poller only runs while
+    /// I/Os are parked.
+    pub(super) fn park_nomem(&mut self, io: NexusBio<'n>) {
+        trace!("{io:?}: parking I/O until resources are available");
+        self.nomem_ios.push_back(io);
+
+        if self.nomem_poller.is_none() {
+            let chan = self as *mut Self;
+            self.nomem_poller = Some(
+                PollerBuilder::new()
+                    .with_interval(NOMEM_RETRY_PERIOD)
+                    .with_poll_fn(move |_| unsafe { (*chan).resubmit_nomem() })
+                    .build(),
+            );
+        }
+    }
+
+    /// Takes the I/Os waiting for resources, if any.
+    #[inline(always)]
+    pub(super) fn take_nomem_ios(&mut self) -> Option<VecDeque<NexusBio<'n>>> {
+        if self.nomem_ios.is_empty() {
+            None
+        } else {
+            Some(std::mem::take(&mut self.nomem_ios))
+        }
+    }
+
+    /// Submits again all the I/Os waiting for resources. Those still lacking
+    /// resources are parked again. The retry poller is stopped once no I/O
+    /// is left waiting, and started again by the next park.
+    fn resubmit_nomem(&mut self) -> i32 {
+        let Some(ios) = self.take_nomem_ios() else {
+            // Already resubmitted on an I/O completion.
+            self.nomem_poller = None;
+            return 0;
+        };
+
+        ios.into_iter().for_each(|io| {
+            trace!("{io:?}: resubmitting an I/O waiting for resources");
+            io.submit_request();
+        });
+
+        if self.nomem_ios.is_empty() {
+            self.nomem_poller = None;
+        }
+        1
+    }
+
     /// Prints elaborate debug info to the logs.
     fn dump_dbg(&self) {
         let me = format!(
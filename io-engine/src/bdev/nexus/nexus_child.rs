@@ -144,6 +144,9 @@ pub enum FaultReason {
     Offline,
     /// The child has been permanently offlined by a client API call.
     OfflinePermanent,
+    /// The child returned data not matching the checksums of the blocks
+    /// written. The child cannot be trusted anymore, and must be replaced.
+    IntegrityMismatch,
 }
 
 impl Display for FaultReason {
@@ -158,6 +161,7 @@ impl Display for FaultReason {
             Self::AdminCommandFailed => write!(f, "admin command failed"),
             Self::Offline => write!(f, "offline"),
             Self::OfflinePermanent => write!(f, "offline permanent"),
+            Self::IntegrityMismatch => write!(f, "integrity mismatch"),
         }
     }
 }
@@ -1315,13 +1319,14 @@ impl<'c> NexusChild<'c> {
             return false;
         }
 
+        let mut io_log = self.io_log.lock();
+
+        // An out-of-sync child can only have a log restored from the
+        // persistent store, which keeps tracking its writes.
         if self.sync_state() == ChildSyncState::OutOfSync {
-            assert!(self.io_log.lock().is_none());
-            return false;
+            return io_log.is_some();
         }
 
-        let mut io_log = self.io_log.lock();
-
         if io_log.is_none() {
             if let Some(d) = &self.device {
                 *io_log = Some(IOLog::new(
@@ -1343,6 +1348,17 @@ impl<'c> NexusChild<'c> {
         self.io_log.lock().take().map(|log| log.finalize())
     }
 
+    /// Takes the I/O log of this child, if any.
+    pub(super) fn take_io_log(&self) -> Option<IOLog> {
+        self.io_log.lock().take()
+    }
+
+    /// Gives the child an I/O log restored from the persistent store.
+    pub(super) fn restore_io_log(&self, log: IOLog) {
+        debug!("{self:?}: restored I/O log: {log:?}");
+        *self.io_log.lock() = Some(log);
+    }
+
     /// Returns I/O log channel for the current core.
     pub(super) fn io_log_channel(&self) -> Option<IOLogChannel> {
         self.io_log.lock().as_ref().map(|log| log.current_channel())
@@ -0,0 +1,320 @@
+//!
+//! End-to-end data integrity checking of nexus I/O.
+//!
+//! When enabled on a nexus, the CRC32C of every block written through the
+//! nexus is recorded once all children have acknowledged the write, and the
+//! blocks read back from a child are verified against it before the read
+//! completes. A mismatch means the child returned other data than what was
+//! written: the read is retried, on another child when the read policy picks
+//! one, and failed with a guard check error once every reader was tried.
+//!
+//! The checksums are computed by SPDK's CRC32C, which uses the SSE4.2 or
+//! ISA-L instructions of the CPU, and are kept in memory only, along with the
+//! sequence number of the latest write of each block, 8 bytes per block: the
+//! children are lvols without block metadata, so the checksums cannot be
+//! stored with the data. The table is lost when the nexus is destroyed or
+//! the io-engine restarts, and blocks are therefore verified only once
+//! written through this nexus instance. Blocks added by a resize are not
+//! verified until integrity checking is enabled again. The memory of the
+//! tables of all nexuses of the node is bounded by `NEXUS_INTEGRITY_NODE_MB`
+//! MiB (1024 by default), reserved for the whole nexus when integrity
+//! checking is enabled.
+//!
+//! A write takes a new sequence number when it is submitted, and only
+//! records its checksums in the blocks whose latest write it still is when
+//! it completes. Overlapping writes in flight at the same time may reach
+//! the children in any order, so their blocks are left unknown until
+//! written again. Likewise, a read is not verified against the checksums of
+//! the writes submitted after it.
+use std::{
+    pin::Pin,
+    sync::{
+        atomic::{AtomicU32, AtomicU64, Ordering},
+        Arc,
+    },
+};
+
+use once_cell::sync::{Lazy, OnceCell};
+use spdk_rs::{
+    libspdk::{spdk_crc32c_update, SPDK_CRC32C_INITIAL},
+    IoVec,
+};
+
+use super::{DrEvent, Error, Nexus};
+
+/// Number of blocks of a checksum table chunk.
+const CHUNK_BLOCKS: u64 = 64 * 1024;
+
+/// Checksum of a block whose content is not known, i.e. which was not
+/// written yet or has a write in flight.
+const UNKNOWN_CRC: u32 = 0;
+
+/// Sequence number of no write, left in the entries of blocks written by
+/// overlapping writes.
+const NO_SEQ: u32 = 0;
+
+/// Memory of the checksum tables of all nexuses, in bytes.
+static NODE_TABLE_LIMIT: Lazy<u64> = Lazy::new(|| {
+    std::env::var("NEXUS_INTEGRITY_NODE_MB")
+        .ok()
+        .and_then(|s| s.parse::<u64>().ok())
+        .unwrap_or(1024)
+        * 1024
+        * 1024
+});
+
+/// Memory currently reserved by the checksum tables, in bytes.
+static NODE_TABLE_USED: AtomicU64 = AtomicU64::new(0);
+
+/// Packs the sequence number of the latest write of a block and its
+/// checksum into a table entry.
+#[inline(always)]
+fn entry_value(seq: u32, crc: u32) -> u64 {
+    (seq as u64) << 32 | crc as u64
+}
+
+/// Per block checksums of a nexus. The table is allocated by chunks on the
+/// first write to a chunk, and shared by the I/O channels of all cores.
+pub(crate) struct IntegrityMap {
+    chunks: Box<[OnceCell<Box<[AtomicU64]>>]>,
+    num_blocks: u64,
+    /// Sequence number of the next write.
+    next_seq: AtomicU32,
+    /// Memory reserved for the table, in bytes.
+    size: u64,
+}
+
+impl Drop for IntegrityMap {
+    fn drop(&mut self) {
+        NODE_TABLE_USED.fetch_sub(self.size, Ordering::SeqCst);
+    }
+}
+
+impl IntegrityMap {
+    /// Creates an empty table for the given number of blocks, within the
+    /// memory left to the checksum tables of the node.
+    fn new(name: &str, num_blocks: u64) -> Result<Self, Error> {
+        let size = num_blocks * std::mem::size_of::<AtomicU64>() as u64;
+        NODE_TABLE_USED
+            .fetch_update(Ordering::SeqCst, Ordering::SeqCst, |used| {
+                (used + size <= *NODE_TABLE_LIMIT).then_some(used + size)
+            })
+            .map_err(|used| Error::Integrity {
+                name: name.to_string(),
+                reason: format!(
+                    "the checksum table needs {} MiB, {} MiB left to the \
+                    checksum tables of the node",
+                    (size + (1 << 20) - 1) >> 20,
+                    (*NODE_TABLE_LIMIT).saturating_sub(used) >> 20
+                ),
+            })?;
+
+        let chunks = (0 .. (num_blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS)
+            .map(|_| OnceCell::new())
+            .collect();
+
+        Ok(Self {
+            chunks,
+            num_blocks,
+            next_seq: AtomicU32::new(1),
+            size,
+        })
+    }
+
+    /// Returns the checksum entry of the given block, if its chunk exists.
+    #[inline]
+    fn entry(&self, blk: u64) -> Option<&AtomicU64> {
+        let chunk = self.chunks.get((blk / CHUNK_BLOCKS) as usize)?.get()?;
+        Some(&chunk[(blk % CHUNK_BLOCKS) as usize])
+    }
+
+    /// Returns the checksum entry of the given block, allocating its chunk.
+    #[inline]
+    fn entry_or_alloc(&self, blk: u64) -> Option<&AtomicU64> {
+        let chunk = self
+            .chunks
+            .get((blk / CHUNK_BLOCKS) as usize)?
+            .get_or_init(|| {
+                (0 .. CHUNK_BLOCKS)
+                    .map(|_| AtomicU64::new(entry_value(NO_SEQ, UNKNOWN_CRC)))
+                    .collect()
+            });
+        Some(&chunk[(blk % CHUNK_BLOCKS) as usize])
+    }
+
+    /// Returns the sequence number the next write will take, to be given
+    /// to `verify()` by the reads submitted now.
+    #[inline]
+    pub(crate) fn current_seq(&self) -> u32 {
+        self.next_seq.load(Ordering::Relaxed)
+    }
+
+    /// Forgets the checksums of the given blocks, before they are written,
+    /// and returns the sequence number of the write, to be given to
+    /// `record()` once it completes.
+    pub(crate) fn invalidate(&self, offset: u64, num_blocks: u64) -> u32 {
+        let seq = self.next_seq.fetch_add(1, Ordering::Relaxed).max(1);
+        let end = offset.saturating_add(num_blocks).min(self.num_blocks);
+        (offset .. end).for_each(|blk| {
+            if let Some(e) = self.entry_or_alloc(blk) {
+                e.store(entry_value(seq, UNKNOWN_CRC), Ordering::Relaxed);
+            }
+        });
+        seq
+    }
+
+    /// Records the checksums of the given blocks, once written by the write
+    /// with the given sequence number. The blocks written again since this
+    /// write was submitted are left unknown, as either write may have
+    /// reached the children last.
+    pub(crate) fn record(
+        &self,
+        seq: u32,
+        offset: u64,
+        num_blocks: u64,
+        block_len: u64,
+        iovs: &[IoVec],
+    ) {
+        blocks_crc32c(iovs, block_len, num_blocks, |i, crc| {
+            if let Some(e) = self.entry(offset + i) {
+                if e.compare_exchange(
+                    entry_value(seq, UNKNOWN_CRC),
+                    entry_value(seq, crc),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                )
+                .is_err()
+                {
+                    e.store(
+                        entry_value(NO_SEQ, UNKNOWN_CRC),
+                        Ordering::Relaxed,
+                    );
+                }
+            }
+            true
+        });
+    }
+
+    /// Verifies the checksums of the given blocks, once read by a read
+    /// submitted when the table had the given sequence number. Returns the
+    /// first block which does not match its recorded checksum, if any.
+    pub(crate) fn verify(
+        &self,
+        seq: u32,
+        offset: u64,
+        num_blocks: u64,
+        block_len: u64,
+        iovs: &[IoVec],
+    ) -> Option<u64> {
+        let mut bad = None;
+        blocks_crc32c(iovs, block_len, num_blocks, |i, crc| {
+            let e = self
+                .entry(offset + i)
+                .map_or(0, |e| e.load(Ordering::Relaxed));
+            let (written, expected) = ((e >> 32) as u32, e as u32);
+            // Blocks written after the read was submitted may hold either
+            // data.
+            let newer = written.wrapping_sub(seq) as i32 >= 0;
+            if expected != UNKNOWN_CRC && !newer && expected != crc {
+                bad = Some(offset + i);
+                return false;
+            }
+            true
+        });
+        bad
+    }
+}
+
+/// Computes the CRC32C of each block of the given buffers, passing the block
+/// index and its checksum to the given function until it returns false.
+/// Blocks may span buffers.
+fn blocks_crc32c<F>(iovs: &[IoVec], block_len: u64, num_blocks: u64, mut f: F)
+where
+    F: FnMut(u64, u32) -> bool,
+{
+    let mut blk = 0;
+    let mut crc = SPDK_CRC32C_INITIAL;
+    let mut filled = 0;
+
+    for iov in iovs {
+        let mut ptr = iov.as_ptr() as *const u8;
+        let mut left = iov.len() as u64;
+
+        while left > 0 && blk < num_blocks {
+            let n = left.min(block_len - filled);
+            crc = unsafe { spdk_crc32c_update(ptr.cast(), n, crc) };
+            ptr = unsafe { ptr.add(n as usize) };
+            left -= n;
+            filled += n;
+
+            if filled == block_len {
+                // A zero checksum would read as unknown.
+                if !f(blk, crc.max(1)) {
+                    return;
+                }
+                blk += 1;
+                crc = SPDK_CRC32C_INITIAL;
+                filled = 0;
+            }
+        }
+    }
+}
+
+impl<'n> Nexus<'n> {
+    /// Returns the checksum table of the nexus, if integrity checking is
+    /// enabled.
+    pub(super) fn integrity_map(&self) -> Option<Arc<IntegrityMap>> {
+        self.integrity.lock().clone()
+    }
+
+    /// Determines if integrity checking is enabled on the nexus.
+    pub fn integrity_enabled(&self) -> bool {
+        self.integrity.lock().is_some()
+    }
+
+    /// Enables integrity checking on a nexus being created, if enabled by
+    /// default and the node has memory left for its checksum table. Must be
+    /// called before the I/O channels are created.
+    pub(super) fn init_integrity(&self) {
+        if super::ENABLE_NEXUS_INTEGRITY.load(Ordering::SeqCst) {
+            match IntegrityMap::new(&self.name, self.num_blocks()) {
+                Ok(map) => {
+                    *self.integrity.lock() = Some(Arc::new(map));
+                    info!("{self:?}: integrity checking enabled");
+                }
+                Err(e) => {
+                    warn!("{self:?}: integrity checking not enabled: {e}")
+                }
+            }
+        }
+    }
+
+    /// Enables or disables integrity checking. The nexus I/O is paused while
+    /// the I/O channels switch, so that no write escapes the new checksums.
+    pub async fn set_integrity(
+        mut self: Pin<&mut Self>,
+        enable: bool,
+    ) -> Result<(), Error> {
+        if self.integrity_enabled() == enable {
+            return Ok(());
+        }
+
+        let map = if enable {
+            Some(Arc::new(IntegrityMap::new(&self.name, self.num_blocks())?))
+        } else {
+            None
+        };
+
+        self.as_mut().pause().await?;
+
+        *self.integrity.lock() = map;
+        self.reconfigure(DrEvent::IntegrityChange).await;
+
+        info!(
+            "{self:?}: integrity checking {s}",
+            s = if enable { "enabled" } else { "disabled" }
+        );
+
+        self.resume().await
+    }
+}
@@ -2,6 +2,7 @@ use std::{
     fmt::{Debug, Formatter},
     ops::{Deref, DerefMut},
     pin::Pin,
+    sync::atomic::Ordering,
 };
 
 use libc::c_void;
@@ -14,13 +15,23 @@ use spdk_rs::{
         spdk_io_channel,
         SPDK_NVME_SC_ABORTED_SQ_DELETION,
         SPDK_NVME_SC_CAPACITY_EXCEEDED,
+        SPDK_NVME_SC_GUARD_CHECK_ERROR,
         SPDK_NVME_SC_INVALID_OPCODE,
         SPDK_NVME_SC_RESERVATION_CONFLICT,
     },
     BdevIo,
+    IoVec,
 };
 
-use super::{FaultReason, IOLogChannel, Nexus, NexusChannel, NEXUS_PRODUCT_ID};
+use super::{
+    nexus_read_policy::now_ticks,
+    FaultReason,
+    IOLogChannel,
+    Nexus,
+    NexusChannel,
+    NEXUS_PRODUCT_ID,
+    NEXUS_WRITE_BATCH,
+};
 
 use crate::core::{
     BlockDevice,
@@ -74,6 +85,28 @@ pub(super) struct NioCtx<'n> {
     failed: u8,
     /// Number of resubmissions. Incremented with each resubmission.
     resubmits: u8,
+    /// Number of reads retried after a checksum mismatch.
+    verify_retries: u8,
+    /// Whether the I/O was admitted by the QoS limits of the nexus.
+    qos_admitted: bool,
+    /// Whether some child I/Os could not be submitted for lack of
+    /// resources. The I/O is then submitted again in full once the child
+    /// I/Os that were submitted complete.
+    nomem: bool,
+    /// Generation of the nexus read cache at read submission.
+    cache_gen: u64,
+    /// Identifier of the channel reader a read I/O was submitted to.
+    reader_id: u32,
+    /// Identifier of the channel reader which returned corrupted data for
+    /// this read, not to retry the read on.
+    bad_reader: u32,
+    /// Sequence number of the write in the checksum table, or of the table
+    /// at read submission.
+    integrity_seq: u32,
+    /// Tick count at read submission.
+    start_ticks: u64,
+    /// Tick count at submission to the nexus.
+    submit_ticks: u64,
     /// Debug serial number.
     #[cfg(feature = "nexus-io-tracing")]
     serial: u64,
@@ -89,7 +122,7 @@ impl<'n> Debug for NioCtx<'n> {
 
         write!(
             f,
-            "{serial}[{re}{status:?} {sc}:{fc}{infl}]",
+            "{serial}[{re}{status:?} {sc}:{fc}{infl}{nomem}]",
             re = if self.resubmits > 0 {
                 format!("re:{} ", self.resubmits)
             } else {
@@ -103,10 +136,80 @@ impl<'n> Debug for NioCtx<'n> {
             },
             sc = self.successful,
             fc = self.failed,
+            nomem = if self.nomem { " nomem" } else { "" },
         )
     }
 }
 
+/// Maximum size of a coalesced write, in bytes.
+const WRITE_BATCH_MAX_BYTES: u64 = 128 * 1024;
+
+/// Maximum number of I/O vectors of a coalesced write.
+const WRITE_BATCH_MAX_IOVS: usize = 64;
+
+/// Adjacent nexus writes coalesced into a single vectored write per child.
+///
+/// While a channel has writes in flight, small writes are held back in a
+/// batch as long as each one starts where the previous one ends. The batch
+/// is submitted once it is full, when a write or any other I/O it cannot
+/// be merged with arrives, or when the last write in flight on the channel
+/// completes. Submission order is therefore preserved, and a held write is
+/// never delayed beyond the completion of the writes submitted before it.
+pub(super) struct WriteBatch<'n> {
+    /// Nexus I/Os of the batch, in offset order.
+    bios: Vec<NexusBio<'n>>,
+    /// I/O vectors of all the nexus I/Os of the batch. They must remain valid
+    /// until all child writes complete.
+    iovs: Vec<IoVec>,
+    /// Effective offset of the batch, in blocks.
+    offset: u64,
+    /// Size of the batch, in blocks.
+    num_blocks: u64,
+    /// Number of child writes in flight.
+    in_flight: usize,
+}
+
+impl<'n> WriteBatch<'n> {
+    /// Creates a new batch starting with the given nexus I/O.
+    fn new(bio: NexusBio<'n>) -> Self {
+        let mut batch = Self {
+            bios: Vec::new(),
+            iovs: Vec::new(),
+            offset: bio.effective_offset(),
+            num_blocks: 0,
+            in_flight: 0,
+        };
+        batch.push(bio);
+        batch
+    }
+
+    /// Determines if the given nexus I/O can be appended to the batch.
+    fn accepts(&self, bio: &NexusBio<'n>) -> bool {
+        bio.effective_offset() == self.offset + self.num_blocks
+            && (self.num_blocks + bio.num_blocks()) * bio.nexus().block_len()
+                <= WRITE_BATCH_MAX_BYTES
+            && self.iovs.len() + bio.iovs().len() <= WRITE_BATCH_MAX_IOVS
+    }
+
+    /// Appends a nexus I/O to the batch.
+    fn push(&mut self, bio: NexusBio<'n>) {
+        self.iovs.extend(bio.iovs().iter().cloned());
+        self.num_blocks += bio.num_blocks();
+        self.bios.push(bio);
+    }
+
+    /// Number of nexus I/Os in the batch.
+    fn len(&self) -> usize {
+        self.bios.len()
+    }
+
+    /// Fails all the nexus I/Os of a batch which was never submitted.
+    pub(super) fn fail(self) {
+        debug_assert_eq!(self.in_flight, 0);
+        self.bios.iter().for_each(|bio| bio.fail());
+    }
+}
+
 /// TODO
 #[repr(transparent)]
 #[derive(Clone)]
@@ -163,8 +266,17 @@ impl<'n> NexusBio<'n> {
         ctx.status = IoStatus::Pending;
         ctx.in_flight = 0;
         ctx.resubmits = 0;
+        ctx.verify_retries = 0;
+        ctx.qos_admitted = false;
+        ctx.nomem = false;
+        ctx.cache_gen = 0;
         ctx.successful = 0;
         ctx.failed = 0;
+        ctx.reader_id = 0;
+        ctx.bad_reader = 0;
+        ctx.integrity_seq = 0;
+        ctx.start_ticks = 0;
+        ctx.submit_ticks = now_ticks();
 
         #[cfg(feature = "nexus-io-tracing")]
         {
@@ -184,6 +296,42 @@ impl<'n> NexusBio<'n> {
             return;
         }
 
+        if !self.ctx().qos_admitted {
+            let s = self.clone();
+            if self.channel_mut().qos_throttle(&s) {
+                return;
+            }
+            self.ctx_mut().qos_admitted = true;
+        }
+
+        if matches!(
+            self.io_type(),
+            IoType::Write | IoType::WriteZeros | IoType::Unmap
+        ) {
+            if let Some(map) = self.channel().integrity() {
+                let seq = map.invalidate(self.offset(), self.num_blocks());
+                self.ctx_mut().integrity_seq = seq;
+            }
+            if let Some(cache) = self.channel().read_cache() {
+                cache.invalidate(self.offset(), self.num_blocks());
+            }
+        } else if matches!(self.io_type(), IoType::Read) {
+            if let Some(map) = self.channel().integrity() {
+                let seq = map.current_seq();
+                self.ctx_mut().integrity_seq = seq;
+            }
+        }
+
+        if self.is_batchable() {
+            self.batch_write();
+            return;
+        }
+
+        // Submit the pending write batch first, to keep submission order.
+        if let Some(batch) = self.channel_mut().take_write_batch() {
+            Self::submit_write_batch(batch);
+        }
+
         if let Err(_e) = match self.io_type() {
             IoType::Read => self.readv(),
             // these IOs are submitted to all the underlying children
@@ -210,6 +358,18 @@ impl<'n> NexusBio<'n> {
         }
     }
 
+    /// Submits an I/O held back by the QoS limits, once admitted.
+    pub(super) fn submit_throttled(mut self) {
+        self.ctx_mut().qos_admitted = true;
+        self.submit_request();
+    }
+
+    /// Returns the size of the I/O in bytes.
+    #[inline(always)]
+    pub(super) fn num_bytes(&self) -> u64 {
+        self.num_blocks() * self.nexus().block_len()
+    }
+
     /// Obtains a reference to the Nexus struct embedded within the bdev.
     #[inline(always)]
     pub(crate) fn nexus(&self) -> &Nexus<'n> {
@@ -257,6 +417,12 @@ impl<'n> NexusBio<'n> {
         debug_assert!(self.ctx().in_flight > 0);
         self.ctx_mut().in_flight -= 1;
 
+        if matches!(self.io_type(), IoType::Read) {
+            let ctx = self.ctx();
+            let (reader_id, start_ticks) = (ctx.reader_id, ctx.start_ticks);
+            self.channel_mut().reader_completed(reader_id, start_ticks);
+        }
+
         if status == IoCompletionStatus::Success {
             self.ctx_mut().successful += 1;
         } else {
@@ -272,10 +438,43 @@ impl<'n> NexusBio<'n> {
             return;
         }
 
+        self.channel_mut().io_completed();
+
+        // Drop again the cached lines a read may have filled while this
+        // write was in flight.
+        if matches!(
+            self.io_type(),
+            IoType::Write | IoType::WriteZeros | IoType::Unmap
+        ) {
+            if let Some(cache) = self.channel().read_cache() {
+                cache.invalidate(self.offset(), self.num_blocks());
+            }
+        }
+
+        // The I/O may be reused as soon as it is completed: take the
+        // pending write batch, if it is to be submitted, before that.
+        let pending_batch = if matches!(self.io_type(), IoType::Write) {
+            self.channel_mut().write_completed()
+        } else {
+            None
+        };
+
+        // Likewise for the I/Os waiting for resources, which this
+        // completion may have freed.
+        let nomem_ios = self.channel_mut().take_nomem_ios();
+
         if self.ctx().failed == 0 {
-            // No child failures, complete nexus I/O with success.
-            trace_nexus_io!("Success: {self:?}");
-            self.ok();
+            if self.ctx().nomem {
+                // Some child I/Os could not be submitted for lack of
+                // resources: submit the I/O again once they are available.
+                self.park_nomem();
+            } else if self.check_integrity(child) {
+                // No child failures, complete nexus I/O with success.
+                trace_nexus_io!("Success: {self:?}");
+                self.fill_read_cache();
+                self.record_latency();
+                self.ok();
+            }
         } else if self.ctx().successful > 0 {
             // Having some child failures, resubmit the I/O.
             self.resubmit();
@@ -286,8 +485,119 @@ impl<'n> NexusBio<'n> {
                 self.nexus_mut().get_unchecked_mut().last_error = status;
             }
 
+            self.record_latency();
             self.fail();
         }
+
+        if let Some(batch) = pending_batch {
+            Self::submit_write_batch(batch);
+        }
+
+        if let Some(ios) = nomem_ios {
+            ios.into_iter().for_each(|io| io.submit_request());
+        }
+    }
+
+    /// Records the checksums of the blocks written, or verifies the ones of
+    /// the blocks read from the given child, if integrity checking is
+    /// enabled. On mismatch, the child is retired and the read is retried on
+    /// the other readers until one returns the data written, or failed with
+    /// a guard check error when no reader is left. Returns true if the I/O
+    /// can complete successfully.
+    fn check_integrity(&mut self, child: &dyn BlockDevice) -> bool {
+        let Some(map) = self.channel().integrity() else {
+            return true;
+        };
+        let (offset, num_blocks) = (self.offset(), self.num_blocks());
+        let block_len = self.nexus().block_len();
+        let seq = self.ctx().integrity_seq;
+
+        let bad = match self.io_type() {
+            IoType::Write => {
+                map.record(seq, offset, num_blocks, block_len, self.iovs());
+                None
+            }
+            IoType::Read => {
+                map.verify(seq, offset, num_blocks, block_len, self.iovs())
+            }
+            _ => None,
+        };
+        let Some(blk) = bad else {
+            return true;
+        };
+
+        let device = child.device_name();
+        let reader_id = self.ctx().reader_id;
+        let retries = self.ctx().verify_retries as usize;
+        let left = self.channel().reader_verify_failed(reader_id);
+        if left > 0 && retries < self.channel().num_readers() {
+            error!(
+                "{self:?}: checksum mismatch at block {blk} read from \
+                '{device}', retiring the child and retrying the read"
+            );
+            self.channel_mut()
+                .fault_device(&device, FaultReason::IntegrityMismatch);
+            let ctx = self.ctx_mut();
+            ctx.bad_reader = reader_id;
+            ctx.verify_retries += 1;
+            ctx.status = IoStatus::Pending;
+            ctx.successful = 0;
+            self.clone().submit_request();
+        } else {
+            error!(
+                "{self:?}: checksum mismatch at block {blk} read from \
+                '{device}', failing nexus I/O after {retries} retries"
+            );
+            self.record_latency();
+            self.fail_nvme_status(NvmeStatus::Media(
+                SPDK_NVME_SC_GUARD_CHECK_ERROR,
+            ));
+        }
+        false
+    }
+
+    /// Completes this read from the nexus read cache if all its blocks are
+    /// cached. Otherwise, notes the cache generation for the blocks to be
+    /// cached once read. Returns true if the read was completed.
+    fn read_cached(&mut self) -> bool {
+        let Some(cache) = self.channel().read_cache() else {
+            return false;
+        };
+        let gen = cache.generation();
+        if !cache.read(self.offset(), self.num_blocks(), self.iovs()) {
+            self.ctx_mut().cache_gen = gen;
+            return false;
+        }
+
+        trace_nexus_io!("Read cache hit: {self:?}");
+        self.record_latency();
+        self.ok();
+        true
+    }
+
+    /// Caches the blocks of a successful read, if the nexus has a read cache.
+    fn fill_read_cache(&self) {
+        if !matches!(self.io_type(), IoType::Read) {
+            return;
+        }
+        if let Some(cache) = self.channel().read_cache() {
+            cache.fill(
+                self.offset(),
+                self.num_blocks(),
+                self.iovs(),
+                self.ctx().cache_gen,
+            );
+        }
+    }
+
+    /// Records the latency of this I/O, from its submission to the nexus
+    /// (resubmissions included) until now.
+    #[inline(always)]
+    fn record_latency(&mut self) {
+        let ticks = now_ticks().saturating_sub(self.ctx().submit_ticks);
+        let (io_type, num_bytes) = (self.io_type(), self.num_bytes());
+        self.channel_mut()
+            .record_io_latency(io_type, num_bytes, ticks);
     }
 
     /// Fails the current I/O with a generic internal error. If the nexus
@@ -324,6 +634,7 @@ impl<'n> NexusBio<'n> {
 
         ctx.status = IoStatus::Pending;
         ctx.resubmits += 1;
+        ctx.nomem = false;
         ctx.successful = 0;
         ctx.failed = 0;
 
@@ -332,6 +643,25 @@ impl<'n> NexusBio<'n> {
         bio.submit_request();
     }
 
+    /// Parks the I/O in the channel's wait queue after its submission failed
+    /// for lack of resources, to be submitted again in full once resources
+    /// are freed. The children are not faulted, as the failure is transient.
+    fn park_nomem(&mut self) {
+        trace_nexus_io!("Out of resources: {self:?}");
+
+        let ctx = self.ctx_mut();
+
+        debug_assert_eq!(ctx.in_flight, 0);
+
+        ctx.status = IoStatus::Pending;
+        ctx.nomem = false;
+        ctx.successful = 0;
+        ctx.failed = 0;
+
+        let bio = self.clone();
+        self.channel_mut().park_nomem(bio);
+    }
+
     /// reference to the channel. The channel contains the specific
     /// per-core data structures.
     #[inline(always)]
@@ -380,10 +710,25 @@ impl<'n> NexusBio<'n> {
 
     /// Submit a Read operation to the next available replica.
     fn __do_readv_one(&mut self) -> Result<(), CoreError> {
-        if let Some(hdl) = self.channel().select_reader() {
+        let bad_reader = self.ctx().bad_reader;
+        if let Some((idx, hdl)) = self.channel().select_reader(bad_reader) {
+            let start_ticks = now_ticks();
             let r = self.submit_read(hdl);
 
-            if r.is_err() {
+            if let Err(e) = &r {
+                // Lack of resources is transient: keep the device, and keep
+                // the reader selectable, the read is to be submitted again.
+                if e.is_enomem() {
+                    trace_nexus_io!(
+                        "{self:?}: read I/O to '{dev}' submission failed: \
+                        out of resources",
+                        dev = hdl.get_device().device_name()
+                    );
+                    return r;
+                }
+
+                self.channel().reader_submission_failed(idx);
+
                 // Such a situation can happen when there is no active I/O in
                 // the queues, but error on qpair is observed
                 // due to network timeout, which initiates
@@ -391,8 +736,6 @@ impl<'n> NexusBio<'n> {
                 // I/O channels are de-initialized, so no I/O
                 // submission is possible (spdk returns -6/ENXIO), so we have to
                 // start device retire.
-                // TODO: ENOMEM and ENXIO should be handled differently and
-                // device should not be retired in case of ENOMEM.
                 let device = hdl.get_device().device_name();
                 error!(
                     "{self:?}: read I/O to '{device}' submission failed: {r:?}"
@@ -406,7 +749,13 @@ impl<'n> NexusBio<'n> {
                 );
                 r
             } else {
-                self.ctx_mut().in_flight = 1;
+                self.channel().reader_submitted(idx);
+                self.channel_mut().ios_submitted(1);
+                let reader_id = self.channel().reader_id(idx);
+                let ctx = self.ctx_mut();
+                ctx.in_flight = 1;
+                ctx.reader_id = reader_id;
+                ctx.start_ticks = start_ticks;
                 r
             }
         } else {
@@ -420,8 +769,13 @@ impl<'n> NexusBio<'n> {
 
     /// Submit a read operation to the next suitable replica.
     /// In case of submission error the requiest is transparently resubmitted
-    /// to the next available replica.
+    /// to the next available replica. If no replica accepts it and some
+    /// lacked resources, the read is parked until resources are freed.
     fn do_readv(&mut self) -> Result<(), CoreError> {
+        if self.read_cached() {
+            return Ok(());
+        }
+
         match self.__do_readv_one() {
             Err(e) => {
                 match e {
@@ -433,6 +787,7 @@ impl<'n> NexusBio<'n> {
                     // Failed to submit Read I/O request to the current replica,
                     // try to resumbit request to the next available replica.
                     _ => {
+                        let mut nomem = e.is_enomem();
                         let mut num_readers = self.channel().num_readers();
 
                         let r = {
@@ -449,6 +804,7 @@ impl<'n> NexusBio<'n> {
                                     match self.__do_readv_one() {
                                         Ok(_) => break Ok(()),
                                         Err(e) => {
+                                            nomem |= e.is_enomem();
                                             num_readers -= 1;
 
                                             if num_readers == 0 {
@@ -461,6 +817,10 @@ impl<'n> NexusBio<'n> {
                         };
 
                         if r.is_err() {
+                            if nomem {
+                                self.park_nomem();
+                                return Ok(());
+                            }
                             self.fail();
                         }
                         r
@@ -594,6 +954,10 @@ impl<'n> NexusBio<'n> {
     /// the child IOs have completed before we mark the whole IO failed to
     /// avoid double frees. This function handles IO for a subset that must
     /// be submitted to all the underlying children.
+    ///
+    /// A submission failing for lack of resources (ENOMEM) does not fault
+    /// the child: the IO is parked in the channel's wait queue, right away
+    /// if nothing was submitted, or once the submitted child IOs complete.
     fn submit_all(&mut self) -> Result<(), CoreError> {
         let mut inflight = 0;
         // Name of the device which experiences I/O submission failures.
@@ -633,11 +997,11 @@ impl<'n> NexusBio<'n> {
         // reset all I/O channels are de-initialized, so no I/O
         // submission is possible (spdk returns -6/ENXIO), so we have to
         // start device retire.
+        // Lack of resources, on the contrary, is transient and must not
+        // retire the device.
+        let nomem = matches!(&result, Err(e) if e.is_enomem());
 
-        // TODO:
-        // ENOMEM and ENXIO should be handled differently and
-        // device should not be retired in case of ENOMEM.
-        if result.is_err() {
+        if result.is_err() && !nomem {
             let device = failed_device.unwrap();
             // set the IO as failed in the submission stage.
             self.ctx_mut().failed += 1;
@@ -664,6 +1028,13 @@ impl<'n> NexusBio<'n> {
             // prior to the error condition.
             self.ctx_mut().in_flight = inflight;
             self.ctx_mut().status = IoStatus::Success;
+            self.ctx_mut().nomem = nomem;
+            self.channel_mut().ios_submitted(1);
+            if matches!(self.io_type(), IoType::Write) {
+                self.channel_mut().writes_submitted(1);
+            }
+        } else if nomem {
+            self.park_nomem();
         } else {
             debug_assert_eq!(self.ctx().in_flight, 0);
             error!(
@@ -672,7 +1043,11 @@ impl<'n> NexusBio<'n> {
             self.fail();
         }
 
-        result
+        if nomem {
+            Ok(())
+        } else {
+            result
+        }
     }
 
     /// Logs all write-like operation in the rebuild logs, if any exist.
@@ -681,6 +1056,187 @@ impl<'n> NexusBio<'n> {
         log.log_io(self.io_type(), self.effective_offset(), self.num_blocks());
     }
 
+    /// Determines if this I/O is a write that can be held back in the
+    /// channel's write batch.
+    #[inline]
+    fn is_batchable(&self) -> bool {
+        NEXUS_WRITE_BATCH.load(Ordering::Relaxed) > 1
+            && matches!(self.io_type(), IoType::Write)
+            && self.channel().writes_in_flight() > 0
+            && self.num_blocks() * self.nexus().block_len()
+                < WRITE_BATCH_MAX_BYTES
+            && self.iovs().len() < WRITE_BATCH_MAX_IOVS
+    }
+
+    /// Adds this write to the channel's write batch, submitting the batch
+    /// when it is full or when this write cannot be merged with it.
+    fn batch_write(self) {
+        let mut bio = self.clone();
+        let chan = bio.channel_mut();
+        let max_ios = NEXUS_WRITE_BATCH.load(Ordering::Relaxed) as usize;
+
+        match chan.take_write_batch() {
+            Some(mut batch) if batch.accepts(&self) => {
+                batch.push(self);
+                if batch.len() >= max_ios {
+                    Self::submit_write_batch(batch);
+                } else {
+                    chan.set_write_batch(batch);
+                }
+            }
+            Some(batch) => {
+                chan.set_write_batch(WriteBatch::new(self));
+                Self::submit_write_batch(batch);
+            }
+            None => chan.set_write_batch(WriteBatch::new(self)),
+        }
+    }
+
+    /// Submits a write batch to all writers, as one vectored write per child.
+    fn submit_write_batch(mut batch: WriteBatch<'n>) {
+        let mut first = batch.bios[0].clone();
+
+        if first.channel().is_frozen() {
+            batch.bios.into_iter().for_each(|bio| {
+                first.channel_mut().freeze_io_submission(bio);
+            });
+            return;
+        }
+
+        if batch.len() == 1 {
+            let _ = first.submit_all();
+            return;
+        }
+
+        trace_nexus_io!(
+            "Submitting batch of {n} writes at {off}/{num}",
+            n = batch.len(),
+            off = batch.offset,
+            num = batch.num_blocks
+        );
+
+        let mut batch = Box::new(batch);
+        let batch_ptr = &mut *batch as *mut WriteBatch<'n>;
+        let mut inflight = 0;
+        // Name of the device which experiences I/O submission failures.
+        let mut failed_device = None;
+
+        let result = first.channel().for_each_writer(|h| {
+            first
+                .submit_batched_write(h, &batch, batch_ptr.cast())
+                .map(|_| {
+                    inflight += 1;
+                })
+                .map_err(|err| {
+                    error!(
+                        "(core: {core} thread: {thread}): batched write \
+                        submission failed with error {err:?}, \
+                        I/Os submitted: {inflight}",
+                        core = Cores::current(),
+                        thread = Mthread::current().unwrap().name()
+                    );
+
+                    // Record the name of the device for immediate retire.
+                    failed_device = Some(h.get_device().device_name());
+                    err
+                })
+        });
+
+        // Submission errors are handled the same as in `submit_all`.
+        let nomem = matches!(&result, Err(e) if e.is_enomem());
+
+        if result.is_err() && !nomem {
+            let device = failed_device.unwrap();
+            batch
+                .bios
+                .iter_mut()
+                .for_each(|bio| bio.ctx_mut().failed += 1);
+
+            first.channel_mut().detach_device(&device);
+            first.channel_mut().disconnect_detached_devices(|_| true);
+
+            if let Some(log) = first.fault_device(
+                &device,
+                IoCompletionStatus::IoSubmissionError(
+                    IoSubmissionFailure::Write,
+                ),
+            ) {
+                batch.bios.iter().for_each(|bio| bio.log_io(&log));
+            }
+        }
+
+        first.channel().for_each_io_log(|log| {
+            batch.bios.iter().for_each(|bio| bio.log_io(log));
+        });
+
+        if inflight > 0 {
+            batch.in_flight = inflight;
+            batch.bios.iter_mut().for_each(|bio| {
+                let ctx = bio.ctx_mut();
+                ctx.in_flight = inflight as u8;
+                ctx.status = IoStatus::Success;
+                ctx.nomem = nomem;
+            });
+            first.channel_mut().ios_submitted(batch.len() as u32);
+            first.channel_mut().writes_submitted(batch.len() as u32);
+
+            // Released by the completion of the last child write.
+            let _ = Box::into_raw(batch);
+        } else if nomem {
+            batch.bios.iter_mut().for_each(|bio| bio.park_nomem());
+        } else {
+            error!(
+                "{first:?}: failing {n} batched nexus I/Os: all child I/O \
+                submissions failed",
+                n = batch.len()
+            );
+            batch.bios.iter().for_each(|bio| bio.fail());
+        }
+    }
+
+    /// Submits a write batch to the given child.
+    #[inline]
+    fn submit_batched_write(
+        &self,
+        hdl: &dyn BlockDeviceHandle,
+        batch: &WriteBatch<'n>,
+        arg: *mut c_void,
+    ) -> Result<(), CoreError> {
+        #[cfg(feature = "fault-injection")]
+        self.inject_submission_error(hdl)?;
+
+        hdl.writev_blocks(
+            &batch.iovs,
+            batch.offset,
+            batch.num_blocks,
+            Self::batch_completion,
+            arg,
+        )
+    }
+
+    /// Invoked when a child write of a write batch completes.
+    fn batch_completion(
+        device: &dyn BlockDevice,
+        status: IoCompletionStatus,
+        ctx: *mut c_void,
+    ) {
+        let batch_ptr = ctx as *mut WriteBatch<'n>;
+        let batch = unsafe { &mut *batch_ptr };
+
+        debug_assert!(batch.in_flight > 0);
+        batch.in_flight -= 1;
+        let last = batch.in_flight == 0;
+
+        batch
+            .bios
+            .iter()
+            .for_each(|bio| bio.clone().complete(device, status));
+
+        if last {
+            drop(unsafe { Box::from_raw(batch_ptr) });
+        }
+    }
+
     /// Initiate shutdown of the nexus associated with this BIO request.
     fn try_self_shutdown_nexus(&mut self) {
         if self
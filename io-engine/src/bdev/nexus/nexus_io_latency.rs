@@ -0,0 +1,171 @@
+//!
+//! I/O latency histograms of a nexus.
+//!
+//! Every nexus I/O channel records the latencies of the I/Os it completes
+//! into its own histograms, without any synchronization. The histograms of
+//! all channels are merged on demand by traversing the channels.
+use serde::Serialize;
+
+use crate::core::{
+    IoLatencyHistograms,
+    IoLatencySummary,
+    IoType,
+    LatencyHistogram,
+    LatencySummary,
+};
+
+/// Latency histograms of a nexus child.
+#[derive(Debug, Clone)]
+pub struct ChildIoLatency {
+    /// URI of the child.
+    pub uri: String,
+    /// Latencies of the reads served by the child.
+    pub read: LatencyHistogram,
+}
+
+/// I/O latency histograms of a nexus, or of one of its channels.
+#[derive(Debug, Clone, Default)]
+pub struct NexusIoLatency {
+    /// Latencies of nexus I/Os, measured from their submission to the nexus
+    /// to their completion, per I/O type.
+    pub io: IoLatencyHistograms,
+    /// Latencies of child I/Os. Only reads can be attributed to a single
+    /// child; writes complete once all children have completed them, which
+    /// `io` accounts for.
+    pub children: Vec<ChildIoLatency>,
+    /// Durations of the I/O freezes of the nexus. Recorded by the nexus
+    /// itself, not by its channels.
+    pub freeze: NexusFreezeLatency,
+}
+
+/// Durations of the I/O freezes of a nexus.
+#[derive(Debug, Clone, Default)]
+pub struct NexusFreezeLatency {
+    /// Durations of the pauses of the nexus I/O subsystem, from the start of
+    /// the pause until the subsystem is resumed.
+    pub pause: LatencyHistogram,
+    /// Durations of the freezes of I/O submissions on the nexus channels.
+    pub io_freeze: LatencyHistogram,
+}
+
+impl NexusFreezeLatency {
+    /// Adds all samples of other histograms to these ones.
+    pub(super) fn merge(&mut self, other: &NexusFreezeLatency) {
+        self.pause.merge(&other.pause);
+        self.io_freeze.merge(&other.io_freeze);
+    }
+
+    /// Removes all samples.
+    pub(super) fn reset(&mut self) {
+        self.pause.reset();
+        self.io_freeze.reset();
+    }
+
+    /// Returns summaries of these histograms, in microseconds.
+    pub fn summary(&self, tick_rate: u64) -> NexusFreezeLatencySummary {
+        NexusFreezeLatencySummary {
+            pause: self.pause.summary(tick_rate),
+            io_freeze: self.io_freeze.summary(tick_rate),
+        }
+    }
+}
+
+impl NexusIoLatency {
+    /// Records the latency of a completed nexus I/O.
+    #[inline(always)]
+    pub(super) fn record(&mut self, io_type: IoType, ticks: u64) {
+        match io_type {
+            IoType::Read => self.io.read.record(ticks),
+            IoType::Write | IoType::WriteZeros => self.io.write.record(ticks),
+            IoType::Unmap => self.io.unmap.record(ticks),
+            IoType::Flush => self.io.flush.record(ticks),
+            _ => {}
+        }
+    }
+
+    /// Records the latency of a read served by the child at the given index.
+    #[inline(always)]
+    pub(super) fn record_child_read(&mut self, idx: usize, ticks: u64) {
+        if let Some(c) = self.children.get_mut(idx) {
+            c.read.record(ticks);
+        }
+    }
+
+    /// Returns the index of the given child's histograms, adding them if
+    /// needed.
+    pub(super) fn child_index(&mut self, uri: &str) -> usize {
+        match self.children.iter().position(|c| c.uri == uri) {
+            Some(idx) => idx,
+            None => {
+                self.children.push(ChildIoLatency {
+                    uri: uri.to_string(),
+                    read: LatencyHistogram::default(),
+                });
+                self.children.len() - 1
+            }
+        }
+    }
+
+    /// Drops the histograms of the children not matching the predicate.
+    pub(super) fn retain_children<F>(&mut self, f: F)
+    where
+        F: Fn(&str) -> bool,
+    {
+        self.children.retain(|c| f(&c.uri));
+    }
+
+    /// Adds all samples of other histograms to these ones.
+    pub(super) fn merge(&mut self, other: &NexusIoLatency) {
+        self.io.merge(&other.io);
+        for c in &other.children {
+            let idx = self.child_index(&c.uri);
+            self.children[idx].read.merge(&c.read);
+        }
+        self.freeze.merge(&other.freeze);
+    }
+
+    /// Removes all samples.
+    pub(super) fn reset(&mut self) {
+        self.io.reset();
+        self.children.iter_mut().for_each(|c| c.read.reset());
+        self.freeze.reset();
+    }
+
+    /// Returns summaries of these histograms, in microseconds.
+    pub fn summary(&self, tick_rate: u64) -> NexusIoLatencySummary {
+        NexusIoLatencySummary {
+            io: self.io.summary(tick_rate),
+            children: self
+                .children
+                .iter()
+                .map(|c| ChildIoLatencySummary {
+                    uri: c.uri.clone(),
+                    read: c.read.summary(tick_rate),
+                })
+                .collect(),
+            freeze: self.freeze.summary(tick_rate),
+        }
+    }
+}
+
+/// Summary of the latency histograms of a nexus child.
+#[derive(Debug, Clone, Serialize)]
+pub struct ChildIoLatencySummary {
+    pub uri: String,
+    pub read: LatencySummary,
+}
+
+/// Summary of the I/O latency histograms of a nexus.
+#[derive(Debug, Clone, Serialize)]
+pub struct NexusIoLatencySummary {
+    pub io: IoLatencySummary,
+    pub children: Vec<ChildIoLatencySummary>,
+    pub freeze: NexusFreezeLatencySummary,
+}
+
+/// Summary of the I/O freeze durations of a nexus.
+#[derive(Debug, Clone, Serialize)]
+pub struct NexusFreezeLatencySummary {
+    pub pause: LatencySummary,
+    pub io_freeze: LatencySummary,
+}
@@ -84,6 +84,17 @@ impl IOLogChannelInner {
             .expect("Accessing stopped I/O log channel")
     }
 
+    /// Marks the segments of the given map as modified in this channel.
+    /// Must not be called once the channel is shared with I/O channels.
+    fn merge_segments(&self, other: &SegmentMap) {
+        let segments = unsafe { &mut *self.segments.get() };
+        let merged = segments
+            .take()
+            .expect("Accessing stopped I/O log channel")
+            .merge(other);
+        *segments = Some(merged);
+    }
+
     /// Takes segments from this channel.
     #[inline]
     fn take_segments(&self) -> SegmentMap {
@@ -135,7 +146,7 @@ impl IOLogChannel {
 }
 
 /// I/O log.
-pub struct IOLog {
+pub(crate) struct IOLog {
     /// Name of the underlying block device.
     device_name: String,
     /// Per-core log channels.
@@ -177,6 +188,26 @@ impl IOLog {
         }
     }
 
+    /// Creates a new I/O log instance for the given device, with the segments
+    /// of the given map already marked as modified, e.g. as restored from
+    /// the persistent store.
+    pub(crate) fn with_segments(
+        device_name: &str,
+        segments: &SegmentMap,
+    ) -> Self {
+        let log =
+            Self::new(device_name, segments.size_blks(), segments.block_len());
+
+        log.channels
+            .lock()
+            .values()
+            .next()
+            .expect("Should have at least 1 core")
+            .merge_segments(segments);
+
+        log
+    }
+
     /// Returns I/O log channel for the current core.
     pub(crate) fn current_channel(&self) -> IOLogChannel {
         self.channels
@@ -188,14 +219,18 @@ impl IOLog {
 
     /// Consumes an I/O log instance and returns the corresponding rebuild map.
     pub(crate) fn finalize(self) -> RebuildMap {
-        let segments = self
-            .channels
+        let device_name = self.device_name.clone();
+        RebuildMap::new(&device_name, self.into_segments())
+    }
+
+    /// Consumes an I/O log instance and returns the map of the segments
+    /// modified on all cores.
+    pub(crate) fn into_segments(self) -> SegmentMap {
+        self.channels
             .lock()
             .values_mut()
             .map(|x| x.take_segments())
             .reduce(|acc, e| acc.merge(&e))
-            .expect("Should have at least 1 core");
-
-        RebuildMap::new(&self.device_name, segments)
+            .expect("Should have at least 1 core")
     }
 }
@@ -0,0 +1,237 @@
+//!
+//! Persistence of the I/O logs of nexus children across io-engine restarts.
+//!
+//! The I/O logs of the children which are not in sync are saved to the
+//! persistent store when the nexus is shut down, once its I/O has stopped, so
+//! that the saved logs are exact. When the nexus is created again, the saved
+//! logs are loaded and removed from the store before any I/O is submitted,
+//! and they keep tracking the writes until their children are added back to
+//! the nexus, which can then rebuild them partially.
+//!
+//! Logs are never saved while I/O is running: after an unclean shutdown,
+//! no log is found and the children are fully rebuilt, as before.
+use std::{collections::HashMap, sync::atomic::Ordering};
+
+use serde::{Deserialize, Serialize};
+
+use super::{IOLog, IOLogChannel, Nexus, NexusChild};
+use crate::{
+    core::SegmentMap,
+    persistent_store::PersistentStore,
+    rebuild::SEGMENT_SIZE,
+    store::store_defs::StoreError,
+};
+
+/// Maximum number of extents of a saved I/O log. Logs with more extents,
+/// i.e. which would need a full rebuild anyway, are not saved.
+const MAX_IO_LOG_EXTENTS: usize = 16 * 1024;
+
+/// I/O logs of the children of a nexus, as saved in the persistent store.
+#[derive(Serialize, Deserialize, Debug, Default)]
+pub struct NexusIoLogs {
+    /// Logs of the children.
+    pub children: Vec<ChildIoLog>,
+}
+
+/// I/O log of a child, as saved in the persistent store.
+#[derive(Serialize, Deserialize, Debug, Clone)]
+pub struct ChildIoLog {
+    /// UUID of the child.
+    pub uuid: String,
+    /// Size of the child device in blocks.
+    pub num_blocks: u64,
+    /// Block size of the child device in bytes.
+    pub block_len: u64,
+    /// Modified extents, as pairs of first block and number of blocks.
+    pub extents: Vec<(u64, u64)>,
+}
+
+impl ChildIoLog {
+    /// Creates a saved log from the given segments, unless it would have
+    /// too many extents.
+    fn new(uuid: String, segments: &SegmentMap) -> Option<Self> {
+        let extents = segments.dirty_extents();
+        if extents.len() > MAX_IO_LOG_EXTENTS {
+            return None;
+        }
+
+        Some(Self {
+            uuid,
+            num_blocks: segments.size_blks(),
+            block_len: segments.block_len(),
+            extents,
+        })
+    }
+
+    /// Restores the I/O log of the saved segments.
+    fn into_io_log(self) -> IOLog {
+        let mut segments =
+            SegmentMap::new(self.num_blocks, self.block_len, SEGMENT_SIZE);
+        self.extents
+            .iter()
+            .for_each(|(blk, cnt)| segments.set(*blk, *cnt, true));
+
+        IOLog::with_segments(&self.uuid, &segments)
+    }
+}
+
+impl<'n> Nexus<'n> {
+    /// Determines if I/O logs are persisted.
+    fn io_log_persistence_enabled() -> bool {
+        super::ENABLE_IO_LOG_PERSISTENCE.load(Ordering::SeqCst)
+            && PersistentStore::enabled()
+    }
+
+    /// Returns the key of the saved I/O logs of this nexus.
+    async fn io_logs_key(&self) -> String {
+        format!("{}/io_logs", self.nexus_info.lock().await.key(self))
+    }
+
+    /// Loads the I/O logs saved at the last shutdown of this nexus, and
+    /// removes them from the store. Logs of children which are already part
+    /// of the nexus are dropped; the others are kept pending until their
+    /// child is added. Must be called before the nexus I/O device is
+    /// registered, so that the pending logs see every write.
+    pub(super) async fn load_io_logs(&self) {
+        if !Self::io_log_persistence_enabled() {
+            return;
+        }
+
+        let key = self.io_logs_key().await;
+        let logs = match PersistentStore::get(&key).await {
+            Ok(value) => match serde_json::from_value::<NexusIoLogs>(value) {
+                Ok(logs) => logs,
+                Err(error) => {
+                    error!("{self:?}: bad saved I/O logs: {error}");
+                    NexusIoLogs::default()
+                }
+            },
+            Err(StoreError::MissingEntry {
+                ..
+            }) => return,
+            Err(error) => {
+                error!("{self:?}: failed to load saved I/O logs: {error}");
+                return;
+            }
+        };
+
+        // The logs must not be used again after an unclean shutdown.
+        if let Err(error) = PersistentStore::delete(&key).await {
+            error!(
+                "{self:?}: failed to remove saved I/O logs, \
+                ignoring them: {error}"
+            );
+            return;
+        }
+
+        let mut pending = self.pending_io_logs.lock();
+        for log in logs.children {
+            if self.children_iter().any(|c| {
+                NexusChild::uuid(c.uri()).map_or(false, |u| u == log.uuid)
+            }) {
+                warn!(
+                    "{self:?}: child '{uuid}' is already part of the nexus, \
+                    dropping its saved I/O log",
+                    uuid = log.uuid
+                );
+                continue;
+            }
+
+            info!(
+                "{self:?}: restored I/O log of child '{uuid}': \
+                {n} modified extents",
+                uuid = log.uuid,
+                n = log.extents.len()
+            );
+            pending.insert(log.uuid.clone(), log.into_io_log());
+        }
+    }
+
+    /// Saves the I/O logs of the children, and the pending ones. Must be
+    /// called once the nexus I/O has stopped; the logs are consumed.
+    pub(super) async fn save_io_logs(&self) {
+        if !Self::io_log_persistence_enabled() {
+            return;
+        }
+
+        let mut logs: Vec<(String, IOLog)> =
+            self.pending_io_logs.lock().drain().collect();
+        logs.extend(self.children_iter().filter_map(|c| {
+            let uuid = NexusChild::uuid(c.uri())?;
+            c.take_io_log().map(|log| (uuid, log))
+        }));
+
+        if logs.is_empty() {
+            return;
+        }
+
+        let children = logs
+            .into_iter()
+            .filter_map(|(uuid, log)| {
+                let segments = log.into_segments();
+                let saved = ChildIoLog::new(uuid.clone(), &segments);
+                if saved.is_none() {
+                    warn!(
+                        "{self:?}: I/O log of child '{uuid}' is too large \
+                        to be saved, the child will be fully rebuilt"
+                    );
+                }
+                saved
+            })
+            .collect();
+
+        let key = self.io_logs_key().await;
+        match PersistentStore::put(
+            &key,
+            &NexusIoLogs {
+                children,
+            },
+        )
+        .await
+        {
+            Ok(_) => info!("{self:?}: saved I/O logs"),
+            Err(error) => error!("{self:?}: failed to save I/O logs: {error}"),
+        }
+    }
+
+    /// Removes the saved I/O logs of this nexus, if any.
+    pub(super) async fn delete_io_logs(&self) {
+        if !Self::io_log_persistence_enabled() {
+            return;
+        }
+
+        let key = self.io_logs_key().await;
+        match PersistentStore::delete(&key).await {
+            Ok(_)
+            | Err(StoreError::MissingEntry {
+                ..
+            }) => {}
+            Err(error) => {
+                error!("{self:?}: failed to remove saved I/O logs: {error}")
+            }
+        }
+    }
+
+    /// Gives the restored I/O log of the given child to it, if any.
+    pub(super) fn restore_child_io_log(&self, child: &NexusChild<'n>) {
+        let Some(uuid) = NexusChild::uuid(child.uri()) else {
+            return;
+        };
+
+        if let Some(log) = self.pending_io_logs.lock().remove(&uuid) {
+            child.restore_io_log(log);
+        }
+    }
+
+    /// Returns the channels of the pending I/O logs for the current core.
+    pub(super) fn pending_io_log_channels(&self) -> Vec<IOLogChannel> {
+        self.pending_io_logs
+            .lock()
+            .values()
+            .map(|log| log.current_channel())
+            .collect()
+    }
+}
+
+/// Pending I/O logs of a nexus, by child UUID.
+pub(super) type PendingIoLogs = parking_lot::Mutex<HashMap<String, IOLog>>;
@@ -7,7 +7,7 @@ use std::{
 use crossbeam::atomic::AtomicCell;
 use futures::channel::oneshot;
 
-use super::{Error, Nexus};
+use super::{nexus_read_policy::now_ticks, Error, Nexus};
 
 use crate::{
     core::{Bdev, Cores, Protocol, Share},
@@ -53,6 +53,8 @@ pub(super) struct NexusIoSubsystem<'n> {
     pause_waiters: VecDeque<oneshot::Sender<i32>>,
     /// Pause counter.
     pause_cnt: AtomicU32,
+    /// Ticks at which the current pause started.
+    paused_at: u64,
 }
 
 impl<'n> Debug for NexusIoSubsystem<'n> {
@@ -75,6 +77,7 @@ impl<'n> NexusIoSubsystem<'n> {
             pause_waiters: VecDeque::with_capacity(8), /* Default number of
                                                         * replicas */
             pause_cnt: AtomicU32::new(0),
+            paused_at: 0,
             name,
             bdev,
         }
@@ -85,6 +88,12 @@ impl<'n> NexusIoSubsystem<'n> {
         self.pause_state.load()
     }
 
+    /// Records the duration of the pause which just ended.
+    fn record_pause(&self) {
+        let ticks = now_ticks().saturating_sub(self.paused_at);
+        self.bdev.data().freeze_latency.lock().pause.record(ticks);
+    }
+
     /// Suspend any incoming IO to the bdev pausing the controller allows us to
     /// handle internal events and which is a protocol feature.
     /// In case concurrent pause requests take place, the other callers
@@ -116,6 +125,7 @@ impl<'n> NexusIoSubsystem<'n> {
                         0,
                         "Corrupted subsystem pause counter"
                     );
+                    self.paused_at = now_ticks();
 
                     if let Some(Protocol::Nvmf) = self.bdev.shared() {
                         if let Some(subsystem) =
@@ -288,6 +298,7 @@ impl<'n> NexusIoSubsystem<'n> {
                                 );
                             }
                             self.pause_state.store(NexusPauseState::Unpaused);
+                            self.record_pause();
                         }
                     }
                     break;
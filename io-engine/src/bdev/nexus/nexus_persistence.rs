@@ -23,6 +23,15 @@ impl PersistentNexusInfo {
         }
     }
 
+    /// Returns the key used to persist the NexusInfo structure: the key
+    /// supplied by the control plane, or the nexus uuid otherwise.
+    pub(super) fn key(&self, nexus: &Nexus) -> String {
+        match &self.key {
+            Some(k) => k.clone(),
+            None => nexus.uuid().to_string(),
+        }
+    }
+
     /// Get a mutable reference to the inner NexusInfo structure.
     fn inner_mut(&mut self) -> &mut NexusInfo {
         &mut self.inner
@@ -206,17 +215,17 @@ impl<'n> Nexus<'n> {
     // Saves the nexus info to the store. This is integral to ensuring data
     // consistency across restarts of Mayastor. Therefore, keep retrying
     // until successful.
+    // The puts of all nexuses are batched, so that a storm of child state
+    // changes, e.g. on a node loss, does not serialise behind one store
+    // round-trip per nexus. The put returns only once the info is written.
     async fn save(&self, info: &PersistentNexusInfo) -> Result<(), Error> {
-        // If a key has been provided, use it to store the NexusInfo; use the
-        // nexus uuid as the key otherwise.
-        let key = match &info.key {
-            Some(k) => k.clone(),
-            None => self.uuid().to_string(),
-        };
+        let key = info.key(self);
 
         let mut retry = PersistentStore::retries();
         loop {
-            let Err(err) = PersistentStore::put(&key, &info.inner).await else {
+            let Err(err) =
+                PersistentStore::put_batched(&key, &info.inner).await
+            else {
                 trace!(?key, "{self:?}: the state was saved successfully");
                 return Ok(());
             };
@@ -0,0 +1,348 @@
+//!
+//! Per-nexus quality of service.
+//!
+//! Reads and writes submitted to a nexus with QoS limits take tokens from
+//! the IOPS and bandwidth buckets of their direction. The buckets are shared
+//! by the I/O channels of all cores and refill at the configured rates, up to
+//! `burst_ms` worth of tokens, so that a volume idle for a while may exceed
+//! its rate briefly. An I/O which finds a bucket empty is queued on its
+//! channel, along with every later read and write of the channel to keep
+//! their order, and released by a channel poller once tokens are available.
+//!
+//! The pollers of the channels of a core share a release budget per poll,
+//! split between the throttled nexuses in proportion to their weights, so
+//! that releasing a large backlog neither monopolizes the reactor nor lets a
+//! noisy volume crowd out the others.
+use std::{
+    cell::Cell,
+    pin::Pin,
+    sync::{
+        atomic::{AtomicI64, AtomicU64, Ordering},
+        Arc,
+    },
+    time::Duration,
+};
+
+use serde::{Deserialize, Serialize};
+use spdk_rs::libspdk::spdk_get_ticks_hz;
+
+use super::{nexus_read_policy::now_ticks, DrEvent, Error, Nexus};
+use crate::core::IoType;
+
+/// Period of the pollers releasing throttled I/Os.
+pub(super) const QOS_POLL_PERIOD: Duration = Duration::from_micros(100);
+
+/// Maximum number of throttled I/Os released per poll on a core, shared by
+/// the throttled nexuses by weight.
+const QOS_RELEASE_BUDGET: u64 = 256;
+
+/// Default weight of a nexus.
+const DEFAULT_QOS_WEIGHT: u32 = 100;
+
+/// QoS settings of a nexus. Zero limits are unlimited.
+#[derive(Serialize, Deserialize, Debug, Clone, Copy, PartialEq, Eq)]
+#[serde(default)]
+pub struct NexusQos {
+    /// Read I/Os per second.
+    pub read_iops: u64,
+    /// Write I/Os per second.
+    pub write_iops: u64,
+    /// Read bandwidth, in MiB per second.
+    pub read_mbps: u64,
+    /// Write bandwidth, in MiB per second.
+    pub write_mbps: u64,
+    /// Burst credits, in milliseconds of each limit's rate.
+    pub burst_ms: u64,
+    /// Weight of the nexus when sharing the release of throttled I/Os with
+    /// the other nexuses of a core.
+    pub weight: u32,
+}
+
+impl Default for NexusQos {
+    fn default() -> Self {
+        Self {
+            read_iops: 0,
+            write_iops: 0,
+            read_mbps: 0,
+            write_mbps: 0,
+            burst_ms: 100,
+            weight: DEFAULT_QOS_WEIGHT,
+        }
+    }
+}
+
+impl NexusQos {
+    /// True if no limit is set.
+    pub fn is_unlimited(&self) -> bool {
+        self.read_iops == 0
+            && self.write_iops == 0
+            && self.read_mbps == 0
+            && self.write_mbps == 0
+    }
+}
+
+/// Throttling statistics of a nexus.
+#[derive(Serialize, Debug, Default, Clone, Copy)]
+pub struct NexusQosStats {
+    /// Number of I/Os which were throttled.
+    pub throttled_ios: u64,
+    /// Total time spent by the throttled I/Os in the queues, in
+    /// microseconds.
+    pub throttled_us: u64,
+    /// Number of I/Os currently queued.
+    pub queued_ios: u64,
+}
+
+/// Token bucket refilled at a constant rate.
+struct TokenBucket {
+    /// Tokens per second.
+    rate: u64,
+    /// Maximum number of tokens.
+    burst: i64,
+    /// Available tokens. Large I/Os may take more tokens than available, as
+    /// long as there are some, leaving the bucket in debt.
+    tokens: AtomicI64,
+    /// Ticks the tokens were added until.
+    refilled: AtomicU64,
+}
+
+impl TokenBucket {
+    fn new(rate: u64, burst_ms: u64, now: u64) -> Option<Self> {
+        if rate == 0 {
+            return None;
+        }
+        let burst = (rate.saturating_mul(burst_ms.max(1)) / 1000).max(1);
+        Some(Self {
+            rate,
+            burst: burst.min(i64::MAX as u64) as i64,
+            tokens: AtomicI64::new(burst.min(i64::MAX as u64) as i64),
+            refilled: AtomicU64::new(now),
+        })
+    }
+
+    /// Adds the tokens accrued since the last refill.
+    fn refill(&self, now: u64, ticks_hz: u64) {
+        let refilled = self.refilled.load(Ordering::Relaxed);
+        let elapsed = now.saturating_sub(refilled) as u128;
+        let add = elapsed * self.rate as u128 / ticks_hz as u128;
+        if add == 0 {
+            return;
+        }
+
+        // Only the ticks of the added tokens are consumed, so that no
+        // fraction of a token is lost between refills.
+        let used = (add * ticks_hz as u128 / self.rate as u128) as u64;
+        if self
+            .refilled
+            .compare_exchange(
+                refilled,
+                refilled + used,
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+            )
+            .is_ok()
+        {
+            let add = add.min(self.burst as u128) as i64;
+            let _ = self.tokens.fetch_update(
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+                |t| Some(t.saturating_add(add).min(self.burst)),
+            );
+        }
+    }
+
+    /// Takes the given number of tokens if some are available.
+    fn try_take(&self, n: u64) -> bool {
+        self.tokens
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |t| {
+                (t > 0).then(|| t - n as i64)
+            })
+            .is_ok()
+    }
+
+    /// Gives back tokens taken for an I/O which was not admitted.
+    fn give_back(&self, n: u64) {
+        self.tokens.fetch_add(n as i64, Ordering::Relaxed);
+    }
+}
+
+/// Rate limiter of a nexus, shared by its I/O channels.
+pub(crate) struct QosLimiter {
+    qos: NexusQos,
+    ticks_hz: u64,
+    read_iops: Option<TokenBucket>,
+    write_iops: Option<TokenBucket>,
+    read_bytes: Option<TokenBucket>,
+    write_bytes: Option<TokenBucket>,
+    throttled_ios: AtomicU64,
+    throttled_ticks: AtomicU64,
+    queued_ios: AtomicU64,
+}
+
+impl QosLimiter {
+    /// Creates a new limiter with the given settings.
+    pub(super) fn new(qos: NexusQos, now: u64) -> Self {
+        const MIB: u64 = 1024 * 1024;
+        let burst = qos.burst_ms;
+
+        Self {
+            qos,
+            ticks_hz: unsafe { spdk_get_ticks_hz() },
+            read_iops: TokenBucket::new(qos.read_iops, burst, now),
+            write_iops: TokenBucket::new(qos.write_iops, burst, now),
+            read_bytes: TokenBucket::new(
+                qos.read_mbps.saturating_mul(MIB),
+                burst,
+                now,
+            ),
+            write_bytes: TokenBucket::new(
+                qos.write_mbps.saturating_mul(MIB),
+                burst,
+                now,
+            ),
+            throttled_ios: AtomicU64::new(0),
+            throttled_ticks: AtomicU64::new(0),
+            queued_ios: AtomicU64::new(0),
+        }
+    }
+
+    /// Settings of the limiter.
+    pub(super) fn qos(&self) -> NexusQos {
+        self.qos
+    }
+
+    /// Weight of the nexus.
+    pub(super) fn weight(&self) -> u64 {
+        self.qos.weight.max(1) as u64
+    }
+
+    /// Determines if I/Os of the given type are rate limited.
+    pub(super) fn is_limited(io_type: IoType) -> bool {
+        matches!(io_type, IoType::Read | IoType::Write)
+    }
+
+    /// Takes the tokens of an I/O of the given type and size, if available.
+    pub(super) fn admit(&self, io_type: IoType, bytes: u64, now: u64) -> bool {
+        let (iops, bw) = match io_type {
+            IoType::Read => (&self.read_iops, &self.read_bytes),
+            IoType::Write => (&self.write_iops, &self.write_bytes),
+            _ => return true,
+        };
+
+        if let Some(b) = iops {
+            b.refill(now, self.ticks_hz);
+            if !b.try_take(1) {
+                return false;
+            }
+        }
+
+        if let Some(b) = bw {
+            b.refill(now, self.ticks_hz);
+            if !b.try_take(bytes) {
+                if let Some(b) = iops {
+                    b.give_back(1);
+                }
+                return false;
+            }
+        }
+
+        true
+    }
+
+    /// Accounts for I/Os queued on, or moved between, channels.
+    pub(super) fn queued(&self, n: u64, throttled: bool) {
+        self.queued_ios.fetch_add(n, Ordering::Relaxed);
+        if throttled {
+            self.throttled_ios.fetch_add(n, Ordering::Relaxed);
+        }
+    }
+
+    /// Accounts for an I/O released after having been queued for the given
+    /// number of ticks, or for I/Os moved away to another limiter.
+    pub(super) fn dequeued(&self, n: u64, ticks: u64) {
+        self.queued_ios.fetch_sub(n, Ordering::Relaxed);
+        self.throttled_ticks.fetch_add(ticks, Ordering::Relaxed);
+    }
+
+    /// Returns the throttling statistics.
+    pub(super) fn stats(&self) -> NexusQosStats {
+        NexusQosStats {
+            throttled_ios: self.throttled_ios.load(Ordering::Relaxed),
+            throttled_us: self.throttled_ticks.load(Ordering::Relaxed)
+                * 1_000_000
+                / self.ticks_hz.max(1),
+            queued_ios: self.queued_ios.load(Ordering::Relaxed),
+        }
+    }
+}
+
+thread_local! {
+    /// Sum of the weights of the channels of this core with throttled I/Os.
+    static QOS_BACKLOG: Cell<u64> = const { Cell::new(0) };
+}
+
+/// Registers a channel of this core which started throttling I/Os.
+pub(super) fn qos_backlog_add(weight: u64) {
+    QOS_BACKLOG.with(|b| b.set(b.get() + weight));
+}
+
+/// Unregisters a channel of this core which has no more throttled I/Os.
+pub(super) fn qos_backlog_remove(weight: u64) {
+    QOS_BACKLOG.with(|b| b.set(b.get().saturating_sub(weight)));
+}
+
+/// Returns the number of throttled I/Os a channel of the given weight may
+/// release in one poll.
+pub(super) fn qos_release_share(weight: u64) -> usize {
+    let backlog = QOS_BACKLOG.with(|b| b.get()).max(weight);
+    (QOS_RELEASE_BUDGET * weight / backlog).max(1) as usize
+}
+
+impl<'n> Nexus<'n> {
+    /// Returns the rate limiter of the nexus, if QoS limits are set.
+    pub(super) fn qos_limiter(&self) -> Option<Arc<QosLimiter>> {
+        self.qos.lock().clone()
+    }
+
+    /// Returns the QoS settings of the nexus, if limits are set.
+    pub fn qos(&self) -> Option<NexusQos> {
+        self.qos.lock().as_ref().map(|q| q.qos())
+    }
+
+    /// Returns the throttling statistics of the nexus, since its current QoS
+    /// settings were applied.
+    pub fn qos_stats(&self) -> NexusQosStats {
+        self.qos
+            .lock()
+            .as_ref()
+            .map(|q| q.stats())
+            .unwrap_or_default()
+    }
+
+    /// Sets or removes the QoS limits of the nexus. Settings without any
+    /// limit remove them. The nexus I/O is paused while the I/O channels
+    /// switch to the new limiter, and the I/Os throttled by the previous one
+    /// are moved to it.
+    pub async fn set_qos(
+        mut self: Pin<&mut Self>,
+        qos: Option<NexusQos>,
+    ) -> Result<(), Error> {
+        let qos = qos.filter(|q| !q.is_unlimited());
+        if self.qos() == qos {
+            return Ok(());
+        }
+
+        self.as_mut().pause().await?;
+
+        *self.qos.lock() =
+            qos.map(|q| Arc::new(QosLimiter::new(q, now_ticks())));
+        self.reconfigure(DrEvent::QosChange).await;
+
+        match qos {
+            Some(q) => info!("{self:?}: QoS limits set: {q:?}"),
+            None => info!("{self:?}: QoS limits removed"),
+        }
+
+        self.resume().await
+    }
+}
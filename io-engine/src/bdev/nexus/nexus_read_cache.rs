@@ -0,0 +1,610 @@
+//!
+//! Read cache of a nexus.
+//!
+//! The blocks read from the children of a nexus with a read cache are kept in
+//! hugepage DMA memory, by lines of `READ_CACHE_LINE_BYTES`, so that later
+//! reads of the same blocks complete without any child I/O. This helps
+//! read-heavy workloads with a small hot set, such as booting VMs from the
+//! same image or cloned snapshots, when no child is local to the nexus.
+//!
+//! A line is cached once a read covering all of it completes successfully,
+//! and evicted by a CLOCK sweep when the cache is full. Writes, write zeroes
+//! and unmaps passing through the nexus remove the lines they touch from the
+//! cache when they are submitted and again when they complete, and bump the
+//! cache generation: the data of a read submitted before the generation
+//! changed is not cached, as it may predate a write in flight.
+//!
+//! The cache is shared by the I/O channels of all cores. Its lines are spread
+//! by hash over up to `READ_CACHE_SHARDS` shards, each with its own lock.
+//! Reads and writes only take the locks when a counting filter indexed by
+//! line says their lines may be cached, and the data are copied outside of
+//! the locks, into or from slots pinned meanwhile. A line is copied into a
+//! free slot which is published once the copy is done, and is never written
+//! again while cached. The memory of the caches of all nexuses of the node is
+//! bounded by `NEXUS_READ_CACHE_NODE_MB` MiB (1024 by default).
+use std::{
+    collections::HashMap,
+    pin::Pin,
+    sync::{
+        atomic::{AtomicU32, AtomicU64, Ordering},
+        Arc,
+    },
+};
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+use serde::Serialize;
+use spdk_rs::{DmaBuf, IoVec};
+
+use super::{DrEvent, Error, Nexus};
+
+/// Size of a cache line.
+const READ_CACHE_LINE_BYTES: u64 = 4096;
+
+/// Size of the DMA buffers the cache lines are allocated from.
+const READ_CACHE_CHUNK_BYTES: u64 = 2 * 1024 * 1024;
+
+/// Maximum number of shards of a cache, each with at least one chunk.
+const READ_CACHE_SHARDS: usize = 16;
+
+/// Number of counters of the filter of the cached lines, as a power of 2.
+const FILTER_BITS: u32 = 12;
+
+/// Memory of the read caches of all nexuses, in bytes.
+static NODE_CACHE_LIMIT: Lazy<u64> = Lazy::new(|| {
+    std::env::var("NEXUS_READ_CACHE_NODE_MB")
+        .ok()
+        .and_then(|s| s.parse::<u64>().ok())
+        .unwrap_or(1024)
+        * 1024
+        * 1024
+});
+
+/// Memory currently used by the read caches, in bytes.
+static NODE_CACHE_USED: AtomicU64 = AtomicU64::new(0);
+
+/// Read cache statistics of a nexus.
+#[derive(Serialize, Debug, Default, Clone, Copy)]
+pub struct NexusReadCacheStats {
+    /// Size of the cache, in MiB.
+    pub size_mb: u64,
+    /// Number of cached lines.
+    pub cached_lines: u64,
+    /// Number of reads served from the cache.
+    pub hits: u64,
+    /// Number of reads submitted to the children.
+    pub misses: u64,
+    /// Number of lines cached.
+    pub fills: u64,
+    /// Number of lines evicted to cache others.
+    pub evictions: u64,
+    /// Number of lines removed by writes.
+    pub invalidations: u64,
+}
+
+/// Cache slot.
+#[derive(Clone, Copy, Default)]
+struct Slot {
+    /// Line cached in the slot, if any.
+    line: Option<u64>,
+    /// Whether the line was used since the last sweep of the CLOCK hand.
+    referenced: bool,
+}
+
+/// Cached lines of a shard and their memory.
+struct CacheLines {
+    chunks: Vec<DmaBuf>,
+    /// Slots of the cached lines, by line number.
+    index: HashMap<u64, usize>,
+    slots: Vec<Slot>,
+    /// CLOCK hand.
+    hand: usize,
+}
+
+// The DMA buffers are only accessed with the lock of the shard held, or
+// through a pinned slot.
+unsafe impl Send for CacheLines {}
+
+impl CacheLines {
+    /// Returns the memory of the given slot.
+    #[inline(always)]
+    fn slot_ptr(&self, slot: usize) -> *mut u8 {
+        let per_chunk =
+            (READ_CACHE_CHUNK_BYTES / READ_CACHE_LINE_BYTES) as usize;
+        let chunk = &self.chunks[slot / per_chunk];
+        unsafe {
+            (chunk.as_ptr() as *mut u8)
+                .add((slot % per_chunk) * READ_CACHE_LINE_BYTES as usize)
+        }
+    }
+}
+
+/// Shard of the cache, holding the lines hashed to it.
+struct CacheShard {
+    lines: Mutex<CacheLines>,
+    /// Number of copies in progress from or into each slot, outside of the
+    /// lock. Only incremented with the lock held: a slot found unpinned
+    /// under the lock can be reused.
+    pins: Box<[AtomicU32]>,
+}
+
+impl CacheShard {
+    /// Pins the slot of the given line, if cached. Returns the slot and its
+    /// memory.
+    #[inline(always)]
+    fn pin(&self, line: u64) -> Option<(usize, *mut u8)> {
+        let mut lines = self.lines.lock();
+        let slot = *lines.index.get(&line)?;
+        lines.slots[slot].referenced = true;
+        self.pins[slot].fetch_add(1, Ordering::Acquire);
+        Some((slot, lines.slot_ptr(slot)))
+    }
+
+    /// Unpins the given slot.
+    #[inline(always)]
+    fn unpin(&self, slot: usize) {
+        self.pins[slot].fetch_sub(1, Ordering::Release);
+    }
+}
+
+/// Read cache of a nexus.
+pub(crate) struct ReadCache {
+    size: u64,
+    block_len: u64,
+    line_blocks: u64,
+    shards: Box<[CacheShard]>,
+    /// Generation of the cache, bumped by each write.
+    gen: AtomicU64,
+    /// Number of cached lines per filter counter.
+    filter: Box<[AtomicU32]>,
+    hits: AtomicU64,
+    misses: AtomicU64,
+    fills: AtomicU64,
+    evictions: AtomicU64,
+    invalidations: AtomicU64,
+}
+
+impl Drop for ReadCache {
+    fn drop(&mut self) {
+        NODE_CACHE_USED.fetch_sub(self.size, Ordering::SeqCst);
+    }
+}
+
+impl ReadCache {
+    /// Creates a cache of the given size for a nexus with the given block
+    /// size, within the memory left to the read caches of the node.
+    fn new(name: &str, size: u64, block_len: u64) -> Result<Self, Error> {
+        let err = |reason: String| Error::ReadCache {
+            name: name.to_string(),
+            reason,
+        };
+
+        if block_len == 0 || READ_CACHE_LINE_BYTES % block_len != 0 {
+            return Err(err(format!(
+                "block size {block_len} does not divide the cache line size"
+            )));
+        }
+
+        let size = size - size % READ_CACHE_CHUNK_BYTES;
+        if size == 0 {
+            return Err(err(format!(
+                "size must be at least {} MiB",
+                READ_CACHE_CHUNK_BYTES / (1024 * 1024)
+            )));
+        }
+
+        NODE_CACHE_USED
+            .fetch_update(Ordering::SeqCst, Ordering::SeqCst, |used| {
+                (used + size <= *NODE_CACHE_LIMIT).then_some(used + size)
+            })
+            .map_err(|used| {
+                err(format!(
+                    "{} MiB left to the read caches of the node",
+                    (*NODE_CACHE_LIMIT).saturating_sub(used) / (1024 * 1024)
+                ))
+            })?;
+
+        let num_chunks = (size / READ_CACHE_CHUNK_BYTES) as usize;
+        let num_shards = num_chunks.min(READ_CACHE_SHARDS);
+
+        // Each shard gets the same number of chunks, give or take one.
+        let mut shard_chunks: Vec<Vec<DmaBuf>> =
+            (0 .. num_shards).map(|_| Vec::new()).collect();
+        for i in 0 .. num_chunks {
+            let chunk =
+                DmaBuf::new(READ_CACHE_CHUNK_BYTES, 4096).map_err(|_| {
+                    NODE_CACHE_USED.fetch_sub(size, Ordering::SeqCst);
+                    err("failed to allocate DMA memory".to_string())
+                })?;
+            shard_chunks[i % num_shards].push(chunk);
+        }
+
+        let per_chunk =
+            (READ_CACHE_CHUNK_BYTES / READ_CACHE_LINE_BYTES) as usize;
+        let shards = shard_chunks
+            .into_iter()
+            .map(|chunks| {
+                let num_slots = chunks.len() * per_chunk;
+                CacheShard {
+                    lines: Mutex::new(CacheLines {
+                        chunks,
+                        index: HashMap::with_capacity(num_slots),
+                        slots: vec![Slot::default(); num_slots],
+                        hand: 0,
+                    }),
+                    pins: (0 .. num_slots).map(|_| AtomicU32::new(0)).collect(),
+                }
+            })
+            .collect();
+
+        Ok(Self {
+            size,
+            block_len,
+            line_blocks: READ_CACHE_LINE_BYTES / block_len,
+            shards,
+            gen: AtomicU64::new(0),
+            filter: (0 .. 1 << FILTER_BITS)
+                .map(|_| AtomicU32::new(0))
+                .collect(),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+            fills: AtomicU64::new(0),
+            evictions: AtomicU64::new(0),
+            invalidations: AtomicU64::new(0),
+        })
+    }
+
+    /// Returns the filter counter of the given line.
+    #[inline(always)]
+    fn filter(&self, line: u64) -> &AtomicU32 {
+        let h = line.wrapping_mul(0x9e37_79b9_7f4a_7c15) >> (64 - FILTER_BITS);
+        &self.filter[h as usize]
+    }
+
+    /// Returns the shard of the given line.
+    #[inline(always)]
+    fn shard(&self, line: u64) -> &CacheShard {
+        let h = line.wrapping_mul(0x9e37_79b9_7f4a_7c15) >> 32;
+        &self.shards[h as usize % self.shards.len()]
+    }
+
+    /// Returns the current generation of the cache, to be passed to `fill`
+    /// with the data of a read submitted now.
+    #[inline(always)]
+    pub(super) fn generation(&self) -> u64 {
+        self.gen.load(Ordering::SeqCst)
+    }
+
+    /// Copies the given blocks into the given buffers if all of them are
+    /// cached. Returns true on hit. On a miss, the buffers may have been
+    /// partly written.
+    pub(super) fn read(
+        &self,
+        offset: u64,
+        num_blocks: u64,
+        iovs: &[IoVec],
+    ) -> bool {
+        if num_blocks == 0 {
+            return false;
+        }
+
+        let first = offset / self.line_blocks;
+        let last = (offset + num_blocks - 1) / self.line_blocks;
+
+        // Most misses are found without taking any lock.
+        if (first ..= last).any(|l| self.filter(l).load(Ordering::SeqCst) == 0)
+        {
+            self.misses.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+
+        let mut dst = IovCursor::new(iovs);
+        let mut blk = offset;
+        let end = offset + num_blocks;
+        while blk < end {
+            let line = blk / self.line_blocks;
+            let line_end = ((line + 1) * self.line_blocks).min(end);
+
+            let shard = self.shard(line);
+            let Some((slot, ptr)) = shard.pin(line) else {
+                self.misses.fetch_add(1, Ordering::Relaxed);
+                return false;
+            };
+
+            let src = unsafe {
+                ptr.add(((blk % self.line_blocks) * self.block_len) as usize)
+            };
+            dst.copy_from(src, (line_end - blk) * self.block_len);
+            shard.unpin(slot);
+            blk = line_end;
+        }
+
+        self.hits.fetch_add(1, Ordering::Relaxed);
+        true
+    }
+
+    /// Caches the lines fully covered by the given blocks, read into the given
+    /// buffers by a read submitted at the given cache generation.
+    pub(super) fn fill(
+        &self,
+        offset: u64,
+        num_blocks: u64,
+        iovs: &[IoVec],
+        gen: u64,
+    ) {
+        let first = (offset + self.line_blocks - 1) / self.line_blocks;
+        let end = (offset + num_blocks) / self.line_blocks;
+        if first >= end || self.generation() != gen {
+            return;
+        }
+
+        let mut src = IovCursor::new(iovs);
+        src.skip((first * self.line_blocks - offset) * self.block_len);
+
+        let mut filled = 0;
+        for line in first .. end {
+            if self.fill_line(line, &mut src) {
+                filled += 1;
+            }
+        }
+
+        // A write bumps the generation before checking the filter, and the
+        // filter was updated before checking the generation: either the write
+        // finds the lines, or they are removed here.
+        if self.generation() != gen {
+            for line in first .. end {
+                self.remove(&mut self.shard(line).lines.lock(), line);
+            }
+            return;
+        }
+
+        self.fills.fetch_add(filled, Ordering::Relaxed);
+    }
+
+    /// Caches the given line, copied from the given buffers outside of the
+    /// lock of its shard, into a free slot pinned meanwhile. The slot is only
+    /// published once the copy is done, and a line already cached is left
+    /// untouched: the data of a cached line never change, so that hits never
+    /// copy a line being written. Returns true if the line was cached.
+    fn fill_line(&self, line: u64, src: &mut IovCursor) -> bool {
+        let shard = self.shard(line);
+
+        let (slot, ptr) = {
+            let mut lines = shard.lines.lock();
+            let slot = if lines.index.contains_key(&line) {
+                None
+            } else {
+                self.evict(shard, &mut lines)
+            };
+            let Some(slot) = slot else {
+                src.skip(READ_CACHE_LINE_BYTES);
+                return false;
+            };
+            shard.pins[slot].fetch_add(1, Ordering::Acquire);
+            (slot, lines.slot_ptr(slot))
+        };
+
+        src.copy_to(ptr, READ_CACHE_LINE_BYTES);
+
+        let mut lines = shard.lines.lock();
+        // Cached by another read meanwhile: the slot is left free.
+        let cached = !lines.index.contains_key(&line);
+        if cached {
+            lines.index.insert(line, slot);
+            lines.slots[slot] = Slot {
+                line: Some(line),
+                referenced: true,
+            };
+            self.filter(line).fetch_add(1, Ordering::SeqCst);
+        }
+        shard.unpin(slot);
+        cached
+    }
+
+    /// Frees a slot of the given shard, evicting the line of the first slot
+    /// not referenced since the last sweep of the CLOCK hand, and not
+    /// pinned. Returns None if all the slots are pinned.
+    fn evict(
+        &self,
+        shard: &CacheShard,
+        lines: &mut CacheLines,
+    ) -> Option<usize> {
+        for _ in 0 .. 2 * lines.slots.len() {
+            let slot = lines.hand;
+            lines.hand = (lines.hand + 1) % lines.slots.len();
+
+            if shard.pins[slot].load(Ordering::Acquire) > 0 {
+                continue;
+            }
+
+            let s = &mut lines.slots[slot];
+            if s.referenced {
+                s.referenced = false;
+                continue;
+            }
+
+            if let Some(line) = s.line.take() {
+                lines.index.remove(&line);
+                self.filter(line).fetch_sub(1, Ordering::SeqCst);
+                self.evictions.fetch_add(1, Ordering::Relaxed);
+            }
+            return Some(slot);
+        }
+        None
+    }
+
+    /// Removes the given line from the cache, if cached.
+    fn remove(&self, lines: &mut CacheLines, line: u64) -> bool {
+        let Some(slot) = lines.index.remove(&line) else {
+            return false;
+        };
+        lines.slots[slot] = Slot::default();
+        self.filter(line).fetch_sub(1, Ordering::SeqCst);
+        true
+    }
+
+    /// Removes the lines of the given blocks from the cache, before they are
+    /// written and once written.
+    pub(super) fn invalidate(&self, offset: u64, num_blocks: u64) {
+        self.gen.fetch_add(1, Ordering::SeqCst);
+
+        let first = offset / self.line_blocks;
+        let end = (offset + num_blocks.max(1) - 1) / self.line_blocks + 1;
+
+        let mut removed = 0;
+
+        if end - first > self.filter.len() as u64 {
+            // Large unmaps: walk the cached lines instead.
+            for shard in self.shards.iter() {
+                let mut l = shard.lines.lock();
+                let stale: Vec<u64> = l
+                    .index
+                    .keys()
+                    .copied()
+                    .filter(|line| (first .. end).contains(line))
+                    .collect();
+                stale.into_iter().for_each(|line| {
+                    removed += self.remove(&mut l, line) as u64;
+                });
+            }
+        } else {
+            for line in first .. end {
+                if self.filter(line).load(Ordering::SeqCst) == 0 {
+                    continue;
+                }
+                removed += self.remove(&mut self.shard(line).lines.lock(), line)
+                    as u64;
+            }
+        }
+
+        if removed > 0 {
+            self.invalidations.fetch_add(removed, Ordering::Relaxed);
+        }
+    }
+
+    /// Returns the statistics of the cache.
+    pub(super) fn stats(&self) -> NexusReadCacheStats {
+        NexusReadCacheStats {
+            size_mb: self.size / (1024 * 1024),
+            cached_lines: self
+                .shards
+                .iter()
+                .map(|s| s.lines.lock().index.len() as u64)
+                .sum(),
+            hits: self.hits.load(Ordering::Relaxed),
+            misses: self.misses.load(Ordering::Relaxed),
+            fills: self.fills.load(Ordering::Relaxed),
+            evictions: self.evictions.load(Ordering::Relaxed),
+            invalidations: self.invalidations.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Position in a list of I/O vectors.
+struct IovCursor<'a> {
+    iovs: &'a [IoVec],
+    idx: usize,
+    off: usize,
+}
+
+impl<'a> IovCursor<'a> {
+    fn new(iovs: &'a [IoVec]) -> Self {
+        Self {
+            iovs,
+            idx: 0,
+            off: 0,
+        }
+    }
+
+    /// Moves the cursor by up to `len` bytes, calling the given function with
+    /// each contiguous part of the buffers and its offset from the start of
+    /// the move.
+    fn advance<F>(&mut self, len: u64, mut f: F)
+    where
+        F: FnMut(*mut u8, usize, usize),
+    {
+        let mut done = 0;
+        let len = len as usize;
+        while done < len && self.idx < self.iovs.len() {
+            let iov = &self.iovs[self.idx];
+            let n = (iov.len() as usize - self.off).min(len - done);
+            f(unsafe { (iov.as_ptr() as *mut u8).add(self.off) }, n, done);
+            done += n;
+            self.off += n;
+            if self.off == iov.len() as usize {
+                self.idx += 1;
+                self.off = 0;
+            }
+        }
+    }
+
+    fn skip(&mut self, len: u64) {
+        self.advance(len, |_, _, _| {});
+    }
+
+    /// Copies `len` bytes from `src` into the buffers.
+    fn copy_from(&mut self, src: *const u8, len: u64) {
+        self.advance(len, |p, n, done| unsafe {
+            std::ptr::copy_nonoverlapping(src.add(done), p, n)
+        });
+    }
+
+    /// Copies `len` bytes from the buffers into `dst`.
+    fn copy_to(&mut self, dst: *mut u8, len: u64) {
+        self.advance(len, |p, n, done| unsafe {
+            std::ptr::copy_nonoverlapping(p, dst.add(done), n)
+        });
+    }
+}
+
+impl<'n> Nexus<'n> {
+    /// Returns the read cache of the nexus, if any.
+    pub(super) fn read_cache(&self) -> Option<Arc<ReadCache>> {
+        self.read_cache.lock().clone()
+    }
+
+    /// Returns the statistics of the read cache of the nexus, if any.
+    pub fn read_cache_stats(&self) -> Option<NexusReadCacheStats> {
+        self.read_cache.lock().as_ref().map(|c| c.stats())
+    }
+
+    /// Sets up a read cache of the given size in MiB, rounded down to a
+    /// multiple of 2 MiB, replacing the current one; zero removes it. The
+    /// nexus I/O is paused while the I/O channels switch caches, so that no
+    /// read in flight fills the new cache. The current cache is released
+    /// first: the nexus is left without a cache if the new one cannot be
+    /// set up.
+    pub async fn set_read_cache(
+        mut self: Pin<&mut Self>,
+        size_mb: u64,
+    ) -> Result<(), Error> {
+        let size = size_mb * 1024 * 1024;
+        let current = self.read_cache.lock().as_ref().map_or(0, |c| c.size);
+        if size - size % READ_CACHE_CHUNK_BYTES == current {
+            return Ok(());
+        }
+
+        // Release the memory of the current cache before allocating the
+        // new one.
+        self.as_mut().pause().await?;
+        let old = self.read_cache.lock().take();
+        self.reconfigure(DrEvent::ReadCacheChange).await;
+        drop(old);
+
+        let res = if size > 0 {
+            ReadCache::new(&self.name, size, self.block_len()).map(|c| {
+                *self.read_cache.lock() = Some(Arc::new(c));
+            })
+        } else {
+            Ok(())
+        };
+
+        if res.is_ok() {
+            self.reconfigure(DrEvent::ReadCacheChange).await;
+            info!("{self:?}: read cache set to {size_mb} MiB");
+        }
+
+        self.resume().await?;
+        res
+    }
+}
@@ -0,0 +1,225 @@
+//!
+//! Read replica selection policies used by nexus I/O channels.
+//!
+//! Every nexus channel is owned by a single reactor, so the per-reader
+//! counters kept here are plain `Cell`s: they are only ever touched from the
+//! thread that owns the channel, and no atomics or locks are involved on the
+//! I/O hot path.
+use std::{
+    cell::Cell,
+    fmt::{Display, Formatter},
+    str::FromStr,
+    sync::atomic::{AtomicU8, Ordering},
+};
+
+use spdk_rs::libspdk::spdk_get_ticks;
+
+/// Policy used by a nexus channel to select a child for a read I/O.
+#[derive(Debug, Default, Copy, Clone, PartialEq, Eq)]
+#[repr(u8)]
+pub enum ReadPolicy {
+    /// Rotate between all readers.
+    #[default]
+    RoundRobin = 0,
+    /// Select the reader with the least number of outstanding I/Os on this
+    /// channel.
+    LeastOutstanding = 1,
+    /// Select the reader with the lowest expected completion time, based on
+    /// the EWMA of its read completion latency and its queue depth.
+    MinLatency = 2,
+    /// Prefer readers local to the nexus, falling back to the least
+    /// outstanding remote reader when no local one is available.
+    PreferLocal = 3,
+}
+
+impl ReadPolicy {
+    fn from_u8(v: u8) -> Self {
+        match v {
+            1 => Self::LeastOutstanding,
+            2 => Self::MinLatency,
+            3 => Self::PreferLocal,
+            _ => Self::RoundRobin,
+        }
+    }
+}
+
+impl Display for ReadPolicy {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        write!(
+            f,
+            "{}",
+            match self {
+                Self::RoundRobin => "round-robin",
+                Self::LeastOutstanding => "least-outstanding",
+                Self::MinLatency => "min-latency",
+                Self::PreferLocal => "prefer-local",
+            }
+        )
+    }
+}
+
+impl FromStr for ReadPolicy {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "round-robin" | "rr" => Ok(Self::RoundRobin),
+            "least-outstanding" | "lo" => Ok(Self::LeastOutstanding),
+            "min-latency" | "ewma" => Ok(Self::MinLatency),
+            "prefer-local" | "local" => Ok(Self::PreferLocal),
+            _ => Err(format!("unknown nexus read policy: '{s}'")),
+        }
+    }
+}
+
+/// Read policy applied to all nexus channels.
+static NEXUS_READ_POLICY: AtomicU8 =
+    AtomicU8::new(ReadPolicy::RoundRobin as u8);
+
+/// Sets the read policy for all nexus channels. Takes effect for the next
+/// read I/O submitted on every channel.
+pub fn set_read_policy(policy: ReadPolicy) {
+    NEXUS_READ_POLICY.store(policy as u8, Ordering::Relaxed);
+}
+
+/// Returns the current nexus read policy.
+#[inline(always)]
+pub fn read_policy() -> ReadPolicy {
+    ReadPolicy::from_u8(NEXUS_READ_POLICY.load(Ordering::Relaxed))
+}
+
+/// Weight of a new latency sample in the EWMA, as a power of two
+/// (i.e. 1/8).
+const EWMA_SHIFT: u32 = 3;
+
+/// Per-channel statistics of a reader, used by the read policies.
+/// The statistics of a child are kept as long as the child remains a reader
+/// of the channel, across reconnections of the channel.
+#[derive(Debug, Default)]
+pub(super) struct ReaderStats {
+    /// Identifier of the reader, unique within its channel.
+    id: u32,
+    /// URI of the reader's child.
+    uri: String,
+    /// Number of read I/Os submitted to the reader and not yet completed.
+    outstanding: Cell<u32>,
+    /// EWMA of read completion latency, in ticks.
+    ewma_ticks: Cell<u64>,
+    /// True if the reader's device is local to the nexus.
+    is_local: bool,
+    /// Set when a submission to the reader failed or it returned corrupted
+    /// data; the reader is skipped by the policies until the channel is
+    /// reconnected.
+    failed: Cell<bool>,
+    /// Index of the reader's child in the channel latency histograms.
+    latency_idx: usize,
+}
+
+impl ReaderStats {
+    /// Creates new reader statistics.
+    pub(super) fn new(
+        id: u32,
+        uri: &str,
+        is_local: bool,
+        latency_idx: usize,
+    ) -> Self {
+        Self {
+            id,
+            uri: uri.to_string(),
+            is_local,
+            latency_idx,
+            ..Default::default()
+        }
+    }
+
+    /// Reuses the statistics of a reader after its channel was reconnected:
+    /// the outstanding I/Os and the latency are kept, the failed submissions
+    /// are forgotten.
+    pub(super) fn reconnected(mut self, latency_idx: usize) -> Self {
+        self.failed.set(false);
+        self.latency_idx = latency_idx;
+        self
+    }
+
+    /// Identifier of the reader, unique within its channel.
+    #[inline(always)]
+    pub(super) fn id(&self) -> u32 {
+        self.id
+    }
+
+    /// URI of the reader's child.
+    pub(super) fn uri(&self) -> &str {
+        &self.uri
+    }
+
+    /// Accounts a submitted read I/O.
+    #[inline(always)]
+    pub(super) fn submitted(&self) {
+        self.outstanding.set(self.outstanding.get() + 1);
+    }
+
+    /// Accounts a failed read submission.
+    #[inline(always)]
+    pub(super) fn submission_failed(&self) {
+        self.failed.set(true);
+    }
+
+    /// Accounts a read which returned data not matching its checksums.
+    #[inline(always)]
+    pub(super) fn verify_failed(&self) {
+        self.failed.set(true);
+    }
+
+    /// Accounts a completed read I/O which took `sample` ticks.
+    #[inline(always)]
+    pub(super) fn completed(&self, sample: u64) {
+        self.outstanding
+            .set(self.outstanding.get().saturating_sub(1));
+
+        let ewma = self.ewma_ticks.get();
+        self.ewma_ticks.set(if ewma == 0 {
+            sample
+        } else {
+            ewma - (ewma >> EWMA_SHIFT) + (sample >> EWMA_SHIFT)
+        });
+    }
+
+    /// Number of outstanding read I/Os.
+    #[inline(always)]
+    pub(super) fn outstanding(&self) -> u32 {
+        self.outstanding.get()
+    }
+
+    /// Expected completion cost of a new I/O: the average latency multiplied
+    /// by the number of I/Os that would then be queued on the reader.
+    #[inline(always)]
+    pub(super) fn expected_ticks(&self) -> u64 {
+        self.ewma_ticks
+            .get()
+            .saturating_mul(self.outstanding.get() as u64 + 1)
+    }
+
+    /// True if the reader's device is local to the nexus.
+    #[inline(always)]
+    pub(super) fn is_local(&self) -> bool {
+        self.is_local
+    }
+
+    /// True if a submission to the reader failed.
+    #[inline(always)]
+    pub(super) fn is_failed(&self) -> bool {
+        self.failed.get()
+    }
+
+    /// Index of the reader's child in the channel latency histograms.
+    #[inline(always)]
+    pub(super) fn latency_idx(&self) -> usize {
+        self.latency_idx
+    }
+}
+
+/// Returns the current tick count.
+#[inline(always)]
+pub(super) fn now_ticks() -> u64 {
+    unsafe { spdk_get_ticks() }
+}
@@ -1,6 +1,11 @@
 /* I/O channel for NVMe controller, one per core. */
 
-use std::{mem::size_of, os::raw::c_void, ptr::NonNull, time::Duration};
+use std::{
+    mem::size_of,
+    os::raw::c_void,
+    ptr::NonNull,
+    time::{Duration, Instant},
+};
 
 use spdk_rs::{
     libspdk::{
@@ -18,14 +23,25 @@ use spdk_rs::{
 
 use crate::{
     bdev::device_lookup,
-    core::{BlockDevice, BlockDeviceIoStats, IoType},
+    core::{
+        BlockDevice,
+        BlockDeviceIoStats,
+        IoType,
+        StatsShmKind,
+        StatsShmSlot,
+    },
+    subsys::Config,
 };
 
 use super::{
+    handle::NvmeIoCtx,
+    io_ctx_slab::IoCtxSlab,
     nvme_bdev_running_config,
+    qpair::io_queue_requests,
     NvmeControllerState,
     PollGroup,
     QPair,
+    QPairState,
     SpdkNvmeController,
     NVME_CONTROLLERS,
 };
@@ -66,13 +82,38 @@ impl std::fmt::Debug for NvmeIoChannelInner<'_> {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         f.debug_struct("NvmeIoChannelInner")
             .field("qpair", &self.qpair)
+            .field("paths", &self.paths.len())
+            .field("connecting paths", &self.connecting_paths.len())
+            .field("missing paths", &self.missing_paths)
             .field("pending IO", &self.num_pending_ios)
             .finish()
     }
 }
 
+/// Delay between two attempts to recreate the failed additional qpairs of a
+/// channel.
+const PATH_RECONNECT_DELAY: Duration = Duration::from_secs(1);
+
 pub struct NvmeIoChannelInner<'a> {
     qpair: Option<QPair>,
+    /// Additional qpairs, i.e. connections, to the controller. I/O is spread
+    /// round-robin over the connected qpairs, the primary one included, and
+    /// the reads and writes of a failed qpair are resubmitted to the others,
+    /// without resetting the controller.
+    paths: Vec<QPair>,
+    /// Turn of the next qpair to submit to, the primary one being 0.
+    next_path: usize,
+    /// Additional qpairs connecting asynchronously: they join the rotation
+    /// once connected.
+    connecting_paths: Vec<QPair>,
+    /// Failed qpairs, freed once the poll group is done with them.
+    failed_paths: Vec<QPair>,
+    /// Number of additional qpairs to be (re)created.
+    missing_paths: usize,
+    /// Earliest time to try recreating the missing qpairs.
+    reconnect_at: Instant,
+    ctrlr_handle: SpdkNvmeController,
+    ctrlr_name: String,
     poll_group: PollGroup,
     poller: Poller<'a>,
     io_stats_controller: IoStatsController,
@@ -82,6 +123,8 @@ pub struct NvmeIoChannelInner<'a> {
         std::sync::Arc<parking_lot::Mutex<crate::bdev::NvmeController<'a>>>,
     >,
     num_pending_ios: u64,
+    /// Preallocated I/O contexts of the channel.
+    io_ctx_slab: IoCtxSlab<NvmeIoCtx>,
 
     // Flag to indicate the shutdown state of the channel.
     // We need such a flag to differentiate between channel reset and shutdown.
@@ -98,12 +141,215 @@ pub struct NvmeIoChannelInner<'a> {
 }
 
 impl NvmeIoChannelInner<'_> {
-    /// Returns SPDK pointer for the QPair. The QPair must exist.
+    /// Returns SPDK pointer for the QPair to submit the next I/O to, the
+    /// connected qpairs taking turns. The QPair must exist.
     #[inline(always)]
     pub(crate) unsafe fn qpair_ptr(&mut self) -> *mut spdk_nvme_qpair {
+        if !self.paths.is_empty() {
+            if let Some(qpair) = self.next_qpair_ptr() {
+                return qpair;
+            }
+        }
         self.qpair.as_mut().expect("QPair must exist").as_ptr()
     }
 
+    /// Returns the next connected qpair in turn, if any.
+    fn next_qpair_ptr(&mut self) -> Option<*mut spdk_nvme_qpair> {
+        let n = self.paths.len() + 1;
+        for _ in 0 .. n {
+            let i = self.next_path;
+            self.next_path = (i + 1) % n;
+
+            let qpair = if i == 0 {
+                self.qpair.as_ref()
+            } else {
+                self.paths.get(i - 1)
+            };
+            if let Some(q) =
+                qpair.filter(|q| q.state() == QPairState::Connected)
+            {
+                return Some(q.as_ptr());
+            }
+        }
+        None
+    }
+
+    /// Returns the qpair to resubmit an I/O of the given failed qpair to,
+    /// if another connected qpair is left.
+    pub(crate) fn failover_qpair_ptr(
+        &mut self,
+        failed: *mut spdk_nvme_qpair,
+    ) -> Option<*mut spdk_nvme_qpair> {
+        self.next_qpair_ptr().filter(|q| *q != failed)
+    }
+
+    /// Takes the given disconnected qpair out of the rotation, if another
+    /// qpair is connected. When the primary qpair fails, a connected
+    /// additional one takes its place.
+    fn fail_qpair(&mut self, qpair: *mut spdk_nvme_qpair) -> Option<QPair> {
+        let failed = if let Some(idx) =
+            self.paths.iter().position(|q| q.as_ptr() == qpair)
+        {
+            self.paths.remove(idx)
+        } else if self.qpair.as_ref().map(|q| q.as_ptr()) == Some(qpair) {
+            let idx = self
+                .paths
+                .iter()
+                .position(|q| q.state() == QPairState::Connected)?;
+            let primary = self.paths.remove(idx);
+            self.qpair.replace(primary)?
+        } else {
+            return None;
+        };
+
+        warn!(
+            ctrlr = self.ctrlr_name,
+            ?failed,
+            "I/O qpair disconnected, failing over to the other qpairs"
+        );
+
+        self.next_path = 0;
+        self.missing_paths += 1;
+        self.reconnect_at = Instant::now() + PATH_RECONNECT_DELAY;
+        Some(failed)
+    }
+
+    /// Allocates a qpair and adds it to the poll group of the channel.
+    fn alloc_qpair(&mut self) -> Result<QPair, i32> {
+        let qpair = QPair::create(self.ctrlr_handle, &self.ctrlr_name)
+            .map_err(|e| {
+                error!(ctrlr = self.ctrlr_name, ?e, "Failed to allocate qpair");
+                -libc::ENOMEM
+            })?;
+
+        let rc = self.poll_group.add_qpair(&qpair);
+        if rc != 0 {
+            error!(
+                ctrlr = self.ctrlr_name,
+                "failed to add qpair to poll group"
+            );
+            return Err(rc);
+        }
+        Ok(qpair)
+    }
+
+    /// Allocates the additional qpairs configured, which are connected
+    /// later.
+    fn alloc_paths(&mut self) {
+        let n = Config::get().nexus_opts.nvme_io_qpairs.saturating_sub(1);
+        for _ in 0 .. n {
+            match self.alloc_qpair() {
+                Ok(qpair) => self.paths.push(qpair),
+                Err(_) => self.missing_paths += 1,
+            }
+        }
+    }
+
+    /// Connects the additional qpairs which are not connected yet. With
+    /// asynchronous qpair connections, the connections are only started,
+    /// so that the reactor never waits for them: the qpairs are moved into
+    /// the rotation by the channel poller once connected. The ones failing
+    /// to connect are recreated later by the channel poller.
+    pub(crate) fn connect_paths(&mut self) {
+        for qpair in std::mem::take(&mut self.paths) {
+            if qpair.state() != QPairState::Disconnected {
+                self.paths.push(qpair);
+                continue;
+            }
+
+            #[cfg(feature = "spdk-async-qpair-connect")]
+            let rc = qpair.connect_deferred();
+
+            #[cfg(not(feature = "spdk-async-qpair-connect"))]
+            let rc = qpair.connect();
+
+            if rc == 0 {
+                if qpair.state() == QPairState::Connected {
+                    self.paths.push(qpair);
+                } else {
+                    self.connecting_paths.push(qpair);
+                }
+                continue;
+            }
+
+            error!(
+                ctrlr = self.ctrlr_name,
+                "failed to connect additional qpair"
+            );
+            self.poll_group.remove_qpair(&qpair);
+            self.missing_paths += 1;
+            self.reconnect_at = Instant::now() + PATH_RECONNECT_DELAY;
+        }
+    }
+
+    /// Frees the failed qpairs, moves the recreated ones which connected
+    /// into the rotation, and recreates the missing ones once the reconnect
+    /// delay has passed. Called by the channel poller, outside of completion
+    /// processing: the qpairs are connected asynchronously, so that the
+    /// poller never waits for a connection.
+    fn maintain_paths(&mut self) {
+        for qpair in std::mem::take(&mut self.failed_paths) {
+            self.poll_group.remove_qpair(&qpair);
+        }
+
+        for qpair in std::mem::take(&mut self.connecting_paths) {
+            match qpair.state() {
+                QPairState::Connected => {
+                    debug!(
+                        ctrlr = self.ctrlr_name,
+                        ?qpair,
+                        "I/O qpair recreated"
+                    );
+                    self.paths.push(qpair);
+                }
+                QPairState::Disconnected => {
+                    warn!(
+                        ctrlr = self.ctrlr_name,
+                        ?qpair,
+                        "failed to reconnect I/O qpair"
+                    );
+                    self.poll_group.remove_qpair(&qpair);
+                    self.missing_paths += 1;
+                    self.reconnect_at = Instant::now() + PATH_RECONNECT_DELAY;
+                }
+                _ => self.connecting_paths.push(qpair),
+            }
+        }
+
+        if self.missing_paths == 0
+            || self.qpair.is_none()
+            || self.is_shutdown
+            || Instant::now() < self.reconnect_at
+        {
+            return;
+        }
+
+        while self.missing_paths > 0 {
+            let Ok(qpair) = self.alloc_qpair() else {
+                break;
+            };
+
+            #[cfg(feature = "spdk-async-qpair-connect")]
+            let rc = qpair.connect_deferred();
+
+            #[cfg(not(feature = "spdk-async-qpair-connect"))]
+            let rc = qpair.connect();
+
+            if rc != 0 {
+                self.poll_group.remove_qpair(&qpair);
+                break;
+            }
+            self.connecting_paths.push(qpair);
+            self.missing_paths -= 1;
+        }
+        self.reconnect_at = Instant::now() + PATH_RECONNECT_DELAY;
+    }
+
+    /// Checks whether the given qpair is an additional one, still connecting.
+    fn is_connecting(&self, qpair: *mut spdk_nvme_qpair) -> bool {
+        self.connecting_paths.iter().any(|q| q.as_ptr() == qpair)
+    }
+
     #[inline(always)]
     pub(crate) fn qpair(&self) -> &Option<QPair> {
         &self.qpair
@@ -123,6 +369,18 @@ impl NvmeIoChannelInner<'_> {
 
     /// Reset channel, making it unusable till reinitialize() is called.
     pub fn reset(&mut self) -> i32 {
+        // Detach the additional qpairs before dropping them: dropping a
+        // qpair aborts its requests, whose completions must find no qpair to
+        // fail over to.
+        let paths = (
+            std::mem::take(&mut self.paths),
+            std::mem::take(&mut self.connecting_paths),
+            std::mem::take(&mut self.failed_paths),
+        );
+        self.missing_paths = 0;
+        self.next_path = 0;
+        drop(paths);
+
         // Remove qpair and trigger its deallocation via drop().
         match self.remove_qpair() {
             Some(qpair) => {
@@ -168,6 +426,12 @@ impl NvmeIoChannelInner<'_> {
         self.num_pending_ios += 1;
     }
 
+    /// Returns the slab of I/O contexts of the channel.
+    #[inline(always)]
+    pub(super) fn io_ctx_slab(&mut self) -> &mut IoCtxSlab<NvmeIoCtx> {
+        &mut self.io_ctx_slab
+    }
+
     /// Discard active I/O operation for channel.
     #[inline]
     pub fn discard_io(&mut self) {
@@ -227,6 +491,9 @@ impl NvmeIoChannelInner<'_> {
 
         trace!("{} I/O channel successfully reinitialized", ctrlr_name);
         self.qpair = Some(qpair);
+        self.ctrlr_handle = ctrlr_handle;
+        self.alloc_paths();
+        self.connect_paths();
         0
     }
 
@@ -243,14 +510,17 @@ pub struct IoStatsController {
     // I/O stats to the caller, inside get_io_stats().
     io_stats: BlockDeviceIoStats,
     block_size: u64,
+    /// Shared memory statistics record of the channel, if exported.
+    stats_shm: Option<StatsShmSlot>,
 }
 
 /// Top-level wrapper around device I/O statistics.
 impl IoStatsController {
-    fn new(block_size: u64) -> Self {
+    fn new(block_size: u64, name: &str) -> Self {
         Self {
             io_stats: BlockDeviceIoStats::default(),
             block_size,
+            stats_shm: StatsShmSlot::new(StatsShmKind::NvmeChild, name),
         }
     }
 
@@ -280,6 +550,13 @@ impl IoStatsController {
                 warn!("Unsupported I/O type for I/O statistics: {:?}", op);
             }
         }
+
+        // Write zeroes are not accounted as writes, as above.
+        if let Some(shm) = &self.stats_shm {
+            if matches!(op, IoType::Read | IoType::Write | IoType::Unmap) {
+                shm.account(op, num_ops, num_blocks * self.block_size, 0);
+            }
+        }
     }
 
     /// Get I/O statistics for channel.
@@ -299,11 +576,29 @@ impl IoStatsController {
 pub struct NvmeControllerIoChannel(NonNull<spdk_io_channel>);
 
 extern "C" fn disconnected_qpair_cb(
-    _qpair: *mut spdk_nvme_qpair,
+    qpair: *mut spdk_nvme_qpair,
     ctx: *mut c_void,
 ) {
     let inner = NvmeIoChannel::from_raw(ctx).inner_mut();
 
+    // An additional qpair failing to connect has no request, and is freed by
+    // the channel poller.
+    if inner.is_connecting(qpair) {
+        return;
+    }
+
+    // Take the failed qpair out of the rotation before aborting its
+    // requests, so that they are resubmitted to the remaining qpairs.
+    if let Some(failed) = inner.fail_qpair(qpair) {
+        unsafe {
+            spdk_nvme_qpair_set_abort_dnr(failed.as_ptr(), true);
+            nvme_qpair_abort_all_queued_reqs(failed.as_ptr());
+            nvme_transport_qpair_abort_reqs(failed.as_ptr());
+        }
+        inner.failed_paths.push(failed);
+        return;
+    }
+
     if let Some(qpair) = inner.qpair() {
         unsafe {
             spdk_nvme_qpair_set_abort_dnr(qpair.as_ptr(), true);
@@ -328,6 +623,13 @@ extern "C" fn nvme_poll(ctx: *mut c_void) -> i32 {
         )
     };
 
+    if !inner.failed_paths.is_empty()
+        || !inner.connecting_paths.is_empty()
+        || inner.missing_paths > 0
+    {
+        inner.maintain_paths();
+    }
+
     if num_completions > 0 {
         1
     } else {
@@ -425,16 +727,32 @@ impl NvmeControllerIoChannel {
             .with_poll_fn(move |_| nvme_poll(ctx))
             .build();
 
-        let inner = Box::new(NvmeIoChannelInner {
+        // As many I/O contexts as the qpairs of the channel have requests.
+        let num_qpairs = Config::get().nexus_opts.nvme_io_qpairs.max(1);
+        let io_ctx_slab = IoCtxSlab::new(
+            io_queue_requests(controller) as usize * num_qpairs as usize,
+        );
+
+        let mut inner = Box::new(NvmeIoChannelInner {
             qpair: Some(qpair),
+            paths: Vec::new(),
+            next_path: 0,
+            connecting_paths: Vec::new(),
+            failed_paths: Vec::new(),
+            missing_paths: 0,
+            reconnect_at: Instant::now(),
+            ctrlr_handle: controller,
+            ctrlr_name: cname.clone(),
             poll_group,
             poller,
-            io_stats_controller: IoStatsController::new(block_size),
+            io_stats_controller: IoStatsController::new(block_size, &cname),
             is_shutdown: false,
             device,
             ctrl: Some(carc),
             num_pending_ios: 0,
+            io_ctx_slab,
         });
+        inner.alloc_paths();
 
         nvme_channel.inner = Box::into_raw(inner);
         trace!(?cname, ?ctx, "I/O channel successfully initialized");
@@ -455,6 +773,14 @@ impl NvmeControllerIoChannel {
 
             let qpair = inner.remove_qpair();
 
+            debug!(
+                ctrlr = inner.ctrlr_name,
+                capacity = inner.io_ctx_slab.capacity(),
+                max_used = inner.io_ctx_slab.max_used(),
+                overflows = inner.io_ctx_slab.overflows(),
+                "I/O context slab usage"
+            );
+
             // Stop the poller and do extra handling for I/O qpair, as it needs
             // to be detached from the poller prior poller
             // destruction.
@@ -463,6 +789,14 @@ impl NvmeControllerIoChannel {
             if let Some(qpair) = qpair {
                 inner.poll_group.remove_qpair(&qpair);
             }
+            for qpair in inner
+                .paths
+                .drain(..)
+                .chain(inner.connecting_paths.drain(..))
+                .chain(inner.failed_paths.drain(..))
+            {
+                inner.poll_group.remove_qpair(&qpair);
+            }
         }
 
         trace!(
@@ -1214,9 +1214,10 @@ pub(crate) mod transport {
         }
     }
 
-    #[derive(Debug)]
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
     #[allow(clippy::upper_case_acronyms)]
-    enum TransportId {
+    pub(crate) enum TransportId {
+        RDMA = 0x1,
         TCP = 0x3,
     }
 
@@ -1230,6 +1231,7 @@ pub(crate) mod transport {
         fn from(t: TransportId) -> Self {
             match t {
                 TransportId::TCP => String::from("tcp"),
+                TransportId::RDMA => String::from("rdma"),
             }
         }
     }
@@ -1267,6 +1269,12 @@ pub(crate) mod transport {
             }
         }
 
+        /// transport to connect with
+        pub fn with_transport(mut self, trid: TransportId) -> Self {
+            self.trid = trid;
+            self
+        }
+
         /// the address to connect to
         pub fn with_traddr(mut self, traddr: &str) -> Self {
             self.traddr = traddr.to_string();
@@ -1285,16 +1293,17 @@ pub(crate) mod transport {
             self
         }
 
-        /// builder for transportID currently defaults to TCP IPv4
+        /// builder for transportID, defaults to TCP IPv4
         pub fn build(self) -> NvmeTransportId {
-            let trtype = String::from(TransportId::TCP);
+            let trtype = self.trid as u32;
+            let trstring = String::from(self.trid);
             let mut trid = spdk_nvme_transport_id {
                 adrfam: AdressFamily::NvmfAdrfamIpv4 as u32,
-                trtype: TransportId::TCP as u32,
+                trtype,
                 ..Default::default()
             };
 
-            copy_str_with_null(&trtype, &mut trid.trstring);
+            copy_str_with_null(&trstring, &mut trid.trstring);
             copy_str_with_null(&self.traddr, &mut trid.traddr);
             copy_str_with_null(&self.svcid, &mut trid.trsvcid);
             copy_str_with_null(&self.subnqn, &mut trid.subnqn);
@@ -1319,5 +1328,18 @@ pub(crate) mod transport {
             assert_eq!(transport.subnqn(), "nqn.2021-01-01:test.nqn");
             assert_eq!(transport.svcid(), "4420");
         }
+
+        #[test]
+        fn test_rdma_transport_id() {
+            let transport = transport::Builder::new()
+                .with_transport(transport::TransportId::RDMA)
+                .with_subnqn("nqn.2021-01-01:test.nqn")
+                .with_svcid("4420")
+                .with_traddr("127.0.0.1")
+                .build();
+
+            assert_eq!(transport.trtype(), "rdma");
+            assert_eq!(transport.traddr(), "127.0.0.1");
+        }
     }
 }
@@ -16,6 +16,7 @@ use spdk_rs::{
         spdk_nvme_ctrlr_cmd_admin_raw,
         spdk_nvme_ctrlr_cmd_io_raw,
         spdk_nvme_dsm_range,
+        spdk_nvme_ns,
         spdk_nvme_ns_cmd_compare,
         spdk_nvme_ns_cmd_comparev,
         spdk_nvme_ns_cmd_dataset_management,
@@ -25,6 +26,7 @@ use spdk_rs::{
         spdk_nvme_ns_cmd_write,
         spdk_nvme_ns_cmd_write_zeroes,
         spdk_nvme_ns_cmd_writev,
+        spdk_nvme_qpair,
         SPDK_NVME_IO_FLAGS_UNWRITTEN_READ_FAIL,
         SPDK_NVME_SC_INTERNAL_DEVICE_ERROR,
     },
@@ -43,13 +45,21 @@ use crate::{
         channel::NvmeControllerIoChannel,
         controller_inner::SpdkNvmeController,
         utils,
-        utils::{nvme_cpl_is_pi_error, nvme_cpl_succeeded},
+        utils::{
+            nvme_cpl_is_path_error,
+            nvme_cpl_is_pi_error,
+            nvme_cpl_succeeded,
+        },
         NvmeBlockDevice,
         NvmeIoChannel,
         NvmeNamespace,
+        NvmeSnapshotChainMessage,
         NvmeSnapshotMessage,
         NvmeSnapshotMessageV1,
+        NVME_ADMIN_SNAPSHOT_CHAIN,
+        NVME_ADMIN_SNAPSHOT_DELTA,
         NVME_CONTROLLERS,
+        NVME_SNAPSHOT_PAGE_SIZE,
     },
     core::{
         mempool::MemoryPool,
@@ -83,7 +93,7 @@ use super::NvmeIoChannelInner;
  * storing user context and also private state of I/O operations, specific to
  * the controller.
  */
-struct NvmeIoCtx {
+pub(super) struct NvmeIoCtx {
     cb: IoCompletionCallback,
     cb_arg: IoCompletionCallbackArg,
     iov: *mut iovec,
@@ -93,10 +103,23 @@ struct NvmeIoCtx {
     op: IoType,
     num_blocks: u64,
     channel: *mut spdk_io_channel,
+    /// Set for reads and writes, which can be resubmitted once to another
+    /// qpair of the channel when theirs fails.
+    retry: Option<NvmeIoRetry>,
     #[cfg(feature = "fault-injection")]
     inj_op: InjectIoCtx,
 }
 
+/// What it takes to resubmit a read or write.
+#[derive(Clone, Copy)]
+struct NvmeIoRetry {
+    ns: *mut spdk_nvme_ns,
+    /// The qpair the I/O was submitted to.
+    qpair: *mut spdk_nvme_qpair,
+    offset_blocks: u64,
+    flags: u32,
+}
+
 unsafe impl Send for NvmeIoCtx {}
 unsafe impl Sync for NvmeIoCtx {}
 
@@ -205,6 +228,7 @@ impl NvmeDeviceHandle {
             }
             None => warn!("No I/O qpair in NvmeDeviceHandle, can't connect()"),
         };
+        inner.connect_paths();
     }
 
     #[cfg(feature = "spdk-async-qpair-connect")]
@@ -213,7 +237,11 @@ impl NvmeDeviceHandle {
         let inner = NvmeIoChannel::inner_from_channel(self.io_channel.as_ptr());
 
         match inner.qpair_mut() {
-            Some(q) => q.connect_async().await,
+            Some(q) => {
+                q.connect_async().await?;
+                inner.connect_paths();
+                Ok(())
+            }
             None => {
                 error!("No I/O qpair in NvmeDeviceHandle, can't connect()");
                 Err(CoreError::InvalidNvmeDeviceHandle {
@@ -329,11 +357,89 @@ extern "C" fn nvme_queued_next_sge(
     0
 }
 
+/// Resubmits a read or write, whose qpair has failed, to another connected
+/// qpair of its channel. Returns false when the I/O cannot be resubmitted.
+fn resubmit_nvme_command(ctx: *mut NvmeIoCtx) -> bool {
+    let io_ctx = unsafe { &mut *ctx };
+    let Some(retry) = io_ctx.retry.take() else {
+        return false;
+    };
+
+    let inner = NvmeIoChannel::inner_from_channel(io_ctx.channel);
+    let Some(qpair) = inner.failover_qpair_ptr(retry.qpair) else {
+        return false;
+    };
+
+    let num_blocks = io_ctx.num_blocks as u32;
+    let rc = unsafe {
+        match (io_ctx.op, io_ctx.iovcnt) {
+            (IoType::Read, 1) => spdk_nvme_ns_cmd_read(
+                retry.ns,
+                qpair,
+                (*io_ctx.iov).iov_base,
+                retry.offset_blocks,
+                num_blocks,
+                Some(nvme_io_done),
+                ctx as *mut c_void,
+                retry.flags,
+            ),
+            (IoType::Read, _) => spdk_nvme_ns_cmd_readv(
+                retry.ns,
+                qpair,
+                retry.offset_blocks,
+                num_blocks,
+                Some(nvme_io_done),
+                ctx as *mut c_void,
+                retry.flags,
+                Some(nvme_queued_reset_sgl),
+                Some(nvme_queued_next_sge),
+            ),
+            (IoType::Write, 1) => spdk_nvme_ns_cmd_write(
+                retry.ns,
+                qpair,
+                (*io_ctx.iov).iov_base,
+                retry.offset_blocks,
+                num_blocks,
+                Some(nvme_io_done),
+                ctx as *mut c_void,
+                retry.flags,
+            ),
+            (IoType::Write, _) => spdk_nvme_ns_cmd_writev(
+                retry.ns,
+                qpair,
+                retry.offset_blocks,
+                num_blocks,
+                Some(nvme_writev_done),
+                ctx as *mut c_void,
+                retry.flags,
+                Some(nvme_queued_reset_sgl),
+                Some(nvme_queued_next_sge),
+            ),
+            _ => return false,
+        }
+    };
+
+    if rc != 0 {
+        error!(?qpair, rc, "failed to resubmit I/O to another qpair");
+        return false;
+    }
+    true
+}
+
 /// Notify the caller and deallocate Nvme IO context.
 #[inline]
 fn complete_nvme_command(ctx: *mut NvmeIoCtx, cpl: *const spdk_nvme_cpl) {
     let io_ctx = unsafe { &mut *ctx };
     let op_succeeded = nvme_cpl_succeeded(cpl);
+
+    // The qpair of the I/O has failed: try the other ones of the channel.
+    if !op_succeeded
+        && nvme_cpl_is_path_error(cpl)
+        && resubmit_nvme_command(ctx)
+    {
+        return;
+    }
+
     let inner = NvmeIoChannel::inner_from_channel(io_ctx.channel);
 
     // Update I/O statistics in case the operation succeeded.
@@ -499,23 +605,36 @@ pub fn nvme_io_ctx_pool_init(size: u64) {
     });
 }
 
-/// Allocate an NVMe controller I/O context from the pool.
+/// Allocate an NVMe controller I/O context from the slab of the channel, or
+/// from the shared pool once the slab is exhausted.
 fn alloc_nvme_io_ctx(
+    inner: &mut NvmeIoChannelInner,
     op: IoType,
     ctx: NvmeIoCtx,
     offset_blocks: u64,
     num_blocks: u64,
 ) -> Result<*mut NvmeIoCtx, CoreError> {
-    let pool = NVME_IOCTX_POOL.get().unwrap();
-    pool.get(ctx).ok_or_else(|| {
-        io_type_to_err(op, libc::ENOMEM, offset_blocks, num_blocks)
-    })
+    match inner.io_ctx_slab().get(ctx) {
+        Ok(ptr) => Ok(ptr),
+        Err(ctx) => {
+            let pool = NVME_IOCTX_POOL.get().unwrap();
+            pool.get(ctx).ok_or_else(|| {
+                io_type_to_err(op, libc::ENOMEM, offset_blocks, num_blocks)
+            })
+        }
+    }
 }
 
-/// Release the memory used by the NVMe controller I/O context back to the pool.
+/// Release the memory used by the NVMe controller I/O context back to the
+/// slab of its channel, or to the shared pool.
 fn free_nvme_io_ctx(ctx: *mut NvmeIoCtx) {
-    let pool = NVME_IOCTX_POOL.get().unwrap();
-    pool.put(ctx);
+    let inner = NvmeIoChannel::inner_from_channel(unsafe { (*ctx).channel });
+    let slab = inner.io_ctx_slab();
+    if slab.contains(ctx) {
+        slab.put(ctx);
+    } else {
+        NVME_IOCTX_POOL.get().unwrap().put(ctx);
+    }
 }
 
 /// Check whether channel is suitable for serving I/O.
@@ -752,8 +871,10 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
 
         // Make sure channel allows I/O.
         check_channel_for_io(IoType::Read, inner, offset_blocks, num_blocks)?;
+        let qpair = unsafe { inner.qpair_ptr() };
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::Read,
             NvmeIoCtx {
                 cb,
@@ -765,6 +886,12 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::Read,
                 num_blocks,
+                retry: Some(NvmeIoRetry {
+                    ns: self.ns.as_ptr(),
+                    qpair,
+                    offset_blocks,
+                    flags,
+                }),
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::with_iovs(
                     FaultDomain::BlockDevice,
@@ -780,13 +907,16 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         )?;
 
         #[cfg(feature = "fault-injection")]
-        inject_submission_error(unsafe { &(*bio).inj_op })?;
+        inject_submission_error(unsafe { &(*bio).inj_op }).map_err(|e| {
+            free_nvme_io_ctx(bio);
+            e
+        })?;
 
         let rc = if iovs.len() == 1 {
             unsafe {
                 spdk_nvme_ns_cmd_read(
                     self.ns.as_ptr(),
-                    inner.qpair_ptr(),
+                    qpair,
                     iovs[0].as_mut_ptr(),
                     offset_blocks,
                     num_blocks as u32,
@@ -799,7 +929,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
             unsafe {
                 spdk_nvme_ns_cmd_readv(
                     self.ns.as_ptr(),
-                    inner.qpair_ptr(),
+                    qpair,
                     offset_blocks,
                     num_blocks as u32,
                     Some(nvme_io_done),
@@ -812,6 +942,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::ReadDispatch {
                 source: Errno::from_i32(-rc),
                 offset: offset_blocks,
@@ -838,8 +969,10 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
 
         // Make sure channel allows I/O.
         check_channel_for_io(IoType::Write, inner, offset_blocks, num_blocks)?;
+        let qpair = unsafe { inner.qpair_ptr() };
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::Write,
             NvmeIoCtx {
                 cb,
@@ -851,6 +984,12 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::Write,
                 num_blocks,
+                retry: Some(NvmeIoRetry {
+                    ns: self.ns.as_ptr(),
+                    qpair,
+                    offset_blocks,
+                    flags: self.prchk_flags,
+                }),
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::with_iovs(
                     FaultDomain::BlockDevice,
@@ -866,13 +1005,16 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         )?;
 
         #[cfg(feature = "fault-injection")]
-        inject_submission_error(unsafe { &(*bio).inj_op })?;
+        inject_submission_error(unsafe { &(*bio).inj_op }).map_err(|e| {
+            free_nvme_io_ctx(bio);
+            e
+        })?;
 
         let rc = if iovs.len() == 1 {
             unsafe {
                 spdk_nvme_ns_cmd_write(
                     self.ns.as_ptr(),
-                    inner.qpair_ptr(),
+                    qpair,
                     iovs[0].as_ptr() as *mut _,
                     offset_blocks,
                     num_blocks as u32,
@@ -885,7 +1027,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
             unsafe {
                 spdk_nvme_ns_cmd_writev(
                     self.ns.as_ptr(),
-                    inner.qpair_ptr(),
+                    qpair,
                     offset_blocks,
                     num_blocks as u32,
                     Some(nvme_writev_done),
@@ -898,6 +1040,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::WriteDispatch {
                 source: Errno::from_i32(-rc),
                 offset: offset_blocks,
@@ -931,6 +1074,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         )?;
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::Compare,
             NvmeIoCtx {
                 cb,
@@ -942,6 +1086,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::Compare,
                 num_blocks,
+                retry: None,
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::new(FaultDomain::BlockDevice),
             },
@@ -979,6 +1124,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::CompareDispatch {
                 source: Errno::from_i32(-rc),
                 offset: offset_blocks,
@@ -1029,6 +1175,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         check_channel_for_io(IoType::Flush, inner, 0, num_blocks)?;
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::Flush,
             NvmeIoCtx {
                 cb,
@@ -1040,6 +1187,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::Flush,
                 num_blocks,
+                retry: None,
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::new(FaultDomain::BlockDevice),
             },
@@ -1058,6 +1206,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::FlushDispatch {
                 source: Errno::from_i32(-rc),
             })
@@ -1092,6 +1241,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         check_channel_for_io(IoType::Unmap, inner, offset_blocks, num_blocks)?;
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::Unmap,
             NvmeIoCtx {
                 cb,
@@ -1103,6 +1253,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::Unmap,
                 num_blocks,
+                retry: None,
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::new(FaultDomain::BlockDevice),
             },
@@ -1161,6 +1312,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::UnmapDispatch {
                 source: Errno::from_i32(-rc),
                 offset: offset_blocks,
@@ -1191,6 +1343,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         )?;
 
         let bio = alloc_nvme_io_ctx(
+            inner,
             IoType::WriteZeros,
             NvmeIoCtx {
                 cb,
@@ -1202,6 +1355,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
                 channel,
                 op: IoType::WriteZeros,
                 num_blocks,
+                retry: None,
                 #[cfg(feature = "fault-injection")]
                 inj_op: InjectIoCtx::new(FaultDomain::BlockDevice),
             },
@@ -1222,6 +1376,7 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         };
 
         if rc < 0 {
+            free_nvme_io_ctx(bio);
             Err(CoreError::WriteZeroesDispatch {
                 source: Errno::from_i32(-rc),
                 offset: offset_blocks,
@@ -1260,6 +1415,72 @@ impl BlockDeviceHandle for NvmeDeviceHandle {
         Ok(now)
     }
 
+    async fn snapshot_txn_ids(&self) -> Result<Vec<String>, CoreError> {
+        let mut buf =
+            self.dma_malloc(NVME_SNAPSHOT_PAGE_SIZE).map_err(|_| {
+                CoreError::DmaAllocationFailed {
+                    size: NVME_SNAPSHOT_PAGE_SIZE,
+                }
+            })?;
+
+        let mut cmd = spdk_nvme_cmd::default();
+        cmd.set_opc(NVME_ADMIN_SNAPSHOT_CHAIN.into());
+        self.nvme_admin(&cmd, Some(&mut buf)).await?;
+
+        match bincode::deserialize::<NvmeSnapshotChainMessage>(buf.as_slice()) {
+            Ok(NvmeSnapshotChainMessage::V1(v1)) => Ok(v1.txn_ids().clone()),
+            Err(e) => {
+                error!("Failed to deserialize snapshot chain message: {}", e);
+                Err(CoreError::NvmeAdminFailed {
+                    opcode: cmd.opc(),
+                    source: Errno::EINVAL,
+                })
+            }
+        }
+    }
+
+    async fn snapshot_delta(
+        &self,
+        snapshot_idx: u32,
+        granularity: u32,
+    ) -> Result<Vec<u8>, CoreError> {
+        if granularity == 0 {
+            return Err(CoreError::NvmeAdminDispatch {
+                source: Errno::EINVAL,
+                opcode: NVME_ADMIN_SNAPSHOT_DELTA.into(),
+            });
+        }
+
+        let num_blocks = self.get_device().num_blocks();
+        let units = (num_blocks + granularity as u64 - 1) / granularity as u64;
+        let len = (units + 7) / 8;
+
+        let mut buf =
+            self.dma_malloc(NVME_SNAPSHOT_PAGE_SIZE).map_err(|_| {
+                CoreError::DmaAllocationFailed {
+                    size: NVME_SNAPSHOT_PAGE_SIZE,
+                }
+            })?;
+
+        // The replica returns the map one page at a time.
+        let mut bitmap = Vec::with_capacity(len as usize);
+        for page in
+            0 .. (len + NVME_SNAPSHOT_PAGE_SIZE - 1) / NVME_SNAPSHOT_PAGE_SIZE
+        {
+            let mut cmd = spdk_nvme_cmd::default();
+            cmd.set_opc(NVME_ADMIN_SNAPSHOT_DELTA.into());
+            cmd.__bindgen_anon_1.cdw10 = snapshot_idx;
+            cmd.__bindgen_anon_2.cdw11 = granularity;
+            cmd.__bindgen_anon_3.cdw12 = page as u32;
+            self.nvme_admin(&cmd, Some(&mut buf)).await?;
+
+            let n = (len - bitmap.len() as u64).min(NVME_SNAPSHOT_PAGE_SIZE);
+            bitmap.extend_from_slice(&buf.as_slice()[.. n as usize]);
+        }
+
+        Ok(bitmap)
+    }
+
     async fn nvme_admin_custom(&self, opcode: u8) -> Result<(), CoreError> {
         let mut cmd = spdk_nvme_cmd::default();
         cmd.set_opc(opcode.into());
@@ -0,0 +1,111 @@
+//!
+//! Per-channel slab of I/O contexts.
+//!
+//! Every I/O submitted through an NVMe I/O channel needs a context, which
+//! used to come from a mempool shared by all the channels of all cores. Under
+//! heavy fan-out the shared pool is contended and may run dry, failing the
+//! I/O with ENOMEM. Each channel now preallocates as many contexts as its
+//! qpairs have requests: as a qpair cannot have more I/Os outstanding, the
+//! slab of a channel only runs out when its qpairs are full too, and the
+//! shared pool remains as an overflow for the contexts of I/Os queued above.
+use std::{mem::MaybeUninit, ptr::NonNull};
+
+/// Slab of preallocated I/O contexts of one I/O channel. Contexts are
+/// allocated and freed on the core of the channel only.
+pub(super) struct IoCtxSlab<T> {
+    slots: NonNull<[MaybeUninit<T>]>,
+    /// Indexes of the free slots.
+    free: Vec<u32>,
+    /// Maximum number of contexts in use at once.
+    max_used: usize,
+    /// Number of allocations not served by the slab as it was empty.
+    overflows: u64,
+}
+
+impl<T> Drop for IoCtxSlab<T> {
+    fn drop(&mut self) {
+        let used = self.in_use();
+        if used > 0 {
+            // Lost I/Os may still complete: keep their contexts valid.
+            warn!(
+                "I/O context slab dropped with {used} contexts in use, \
+                leaking it"
+            );
+            return;
+        }
+        drop(unsafe { Box::from_raw(self.slots.as_ptr()) });
+    }
+}
+
+impl<T> IoCtxSlab<T> {
+    /// Creates a slab with the given number of contexts.
+    pub(super) fn new(capacity: usize) -> Self {
+        let slots: Box<[MaybeUninit<T>]> =
+            (0 .. capacity).map(|_| MaybeUninit::uninit()).collect();
+
+        Self {
+            slots: NonNull::from(Box::leak(slots)),
+            free: (0 .. capacity as u32).rev().collect(),
+            max_used: 0,
+            overflows: 0,
+        }
+    }
+
+    /// Number of contexts of the slab.
+    #[inline(always)]
+    pub(super) fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Number of contexts in use.
+    #[inline(always)]
+    pub(super) fn in_use(&self) -> usize {
+        self.capacity() - self.free.len()
+    }
+
+    /// Maximum number of contexts in use at once.
+    pub(super) fn max_used(&self) -> usize {
+        self.max_used
+    }
+
+    /// Number of allocations not served by the slab as it was empty.
+    pub(super) fn overflows(&self) -> u64 {
+        self.overflows
+    }
+
+    /// Gets a free context from the slab, initialized with the given value.
+    /// Returns the value back if the slab is empty.
+    #[inline(always)]
+    pub(super) fn get(&mut self, val: T) -> Result<*mut T, T> {
+        let Some(idx) = self.free.pop() else {
+            self.overflows += 1;
+            return Err(val);
+        };
+        self.max_used = self.max_used.max(self.in_use());
+
+        let ptr = unsafe {
+            (self.slots.as_ptr() as *mut MaybeUninit<T>).add(idx as usize)
+                as *mut T
+        };
+        unsafe { ptr.write(val) };
+        Ok(ptr)
+    }
+
+    /// Determines if the given context belongs to the slab.
+    #[inline(always)]
+    pub(super) fn contains(&self, ptr: *const T) -> bool {
+        let start = self.slots.as_ptr() as *const MaybeUninit<T> as usize;
+        let end = start + self.capacity() * std::mem::size_of::<T>();
+        (start .. end).contains(&(ptr as usize))
+    }
+
+    /// Gives back a context obtained from `get`. As with the shared pool, the
+    /// value is not dropped.
+    #[inline(always)]
+    pub(super) fn put(&mut self, ptr: *mut T) {
+        debug_assert!(self.contains(ptr));
+        let start = self.slots.as_ptr() as *const MaybeUninit<T> as usize;
+        let idx = (ptr as usize - start) / std::mem::size_of::<T>();
+        self.free.push(idx as u32);
+    }
+}
@@ -12,7 +12,15 @@ pub use handle::{nvme_io_ctx_pool_init, NvmeDeviceHandle};
 pub use namespace::NvmeNamespace;
 use poll_group::PollGroup;
 pub use qpair::{QPair, QPairState};
-pub use snapshot::{NvmeSnapshotMessage, NvmeSnapshotMessageV1};
+pub use snapshot::{
+    NvmeSnapshotChainMessage,
+    NvmeSnapshotChainMessageV1,
+    NvmeSnapshotMessage,
+    NvmeSnapshotMessageV1,
+    NVME_ADMIN_SNAPSHOT_CHAIN,
+    NVME_ADMIN_SNAPSHOT_DELTA,
+    NVME_SNAPSHOT_PAGE_SIZE,
+};
 pub(crate) use uri::NvmfDeviceTemplate;
 
 use crate::{
@@ -26,6 +34,7 @@ mod controller_inner;
 mod controller_state;
 mod device;
 mod handle;
+mod io_ctx_slab;
 mod namespace;
 mod poll_group;
 mod qpair;
@@ -40,6 +40,9 @@ use spdk_rs::{
 #[cfg(feature = "spdk-async-qpair-connect")]
 use nix::errno::Errno;
 
+#[cfg(feature = "spdk-async-qpair-connect")]
+use crate::core::Reactors;
+
 use crate::core::CoreError;
 
 use super::{nvme_bdev_running_config, SpdkNvmeController};
@@ -132,6 +135,11 @@ fn get_default_options(
     opts
 }
 
+/// Returns the number of requests of the qpairs of the given controller.
+pub(super) fn io_queue_requests(ctrlr_handle: SpdkNvmeController) -> u32 {
+    get_default_options(ctrlr_handle).io_queue_requests
+}
+
 impl QPair {
     /// Returns an SPDK qpair object pointer.
     #[inline(always)]
@@ -262,6 +270,31 @@ impl QPair {
         })?
     }
 
+    /// Starts connecting a qpair asynchronously, without waiting for the
+    /// connection to complete: the qpair is `Connecting` until then, and
+    /// `Connected` or `Disconnected` afterwards. Unlike `connect()`, can be
+    /// called from a poller.
+    pub(crate) fn connect_deferred(&self) -> i32 {
+        if self.state() != QPairState::Disconnected {
+            return 0;
+        }
+
+        match self.start_new_async() {
+            Ok(recv) => {
+                // The connection must have a listener to complete.
+                Reactors::current().send_future(async move {
+                    recv.await.ok();
+                });
+                0
+            }
+            Err(e) => {
+                self.set_state(QPairState::Disconnected);
+                error!(?self, ?e, "failed to start I/O qpair connection");
+                -libc::ENXIO
+            }
+        }
+    }
+
     /// Starts a new async connection and returns a receiver for it.
     fn start_new_async(&self) -> Result<ResultReceiver, CoreError> {
         trace!(?self, "new async I/O pair connection");
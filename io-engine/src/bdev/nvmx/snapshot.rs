@@ -25,3 +25,41 @@ impl NvmeSnapshotMessageV1 {
 pub enum NvmeSnapshotMessage {
     V1(NvmeSnapshotMessageV1),
 }
+
+/// Custom NVMe admin command returning the snapshot chain of a replica, as an
+/// encoded `NvmeSnapshotChainMessage` (controller to host).
+pub const NVME_ADMIN_SNAPSHOT_CHAIN: u8 = 0xc2;
+
+/// Custom NVMe admin command returning a page of the map of the blocks
+/// written to a replica since one of its snapshots (controller to host).
+/// CDW10 holds the index of the snapshot in the chain, CDW11 the number of
+/// blocks per bit of the map, and CDW12 the index of the page.
+pub const NVME_ADMIN_SNAPSHOT_DELTA: u8 = 0xc6;
+
+/// Size of the data of the snapshot chain and delta admin commands.
+pub const NVME_SNAPSHOT_PAGE_SIZE: u64 = 4096;
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct NvmeSnapshotChainMessageV1 {
+    txn_ids: Vec<String>,
+}
+
+impl NvmeSnapshotChainMessageV1 {
+    /// Create a V1 snapshot chain message, from the transaction ids of the
+    /// snapshots of a replica, newest first.
+    pub fn new(txn_ids: Vec<String>) -> Self {
+        Self {
+            txn_ids,
+        }
+    }
+
+    /// Get the transaction ids of the snapshots, newest first.
+    pub fn txn_ids(&self) -> &Vec<String> {
+        &self.txn_ids
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub enum NvmeSnapshotChainMessage {
+    V1(NvmeSnapshotChainMessageV1),
+}
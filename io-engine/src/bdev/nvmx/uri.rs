@@ -53,7 +53,7 @@ use crate::{
     subsys::Config,
 };
 
-use super::controller::transport::NvmeTransportId;
+use super::controller::transport::{NvmeTransportId, TransportId};
 
 const DEFAULT_NVMF_PORT: u16 = 8420;
 // Callback to be called once NVMe controller attach sequence completes.
@@ -113,12 +113,24 @@ pub struct NvmfDeviceTemplate {
     uuid: Option<uuid::Uuid>,
     /// The HostNqn to connect to the nvmf target with.
     hostnqn: Option<String>,
+    /// Transport to connect to the nvmf target with.
+    transport: TransportId,
 }
 
 impl TryFrom<&Url> for NvmfDeviceTemplate {
     type Error = BdevError;
 
     fn try_from(url: &Url) -> Result<Self, Self::Error> {
+        let transport = match url.scheme() {
+            "nvmf" | "nvmf+tcp" => TransportId::TCP,
+            "nvmf+rdma" => TransportId::RDMA,
+            scheme => {
+                return Err(BdevError::UriSchemeUnsupported {
+                    scheme: scheme.to_string(),
+                })
+            }
+        };
+
         let host = url.host_str().ok_or_else(|| BdevError::InvalidUri {
             uri: url.to_string(),
             message: String::from("missing host"),
@@ -188,6 +200,7 @@ impl TryFrom<&Url> for NvmfDeviceTemplate {
             prchk_flags,
             uuid,
             hostnqn,
+            transport,
         })
     }
 }
@@ -212,6 +225,7 @@ pub(crate) struct NvmeControllerContext<'probe> {
 impl<'probe> NvmeControllerContext<'probe> {
     pub fn new(template: &NvmfDeviceTemplate) -> NvmeControllerContext {
         let trid = controller::transport::Builder::new()
+            .with_transport(template.transport)
             .with_subnqn(&template.subnqn)
             .with_svcid(&template.port.to_string())
             .with_traddr(&template.host)
@@ -4,6 +4,7 @@ use spdk_rs::libspdk::spdk_nvme_cpl;
 enum NvmeStatusCodeType {
     Generic = 0x0,
     MediaError = 0x2,
+    PathRelated = 0x3,
 }
 
 #[derive(Debug, PartialEq)]
@@ -16,6 +17,7 @@ pub enum NvmeMediaErrorStatusCode {
 #[derive(Debug, PartialEq)]
 enum NvmeGenericCommandStatusCode {
     Success = 0x0,
+    AbortedSqDeletion = 0x8,
 }
 
 #[derive(Debug, PartialEq)]
@@ -80,6 +82,24 @@ pub(crate) fn nvme_cpl_succeeded(cpl: *const spdk_nvme_cpl) -> bool {
         && sc == NvmeGenericCommandStatusCode::Success as u16
 }
 
+#[inline]
+/// Check if NVMe command failed because of its qpair (path) rather than the
+/// device: it was aborted as the qpair went away, or it got a path error.
+pub(crate) fn nvme_cpl_is_path_error(cpl: *const spdk_nvme_cpl) -> bool {
+    let sct;
+    let sc;
+
+    unsafe {
+        let cplr = &(*cpl);
+        sct = cplr.__bindgen_anon_1.status.sct();
+        sc = cplr.__bindgen_anon_1.status.sc();
+    }
+
+    sct == NvmeStatusCodeType::PathRelated as u16
+        || (sct == NvmeStatusCodeType::Generic as u16
+            && sc == NvmeGenericCommandStatusCode::AbortedSqDeletion as u16)
+}
+
 /* Bit set of attributes for DATASET MANAGEMENT commands. */
 #[allow(dead_code)]
 pub enum NvmeDsmAttribute {
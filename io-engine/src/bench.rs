@@ -0,0 +1,48 @@
+//!
+//! Entry points into crate internals for the io-engine-bench benchmarks, only
+//! built with the `bench-internals` feature. The internals themselves stay
+//! private to the crate.
+use spdk_rs::IoType;
+
+use crate::{
+    bdev::nexus::{IOLog, IOLogChannel},
+    core::segment_map::SegmentMap,
+};
+
+/// I/O log of a device, logging the writes of the current core.
+pub struct IoLogWriter {
+    _log: IOLog,
+    channel: IOLogChannel,
+}
+
+impl IoLogWriter {
+    /// Creates an I/O log for a device with the given geometry. Must be called
+    /// on a reactor, as the I/O log has a channel per core.
+    pub fn new(device_name: &str, num_blocks: u64, block_len: u64) -> Self {
+        let log = IOLog::new(device_name, num_blocks, block_len);
+        let channel = log.current_channel();
+        Self {
+            _log: log,
+            channel,
+        }
+    }
+
+    /// Logs a write of the given blocks, as the nexus does for each write
+    /// while a child is out of sync. Must be called on the core which created
+    /// the log.
+    #[inline(always)]
+    pub fn log_write(&self, lbn: u64, lbn_cnt: u64) {
+        self.channel.log_io(IoType::Write, lbn, lbn_cnt);
+    }
+}
+
+/// Merges two segment maps, as done with the per-core maps of an I/O log.
+pub fn segment_map_merge(map: SegmentMap, other: &SegmentMap) -> SegmentMap {
+    map.merge(other)
+}
+
+/// Returns the first logical blocks of the dirty segments of a map, in
+/// ascending order, as iterated by a partial rebuild.
+pub fn segment_map_dirty_blks(map: SegmentMap) -> impl Iterator<Item = u64> {
+    map.into_dirty_blks()
+}
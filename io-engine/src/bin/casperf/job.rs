@@ -0,0 +1,390 @@
+//! Jobs driving I/O to a bdev from a reactor.
+use std::{ptr::NonNull, time::Duration};
+
+use rand::Rng;
+
+use io_engine::{
+    bdev_api::bdev_create,
+    core::{
+        mayastor_env_stop,
+        Mthread,
+        Reactors,
+        UntypedBdev,
+        UntypedDescriptorGuard,
+    },
+};
+use spdk_rs::{
+    libspdk::{
+        spdk_bdev_free_io,
+        spdk_bdev_io,
+        spdk_bdev_read,
+        spdk_bdev_write,
+        spdk_get_ticks,
+        spdk_get_ticks_hz,
+    },
+    DmaBuf,
+    IoChannelGuard,
+    Poller,
+    PollerBuilder,
+};
+
+use crate::{
+    report::{Interval, Report},
+    workload::{OffsetGen, Workload},
+};
+
+/// A pointer to a job that can be sent to the job's thread.
+#[derive(Debug, Clone, Copy)]
+pub(crate) struct JobPtr(NonNull<Job>);
+
+unsafe impl Send for JobPtr {}
+
+/// A job drives I/O to a bdev using its own thread and I/O channel, until
+/// it is stopped.
+pub(crate) struct Job {
+    /// Name of the job, used in the report.
+    name: String,
+    bdev: UntypedBdev,
+    /// descriptor to the bdev
+    desc: UntypedDescriptorGuard,
+    /// io channel being used to submit IO
+    ch: Option<IoChannelGuard<()>>,
+    /// workload of this job
+    workload: Workload,
+    /// generator of I/O offsets, in units of I/Os
+    offsets: OffsetGen,
+    /// io queue
+    queue: Vec<Io>,
+    /// indices of the I/Os of the queue which are not in flight (open loop)
+    free: Vec<usize>,
+    /// number of IO's currently inflight
+    n_inflight: u32,
+    /// random numbers for offsets and the read/write mix
+    rng: rand::rngs::ThreadRng,
+    /// drain the job which means that we wait for all pending IO to complete
+    /// and stop the run
+    drain: bool,
+    /// statistics of the current interval
+    interval: Interval,
+    /// start of the current interval, in ticks
+    interval_start: u64,
+    /// identifier of this job in the report
+    report_id: usize,
+    /// ticks between two I/Os in open loop mode
+    ticks_per_io: u64,
+    /// time the next I/O is due in open loop mode, in ticks
+    next_due: u64,
+    /// pollers submitting I/Os in open loop mode, and reporting intervals
+    pollers: Vec<Poller<'static>>,
+}
+
+impl Job {
+    /// Creates a new job for the given bdev URI. `index` and `count` tell
+    /// the position of this job among all jobs of the same bdev.
+    pub(crate) async fn new(
+        uri: &str,
+        workload: Workload,
+        index: u64,
+        count: u64,
+    ) -> Box<Self> {
+        let name = match UntypedBdev::lookup_by_name(uri) {
+            Some(bdev) => bdev.name().to_string(),
+            None => bdev_create(uri).await.unwrap_or_else(|e| {
+                eprintln!("Failed to open URI {uri}: {e}");
+                std::process::exit(1);
+            }),
+        };
+        let bdev = UntypedBdev::lookup_by_name(&name).unwrap();
+        let desc = bdev.open(true).unwrap();
+
+        let io_size = workload.io_size;
+        let dev_size = bdev.num_blocks() * bdev.block_len() as u64;
+        if io_size == 0 || io_size % bdev.block_len() as u64 != 0 {
+            eprintln!(
+                "I/O size {io_size} is not a multiple of the block size of \
+                {name} ({})",
+                bdev.block_len()
+            );
+            std::process::exit(1);
+        }
+        let io_count = dev_size / io_size;
+        if io_count == 0 {
+            eprintln!("I/O size {io_size} exceeds the size of {name}");
+            std::process::exit(1);
+        }
+
+        let queue = (0 .. workload.qd as usize)
+            .map(|idx| Io {
+                buf: DmaBuf::new(io_size, bdev.alignment()).unwrap(),
+                idx,
+                read: true,
+                offset: 0,
+                start: 0,
+                job: NonNull::dangling(),
+            })
+            .collect::<Vec<_>>();
+
+        let ticks_per_io = if workload.rate > 0 {
+            (unsafe { spdk_get_ticks_hz() } / workload.rate).max(1)
+        } else {
+            0
+        };
+
+        let name = format!("{name}/{index}");
+        Box::new(Self {
+            report_id: Report::add_job(name.clone()),
+            name,
+            bdev,
+            desc,
+            ch: None,
+            offsets: OffsetGen::new(&workload, io_count, index, count),
+            workload,
+            free: Vec::new(),
+            queue,
+            n_inflight: 0,
+            rng: Default::default(),
+            drain: false,
+            interval: Interval::default(),
+            interval_start: 0,
+            ticks_per_io,
+            next_due: 0,
+            pollers: Vec::new(),
+        })
+    }
+
+    /// Name of the job.
+    pub(crate) fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// Starts the job on the current thread. The job is leaked, and freed
+    /// once it has drained after being stopped.
+    pub(crate) fn run(self: Box<Self>) -> JobPtr {
+        let job = Box::leak(self);
+        let ptr = JobPtr(NonNull::from(&mut *job));
+
+        job.ch = job.desc.io_channel().ok();
+        job.interval_start = ticks();
+
+        job.pollers.push(
+            PollerBuilder::new()
+                .with_name("casperf_report")
+                .with_interval(Duration::from_secs(1))
+                .with_poll_fn(move |_| {
+                    unsafe { &mut *ptr.0.as_ptr() }.report(false);
+                    0
+                })
+                .build(),
+        );
+
+        job.queue.iter_mut().for_each(|io| io.job = ptr.0);
+
+        if job.ticks_per_io == 0 {
+            // Closed loop: keep all I/Os of the queue in flight.
+            for idx in 0 .. job.queue.len() {
+                job.submit(idx, ticks());
+            }
+        } else {
+            // Open loop: submit I/Os at fixed intervals from a poller.
+            job.free = (0 .. job.queue.len()).rev().collect();
+            job.next_due = ticks();
+            job.pollers.push(
+                PollerBuilder::new()
+                    .with_name("casperf_submit")
+                    .with_poll_fn(move |_| {
+                        unsafe { &mut *ptr.0.as_ptr() }.submit_due() as i32
+                    })
+                    .build(),
+            );
+        }
+
+        ptr
+    }
+
+    /// Stops the given job: no more I/Os are submitted, and the job is freed
+    /// once all I/Os in flight have completed. Must be called once, on the
+    /// job's thread.
+    pub(crate) fn stop(ptr: JobPtr) {
+        let job = unsafe { &mut *ptr.0.as_ptr() };
+        job.drain = true;
+        // Stop submitting from the open loop poller.
+        job.pollers.truncate(1);
+        if job.n_inflight == 0 {
+            job.finish();
+        }
+    }
+
+    /// Submits the I/Os which are due in open loop mode. I/Os that cannot
+    /// be submitted for lack of a free slot remain due, and their latency
+    /// is measured from the time they were due, so that stalls of the device
+    /// are not hidden by a lower submission rate.
+    fn submit_due(&mut self) -> u32 {
+        let now = ticks();
+        let mut n = 0;
+        while !self.drain && self.next_due <= now {
+            let Some(idx) = self.free.pop() else {
+                break;
+            };
+            if now - self.next_due > self.ticks_per_io {
+                self.interval.late += 1;
+            }
+            let due = self.next_due;
+            self.next_due += self.ticks_per_io;
+            self.submit(idx, due);
+            n += 1;
+        }
+        n
+    }
+
+    /// Submits the I/O with the given index of the queue, accounting its
+    /// latency from `start`.
+    fn submit(&mut self, idx: usize, start: u64) {
+        let offset = self.offsets.next(&mut self.rng) * self.workload.io_size;
+        let read = self.workload.read_pct >= 100
+            || (self.workload.read_pct > 0
+                && self.rng.gen_range(0 .. 100) < self.workload.read_pct);
+
+        let io = &mut self.queue[idx];
+        io.offset = offset;
+        io.read = read;
+        io.start = start;
+
+        let rc = unsafe {
+            let desc = self.desc.legacy_as_ptr();
+            let ch = self.ch.as_ref().unwrap().legacy_as_ptr();
+            let arg = io as *mut Io as *mut _;
+            if read {
+                spdk_bdev_read(
+                    desc,
+                    ch,
+                    io.buf.as_mut_ptr(),
+                    offset,
+                    io.buf.len(),
+                    Some(Self::io_completion),
+                    arg,
+                )
+            } else {
+                spdk_bdev_write(
+                    desc,
+                    ch,
+                    io.buf.as_mut_ptr(),
+                    offset,
+                    io.buf.len(),
+                    Some(Self::io_completion),
+                    arg,
+                )
+            }
+        };
+
+        if rc == 0 {
+            self.n_inflight += 1;
+        } else {
+            eprintln!(
+                "failed to submit {op} IO to {name}, offset={offset}: {rc}",
+                op = if read { "read" } else { "write" },
+                name = self.bdev.name(),
+            );
+            // The slot stays idle in closed loop mode.
+            self.interval.errors += 1;
+            if self.ticks_per_io > 0 {
+                self.free.push(idx);
+            }
+        }
+    }
+
+    /// io completion callback
+    extern "C" fn io_completion(
+        bdev_io: *mut spdk_bdev_io,
+        success: bool,
+        arg: *mut std::ffi::c_void,
+    ) {
+        let now = ticks();
+        let io: &mut Io = unsafe { &mut *arg.cast() };
+        let idx = io.idx;
+        let job = unsafe { io.job.as_mut() };
+
+        unsafe { spdk_bdev_free_io(bdev_io) }
+        job.n_inflight -= 1;
+
+        if success {
+            let bytes = io.buf.len();
+            let ticks = now.saturating_sub(io.start);
+            if io.read {
+                job.interval.read.record(bytes, ticks);
+            } else {
+                job.interval.write.record(bytes, ticks);
+            }
+        } else {
+            eprintln!(
+                "IO error for bdev {}, offset {}",
+                job.bdev.name(),
+                io.offset
+            );
+            job.interval.errors += 1;
+        }
+
+        if job.drain {
+            if job.n_inflight == 0 {
+                job.finish();
+            }
+            return;
+        }
+
+        if job.ticks_per_io == 0 {
+            job.submit(idx, now);
+        } else {
+            job.free.push(idx);
+        }
+    }
+
+    /// Hands over the statistics of the current interval to the report.
+    /// Returns true once all jobs are done.
+    fn report(&mut self, last: bool) -> bool {
+        let now = ticks();
+        let interval = std::mem::take(&mut self.interval);
+        let elapsed = now - self.interval_start;
+        self.interval_start = now;
+        Report::submit(self.report_id, interval, elapsed, last)
+    }
+
+    /// Completes the job once drained, and schedules it to be freed.
+    fn finish(&mut self) {
+        debug_assert_eq!(self.n_inflight, 0);
+        self.pollers.clear();
+
+        if self.report(true) {
+            Reactors::master().send_future(async {
+                mayastor_env_stop(0);
+            });
+        }
+
+        // The job may still be referenced by the caller (e.g. from an I/O
+        // completion), so free it from a message.
+        let ptr = JobPtr(NonNull::from(&mut *self));
+        Mthread::current().unwrap().send_msg(ptr, |ptr| {
+            drop(unsafe { Box::from_raw(ptr.0.as_ptr()) });
+        });
+    }
+}
+
+/// An I/O slot of a job.
+struct Io {
+    /// buffer we read/write from/to
+    buf: DmaBuf,
+    /// index of this I/O in the job's queue
+    idx: usize,
+    /// whether the current I/O is a read or a write
+    read: bool,
+    /// current offset, in bytes
+    offset: u64,
+    /// time the current I/O was submitted or due, in ticks
+    start: u64,
+    /// pointer to our the job we belong too
+    job: NonNull<Job>,
+}
+
+/// Returns the current time, in ticks.
+#[inline(always)]
+pub(crate) fn ticks() -> u64 {
+    unsafe { spdk_get_ticks() }
+}
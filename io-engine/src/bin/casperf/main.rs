@@ -0,0 +1,314 @@
+//! Multi-core, multi-bdev I/O benchmark.
+//!
+//! Every storage URI is driven by one or more jobs, spread over the reactors
+//! of the reactor mask. A job keeps a fixed number of I/Os in flight (closed
+//! loop), or submits I/Os at a fixed rate regardless of completions (open
+//! loop), with a configurable read/write mix and offset distribution.
+//! Throughput and latency percentiles are printed every second, and for the
+//! whole run once the jobs are stopped, either as text or as JSON lines.
+use std::cell::RefCell;
+
+use clap::{Arg, ArgAction, Command};
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+
+use io_engine::{
+    core::{Cores, MayastorCliArgs, MayastorEnvironment, Mthread, Reactors},
+    logger,
+    subsys::Config,
+};
+use spdk_rs::{libspdk::spdk_get_ticks_hz, Poller, PollerBuilder};
+use version_info::version_info_str;
+
+mod job;
+mod report;
+mod workload;
+
+use job::{Job, JobPtr};
+use report::Report;
+use workload::{Distribution, Pattern, Workload};
+
+/// default queue depth
+const QD: u64 = 64;
+/// default io_size
+const IO_SIZE: u64 = 512;
+
+/// Running jobs, and whether they are being stopped.
+#[derive(Default)]
+struct Jobs {
+    stopping: bool,
+    jobs: Vec<(Mthread, JobPtr)>,
+}
+
+static JOBS: Lazy<Mutex<Jobs>> = Lazy::new(Default::default);
+
+thread_local! {
+    /// Poller stopping the jobs once the runtime has elapsed.
+    static RUNTIME: RefCell<Option<Poller<'static>>> = RefCell::new(None);
+}
+
+/// Registers a job started on the current thread. The job is stopped right
+/// away if the jobs are already being stopped.
+fn add_job(ptr: JobPtr) {
+    let mut jobs = JOBS.lock();
+    if jobs.stopping {
+        Job::stop(ptr);
+    } else {
+        jobs.jobs.push((Mthread::current().unwrap(), ptr));
+    }
+}
+
+/// Stops all jobs. The environment is stopped once they have drained.
+fn stop_jobs() {
+    let mut jobs = JOBS.lock();
+    if jobs.stopping {
+        return;
+    }
+    jobs.stopping = true;
+
+    eprintln!("Draining jobs....");
+    for (thread, ptr) in jobs.jobs.drain(..) {
+        thread.send_msg(ptr, Job::stop);
+    }
+}
+
+/// override the default signal handler as we need to stop the jobs first
+/// before we can shut down
+fn sig_override() {
+    let handler = || {
+        Mthread::primary().send_msg((), |_| stop_jobs());
+    };
+
+    unsafe {
+        signal_hook::low_level::register(signal_hook::consts::SIGTERM, handler)
+            .expect("failed to set SIGTERM");
+        signal_hook::low_level::register(signal_hook::consts::SIGINT, handler)
+            .expect("failed to set SIGINT");
+    };
+}
+
+fn main() {
+    logger::init("INFO");
+
+    // do not start the target(s)
+    Config::get_or_init(|| {
+        let mut cfg = Config::default();
+        cfg.nexus_opts.nvmf_enable = false;
+        cfg
+    });
+
+    let matches = Command::new("Mayastor performance tool")
+        .version(version_info_str!())
+        .about("Perform IO to storage URIs")
+        .arg(
+            Arg::new("io-size")
+                .value_name("io-size")
+                .short('b')
+                .help("block size in bytes"),
+        )
+        .arg(
+            Arg::new("io-type")
+                .value_name("io-type")
+                .short('t')
+                .help("type of IOs")
+                .value_parser([
+                    "read",
+                    "write",
+                    "rw",
+                    "readwrite",
+                    "randread",
+                    "randwrite",
+                    "randrw",
+                ]),
+        )
+        .arg(
+            Arg::new("rwmixread")
+                .value_name("percent")
+                .short('M')
+                .long("rwmixread")
+                .value_parser(clap::value_parser!(u32).range(0 ..= 100))
+                .help("percentage of reads of mixed workloads"),
+        )
+        .arg(
+            Arg::new("distribution")
+                .value_name("distribution")
+                .short('d')
+                .long("distribution")
+                .value_parser(clap::value_parser!(Distribution))
+                .help(
+                    "offset distribution of random IOs: uniform or \
+                    zipf[:theta]",
+                ),
+        )
+        .arg(
+            Arg::new("queue-depth")
+                .value_name("queue-depth")
+                .short('q')
+                .value_parser(clap::value_parser!(u64).range(1 ..))
+                .help("queue depth"),
+        )
+        .arg(
+            Arg::new("jobs")
+                .value_name("jobs")
+                .short('j')
+                .long("jobs")
+                .value_parser(clap::value_parser!(u64).range(1 ..))
+                .help("number of jobs per URI, spread over the reactors"),
+        )
+        .arg(
+            Arg::new("rate")
+                .value_name("iops")
+                .short('r')
+                .long("rate")
+                .value_parser(clap::value_parser!(u64))
+                .help(
+                    "IOs per second submitted by each job regardless of \
+                    completions (open loop); 0 keeps queue-depth IOs in \
+                    flight (closed loop)",
+                ),
+        )
+        .arg(
+            Arg::new("runtime")
+                .value_name("seconds")
+                .short('T')
+                .long("runtime")
+                .value_parser(clap::value_parser!(u64))
+                .help(
+                    "stop after the given number of seconds; 0 runs until \
+                    interrupted",
+                ),
+        )
+        .arg(
+            Arg::new("reactor-mask")
+                .value_name("mask")
+                .short('m')
+                .long("reactor-mask")
+                .default_value("0x2")
+                .help("mask of the reactors to run the jobs on"),
+        )
+        .arg(
+            Arg::new("json")
+                .long("json")
+                .action(ArgAction::SetTrue)
+                .help("print JSON lines instead of text"),
+        )
+        .arg(
+            Arg::new("URI")
+                .value_name("URI")
+                .help("storage URI's")
+                .required(true)
+                .index(1)
+                .action(ArgAction::Append),
+        )
+        .subcommand_required(false)
+        .get_matches();
+
+    let uris = matches
+        .get_many::<String>("URI")
+        .unwrap()
+        .map(|u| u.to_string())
+        .collect::<Vec<_>>();
+
+    let io_size = match matches.get_one::<String>("io-size") {
+        Some(io_size) => {
+            byte_unit::Byte::from_str(io_size).unwrap().get_bytes() as u64
+        }
+        None => IO_SIZE,
+    };
+
+    let (pattern, read_pct) = Workload::parse_io_type(
+        matches
+            .get_one::<String>("io-type")
+            .map(|s| s.as_str())
+            .unwrap_or("randread"),
+    )
+    .unwrap();
+
+    let distribution = matches
+        .get_one::<Distribution>("distribution")
+        .copied()
+        .unwrap_or(Distribution::Uniform);
+    if pattern == Pattern::Sequential && distribution != Distribution::Uniform {
+        eprintln!("Offset distributions only apply to random IO types");
+        std::process::exit(1);
+    }
+
+    let workload = Workload {
+        io_size,
+        qd: *matches.get_one::<u64>("queue-depth").unwrap_or(&QD),
+        read_pct: matches
+            .get_one::<u32>("rwmixread")
+            .copied()
+            .unwrap_or(read_pct),
+        pattern,
+        distribution,
+        rate: *matches.get_one::<u64>("rate").unwrap_or(&0),
+    };
+    let jobs_per_uri = *matches.get_one::<u64>("jobs").unwrap_or(&1);
+    let runtime = *matches.get_one::<u64>("runtime").unwrap_or(&0);
+    let json = matches.get_flag("json");
+
+    let args = MayastorCliArgs {
+        reactor_mask: matches
+            .get_one::<String>("reactor-mask")
+            .unwrap()
+            .to_string(),
+        skip_sig_handler: true,
+        enable_io_all_thrd_nexus_channels: true,
+        no_pci: false,
+        ..Default::default()
+    };
+
+    MayastorEnvironment::new(args).init();
+    sig_override();
+    io_engine::bdev::nexus::register_module(false);
+    Report::init(json, unsafe { spdk_get_ticks_hz() });
+
+    if json {
+        let rec = serde_json::json!({
+            "workload": workload,
+            "jobs_per_uri": jobs_per_uri,
+        });
+        println!("{rec}");
+    } else {
+        println!("Workload: {workload:?}, {jobs_per_uri} job(s) per URI");
+    }
+
+    Reactors::master().send_future(async move {
+        let cores = Cores::list_cores().into_iter().collect::<Vec<u32>>();
+        let mut n = 0;
+
+        for uri in &uris {
+            for index in 0 .. jobs_per_uri {
+                let job = Job::new(uri, workload, index, jobs_per_uri).await;
+                let core = cores[n % cores.len()];
+                n += 1;
+
+                if !json {
+                    println!("Starting job {} on core {core}", job.name());
+                }
+                let thread =
+                    Mthread::new(job.name().to_string(), core).unwrap();
+                thread.send_msg(job, |job| add_job(job.run()));
+            }
+        }
+
+        if runtime > 0 {
+            RUNTIME.with(|r| {
+                *r.borrow_mut() = Some(
+                    PollerBuilder::new()
+                        .with_name("casperf_runtime")
+                        .with_interval(std::time::Duration::from_secs(runtime))
+                        .with_poll_fn(|_| {
+                            stop_jobs();
+                            0
+                        })
+                        .build(),
+                );
+            });
+        }
+    });
+
+    Reactors::master().running();
+    Reactors::master().poll_reactor();
+}
@@ -0,0 +1,304 @@
+//! Collection and output of the job statistics.
+//!
+//! Every job accounts its I/Os into its own `Interval` on its own reactor,
+//! and hands the interval over to the report once per second. The report
+//! merges the intervals of all jobs and prints a line per second as soon as
+//! every running job has reported it, followed by a summary once all jobs
+//! are done.
+use std::collections::BTreeMap;
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+use serde::Serialize;
+
+use io_engine::core::{LatencyHistogram, LatencySummary};
+
+/// Statistics of one I/O direction over a period of time.
+#[derive(Debug, Clone, Default)]
+pub(crate) struct OpStats {
+    /// Number of completed I/Os.
+    pub(crate) ios: u64,
+    /// Number of bytes transferred.
+    pub(crate) bytes: u64,
+    /// Latencies of the completed I/Os, in ticks.
+    pub(crate) latency: LatencyHistogram,
+}
+
+impl OpStats {
+    #[inline(always)]
+    pub(crate) fn record(&mut self, bytes: u64, ticks: u64) {
+        self.ios += 1;
+        self.bytes += bytes;
+        self.latency.record(ticks);
+    }
+
+    fn merge(&mut self, other: &OpStats) {
+        self.ios += other.ios;
+        self.bytes += other.bytes;
+        self.latency.merge(&other.latency);
+    }
+
+    fn summary(&self, secs: f64, tick_rate: u64, buckets: bool) -> OpSummary {
+        let mut latency = self.latency.summary(tick_rate);
+        if !buckets {
+            latency.buckets.clear();
+        }
+        OpSummary {
+            ios: self.ios,
+            iops: (self.ios as f64 / secs) as u64,
+            bytes_per_sec: (self.bytes as f64 / secs) as u64,
+            latency,
+        }
+    }
+}
+
+/// Statistics of a job over a period of time.
+#[derive(Debug, Clone, Default)]
+pub(crate) struct Interval {
+    pub(crate) read: OpStats,
+    pub(crate) write: OpStats,
+    /// Number of failed I/Os.
+    pub(crate) errors: u64,
+    /// Number of I/Os which were submitted later than scheduled in open loop
+    /// mode, because all I/O slots were busy.
+    pub(crate) late: u64,
+}
+
+impl Interval {
+    fn merge(&mut self, other: &Interval) {
+        self.read.merge(&other.read);
+        self.write.merge(&other.write);
+        self.errors += other.errors;
+        self.late += other.late;
+    }
+
+    fn summary(&self, secs: f64, tick_rate: u64, buckets: bool) -> Summary {
+        let secs = secs.max(1e-6);
+        Summary {
+            read: self.read.summary(secs, tick_rate, buckets),
+            write: self.write.summary(secs, tick_rate, buckets),
+            errors: self.errors,
+            late: self.late,
+        }
+    }
+}
+
+/// Summary of one I/O direction.
+#[derive(Debug, Serialize)]
+struct OpSummary {
+    ios: u64,
+    iops: u64,
+    bytes_per_sec: u64,
+    latency: LatencySummary,
+}
+
+/// Summary of a job, or of all jobs.
+#[derive(Debug, Serialize)]
+struct Summary {
+    read: OpSummary,
+    write: OpSummary,
+    errors: u64,
+    late: u64,
+}
+
+/// Per-second record.
+#[derive(Debug, Serialize)]
+struct SecondRecord {
+    time_s: u64,
+    #[serde(flatten)]
+    stats: Summary,
+}
+
+/// Per-job part of the final summary.
+#[derive(Debug, Serialize)]
+struct JobRecord<'a> {
+    job: &'a str,
+    #[serde(flatten)]
+    stats: Summary,
+}
+
+/// Final summary.
+#[derive(Debug, Serialize)]
+struct FinalRecord<'a> {
+    runtime_s: f64,
+    jobs: Vec<JobRecord<'a>>,
+    total: Summary,
+}
+
+/// Reporting state of a job.
+#[derive(Debug)]
+struct JobState {
+    name: String,
+    /// Number of intervals the job has reported.
+    reported: u64,
+    /// Running time of the job, in ticks.
+    ticks: u64,
+    /// Set once the job has completed.
+    done: bool,
+    /// Statistics of the whole run of the job.
+    total: Interval,
+}
+
+/// Report of all jobs.
+#[derive(Debug, Default)]
+pub(crate) struct Report {
+    /// Print JSON records instead of text.
+    json: bool,
+    /// Tick rate of the reactors.
+    tick_rate: u64,
+    jobs: Vec<JobState>,
+    /// Merged intervals waiting for some jobs to report them.
+    pending: BTreeMap<u64, Interval>,
+}
+
+static REPORT: Lazy<Mutex<Report>> = Lazy::new(Default::default);
+
+impl Report {
+    /// Sets the output format and the tick rate.
+    pub(crate) fn init(json: bool, tick_rate: u64) {
+        let mut r = REPORT.lock();
+        r.json = json;
+        r.tick_rate = tick_rate;
+    }
+
+    /// Registers a job and returns its report identifier.
+    pub(crate) fn add_job(name: String) -> usize {
+        let mut r = REPORT.lock();
+        r.jobs.push(JobState {
+            name,
+            reported: 0,
+            ticks: 0,
+            done: false,
+            total: Interval::default(),
+        });
+        r.jobs.len() - 1
+    }
+
+    /// Hands over the statistics of the given job for its next interval,
+    /// which lasted `ticks`. The last interval of a job can be shorter than
+    /// a second, and it is only accounted for in the final summary.
+    /// Returns true once all the jobs are done.
+    pub(crate) fn submit(
+        id: usize,
+        interval: Interval,
+        ticks: u64,
+        last: bool,
+    ) -> bool {
+        let mut r = REPORT.lock();
+
+        let job = &mut r.jobs[id];
+        job.total.merge(&interval);
+        job.ticks += ticks;
+        let idx = job.reported;
+        if last {
+            job.done = true;
+        } else {
+            job.reported += 1;
+        }
+
+        if !last {
+            r.pending.entry(idx).or_default().merge(&interval);
+        }
+        r.flush();
+
+        let done = r.jobs.iter().all(|j| j.done);
+        if done {
+            r.print_summary();
+        }
+        done
+    }
+
+    /// Prints the pending intervals that every running job has reported.
+    fn flush(&mut self) {
+        while let Some((&idx, _)) = self.pending.iter().next() {
+            if !self.jobs.iter().all(|j| j.done || j.reported > idx) {
+                break;
+            }
+            let interval = self.pending.remove(&idx).unwrap();
+            let s = interval.summary(1.0, self.tick_rate, false);
+            if self.json {
+                let rec = SecondRecord {
+                    time_s: idx + 1,
+                    stats: s,
+                };
+                println!("{}", serde_json::to_string(&rec).unwrap());
+            } else {
+                println!("[{:>4}s] {}", idx + 1, format_summary(&s));
+            }
+        }
+    }
+
+    /// Prints the summary of the whole run.
+    fn print_summary(&self) {
+        let tick_rate = self.tick_rate.max(1);
+        let mut total = Interval::default();
+        let mut runtime = 0.0f64;
+
+        let jobs = self
+            .jobs
+            .iter()
+            .map(|j| {
+                total.merge(&j.total);
+                let secs = j.ticks as f64 / tick_rate as f64;
+                runtime = runtime.max(secs);
+                JobRecord {
+                    job: &j.name,
+                    stats: j.total.summary(secs, tick_rate, !self.json),
+                }
+            })
+            .collect::<Vec<_>>();
+
+        let rec = FinalRecord {
+            runtime_s: runtime,
+            total: total.summary(runtime, tick_rate, true),
+            jobs,
+        };
+
+        if self.json {
+            println!("{}", serde_json::to_string(&rec).unwrap());
+            return;
+        }
+
+        println!("\n{:=^100}", " Summary ");
+        for j in &rec.jobs {
+            println!("{:30} {}", j.job, format_summary(&j.stats));
+        }
+        println!("{:-^100}", "");
+        println!("{:30} {}", "Total", format_summary(&rec.total));
+        println!("Runtime: {:.1}s", rec.runtime_s);
+    }
+}
+
+/// Formats a summary on a single line.
+fn format_summary(s: &Summary) -> String {
+    let op = |name: &str, o: &OpSummary| {
+        format!(
+            "{name}: {iops:>9} IO/s {mbs:>7} MiB/s lat(us) p50 {p50:>6} \
+            p99 {p99:>6} p99.9 {p999:>6} max {max:>7}",
+            iops = o.iops,
+            mbs = o.bytes_per_sec / (1024 * 1024),
+            p50 = o.latency.p50_us,
+            p99 = o.latency.p99_us,
+            p999 = o.latency.p999_us,
+            max = o.latency.max_us,
+        )
+    };
+
+    let mut line = String::new();
+    if s.read.ios > 0 {
+        line.push_str(&op("read", &s.read));
+    }
+    if s.write.ios > 0 {
+        if !line.is_empty() {
+            line.push_str(" | ");
+        }
+        line.push_str(&op("write", &s.write));
+    }
+    if s.errors > 0 {
+        line.push_str(&format!(" | errors: {}", s.errors));
+    }
+    if s.late > 0 {
+        line.push_str(&format!(" | late: {}", s.late));
+    }
+    line
+}
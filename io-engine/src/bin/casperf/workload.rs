@@ -0,0 +1,212 @@
+//! Workload definition and I/O offset generators.
+use rand::Rng;
+use serde::Serialize;
+
+/// Order in which I/O offsets are generated.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub(crate) enum Pattern {
+    /// Each job walks its own region of the device, wrapping at its end.
+    Sequential,
+    /// Offsets are drawn from the configured distribution.
+    Random,
+}
+
+/// Distribution of random I/O offsets.
+#[derive(Debug, Clone, Copy, PartialEq, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub(crate) enum Distribution {
+    /// All offsets of the device are equally likely.
+    Uniform,
+    /// Offsets follow a Zipfian distribution with the given skew (theta):
+    /// a few hot offsets receive most of the I/O.
+    Zipf(f64),
+}
+
+impl std::str::FromStr for Distribution {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s.split_once(':') {
+            None if s == "uniform" => Ok(Self::Uniform),
+            None if s == "zipf" => Ok(Self::Zipf(ZIPF_THETA)),
+            Some(("zipf", theta)) => match theta.parse::<f64>() {
+                Ok(t) if t > 0.0 && t < 1.0 => Ok(Self::Zipf(t)),
+                _ => {
+                    Err(format!("invalid zipf theta '{theta}': not in (0, 1)"))
+                }
+            },
+            _ => Err(format!(
+                "invalid distribution '{s}': expected uniform or zipf[:theta]"
+            )),
+        }
+    }
+}
+
+/// Default skew of the Zipfian distribution, as used by YCSB.
+const ZIPF_THETA: f64 = 0.99;
+
+/// Parameters of the I/O a job generates.
+#[derive(Debug, Clone, Copy, Serialize)]
+pub(crate) struct Workload {
+    /// Size of each I/O, in bytes.
+    pub(crate) io_size: u64,
+    /// Number of I/Os kept in flight by a job (closed loop), or the maximum
+    /// number of I/Os in flight (open loop).
+    pub(crate) qd: u64,
+    /// Percentage of reads; the remaining I/Os are writes.
+    pub(crate) read_pct: u32,
+    /// Order of I/O offsets.
+    pub(crate) pattern: Pattern,
+    /// Distribution of random I/O offsets.
+    pub(crate) distribution: Distribution,
+    /// Number of I/Os per second a job submits at fixed intervals, regardless
+    /// of completions (open loop). Zero submits a new I/O as soon as one
+    /// completes (closed loop).
+    pub(crate) rate: u64,
+}
+
+impl Workload {
+    /// Parses an fio-style I/O type and returns the pattern and the default
+    /// percentage of reads.
+    pub(crate) fn parse_io_type(s: &str) -> Option<(Pattern, u32)> {
+        match s {
+            "read" => Some((Pattern::Sequential, 100)),
+            "write" => Some((Pattern::Sequential, 0)),
+            "rw" | "readwrite" => Some((Pattern::Sequential, 50)),
+            "randread" => Some((Pattern::Random, 100)),
+            "randwrite" => Some((Pattern::Random, 0)),
+            "randrw" => Some((Pattern::Random, 50)),
+            _ => None,
+        }
+    }
+}
+
+/// Generator of I/O offsets, in units of I/Os (i.e. the returned values must
+/// be multiplied by the I/O size).
+pub(crate) enum OffsetGen {
+    Sequential { first: u64, count: u64, next: u64 },
+    Uniform { count: u64 },
+    Zipf(Zipf),
+}
+
+impl OffsetGen {
+    /// Creates a new generator for the given job out of `jobs` jobs sharing
+    /// a device of `count` I/Os.
+    pub(crate) fn new(
+        workload: &Workload,
+        count: u64,
+        job: u64,
+        jobs: u64,
+    ) -> Self {
+        match (workload.pattern, workload.distribution) {
+            (Pattern::Sequential, _) => {
+                // Split the device between the jobs so that they do not
+                // stream over the same blocks.
+                let region = (count / jobs.max(1)).max(1);
+                let first = (job * region).min(count - 1);
+                Self::Sequential {
+                    first,
+                    count: region.min(count - first),
+                    next: 0,
+                }
+            }
+            (Pattern::Random, Distribution::Uniform) => Self::Uniform {
+                count,
+            },
+            (Pattern::Random, Distribution::Zipf(theta)) => {
+                Self::Zipf(Zipf::new(count, theta))
+            }
+        }
+    }
+
+    /// Returns the next offset.
+    #[inline]
+    pub(crate) fn next<R: Rng>(&mut self, rng: &mut R) -> u64 {
+        match self {
+            Self::Sequential {
+                first,
+                count,
+                next,
+            } => {
+                let offset = *first + *next;
+                *next = (*next + 1) % *count;
+                offset
+            }
+            Self::Uniform {
+                count,
+            } => rng.gen_range(0 .. *count),
+            Self::Zipf(z) => z.next(rng),
+        }
+    }
+}
+
+/// Number of terms of the zeta function summed exactly; the rest of the
+/// series is approximated by an integral, so that setting up a generator for
+/// a large device does not take minutes.
+const ZETA_EXACT_TERMS: u64 = 1 << 20;
+
+/// Computes the generalized harmonic number `sum(1 / i^theta), i = 1 ..= n`.
+fn zeta(n: u64, theta: f64) -> f64 {
+    let m = n.min(ZETA_EXACT_TERMS);
+    let exact: f64 = (1 ..= m).map(|i| (i as f64).powf(-theta)).sum();
+    if n == m {
+        return exact;
+    }
+    // Integral of x^-theta over [m + 0.5, n + 0.5].
+    let p = 1.0 - theta;
+    exact + ((n as f64 + 0.5).powf(p) - (m as f64 + 0.5).powf(p)) / p
+}
+
+/// Zipfian generator after Gray et al., "Quickly Generating Billion-Record
+/// Synthetic Databases", as used by YCSB. Ranks are scrambled with a hash so
+/// that the hot offsets are spread over the device instead of being packed
+/// at its start.
+pub(crate) struct Zipf {
+    count: u64,
+    theta: f64,
+    alpha: f64,
+    zetan: f64,
+    eta: f64,
+}
+
+impl Zipf {
+    fn new(count: u64, theta: f64) -> Self {
+        let zetan = zeta(count, theta);
+        let zeta2 = zeta(2, theta);
+        Self {
+            count,
+            theta,
+            alpha: 1.0 / (1.0 - theta),
+            zetan,
+            eta: (1.0 - (2.0 / count as f64).powf(1.0 - theta))
+                / (1.0 - zeta2 / zetan),
+        }
+    }
+
+    /// Returns the next offset.
+    #[inline]
+    fn next<R: Rng>(&mut self, rng: &mut R) -> u64 {
+        let u: f64 = rng.gen();
+        let uz = u * self.zetan;
+
+        let rank = if uz < 1.0 {
+            0
+        } else if uz < 1.0 + 0.5f64.powf(self.theta) {
+            1
+        } else {
+            let r = self.count as f64
+                * (self.eta * u - self.eta + 1.0).powf(self.alpha);
+            (r as u64).min(self.count - 1)
+        };
+
+        fnv1a(rank) % self.count
+    }
+}
+
+/// FNV-1a hash of a 64-bit value.
+fn fnv1a(v: u64) -> u64 {
+    v.to_le_bytes().iter().fold(0xcbf2_9ce4_8422_2325, |h, b| {
+        (h ^ *b as u64).wrapping_mul(0x0100_0000_01b3)
+    })
+}
@@ -1,8 +1,9 @@
 //!
 //! Methods related to the gathering of performance statistics.
 //!
-//! At present we only have get_resource_usage() which is
-//! essentially the result of a getrusage(2) system call.
+//! get_resource_usage() is essentially the result of a getrusage(2) system
+//! call, and get_reactor_stats() returns the poll loop statistics of the
+//! reactors, through the reactor_stats json-rpc method.
 
 use super::{
     context::{Context, OutputFormat},
@@ -10,23 +11,27 @@ use super::{
 };
 use clap::{ArgMatches, Command};
 use colored_json::ToColoredJson;
-use io_engine_api::v0 as rpc;
+use io_engine_api::{v0 as rpc, v1 as v1rpc};
 use snafu::ResultExt;
 use tonic::Status;
 
 pub fn subcommands() -> Command {
     let resource = Command::new("resource").about("Resource usage statistics");
+    let reactor = Command::new("reactor")
+        .about("Reactor poll loop statistics, per core and SPDK thread");
 
     Command::new("perf")
         .subcommand_required(true)
         .arg_required_else_help(true)
         .about("Performance statistics")
         .subcommand(resource)
+        .subcommand(reactor)
 }
 
 pub async fn handler(ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
     match matches.subcommand().unwrap() {
         ("resource", args) => get_resource_usage(ctx, args).await,
+        ("reactor", args) => get_reactor_stats(ctx, args).await,
         (cmd, _) => {
             Err(Status::not_found(format!("command {cmd} does not exist")))
                 .context(GrpcStatus)
@@ -82,3 +87,94 @@ async fn get_resource_usage(
 
     Ok(())
 }
+
+async fn get_reactor_stats(
+    mut ctx: Context,
+    _matches: &ArgMatches,
+) -> crate::Result<()> {
+    ctx.v2("Requesting reactor statistics");
+
+    let response = ctx
+        .v1
+        .json
+        .json_rpc_call(v1rpc::json::JsonRpcRequest {
+            method: "reactor_stats".to_string(),
+            params: String::new(),
+        })
+        .await
+        .context(GrpcStatus)?;
+
+    match ctx.output {
+        OutputFormat::Json => {
+            println!(
+                "{}",
+                response.get_ref().result.to_colored_json_auto().unwrap()
+            );
+        }
+        OutputFormat::Default => {
+            let reactors: serde_json::Value =
+                serde_json::from_str(&response.get_ref().result)
+                    .unwrap_or_default();
+            let reactors = reactors.as_array().cloned().unwrap_or_default();
+
+            let ratio = |v: &serde_json::Value| {
+                format!(
+                    "{:.1}%",
+                    v["busy_ratio"].as_f64().unwrap_or(0.0) * 100.0
+                )
+            };
+            let mut cores: Vec<Vec<String>> = Vec::new();
+            let mut threads: Vec<Vec<String>> = Vec::new();
+
+            for r in &reactors {
+                let it = &r["iterations"];
+                let polls = it["busy_polls"].as_u64().unwrap_or(0)
+                    + it["idle_polls"].as_u64().unwrap_or(0);
+                cores.push(vec![
+                    r["core"].to_string(),
+                    polls.to_string(),
+                    ratio(it),
+                    ratio(&r["futures"]),
+                    r["slow_iterations"].to_string(),
+                    r["section"].as_str().unwrap_or_default().to_string(),
+                    r["running_us"].to_string(),
+                ]);
+
+                for t in r["threads"].as_array().into_iter().flatten() {
+                    threads.push(vec![
+                        r["core"].to_string(),
+                        t["name"].as_str().unwrap_or_default().to_string(),
+                        t["busy_polls"].to_string(),
+                        t["busy_us"].to_string(),
+                        ratio(t),
+                    ]);
+                }
+            }
+
+            if cores.is_empty() {
+                return Ok(());
+            }
+            ctx.print_list(
+                vec![
+                    ">CORE",
+                    ">ITERATIONS",
+                    ">BUSY",
+                    ">FUTURES_BUSY",
+                    ">SLOW",
+                    "SECTION",
+                    ">RUNNING_US",
+                ],
+                cores,
+            );
+            if !threads.is_empty() {
+                println!();
+                ctx.print_list(
+                    vec![">CORE", "THREAD", ">BUSY_POLLS", ">BUSY_US", ">BUSY"],
+                    threads,
+                );
+            }
+        }
+    };
+
+    Ok(())
+}
@@ -3,6 +3,7 @@
 
 use crate::{
     context::{Context, OutputFormat},
+    parse_size,
     ClientError,
     GrpcStatus,
 };
@@ -23,6 +24,7 @@ pub async fn handler(ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
         ("stats", args) => stats(ctx, args).await,
         ("progress", args) => progress(ctx, args).await,
         ("history", args) => history(ctx, args).await,
+        ("budget", args) => budget(ctx, args).await,
         (cmd, _) => {
             Err(Status::not_found(format!("command {cmd} does not exist")))
                 .context(GrpcStatus)
@@ -145,6 +147,40 @@ pub fn subcommands() -> Command {
                 .help("uuid of the nexus"),
         );
 
+    let budget = Command::new("budget")
+        .about(
+            "gets or sets the bandwidth and IOPS budget of a rebuild, \
+            or of all rebuilds on the node when no nexus is given",
+        )
+        .arg(
+            Arg::new("uuid")
+                .required(false)
+                .index(1)
+                .requires("uri")
+                .help("uuid of the nexus"),
+        )
+        .arg(
+            Arg::new("uri")
+                .required(false)
+                .index(2)
+                .help("uri of the child being rebuilt"),
+        )
+        .arg(
+            Arg::new("bandwidth")
+                .required(false)
+                .long("bandwidth")
+                .short('b')
+                .help("bandwidth per second (e.g. 100MiB), 0 for no limit"),
+        )
+        .arg(
+            Arg::new("iops")
+                .required(false)
+                .long("iops")
+                .short('i')
+                .value_parser(clap::value_parser!(u64))
+                .help("segment copies per second, 0 for no limit"),
+        );
+
     Command::new("rebuild")
         .subcommand_required(true)
         .arg_required_else_help(true)
@@ -157,6 +193,7 @@ pub fn subcommands() -> Command {
         .subcommand(stats)
         .subcommand(progress)
         .subcommand(history)
+        .subcommand(budget)
 }
 
 async fn start(mut ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
@@ -568,3 +605,72 @@ fn rebuild_state_to_str(s: v1::nexus::RebuildJobState) -> &'static str {
         v1::nexus::RebuildJobState::Completed => "completed",
     }
 }
+
+async fn budget(mut ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
+    let uuid = matches.get_one::<String>("uuid").cloned();
+    let uri = matches.get_one::<String>("uri").cloned();
+    let bandwidth = matches
+        .get_one::<String>("bandwidth")
+        .map(|s| {
+            parse_size(s)
+                .map(|b| b.get_bytes() as u64)
+                .map_err(|s| {
+                    Status::invalid_argument(format!("Bad bandwidth '{s}'"))
+                })
+                .context(GrpcStatus)
+        })
+        .transpose()?;
+    let iops = matches.get_one::<u64>("iops").cloned();
+
+    let budget = if bandwidth.is_some() || iops.is_some() {
+        Some(serde_json::json!({
+            "bytes_per_sec": bandwidth.unwrap_or_default(),
+            "iops": iops.unwrap_or_default(),
+        }))
+    } else {
+        None
+    };
+
+    let params = serde_json::json!({
+        "nexus": uuid,
+        "uri": uri,
+        "budget": budget,
+    });
+
+    let response = ctx
+        .v1
+        .json
+        .json_rpc_call(v1::json::JsonRpcRequest {
+            method: "nexus_rebuild_budget".to_string(),
+            params: params.to_string(),
+        })
+        .await
+        .context(GrpcStatus)?;
+
+    match ctx.output {
+        OutputFormat::Json => {
+            println!(
+                "{}",
+                response.get_ref().result.to_colored_json_auto().unwrap()
+            );
+        }
+        OutputFormat::Default => {
+            let reply: serde_json::Value =
+                serde_json::from_str(&response.get_ref().result)
+                    .unwrap_or_default();
+            let fmt = |b: &serde_json::Value| {
+                format!(
+                    "{bw} B/s, {iops} IOPS",
+                    bw = b["bytes_per_sec"],
+                    iops = b["iops"]
+                )
+            };
+            println!("node: {}", fmt(&reply["node"]));
+            if !reply["job"].is_null() {
+                println!("job:  {}", fmt(&reply["job"]));
+            }
+        }
+    };
+
+    Ok(())
+}
@@ -31,6 +31,21 @@ pub fn subcommands() -> Command {
             .help("Replica name"),
     );
 
+    let latency = Command::new("latency")
+        .about("Get Nexus IO latency percentiles")
+        .arg(
+            Arg::new("name")
+                .required(false)
+                .index(1)
+                .help("Volume target/nexus name"),
+        )
+        .arg(
+            Arg::new("reset")
+                .long("reset")
+                .action(clap::ArgAction::SetTrue)
+                .help("Reset the latency histograms after collecting them"),
+        );
+
     let reset = Command::new("reset").about("Reset all resource IO Stats");
 
     Command::new("stats")
@@ -40,6 +55,7 @@ pub fn subcommands() -> Command {
         .subcommand(pool)
         .subcommand(nexus)
         .subcommand(replica)
+        .subcommand(latency)
         .subcommand(reset)
 }
 
@@ -48,6 +64,7 @@ pub async fn handler(ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
         ("pool", args) => pool(ctx, args).await,
         ("nexus", args) => nexus(ctx, args).await,
         ("replica", args) => replica(ctx, args).await,
+        ("latency", args) => latency(ctx, args).await,
         ("reset", _) => reset(ctx).await,
         (cmd, _) => {
             Err(Status::not_found(format!("command {cmd} does not exist")))
@@ -310,6 +327,73 @@ async fn replica(mut ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
     Ok(())
 }
 
+async fn latency(mut ctx: Context, matches: &ArgMatches) -> crate::Result<()> {
+    ctx.v2("Requesting Nexus latency histograms");
+    let params = serde_json::json!({
+        "name": matches.get_one::<String>("name"),
+        "reset": matches.get_flag("reset"),
+    });
+    let response = ctx
+        .v1
+        .json
+        .json_rpc_call(v1rpc::json::JsonRpcRequest {
+            method: "nexus_io_latency".to_string(),
+            params: params.to_string(),
+        })
+        .await
+        .context(GrpcStatus)?;
+    match ctx.output {
+        OutputFormat::Json => {
+            println!(
+                "{}",
+                response.get_ref().result.to_colored_json_auto().unwrap()
+            );
+        }
+        OutputFormat::Default => {
+            let reply: serde_json::Value =
+                serde_json::from_str(&response.get_ref().result)
+                    .unwrap_or_default();
+            let row = |name: String, op: &str, h: &serde_json::Value| {
+                vec![
+                    name,
+                    op.to_string(),
+                    h["count"].to_string(),
+                    h["mean_us"].to_string(),
+                    h["p50_us"].to_string(),
+                    h["p90_us"].to_string(),
+                    h["p99_us"].to_string(),
+                    h["p999_us"].to_string(),
+                    h["max_us"].to_string(),
+                ]
+            };
+            let mut table = Vec::new();
+            for nexus in reply.as_array().into_iter().flatten() {
+                let name = nexus["name"].as_str().unwrap_or_default();
+                for op in ["read", "write", "unmap", "flush"] {
+                    table.push(row(name.to_string(), op, &nexus["io"][op]));
+                }
+                for child in nexus["children"].as_array().into_iter().flatten()
+                {
+                    let uri = child["uri"].as_str().unwrap_or_default();
+                    table.push(row(format!("  {uri}"), "read", &child["read"]));
+                }
+            }
+            if table.is_empty() {
+                ctx.v1("No Nexus latency histograms found");
+                return Ok(());
+            }
+            ctx.print_list(
+                vec![
+                    "NAME", "OP", "COUNT", "MEAN_US", "P50_US", "P90_US",
+                    "P99_US", "P999_US", "MAX_US",
+                ],
+                table,
+            );
+        }
+    };
+    Ok(())
+}
+
 async fn reset(mut ctx: Context) -> crate::Result<()> {
     ctx.v2("Resetting all metrics");
     let _ = ctx.v1.stats.reset_io_stats(()).await.context(GrpcStatus)?;
@@ -10,9 +10,15 @@ use futures::future::FutureExt;
 use io_engine::{
     bdev::{
         nexus::{
+            read_policy,
+            set_read_policy,
+            ReadPolicy,
+            ENABLE_IO_LOG_PERSISTENCE,
             ENABLE_NEXUS_CHANNEL_DEBUG,
+            ENABLE_NEXUS_INTEGRITY,
             ENABLE_NEXUS_RESET,
             ENABLE_PARTIAL_REBUILD,
+            NEXUS_WRITE_BATCH,
         },
         util::uring,
     },
@@ -81,6 +87,15 @@ fn start_tokio_runtime(args: &MayastorCliArgs) {
         warn!("Partial rebuild is disabled");
     }
 
+    // Enable saving the I/O logs of out-of-sync children on nexus shutdown.
+    if let Ok(v) = std::env::var("NEXUS_PERSIST_IO_LOG") {
+        ENABLE_IO_LOG_PERSISTENCE.store(v == "1", Ordering::SeqCst);
+    }
+
+    if ENABLE_IO_LOG_PERSISTENCE.load(Ordering::SeqCst) {
+        info!("Nexus I/O log persistence is enabled");
+    }
+
     // Enable nexus reset.
     if let Ok(v) = std::env::var("NEXUS_RESET") {
         ENABLE_NEXUS_RESET.store(v == "1", Ordering::SeqCst);
@@ -90,6 +105,38 @@ fn start_tokio_runtime(args: &MayastorCliArgs) {
         warn!("Nexus reset is disabled");
     }
 
+    // Enable integrity checking of the I/O of new nexuses.
+    if let Ok(v) = std::env::var("NEXUS_INTEGRITY") {
+        ENABLE_NEXUS_INTEGRITY.store(v == "1", Ordering::SeqCst);
+    }
+
+    if ENABLE_NEXUS_INTEGRITY.load(Ordering::SeqCst) {
+        info!("Nexus integrity checking is enabled");
+    }
+
+    // Nexus read policy.
+    if let Ok(v) = std::env::var("NEXUS_READ_POLICY") {
+        match v.parse::<ReadPolicy>() {
+            Ok(p) => set_read_policy(p),
+            Err(e) => error!("{e}, keeping the default read policy"),
+        }
+    }
+
+    info!("Nexus read policy is {p}", p = read_policy());
+
+    // Nexus write coalescing.
+    if let Ok(v) = std::env::var("NEXUS_WRITE_BATCH") {
+        match v.parse::<u32>() {
+            Ok(n) => NEXUS_WRITE_BATCH.store(n, Ordering::SeqCst),
+            Err(e) => error!("Bad NEXUS_WRITE_BATCH value '{v}': {e}"),
+        }
+    }
+
+    let n = NEXUS_WRITE_BATCH.load(Ordering::SeqCst);
+    if n > 1 {
+        info!("Nexus write coalescing is enabled: up to {n} writes");
+    }
+
     if args.enable_nexus_channel_debug {
         ENABLE_NEXUS_CHANNEL_DEBUG.store(true, Ordering::SeqCst);
         warn!("Nexus channel debug is enabled");
@@ -100,7 +147,8 @@ fn start_tokio_runtime(args: &MayastorCliArgs) {
 
     // Initialize Lock manager.
     let cfg = ResourceLockManagerConfig::default()
-        .with_subsystem(ProtectedSubsystems::NEXUS, 512);
+        .with_subsystem(ProtectedSubsystems::NEXUS, 512)
+        .with_subsystem(ProtectedSubsystems::REPLICA, 512);
     ResourceLockManager::initialize(cfg);
 
     Mthread::spawn_unaffinitized(move || {
@@ -209,7 +209,7 @@ where
     type Error = CoreError;
     type Output = String;
 
-    /// share the bdev over NVMe-OF TCP
+    /// share the bdev over NVMe-OF TCP, and RDMA if requested
     async fn share_nvmf(
         self: Pin<&mut Self>,
         props: Option<ShareProps>,
@@ -235,7 +235,10 @@ where
             .await
             .context(ShareNvmf {})?;
 
-        subsystem.start().await.context(ShareNvmf {})
+        subsystem
+            .start_with(props.rdma())
+            .await
+            .context(ShareNvmf {})
     }
 
     async fn update_properties<P: Into<Option<UpdateProps>>>(
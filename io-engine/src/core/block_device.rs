@@ -402,6 +402,83 @@ pub trait BlockDeviceHandle {
         cb_arg: IoCompletionCallbackArg,
     ) -> Result<(), CoreError>;
 
+    /// Deallocates the given number of blocks, starting at the given offset.
+    ///
+    /// Operation is performed asynchronously; failure is reported as
+    /// `CoreError::UnmapFailed`.
+    async fn unmap_blocks_async(
+        &self,
+        offset_blocks: u64,
+        num_blocks: u64,
+    ) -> Result<(), CoreError> {
+        let (s, r) = oneshot::channel::<IoCompletionStatus>();
+
+        self.unmap_blocks(
+            offset_blocks,
+            num_blocks,
+            block_device_io_completion,
+            cb_arg(s),
+        )?;
+
+        match r.await.expect("Failed awaiting at unmap_blocks()") {
+            IoCompletionStatus::Success => Ok(()),
+            _ => Err(CoreError::UnmapFailed {
+                offset: offset_blocks,
+                len: num_blocks,
+            }),
+        }
+    }
+
+    /// Zeroes the given number of blocks, starting at the given offset.
+    ///
+    /// Operation is performed asynchronously; failure is reported as
+    /// `CoreError::WriteZeroesFailed`.
+    async fn write_zeroes_async(
+        &self,
+        offset_blocks: u64,
+        num_blocks: u64,
+    ) -> Result<(), CoreError> {
+        let (s, r) = oneshot::channel::<IoCompletionStatus>();
+
+        self.write_zeroes(
+            offset_blocks,
+            num_blocks,
+            block_device_io_completion,
+            cb_arg(s),
+        )?;
+
+        match r.await.expect("Failed awaiting at write_zeroes()") {
+            IoCompletionStatus::Success => Ok(()),
+            _ => Err(CoreError::WriteZeroesFailed {
+                offset: offset_blocks,
+                len: num_blocks,
+            }),
+        }
+    }
+
+    /// Returns the offset of the first allocated block at or after the given
+    /// offset, or the number of blocks of the device if there is none. The
+    /// allocation is the one of the whole device as seen by its readers.
+    ///
+    /// Devices which cannot report their allocation return
+    /// `CoreError::NotSupported`.
+    async fn seek_data(&self, _offset_blocks: u64) -> Result<u64, CoreError> {
+        Err(CoreError::NotSupported {
+            source: Errno::EOPNOTSUPP,
+        })
+    }
+
+    /// Returns the offset of the first unallocated block at or after the
+    /// given offset, or the number of blocks of the device if there is none.
+    ///
+    /// Devices which cannot report their allocation return
+    /// `CoreError::NotSupported`.
+    async fn seek_hole(&self, _offset_blocks: u64) -> Result<u64, CoreError> {
+        Err(CoreError::NotSupported {
+            source: Errno::EOPNOTSUPP,
+        })
+    }
+
     // NVMe only.
 
     /// TODO
@@ -423,6 +500,33 @@ pub trait BlockDeviceHandle {
         params: SnapshotParams,
     ) -> Result<u64, CoreError>;
 
+    /// Returns the transaction ids of the snapshots of the replica behind
+    /// this device, newest first. The id of a snapshot not created by a
+    /// transaction is empty.
+    ///
+    /// Devices which are not replicas return `CoreError::NotSupported`.
+    async fn snapshot_txn_ids(&self) -> Result<Vec<String>, CoreError> {
+        Err(CoreError::NotSupported {
+            source: Errno::EOPNOTSUPP,
+        })
+    }
+
+    /// Returns the map of the blocks written to the replica behind this
+    /// device since its snapshot at the given index of `snapshot_txn_ids()`,
+    /// with one bit per unit of `granularity` blocks, the first unit being
+    /// the lowest bit of the first byte.
+    ///
+    /// Devices which are not replicas return `CoreError::NotSupported`.
+    async fn snapshot_delta(
+        &self,
+        _snapshot_idx: u32,
+        _granularity: u32,
+    ) -> Result<Vec<u8>, CoreError> {
+        Err(CoreError::NotSupported {
+            source: Errno::EOPNOTSUPP,
+        })
+    }
+
     /// TODO
     async fn nvme_resv_register(
         &self,
@@ -43,14 +43,17 @@ async fn dump_self_stack() {
     }
 }
 
-/// Dump detailed diagnostic information for the frozen reactor.
-/// As of now print only basic information about the reactor,
-/// in the future might print stack traces too.
+/// Dump detailed diagnostic information for the frozen reactor: its state,
+/// the section of its poll loop it is stuck in, and the stacks of the
+/// process.
 pub fn diagnose_reactor(reactor: &Reactor) {
+    let (section, running_us) = reactor.poll_section();
     info!(
         core=reactor.core(),
         tid=reactor.tid(),
         state=%reactor.get_state(),
+        section,
+        running_us,
         "Reactor is frozen"
     );
 
@@ -0,0 +1,278 @@
+//!
+//! Per-core DMA buffer arenas.
+//!
+//! Allocating DMA buffers from the SPDK environment goes through its global
+//! heap, which is shared by all cores and slow compared to the I/O it serves.
+//! The arenas keep freed buffers instead, in per-core caches by size class,
+//! and hand them out again to the next allocation of the same size on the
+//! same core without taking any lock. A buffer freed on another core than the
+//! one it was allocated on goes to the cache of the core it is freed on.
+//!
+//! Size classes are the powers of two between 4 KiB and 4 MiB, with 4 KiB
+//! alignment. Other sizes or alignments are allocated and freed directly.
+//! Each core caches at most `DMA_ARENA_CACHE_MB` MiB (64 by default) of
+//! buffers, split evenly between the size classes; buffers freed to a full
+//! cache are released to the environment.
+//!
+//! Buffers drawn from an arena are not zeroed.
+use std::{
+    cell::RefCell,
+    fmt::{Debug, Formatter},
+    ops::{Deref, DerefMut},
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc,
+    },
+};
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+use serde::Serialize;
+use spdk_rs::{DmaBuf, DmaError};
+
+use super::Cores;
+
+/// Size of the smallest size class, as a power of 2.
+const MIN_CLASS_SHIFT: u32 = 12;
+
+/// Number of size classes.
+const NUM_CLASSES: usize = 11;
+
+/// Alignment of the buffers of the size classes.
+const ARENA_ALIGN: u64 = 1 << MIN_CLASS_SHIFT;
+
+/// Bytes of buffers cached per core.
+static CORE_CACHE_BYTES: Lazy<u64> = Lazy::new(|| {
+    std::env::var("DMA_ARENA_CACHE_MB")
+        .ok()
+        .and_then(|s| s.parse::<u64>().ok())
+        .unwrap_or(64)
+        * 1024
+        * 1024
+});
+
+/// Returns the size class of buffers of the given size and alignment, if
+/// any.
+#[inline(always)]
+fn size_class(size: u64, align: u64) -> Option<usize> {
+    if !size.is_power_of_two() || align > ARENA_ALIGN {
+        return None;
+    }
+    let class = size.trailing_zeros().checked_sub(MIN_CLASS_SHIFT)? as usize;
+    (class < NUM_CLASSES).then_some(class)
+}
+
+/// Returns the size of the buffers of the given class.
+#[inline(always)]
+fn class_size(class: usize) -> u64 {
+    1 << (class as u32 + MIN_CLASS_SHIFT)
+}
+
+/// Counters of a size class of a core arena.
+#[derive(Default)]
+struct ClassCounters {
+    /// Allocations served from the cache.
+    hits: AtomicU64,
+    /// Allocations served by the environment.
+    misses: AtomicU64,
+    /// Buffers in the cache.
+    cached: AtomicU64,
+    /// Maximum number of buffers in the cache.
+    cached_max: AtomicU64,
+    /// Buffers released to the environment as the cache was full.
+    released: AtomicU64,
+}
+
+/// Counters of a core arena, readable from any core.
+struct ArenaCounters {
+    core: u32,
+    classes: [ClassCounters; NUM_CLASSES],
+}
+
+/// Counters of the arenas of all cores.
+static ARENAS: Lazy<Mutex<Vec<Arc<ArenaCounters>>>> =
+    Lazy::new(Default::default);
+
+#[allow(clippy::declare_interior_mutable_const)]
+const ZERO: AtomicU64 = AtomicU64::new(0);
+
+/// Buffers of a size class in use, on all cores.
+static IN_USE: [AtomicU64; NUM_CLASSES] = [ZERO; NUM_CLASSES];
+
+/// Maximum number of buffers of a size class in use, on all cores.
+static IN_USE_MAX: [AtomicU64; NUM_CLASSES] = [ZERO; NUM_CLASSES];
+
+/// Arena of a core.
+struct CoreArena {
+    free: [Vec<DmaBuf>; NUM_CLASSES],
+    counters: Arc<ArenaCounters>,
+}
+
+impl CoreArena {
+    fn new() -> Self {
+        let counters = Arc::new(ArenaCounters {
+            core: Cores::current(),
+            classes: Default::default(),
+        });
+        ARENAS.lock().push(counters.clone());
+
+        Self {
+            free: Default::default(),
+            counters,
+        }
+    }
+
+    /// Maximum number of cached buffers of the given class.
+    fn capacity(class: usize) -> usize {
+        (*CORE_CACHE_BYTES / NUM_CLASSES as u64 / class_size(class)).max(1)
+            as usize
+    }
+}
+
+thread_local! {
+    static ARENA: RefCell<CoreArena> = RefCell::new(CoreArena::new());
+}
+
+/// DMA buffer drawn from the arena of a core, and given back to the arena of
+/// the core it is dropped on.
+pub struct DmaArenaBuf {
+    buf: Option<DmaBuf>,
+    class: Option<usize>,
+}
+
+impl Debug for DmaArenaBuf {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        write!(
+            f,
+            "DmaArenaBuf({len} bytes{pooled})",
+            len = self.len(),
+            pooled = if self.class.is_some() { ", pooled" } else { "" }
+        )
+    }
+}
+
+impl Deref for DmaArenaBuf {
+    type Target = DmaBuf;
+
+    fn deref(&self) -> &DmaBuf {
+        self.buf.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for DmaArenaBuf {
+    fn deref_mut(&mut self) -> &mut DmaBuf {
+        self.buf.as_mut().unwrap()
+    }
+}
+
+impl Drop for DmaArenaBuf {
+    fn drop(&mut self) {
+        let (Some(buf), Some(class)) = (self.buf.take(), self.class) else {
+            return;
+        };
+
+        IN_USE[class].fetch_sub(1, Ordering::Relaxed);
+
+        // During thread teardown the buffer is simply freed.
+        let _ = ARENA.try_with(|a| {
+            let mut a = a.borrow_mut();
+            let c = &a.counters.classes[class];
+            if a.free[class].len() >= CoreArena::capacity(class) {
+                c.released.fetch_add(1, Ordering::Relaxed);
+                return;
+            }
+            let n = c.cached.fetch_add(1, Ordering::Relaxed) + 1;
+            c.cached_max.fetch_max(n, Ordering::Relaxed);
+            a.free[class].push(buf);
+        });
+    }
+}
+
+impl DmaArenaBuf {
+    /// Allocates a DMA buffer of the given size and alignment, from the
+    /// arena of the current core if it has a size class for it.
+    pub fn new(size: u64, align: u64) -> Result<Self, DmaError> {
+        let Some(class) = size_class(size, align) else {
+            return Ok(Self {
+                buf: Some(DmaBuf::new(size, align)?),
+                class: None,
+            });
+        };
+
+        let cached = ARENA
+            .try_with(|a| {
+                let mut a = a.borrow_mut();
+                let buf = a.free[class].pop();
+                let c = &a.counters.classes[class];
+                if buf.is_some() {
+                    c.hits.fetch_add(1, Ordering::Relaxed);
+                    c.cached.fetch_sub(1, Ordering::Relaxed);
+                } else {
+                    c.misses.fetch_add(1, Ordering::Relaxed);
+                }
+                buf
+            })
+            .ok()
+            .flatten();
+
+        let buf = match cached {
+            Some(buf) => buf,
+            None => DmaBuf::new(size, ARENA_ALIGN)?,
+        };
+
+        let n = IN_USE[class].fetch_add(1, Ordering::Relaxed) + 1;
+        IN_USE_MAX[class].fetch_max(n, Ordering::Relaxed);
+
+        Ok(Self {
+            buf: Some(buf),
+            class: Some(class),
+        })
+    }
+}
+
+/// Statistics of a size class of the DMA arenas.
+#[derive(Serialize, Debug, Default, Clone)]
+pub struct DmaArenaClassStats {
+    /// Size of the buffers of the class.
+    pub size: u64,
+    /// Buffers in use, on all cores.
+    pub in_use: u64,
+    /// Maximum number of buffers in use, on all cores.
+    pub in_use_max: u64,
+    /// Buffers cached, per core.
+    pub cached: Vec<(u32, u64)>,
+    /// Maximum number of buffers cached, on any core.
+    pub cached_max: u64,
+    /// Allocations served from the caches.
+    pub hits: u64,
+    /// Allocations served by the environment.
+    pub misses: u64,
+    /// Buffers released to the environment as a cache was full.
+    pub released: u64,
+}
+
+/// Returns the statistics of the DMA arenas, by size class.
+pub fn dma_arena_stats() -> Vec<DmaArenaClassStats> {
+    let arenas = ARENAS.lock();
+
+    (0 .. NUM_CLASSES)
+        .map(|class| {
+            let mut s = DmaArenaClassStats {
+                size: class_size(class),
+                in_use: IN_USE[class].load(Ordering::Relaxed),
+                in_use_max: IN_USE_MAX[class].load(Ordering::Relaxed),
+                ..Default::default()
+            };
+            arenas.iter().for_each(|a| {
+                let c = &a.classes[class];
+                s.cached.push((a.core, c.cached.load(Ordering::Relaxed)));
+                s.cached_max =
+                    s.cached_max.max(c.cached_max.load(Ordering::Relaxed));
+                s.hits += c.hits.load(Ordering::Relaxed);
+                s.misses += c.misses.load(Ordering::Relaxed);
+                s.released += c.released.load(Ordering::Relaxed);
+            });
+            s
+        })
+        .collect()
+}
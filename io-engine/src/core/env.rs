@@ -10,7 +10,7 @@ use std::{
         Arc,
         Mutex,
     },
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 use byte_unit::{Byte, ByteUnit};
@@ -69,6 +69,37 @@ use crate::{
     },
 };
 
+/// Duration of a phase of the startup of the io-engine.
+#[derive(Debug, Clone, Serialize)]
+pub struct StartupPhase {
+    /// Name of the phase.
+    pub name: &'static str,
+    /// Duration of the phase, in milliseconds.
+    pub duration_ms: u64,
+}
+
+/// Startup phases completed so far, in order.
+static STARTUP_PHASES: Lazy<Mutex<Vec<StartupPhase>>> =
+    Lazy::new(Default::default);
+
+/// Records the end of a startup phase begun at the given instant, and
+/// returns the instant it ended at.
+fn startup_phase_done(name: &'static str, start: Instant) -> Instant {
+    let now = Instant::now();
+    let duration = now - start;
+    info!("Startup phase '{name}' completed in {duration:?}");
+    STARTUP_PHASES.lock().unwrap().push(StartupPhase {
+        name,
+        duration_ms: duration.as_millis() as u64,
+    });
+    now
+}
+
+/// Returns the durations of the startup phases completed so far.
+pub fn startup_phases() -> Vec<StartupPhase> {
+    STARTUP_PHASES.lock().unwrap().clone()
+}
+
 fn parse_mb(src: &str) -> Result<i32, String> {
     // For compatibility, we check to see if there are no alphabetic characters
     // passed in, if, so we interpret the value to be in MiB which is what the
@@ -786,6 +817,16 @@ impl MayastorEnvironment {
             .map(|s| s.clone())
     }
 
+    /// Returns the NUMA node of the network interface of the NVMF target,
+    /// if it can be found.
+    pub(crate) fn get_nvmf_tgt_numa_node() -> Option<u32> {
+        let addr = nic::parse_ipv4(&Self::get_nvmf_tgt_ip().ok()?).ok()?;
+        nic::find_all_nics()
+            .into_iter()
+            .find(|n| n.inet.addr == Some(addr))
+            .and_then(|n| n.numa_node())
+    }
+
     /// Detects IP address for NVMF target by the interface specified in CLI
     /// arguments.
     fn detect_nvmf_tgt_iface_ip(iface: &str) -> Result<String, String> {
@@ -932,6 +973,8 @@ impl MayastorEnvironment {
 
     /// initialize the core, call this before all else
     pub fn init(mut self) -> Self {
+        let started = Instant::now();
+
         // setup the logger as soon as possible
         self.init_logger();
 
@@ -951,6 +994,7 @@ impl MayastorEnvironment {
 
         // bootstrap DPDK and its magic
         self.initialize_eal();
+        let phase = startup_phase_done("eal", started);
 
         // initialize memory pool for allocating bdev I/O contexts
         bdev_io_ctx_pool_init(self.bdev_io_ctx_pool_size);
@@ -994,6 +1038,7 @@ impl MayastorEnvironment {
         }
 
         info!("All cores locked and loaded!");
+        let phase = startup_phase_done("reactors", phase);
 
         // ensure we are within the context of a spdk thread from here
         Mthread::primary().set_current();
@@ -1013,11 +1058,14 @@ impl MayastorEnvironment {
 
             assert!(receiver.await.unwrap());
         });
+        let phase = startup_phase_done("subsystems", phase);
 
         // load any pools that need to be created
         if let Some(config) = pool_config {
             config.import_pools();
+            startup_phase_done("pools", phase);
         }
+        startup_phase_done("init", started);
 
         self
     }
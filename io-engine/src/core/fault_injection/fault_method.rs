@@ -127,6 +127,9 @@ impl FaultMethod {
             "status-submit-write" => IoCompletionStatus::IoSubmissionError(
                 IoSubmissionFailure::Write,
             ),
+            "status-submit-nomem" => IoCompletionStatus::IoSubmissionError(
+                IoSubmissionFailure::NoMem,
+            ),
             "status-admin" => IoCompletionStatus::AdminCommandError,
             _ => return None,
         };
@@ -4,7 +4,7 @@ use nix::errno::Errno;
 use once_cell::sync::OnceCell;
 use std::sync::atomic::{AtomicBool, Ordering};
 
-use crate::core::{CoreError, IoCompletionStatus};
+use crate::core::{CoreError, IoCompletionStatus, IoSubmissionFailure};
 
 use super::{
     add_bdev_io_injection,
@@ -110,7 +110,8 @@ pub fn list_fault_injections() -> Vec<Injection> {
 
 /// Finds and injects a fault for the given I/O context, at the submission I/O
 /// stage. In the case a fault is injected, returns the corresponding
-/// `CoreError`.
+/// `CoreError`: an ENOMEM submission failure for `status-submit-nomem`
+/// faults, and ENXIO for other ones.
 #[inline]
 pub fn inject_submission_error(ctx: &InjectIoCtx) -> Result<(), CoreError> {
     if !injections_enabled() || !ctx.is_valid() {
@@ -120,9 +121,14 @@ pub fn inject_submission_error(ctx: &InjectIoCtx) -> Result<(), CoreError> {
     match Injections::get().inject(FaultIoStage::Submission, ctx) {
         None => Ok(()),
         Some(IoCompletionStatus::Success) => Ok(()),
-        Some(_) => Err(crate::bdev::device::io_type_to_err(
+        Some(status) => Err(crate::bdev::device::io_type_to_err(
             ctx.io_type,
-            Errno::ENXIO,
+            match status {
+                IoCompletionStatus::IoSubmissionError(
+                    IoSubmissionFailure::NoMem,
+                ) => Errno::ENOMEM,
+                _ => Errno::ENXIO,
+            },
             ctx.range.start,
             ctx.range.end - ctx.range.start,
         )),
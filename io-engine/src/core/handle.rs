@@ -16,6 +16,7 @@ use spdk_rs::{
         spdk_bdev_nvme_admin_passthru_ro,
         spdk_bdev_read,
         spdk_bdev_reset,
+        spdk_bdev_unmap,
         spdk_bdev_write,
         spdk_bdev_write_zeroes,
         spdk_io_channel,
@@ -274,6 +275,42 @@ impl<T: BdevOps> BdevHandle<T> {
         }
     }
 
+    /// Unmaps `len` bytes at the given byte offset.
+    pub async fn unmap_at(
+        &self,
+        offset: u64,
+        len: u64,
+    ) -> Result<(), CoreError> {
+        let (s, r) = oneshot::channel::<NvmeStatus>();
+        let errno = unsafe {
+            spdk_bdev_unmap(
+                self.desc.legacy_as_ptr(),
+                self.channel.legacy_as_ptr(),
+                offset,
+                len,
+                Some(Self::io_completion_cb),
+                cb_arg(s),
+            )
+        };
+
+        if errno != 0 {
+            return Err(CoreError::UnmapDispatch {
+                source: Errno::from_i32(errno.abs()),
+                offset,
+                len,
+            });
+        }
+
+        if r.await.expect("Failed awaiting unmap IO").is_success() {
+            Ok(())
+        } else {
+            Err(CoreError::UnmapFailed {
+                offset,
+                len,
+            })
+        }
+    }
+
     /// create a snapshot, only works for nvme bdev
     /// returns snapshot time as u64 seconds since Unix epoch
     pub async fn create_snapshot(
@@ -0,0 +1,295 @@
+//!
+//! Log-linear latency histograms.
+//!
+//! Values are bucketed by their power of two, and every power of two is
+//! split into `SUB_BUCKETS` linear sub-buckets, which bounds the relative
+//! error of a reported percentile by 1 / `SUB_BUCKETS` over the whole `u64`
+//! range with a fixed, small number of buckets.
+//!
+//! A histogram is not synchronized: it is meant to be recorded from a single
+//! reactor (e.g. per I/O channel), and merged with histograms of other
+//! reactors on demand.
+use serde::Serialize;
+
+/// Number of bits of a value kept below its most significant bit.
+const SUB_BUCKET_BITS: u32 = 3;
+
+/// Number of linear sub-buckets per power of two.
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+
+/// Total number of buckets needed to cover the `u64` range.
+const BUCKETS: usize = (u64::BITS - SUB_BUCKET_BITS + 1) as usize * SUB_BUCKETS;
+
+/// Returns the index of the bucket the given value belongs to.
+#[inline(always)]
+fn bucket_index(v: u64) -> usize {
+    if v < SUB_BUCKETS as u64 {
+        return v as usize;
+    }
+    let msb = u64::BITS - 1 - v.leading_zeros();
+    let shift = msb - SUB_BUCKET_BITS;
+    let sub = (v >> shift) as usize & (SUB_BUCKETS - 1);
+    (shift as usize + 1) * SUB_BUCKETS + sub
+}
+
+/// Returns the highest value that belongs to the bucket with the given index.
+fn bucket_upper_bound(idx: usize) -> u64 {
+    if idx < SUB_BUCKETS {
+        return idx as u64;
+    }
+    let shift = (idx / SUB_BUCKETS - 1) as u32;
+    let sub = (idx % SUB_BUCKETS) as u64;
+    let low = (SUB_BUCKETS as u64 + sub) << shift;
+    low + ((1u64 << shift) - 1)
+}
+
+/// Log-linear histogram of latencies, in ticks.
+#[derive(Clone)]
+pub struct LatencyHistogram {
+    /// Number of samples per bucket.
+    buckets: Box<[u64; BUCKETS]>,
+    /// Total number of samples.
+    count: u64,
+    /// Sum of all samples.
+    sum: u64,
+    /// Lowest sample.
+    min: u64,
+    /// Highest sample.
+    max: u64,
+}
+
+impl std::fmt::Debug for LatencyHistogram {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("LatencyHistogram")
+            .field("count", &self.count)
+            .field("min", &self.min())
+            .field("max", &self.max)
+            .finish()
+    }
+}
+
+impl Default for LatencyHistogram {
+    fn default() -> Self {
+        Self {
+            buckets: Box::new([0; BUCKETS]),
+            count: 0,
+            sum: 0,
+            min: u64::MAX,
+            max: 0,
+        }
+    }
+}
+
+impl LatencyHistogram {
+    /// Records a sample.
+    #[inline(always)]
+    pub fn record(&mut self, ticks: u64) {
+        self.buckets[bucket_index(ticks)] += 1;
+        self.count += 1;
+        self.sum = self.sum.wrapping_add(ticks);
+        self.min = self.min.min(ticks);
+        self.max = self.max.max(ticks);
+    }
+
+    /// Adds all samples of another histogram to this one.
+    pub fn merge(&mut self, other: &LatencyHistogram) {
+        if other.count == 0 {
+            return;
+        }
+        self.buckets
+            .iter_mut()
+            .zip(other.buckets.iter())
+            .for_each(|(b, o)| *b += *o);
+        self.count += other.count;
+        self.sum = self.sum.wrapping_add(other.sum);
+        self.min = self.min.min(other.min);
+        self.max = self.max.max(other.max);
+    }
+
+    /// Removes all samples.
+    pub fn reset(&mut self) {
+        *self = Self::default();
+    }
+
+    /// Total number of samples.
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+
+    /// Lowest sample, or zero if there are none.
+    pub fn min(&self) -> u64 {
+        if self.count == 0 {
+            0
+        } else {
+            self.min
+        }
+    }
+
+    /// Highest sample.
+    pub fn max(&self) -> u64 {
+        self.max
+    }
+
+    /// Mean of all samples.
+    pub fn mean(&self) -> u64 {
+        if self.count == 0 {
+            0
+        } else {
+            self.sum / self.count
+        }
+    }
+
+    /// Returns the value below or at which the given fraction (0.0 to 1.0)
+    /// of the samples fall. The value is the upper bound of its bucket,
+    /// capped by the highest sample.
+    pub fn percentile(&self, q: f64) -> u64 {
+        if self.count == 0 {
+            return 0;
+        }
+        let rank = ((q * self.count as f64).ceil() as u64).clamp(1, self.count);
+        let mut seen = 0;
+        for (idx, n) in self.buckets.iter().enumerate() {
+            seen += n;
+            if seen >= rank {
+                return bucket_upper_bound(idx).min(self.max);
+            }
+        }
+        self.max
+    }
+
+    /// Iterates over the non-empty buckets, yielding their upper bounds and
+    /// numbers of samples.
+    pub fn buckets(&self) -> impl Iterator<Item = (u64, u64)> + '_ {
+        self.buckets
+            .iter()
+            .enumerate()
+            .filter(|(_, n)| **n > 0)
+            .map(|(idx, n)| (bucket_upper_bound(idx), *n))
+    }
+
+    /// Returns a summary of this histogram, with latencies converted to
+    /// microseconds using the given tick rate.
+    pub fn summary(&self, tick_rate: u64) -> LatencySummary {
+        let us = |ticks: u64| -> u64 {
+            (ticks as u128 * 1_000_000 / tick_rate.max(1) as u128) as u64
+        };
+        LatencySummary {
+            count: self.count,
+            min_us: us(self.min()),
+            mean_us: us(self.mean()),
+            max_us: us(self.max),
+            p50_us: us(self.percentile(0.5)),
+            p90_us: us(self.percentile(0.9)),
+            p99_us: us(self.percentile(0.99)),
+            p999_us: us(self.percentile(0.999)),
+            buckets: self.buckets().map(|(ub, n)| (us(ub), n)).collect(),
+        }
+    }
+}
+
+/// Summary of a latency histogram, in microseconds.
+#[derive(Debug, Clone, Serialize)]
+pub struct LatencySummary {
+    /// Number of samples.
+    pub count: u64,
+    /// Lowest latency.
+    pub min_us: u64,
+    /// Mean latency.
+    pub mean_us: u64,
+    /// Highest latency.
+    pub max_us: u64,
+    /// Median latency.
+    pub p50_us: u64,
+    /// 90th percentile.
+    pub p90_us: u64,
+    /// 99th percentile.
+    pub p99_us: u64,
+    /// 99.9th percentile.
+    pub p999_us: u64,
+    /// Non-empty buckets: upper bound of the bucket, and number of samples.
+    pub buckets: Vec<(u64, u64)>,
+}
+
+/// Latency histograms of the I/O types tracked separately.
+#[derive(Debug, Clone, Default)]
+pub struct IoLatencyHistograms {
+    pub read: LatencyHistogram,
+    pub write: LatencyHistogram,
+    pub unmap: LatencyHistogram,
+    pub flush: LatencyHistogram,
+}
+
+impl IoLatencyHistograms {
+    /// Adds all samples of other histograms to these ones.
+    pub fn merge(&mut self, other: &IoLatencyHistograms) {
+        self.read.merge(&other.read);
+        self.write.merge(&other.write);
+        self.unmap.merge(&other.unmap);
+        self.flush.merge(&other.flush);
+    }
+
+    /// Removes all samples.
+    pub fn reset(&mut self) {
+        self.read.reset();
+        self.write.reset();
+        self.unmap.reset();
+        self.flush.reset();
+    }
+
+    /// Returns summaries of these histograms, in microseconds.
+    pub fn summary(&self, tick_rate: u64) -> IoLatencySummary {
+        IoLatencySummary {
+            read: self.read.summary(tick_rate),
+            write: self.write.summary(tick_rate),
+            unmap: self.unmap.summary(tick_rate),
+            flush: self.flush.summary(tick_rate),
+        }
+    }
+}
+
+/// Summaries of per I/O type latency histograms.
+#[derive(Debug, Clone, Serialize)]
+pub struct IoLatencySummary {
+    pub read: LatencySummary,
+    pub write: LatencySummary,
+    pub unmap: LatencySummary,
+    pub flush: LatencySummary,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn bucket_bounds() {
+        for v in (0 .. 4096).chain([u64::MAX / 3, u64::MAX - 1, u64::MAX]) {
+            let idx = bucket_index(v);
+            assert!(idx < BUCKETS);
+            assert!(v <= bucket_upper_bound(idx));
+            if idx > 0 {
+                assert!(v > bucket_upper_bound(idx - 1));
+            }
+        }
+    }
+
+    #[test]
+    fn percentiles() {
+        let mut h = LatencyHistogram::default();
+        (1 ..= 1000).for_each(|v| h.record(v));
+
+        assert_eq!(h.count(), 1000);
+        assert_eq!(h.min(), 1);
+        assert_eq!(h.max(), 1000);
+        for (q, exact) in [(0.5, 500u64), (0.99, 990), (0.999, 999)] {
+            let p = h.percentile(q);
+            assert!(p >= exact && p <= exact + exact / SUB_BUCKETS as u64);
+        }
+
+        let mut m = LatencyHistogram::default();
+        m.record(5000);
+        m.merge(&h);
+        assert_eq!(m.count(), 1001);
+        assert_eq!(m.max(), 5000);
+        assert_eq!(m.percentile(1.0), 5000);
+    }
+}
@@ -36,15 +36,24 @@ pub use device_monitor::{
     device_monitor_loop,
     DeviceCommand,
 };
+pub use dma_arena::{dma_arena_stats, DmaArenaBuf, DmaArenaClassStats};
 pub use env::{
     mayastor_env_stop,
+    startup_phases,
     MayastorCliArgs,
     MayastorEnvironment,
+    StartupPhase,
     GLOBAL_RC,
     SIG_RECEIVED,
 };
 pub use handle::{BdevHandle, UntypedBdevHandle};
 pub use io_device::IoDevice;
+pub use latency_histogram::{
+    IoLatencyHistograms,
+    IoLatencySummary,
+    LatencyHistogram,
+    LatencySummary,
+};
 pub use logical_volume::LogicalVolume;
 pub use reactor::{
     reactor_monitor_loop,
@@ -53,6 +62,12 @@ pub use reactor::{
     Reactors,
     REACTOR_LIST,
 };
+pub use reactor_stats::{
+    PollSectionStats,
+    ReactorPollStats,
+    SlowIteration,
+    ThreadPollStats,
+};
 
 pub use lock::{
     ProtectedSubsystems,
@@ -66,6 +81,7 @@ pub use runtime::spawn;
 pub(crate) use segment_map::SegmentMap;
 pub use share::{Protocol, PtplProps, Share, ShareProps, UpdateProps};
 pub use spdk_rs::{cpu_cores, IoStatus, IoType, NvmeStatus};
+pub use stats_shm::{StatsShmKind, StatsShmSlot};
 pub use thread::Mthread;
 
 use crate::subsys::NvmfError;
@@ -86,21 +102,26 @@ mod descriptor;
 mod device_events;
 mod device_monitor;
 pub mod diagnostics;
+mod dma_arena;
 mod env;
 pub mod fault_injection;
 mod handle;
 mod io_device;
 pub mod io_driver;
+mod latency_histogram;
 pub mod lock;
 pub mod logical_volume;
 pub mod mempool;
+mod mpsc_ring;
 mod nic;
 pub mod partition;
 mod reactor;
+mod reactor_stats;
 pub mod runtime;
 pub mod segment_map;
 mod share;
 pub mod snapshot;
+mod stats_shm;
 pub(crate) mod thread;
 pub(crate) mod wiper;
 mod work_queue;
@@ -216,6 +237,15 @@ pub enum CoreError {
         offset: u64,
         len: u64,
     },
+    #[snafu(display(
+        "Failed to dispatch seek at offset {}: {}",
+        offset,
+        source
+    ))]
+    SeekDispatch {
+        source: Errno,
+        offset: u64,
+    },
     #[snafu(display(
         "Failed to dispatch NVMe IO passthru command {:x}h: {}",
         opcode,
@@ -278,6 +308,15 @@ pub enum CoreError {
         offset: u64,
         len: u64,
     },
+    #[snafu(display("Unmap failed at offset {} length {}", offset, len))]
+    UnmapFailed {
+        offset: u64,
+        len: u64,
+    },
+    #[snafu(display("Seek failed at offset {}", offset))]
+    SeekFailed {
+        offset: u64,
+    },
     #[snafu(display("NVMe Admin command {:x}h failed: {}", opcode, source))]
     NvmeAdminFailed {
         source: Errno,
@@ -389,6 +428,9 @@ impl ToErrno for CoreError {
             Self::WriteZeroesDispatch {
                 source, ..
             } => source,
+            Self::SeekDispatch {
+                source, ..
+            } => source,
             Self::NvmeIoPassthruDispatch {
                 source, ..
             } => source,
@@ -410,6 +452,12 @@ impl ToErrno for CoreError {
             | Self::WriteZeroesFailed {
                 ..
             }
+            | Self::UnmapFailed {
+                ..
+            }
+            | Self::SeekFailed {
+                ..
+            }
             | Self::NvmeIoPassthruFailed {
                 ..
             }
@@ -456,6 +504,47 @@ impl ToErrno for CoreError {
     }
 }
 
+impl CoreError {
+    /// Determines if this error is an I/O dispatch failure caused by a
+    /// transient lack of resources (ENOMEM), after which the I/O can be
+    /// submitted again once resources are freed.
+    pub fn is_enomem(&self) -> bool {
+        match self {
+            Self::ReadDispatch {
+                source, ..
+            }
+            | Self::WriteDispatch {
+                source, ..
+            }
+            | Self::CompareDispatch {
+                source, ..
+            }
+            | Self::ResetDispatch {
+                source, ..
+            }
+            | Self::FlushDispatch {
+                source, ..
+            }
+            | Self::UnmapDispatch {
+                source, ..
+            }
+            | Self::WriteZeroesDispatch {
+                source, ..
+            }
+            | Self::NvmeAdminDispatch {
+                source, ..
+            }
+            | Self::SeekDispatch {
+                source, ..
+            }
+            | Self::NvmeIoPassthruDispatch {
+                source, ..
+            } => *source == Errno::ENOMEM,
+            _ => false,
+        }
+    }
+}
+
 /// Logical volume layer failure.
 #[derive(Debug, Copy, Clone, Eq, PartialOrd, PartialEq)]
 #[repr(C)]
@@ -468,6 +557,8 @@ pub enum LvolFailure {
 pub enum IoSubmissionFailure {
     Read,
     Write,
+    /// Submission failed for lack of resources (ENOMEM).
+    NoMem,
 }
 
 // Generic I/O completion status for block devices, which supports per-protocol
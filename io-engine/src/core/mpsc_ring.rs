@@ -0,0 +1,361 @@
+//!
+//! Lock-free multi-producer queues used to hand work over to a reactor.
+//!
+//! `MpscRing` is a bounded ring of preallocated slots, after Dmitry Vyukov's
+//! bounded queue: every slot carries a sequence number telling whether it is
+//! free for the producer whose turn it is, or holds a value for the consumer.
+//! Producers claim a position with a single compare-and-swap on the tail, and
+//! the head and tail sit on separate cache lines, so that producers on other
+//! cores and the consumer do not bounce a shared line on every operation.
+//!
+//! `MpscQueue` puts an unbounded overflow queue behind a ring, for the
+//! callers which cannot fail or retry when the ring is full.
+use std::{
+    cell::UnsafeCell,
+    fmt::{Debug, Formatter},
+    mem::MaybeUninit,
+    sync::atomic::{AtomicUsize, Ordering},
+};
+
+use crossbeam::{queue::SegQueue, utils::CachePadded};
+
+/// A ring slot.
+struct Slot<T> {
+    /// Sequence number: equals the position of the slot when it is free for
+    /// a push at that position, and the position plus one once it holds the
+    /// value pushed at that position.
+    seq: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+/// Outcome of an attempt to pop from a ring.
+enum Pop<T> {
+    /// The oldest value.
+    Value(T),
+    /// Nothing was pushed.
+    Empty,
+    /// The oldest slot has been claimed by a producer which has not written
+    /// its value yet.
+    Pending,
+}
+
+/// Bounded lock-free queue with preallocated slots.
+///
+/// Any number of threads may push. Pops are expected to come from a single
+/// thread (e.g. the reactor owning the ring); they remain safe otherwise, at
+/// the cost of an uncontended compare-and-swap.
+pub struct MpscRing<T> {
+    /// Next position to pop from.
+    head: CachePadded<AtomicUsize>,
+    /// Next position to push to.
+    tail: CachePadded<AtomicUsize>,
+    slots: Box<[Slot<T>]>,
+    /// Capacity minus one; the capacity is a power of two.
+    mask: usize,
+}
+
+unsafe impl<T: Send> Send for MpscRing<T> {}
+unsafe impl<T: Send> Sync for MpscRing<T> {}
+
+impl<T> Debug for MpscRing<T> {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("MpscRing")
+            .field("capacity", &self.capacity())
+            .field("len", &self.len())
+            .finish()
+    }
+}
+
+impl<T> MpscRing<T> {
+    /// Creates a new ring with at least the given capacity, rounded up to a
+    /// power of two.
+    pub fn new(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        let slots = (0 .. capacity)
+            .map(|i| Slot {
+                seq: AtomicUsize::new(i),
+                value: UnsafeCell::new(MaybeUninit::uninit()),
+            })
+            .collect::<Vec<_>>()
+            .into_boxed_slice();
+
+        Self {
+            head: CachePadded::new(AtomicUsize::new(0)),
+            tail: CachePadded::new(AtomicUsize::new(0)),
+            slots,
+            mask: capacity - 1,
+        }
+    }
+
+    /// Capacity of the ring.
+    pub fn capacity(&self) -> usize {
+        self.mask + 1
+    }
+
+    /// Approximate number of values in the ring.
+    pub fn len(&self) -> usize {
+        let tail = self.tail.load(Ordering::Relaxed);
+        let head = self.head.load(Ordering::Relaxed);
+        tail.wrapping_sub(head).min(self.capacity())
+    }
+
+    /// True if the ring is (approximately) empty.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Pushes a value, or gives it back if the ring is full.
+    pub fn push(&self, value: T) -> Result<(), T> {
+        let mut pos = self.tail.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            let diff = seq.wrapping_sub(pos) as isize;
+
+            if diff == 0 {
+                match self.tail.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.seq.store(pos.wrapping_add(1), Ordering::Release);
+                        return Ok(());
+                    }
+                    Err(p) => pos = p,
+                }
+            } else if diff < 0 {
+                // The slot still holds the value pushed one lap ago.
+                return Err(value);
+            } else {
+                // Another producer took this position.
+                pos = self.tail.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Pops the oldest value, if any.
+    pub fn pop(&self) -> Option<T> {
+        match self.try_pop() {
+            Pop::Value(value) => Some(value),
+            Pop::Empty | Pop::Pending => None,
+        }
+    }
+
+    /// Pops the oldest value, telling an empty ring apart from a ring whose
+    /// oldest slot is still being written.
+    fn try_pop(&self) -> Pop<T> {
+        let mut pos = self.head.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            let diff = seq.wrapping_sub(pos.wrapping_add(1)) as isize;
+
+            if diff == 0 {
+                match self.head.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        let value =
+                            unsafe { (*slot.value.get()).assume_init_read() };
+                        slot.seq.store(
+                            pos.wrapping_add(self.capacity()),
+                            Ordering::Release,
+                        );
+                        return Pop::Value(value);
+                    }
+                    Err(p) => pos = p,
+                }
+            } else if diff < 0 {
+                // Empty, unless a producer has already claimed this position
+                // but not finished writing it.
+                return if self.tail.load(Ordering::Acquire) == pos {
+                    Pop::Empty
+                } else {
+                    Pop::Pending
+                };
+            } else {
+                pos = self.head.load(Ordering::Relaxed);
+            }
+        }
+    }
+}
+
+impl<T> Drop for MpscRing<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
+    }
+}
+
+/// Unbounded lock-free queue: a preallocated `MpscRing`, with an overflow
+/// queue used only while the ring is full.
+///
+/// Once a value has overflowed, producers keep pushing to the overflow queue
+/// until the consumer has drained it, so that values pushed by the same
+/// thread are popped in the same order.
+pub struct MpscQueue<T> {
+    ring: MpscRing<T>,
+    overflow: SegQueue<T>,
+    /// Number of values in the overflow queue.
+    overflowed: CachePadded<AtomicUsize>,
+}
+
+impl<T> Debug for MpscQueue<T> {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("MpscQueue")
+            .field("ring", &self.ring)
+            .field("overflowed", &self.overflowed.load(Ordering::Relaxed))
+            .finish()
+    }
+}
+
+impl<T> MpscQueue<T> {
+    /// Creates a new queue, with a ring of at least the given capacity.
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            ring: MpscRing::new(capacity),
+            overflow: SegQueue::new(),
+            overflowed: CachePadded::new(AtomicUsize::new(0)),
+        }
+    }
+
+    /// Pushes a value.
+    pub fn push(&self, value: T) {
+        let value = if self.overflowed.load(Ordering::Acquire) == 0 {
+            match self.ring.push(value) {
+                Ok(()) => return,
+                Err(value) => value,
+            }
+        } else {
+            value
+        };
+
+        self.overflowed.fetch_add(1, Ordering::AcqRel);
+        self.overflow.push(value);
+    }
+
+    /// Pops the oldest value, if any. Values of the ring are older than the
+    /// ones of the overflow queue, which is only popped once the ring is
+    /// empty: while the oldest slot of the ring is still being written,
+    /// nothing is popped and the caller retries later.
+    pub fn pop(&self) -> Option<T> {
+        match self.ring.try_pop() {
+            Pop::Value(value) => return Some(value),
+            Pop::Pending => return None,
+            Pop::Empty => {}
+        }
+        let value = self.overflow.pop()?;
+        self.overflowed.fetch_sub(1, Ordering::AcqRel);
+        Some(value)
+    }
+
+    /// Pops up to `max` values, passing them to the given function, and
+    /// returns the number of popped values.
+    pub fn drain<F>(&self, max: usize, mut f: F) -> usize
+    where
+        F: FnMut(T),
+    {
+        let mut n = 0;
+        while n < max {
+            match self.pop() {
+                Some(value) => f(value),
+                None => break,
+            }
+            n += 1;
+        }
+        n
+    }
+
+    /// Approximate number of values in the queue.
+    pub fn len(&self) -> usize {
+        self.ring.len() + self.overflowed.load(Ordering::Relaxed)
+    }
+
+    /// True if the queue is (approximately) empty.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    #[test]
+    fn ring_bounds() {
+        let ring = MpscRing::new(3);
+        assert_eq!(ring.capacity(), 4);
+        for i in 0 .. 4 {
+            ring.push(i).unwrap();
+        }
+        assert_eq!(ring.push(4), Err(4));
+        assert_eq!(ring.len(), 4);
+
+        for lap in 0 .. 3 {
+            for i in 0 .. 4 {
+                assert_eq!(ring.pop(), Some(lap * 4 + i));
+                ring.push((lap + 1) * 4 + i).unwrap();
+            }
+        }
+        (12 .. 16).for_each(|i| assert_eq!(ring.pop(), Some(i)));
+        assert_eq!(ring.pop(), None);
+    }
+
+    #[test]
+    fn queue_overflow_with_pending_push() {
+        let queue = MpscQueue::new(4);
+
+        // A producer claims the first slot, and is preempted before writing
+        // its value.
+        let pos = queue.ring.tail.fetch_add(1, Ordering::Relaxed);
+
+        // Another producer fills the ring and overflows.
+        (1 .. 5).for_each(|i| queue.push(i));
+        assert_eq!(queue.overflowed.load(Ordering::Relaxed), 1);
+
+        // The overflowed value must not be popped ahead of the ring values.
+        assert_eq!(queue.pop(), None);
+
+        // The first producer completes its push.
+        let slot = &queue.ring.slots[pos & queue.ring.mask];
+        unsafe { (*slot.value.get()).write(0) };
+        slot.seq.store(pos + 1, Ordering::Release);
+
+        (0 .. 5).for_each(|i| assert_eq!(queue.pop(), Some(i)));
+        assert_eq!(queue.pop(), None);
+        assert!(queue.is_empty());
+    }
+
+    #[test]
+    fn queue_per_producer_order() {
+        const PRODUCERS: usize = 4;
+        const VALUES: usize = 10_000;
+
+        let queue = Arc::new(MpscQueue::new(64));
+        let producers = (0 .. PRODUCERS)
+            .map(|p| {
+                let queue = queue.clone();
+                std::thread::spawn(move || {
+                    (0 .. VALUES).for_each(|v| queue.push((p, v)))
+                })
+            })
+            .collect::<Vec<_>>();
+
+        let mut next = [0; PRODUCERS];
+        let mut received = 0;
+        while received < PRODUCERS * VALUES {
+            received += queue.drain(16, |(p, v)| {
+                assert_eq!(next[p], v);
+                next[p] += 1;
+            });
+        }
+        producers.into_iter().for_each(|p| p.join().unwrap());
+        assert!(queue.is_empty());
+    }
+}
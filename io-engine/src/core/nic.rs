@@ -152,6 +152,21 @@ impl Interface {
 
         Ipv4Addr::from(subnet) == net_addr
     }
+
+    /// Returns the NUMA node of the device of this interface, if it is known.
+    /// Virtual interfaces have no device, and the kernel reports -1 when the
+    /// platform does not tell the node of a device.
+    pub fn numa_node(&self) -> Option<u32> {
+        std::fs::read_to_string(format!(
+            "/sys/class/net/{}/device/numa_node",
+            self.name
+        ))
+        .ok()?
+        .trim()
+        .parse::<i32>()
+        .ok()
+        .and_then(|n| u32::try_from(n).ok())
+    }
 }
 fn ipv4addr_to_libc(addr: Ipv4Addr) -> libc::in_addr {
     let octets = addr.octets();
@@ -37,6 +37,7 @@ use std::{
     os::raw::c_void,
     pin::Pin,
     slice::Iter,
+    sync::Arc,
     time::Duration,
 };
 
@@ -57,13 +58,24 @@ use spdk_rs::libspdk::{
     spdk_thread_get_cpumask,
     spdk_thread_lib_init_ext,
     spdk_thread_op,
+    spdk_thread_poll,
     spdk_thread_send_msg,
     SPDK_DEFAULT_MSG_MEMPOOL_SIZE,
     SPDK_THREAD_OP_NEW,
 };
 
 use crate::{
-    core::{CoreError, Cores},
+    core::{
+        mpsc_ring::MpscQueue,
+        reactor_stats::{
+            Iteration,
+            ReactorPollStats,
+            ReactorStats,
+            ThreadCounters,
+        },
+        CoreError,
+        Cores,
+    },
     eventing::Event,
 };
 use gettid::gettid;
@@ -100,6 +112,12 @@ unsafe impl Send for Reactor {}
 
 pub static REACTOR_LIST: OnceCell<Reactors> = OnceCell::new();
 
+/// Number of preallocated slots of the queue of futures sent to a reactor;
+/// futures sent while it is full are queued to an unbounded overflow queue.
+const REACTOR_FUTURE_SLOTS: usize = 1024;
+/// Maximum number of futures received by a reactor per poll.
+const REACTOR_FUTURE_BATCH: usize = 128;
+
 // TODO: we only have one "type" of core however, only the master core deals
 // with futures we can TODO: should consider creating two variants of the
 // Reactor: master and remote
@@ -110,8 +128,8 @@ pub struct Reactor {
     /// Vector of threads allocated by the various subsystems. The threads are
     /// protected by a RefCell to avoid, at runtime, mutating the vector.
     /// This, ideally, we don't want to do but considering the unsafety we
-    /// keep it for now
-    threads: RefCell<VecDeque<spdk_rs::Thread>>,
+    /// keep it for now. Every thread comes with its poll counters.
+    threads: RefCell<VecDeque<(spdk_rs::Thread, Arc<ThreadCounters>)>>,
     /// incoming threads that have been scheduled to this core but are not
     /// polled yet
     incoming: crossbeam::queue::SegQueue<spdk_rs::Thread>,
@@ -121,10 +139,11 @@ pub struct Reactor {
     flags: Cell<ReactorState>,
     /// Unique identifier of the thread on which reactor is running.
     tid: Cell<u64>,
-    /// sender and Receiver for sending futures across cores without going
+    /// lock-free queue for sending futures across cores without going
     /// through FFI
-    sx: Sender<Pin<Box<dyn Future<Output = ()> + 'static>>>,
-    rx: Receiver<Pin<Box<dyn Future<Output = ()> + 'static>>>,
+    futures: MpscQueue<Pin<Box<dyn Future<Output = ()> + 'static>>>,
+    /// statistics of the poll loop
+    stats: ReactorStats,
 }
 
 thread_local! {
@@ -283,18 +302,14 @@ impl<'a> IntoIterator for &'a Reactors {
 impl Reactor {
     /// create a new ['Reactor'] instance
     fn new(core: u32) -> Self {
-        // create a channel to receive futures on
-        let (sx, rx) =
-            unbounded::<Pin<Box<dyn Future<Output = ()> + 'static>>>();
-
         Self {
             threads: RefCell::new(VecDeque::new()),
             incoming: crossbeam::queue::SegQueue::new(),
             lcore: core,
             flags: Cell::new(ReactorState::Init),
             tid: Cell::new(0),
-            sx,
-            rx,
+            futures: MpscQueue::new(REACTOR_FUTURE_SLOTS),
+            stats: ReactorStats::new(),
         }
     }
 
@@ -318,20 +333,23 @@ impl Reactor {
         0
     }
 
-    /// run the futures received on the channel
-    fn run_futures(&self) {
+    /// run the futures received on the channel, and return how many ran
+    fn run_futures(&self) -> usize {
         QUEUE.with(|(_, r)| {
-            r.try_iter().for_each(|f| {
+            r.try_iter().fold(0, |n, f| {
                 f.run();
+                n + 1
             })
-        });
+        })
     }
 
-    /// receive futures if any
-    fn receive_futures(&self) {
-        self.rx.try_iter().for_each(|m| {
+    /// receive futures if any, at most `REACTOR_FUTURE_BATCH` per call so
+    /// that a burst of messages does not starve the threads of this reactor,
+    /// and return how many were received
+    fn receive_futures(&self) -> usize {
+        self.futures.drain(REACTOR_FUTURE_BATCH, |m| {
             self.spawn_local(m).detach();
-        });
+        })
     }
 
     /// send messages to the core/thread -- similar as spdk_thread_send_msg()
@@ -339,7 +357,7 @@ impl Reactor {
     where
         F: Future<Output = ()> + 'static,
     {
-        self.sx.send(Box::pin(future)).unwrap();
+        self.futures.push(Box::pin(future));
     }
 
     /// spawn a future locally on this core; note that you can *not* use the
@@ -444,6 +462,19 @@ impl Reactor {
         self.tid.get()
     }
 
+    /// Returns the statistics of the poll loop of this reactor. They can be
+    /// read from any core, including while the reactor is stuck.
+    pub fn poll_stats(&self) -> ReactorPollStats {
+        self.stats.snapshot(self.lcore)
+    }
+
+    /// Returns the section of the poll loop being run, futures or an SPDK
+    /// thread, and for how long the current iteration has been running, in
+    /// microseconds.
+    pub fn poll_section(&self) -> (String, u64) {
+        self.stats.current()
+    }
+
     /// poll this reactor to complete any work that is pending
     pub fn poll_reactor(&self) {
         // Initialize TID for this reactor.
@@ -481,14 +512,14 @@ impl Reactor {
     /// now
     #[inline]
     pub fn poll_once(&self) {
-        self.receive_futures();
-        self.run_futures();
-        let threads = self.threads.borrow();
-        threads.iter().for_each(|t| {
-            t.poll();
-        });
+        let mut it = Iteration::start(&self.stats);
 
-        drop(threads);
+        it.enter_futures();
+        let n = self.receive_futures() + self.run_futures();
+        it.futures_done(n > 0);
+
+        self.poll_threads(&mut it);
+        it.finish();
 
         self.add_incoming();
     }
@@ -499,24 +530,34 @@ impl Reactor {
     /// We might want to set a flag that we need to run futures and or incoming
     /// queues
     pub fn poll_times(&self, times: u32) {
-        let threads = self.threads.borrow();
+        let mut it = Iteration::start(&self.stats);
         for _ in 0 .. times {
-            threads.iter().for_each(|t| {
-                t.poll();
-            });
+            self.poll_threads(&mut it);
         }
 
-        self.receive_futures();
-        self.run_futures();
-
-        drop(threads);
+        it.enter_futures();
+        let n = self.receive_futures() + self.run_futures();
+        it.futures_done(n > 0);
+        it.finish();
 
         self.add_incoming();
     }
 
+    /// poll all threads once, accounting the time spent in each of them
+    #[inline]
+    fn poll_threads(&self, it: &mut Iteration) {
+        let threads = self.threads.borrow();
+        for (t, counters) in threads.iter() {
+            it.enter_thread(counters);
+            let rc = unsafe { spdk_thread_poll(t.as_ptr(), 0, 0) };
+            it.thread_done(counters, rc > 0);
+        }
+    }
+
     fn add_incoming(&self) {
         while let Some(i) = self.incoming.pop() {
-            self.threads.borrow_mut().push_back(i);
+            let counters = self.stats.add_thread(i.id(), i.name().to_string());
+            self.threads.borrow_mut().push_back((i, counters));
         }
     }
 
@@ -525,7 +566,7 @@ impl Reactor {
         let mut removed = Vec::new();
 
         {
-            self.threads.borrow_mut().retain(|t| {
+            self.threads.borrow_mut().retain(|(t, _)| {
                 if t.is_exited() {
                     removed.push(*t);
                     false
@@ -541,6 +582,7 @@ impl Reactor {
                 Cores::current(),
                 t.name()
             );
+            self.stats.remove_thread(t.id());
             t.destroy();
         });
     }
@@ -651,7 +693,9 @@ impl Future for &'static Reactor {
                 );
 
                 {
-                    while let Some(t) = self.threads.borrow_mut().pop_front() {
+                    while let Some((t, _)) =
+                        self.threads.borrow_mut().pop_front()
+                    {
                         t.wait_exit();
                         t.destroy();
                     }
@@ -0,0 +1,440 @@
+//!
+//! Reactor poll loop statistics.
+//!
+//! Each reactor accounts, in ticks, the time spent in every iteration of its
+//! poll loop, split between the execution of its futures and the polling of
+//! each of its SPDK threads, whose pollers are the nvmf and nvme poll groups,
+//! the bdev channels, rebuild tasks etc. An iteration, or a section of it, is
+//! busy when it did some work, and idle otherwise. The durations of the
+//! iterations are also recorded into a power of two histogram.
+//!
+//! All counters have a single writer, their reactor, and are atomics: they
+//! are read from any core without involving the reactor, which therefore
+//! remains observable while it is stuck. For the same reason, a reactor
+//! publishes the section it is running and since when.
+//!
+//! When `REACTOR_TRACE_US` is set, iterations longer than that many
+//! microseconds are also recorded, with their slowest section, into a ring of
+//! the last `TRACE_LEN` slow iterations of the reactor. Entries are written
+//! without synchronization with readers: a trace read while the reactor
+//! records a slow iteration may contain a partially written entry.
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    Arc,
+};
+
+use parking_lot::Mutex;
+use serde::Serialize;
+use spdk_rs::libspdk::{spdk_get_ticks, spdk_get_ticks_hz};
+
+/// Number of buckets of the histogram of iteration durations.
+const HIST_BUCKETS: usize = 64;
+
+/// Number of entries of the trace of slow iterations.
+const TRACE_LEN: usize = 256;
+
+/// Section id of the futures of a reactor. SPDK thread ids start at 1.
+const FUTURES_SECTION: u64 = 0;
+
+#[allow(clippy::declare_interior_mutable_const)]
+const ZERO: AtomicU64 = AtomicU64::new(0);
+
+/// Returns the current tick.
+#[inline(always)]
+fn ticks() -> u64 {
+    unsafe { spdk_get_ticks() }
+}
+
+/// Single writer addition.
+#[inline(always)]
+fn add(c: &AtomicU64, v: u64) {
+    c.store(c.load(Ordering::Relaxed).wrapping_add(v), Ordering::Relaxed);
+}
+
+/// Busy and idle counters of a section of the poll loop.
+#[derive(Debug, Default)]
+struct SectionCounters {
+    busy_polls: AtomicU64,
+    idle_polls: AtomicU64,
+    busy_ticks: AtomicU64,
+    idle_ticks: AtomicU64,
+}
+
+impl SectionCounters {
+    #[inline(always)]
+    fn account(&self, busy: bool, ticks: u64) {
+        if busy {
+            add(&self.busy_polls, 1);
+            add(&self.busy_ticks, ticks);
+        } else {
+            add(&self.idle_polls, 1);
+            add(&self.idle_ticks, ticks);
+        }
+    }
+
+    fn stats(&self, tick_rate: u64) -> PollSectionStats {
+        let busy_us = us(self.busy_ticks.load(Ordering::Relaxed), tick_rate);
+        let idle_us = us(self.idle_ticks.load(Ordering::Relaxed), tick_rate);
+        PollSectionStats {
+            busy_polls: self.busy_polls.load(Ordering::Relaxed),
+            idle_polls: self.idle_polls.load(Ordering::Relaxed),
+            busy_us,
+            idle_us,
+            busy_ratio: if busy_us + idle_us == 0 {
+                0.0
+            } else {
+                busy_us as f64 / (busy_us + idle_us) as f64
+            },
+        }
+    }
+}
+
+/// Counters of an SPDK thread polled by a reactor.
+#[derive(Debug)]
+pub(crate) struct ThreadCounters {
+    id: u64,
+    name: String,
+    counters: SectionCounters,
+}
+
+/// Slow iteration of a reactor.
+#[derive(Debug)]
+struct TraceEntry {
+    /// Tick the iteration started at.
+    start: AtomicU64,
+    /// Duration of the iteration, in ticks.
+    ticks: AtomicU64,
+    /// Slowest section of the iteration.
+    section: AtomicU64,
+    /// Duration of the slowest section, in ticks.
+    section_ticks: AtomicU64,
+}
+
+/// Statistics of the poll loop of a reactor.
+#[derive(Debug)]
+pub(crate) struct ReactorStats {
+    /// Whole iterations.
+    iterations: SectionCounters,
+    /// Futures received and run.
+    futures: SectionCounters,
+    /// SPDK threads of the reactor.
+    threads: Mutex<Vec<Arc<ThreadCounters>>>,
+    /// Number of iterations per duration, by power of two of ticks.
+    histogram: [AtomicU64; HIST_BUCKETS],
+    /// Tick the current iteration started at.
+    iteration_start: AtomicU64,
+    /// Section being run.
+    section: AtomicU64,
+    /// Minimum duration of the traced iterations, in ticks, or zero if the
+    /// trace is disabled.
+    trace_ticks: u64,
+    /// Ring of slow iterations.
+    trace: Box<[TraceEntry]>,
+    /// Number of slow iterations recorded.
+    trace_head: AtomicU64,
+}
+
+impl ReactorStats {
+    pub(crate) fn new() -> Self {
+        let trace_ticks = std::env::var("REACTOR_TRACE_US")
+            .ok()
+            .and_then(|s| s.parse::<u64>().ok())
+            .map_or(0, |t| t * unsafe { spdk_get_ticks_hz() } / 1_000_000);
+        let trace_len = if trace_ticks > 0 { TRACE_LEN } else { 0 };
+
+        Self {
+            iterations: Default::default(),
+            futures: Default::default(),
+            threads: Default::default(),
+            histogram: [ZERO; HIST_BUCKETS],
+            iteration_start: ZERO,
+            section: ZERO,
+            trace_ticks,
+            trace: (0 .. trace_len)
+                .map(|_| TraceEntry {
+                    start: ZERO,
+                    ticks: ZERO,
+                    section: ZERO,
+                    section_ticks: ZERO,
+                })
+                .collect(),
+            trace_head: ZERO,
+        }
+    }
+
+    /// Adds the counters of a new SPDK thread of the reactor.
+    pub(crate) fn add_thread(
+        &self,
+        id: u64,
+        name: String,
+    ) -> Arc<ThreadCounters> {
+        let t = Arc::new(ThreadCounters {
+            id,
+            name,
+            counters: Default::default(),
+        });
+        self.threads.lock().push(t.clone());
+        t
+    }
+
+    /// Removes the counters of a destroyed SPDK thread.
+    pub(crate) fn remove_thread(&self, id: u64) {
+        self.threads.lock().retain(|t| t.id != id);
+    }
+
+    /// Returns the name of a section.
+    fn section_name(&self, id: u64) -> String {
+        if id == FUTURES_SECTION {
+            return "futures".to_string();
+        }
+        self.threads
+            .lock()
+            .iter()
+            .find(|t| t.id == id)
+            .map_or_else(|| format!("thread #{id}"), |t| t.name.clone())
+    }
+
+    /// Returns the section being run, and for how long the current iteration
+    /// has been running, in microseconds.
+    pub(crate) fn current(&self) -> (String, u64) {
+        let start = self.iteration_start.load(Ordering::Relaxed);
+        (
+            self.section_name(self.section.load(Ordering::Relaxed)),
+            us(ticks().saturating_sub(start), unsafe {
+                spdk_get_ticks_hz()
+            }),
+        )
+    }
+
+    /// Returns a snapshot of the statistics, for the given core.
+    pub(crate) fn snapshot(&self, core: u32) -> ReactorPollStats {
+        let tick_rate = unsafe { spdk_get_ticks_hz() };
+        let now = ticks();
+        let (section, running_us) = self.current();
+
+        let histogram = self
+            .histogram
+            .iter()
+            .enumerate()
+            .map(|(b, n)| (b, n.load(Ordering::Relaxed)))
+            .filter(|(_, n)| *n > 0)
+            .map(|(b, n)| (us(bucket_upper_bound(b), tick_rate), n))
+            .collect();
+
+        let head = self.trace_head.load(Ordering::Acquire);
+        let trace = (head.saturating_sub(self.trace.len() as u64) .. head)
+            .rev()
+            .map(|i| {
+                let e = &self.trace[i as usize % self.trace.len()];
+                SlowIteration {
+                    age_us: us(
+                        now.saturating_sub(e.start.load(Ordering::Relaxed)),
+                        tick_rate,
+                    ),
+                    duration_us: us(e.ticks.load(Ordering::Relaxed), tick_rate),
+                    section: self
+                        .section_name(e.section.load(Ordering::Relaxed)),
+                    section_us: us(
+                        e.section_ticks.load(Ordering::Relaxed),
+                        tick_rate,
+                    ),
+                }
+            })
+            .collect();
+
+        ReactorPollStats {
+            core,
+            iterations: self.iterations.stats(tick_rate),
+            futures: self.futures.stats(tick_rate),
+            threads: self
+                .threads
+                .lock()
+                .iter()
+                .map(|t| ThreadPollStats {
+                    id: t.id,
+                    name: t.name.clone(),
+                    stats: t.counters.stats(tick_rate),
+                })
+                .collect(),
+            histogram,
+            section,
+            running_us,
+            slow_iterations: head,
+            trace,
+        }
+    }
+}
+
+/// Converts ticks to microseconds.
+#[inline(always)]
+fn us(ticks: u64, tick_rate: u64) -> u64 {
+    (ticks as u128 * 1_000_000 / tick_rate.max(1) as u128) as u64
+}
+
+/// Returns the bucket of the histogram of a duration in ticks.
+#[inline(always)]
+fn bucket(ticks: u64) -> usize {
+    (u64::BITS - ticks.leading_zeros()).min(HIST_BUCKETS as u32 - 1) as usize
+}
+
+/// Returns the highest duration of a bucket, in ticks.
+fn bucket_upper_bound(b: usize) -> u64 {
+    if b >= HIST_BUCKETS - 1 {
+        u64::MAX
+    } else {
+        (1u64 << b) - 1
+    }
+}
+
+/// Accounting of an iteration of the poll loop of a reactor.
+pub(crate) struct Iteration<'a> {
+    stats: &'a ReactorStats,
+    start: u64,
+    /// Tick the running section started at.
+    last: u64,
+    busy: bool,
+    slowest: u64,
+    slowest_ticks: u64,
+}
+
+impl<'a> Iteration<'a> {
+    /// Starts accounting an iteration.
+    #[inline(always)]
+    pub(crate) fn start(stats: &'a ReactorStats) -> Self {
+        let start = ticks();
+        stats.iteration_start.store(start, Ordering::Relaxed);
+        Self {
+            stats,
+            start,
+            last: start,
+            busy: false,
+            slowest: FUTURES_SECTION,
+            slowest_ticks: 0,
+        }
+    }
+
+    #[inline(always)]
+    fn end_section(
+        &mut self,
+        counters: &SectionCounters,
+        section: u64,
+        busy: bool,
+    ) {
+        let now = ticks();
+        let t = now - self.last;
+        counters.account(busy, t);
+        self.busy |= busy;
+        if t > self.slowest_ticks {
+            self.slowest = section;
+            self.slowest_ticks = t;
+        }
+        self.last = now;
+    }
+
+    /// Marks the futures as being run.
+    #[inline(always)]
+    pub(crate) fn enter_futures(&self) {
+        self.stats.section.store(FUTURES_SECTION, Ordering::Relaxed);
+    }
+
+    /// Ends running the futures.
+    #[inline(always)]
+    pub(crate) fn futures_done(&mut self, busy: bool) {
+        let stats = self.stats;
+        self.end_section(&stats.futures, FUTURES_SECTION, busy);
+    }
+
+    /// Marks the given SPDK thread as being polled.
+    #[inline(always)]
+    pub(crate) fn enter_thread(&self, thread: &ThreadCounters) {
+        self.stats.section.store(thread.id, Ordering::Relaxed);
+    }
+
+    /// Ends polling the given SPDK thread.
+    #[inline(always)]
+    pub(crate) fn thread_done(&mut self, thread: &ThreadCounters, busy: bool) {
+        self.end_section(&thread.counters, thread.id, busy);
+    }
+
+    /// Ends the iteration.
+    #[inline(always)]
+    pub(crate) fn finish(self) {
+        let stats = self.stats;
+        let t = self.last - self.start;
+        stats.iterations.account(self.busy, t);
+        add(&stats.histogram[bucket(t)], 1);
+
+        if stats.trace_ticks > 0 && t >= stats.trace_ticks {
+            let head = stats.trace_head.load(Ordering::Relaxed);
+            let e = &stats.trace[head as usize % stats.trace.len()];
+            e.start.store(self.start, Ordering::Relaxed);
+            e.ticks.store(t, Ordering::Relaxed);
+            e.section.store(self.slowest, Ordering::Relaxed);
+            e.section_ticks.store(self.slowest_ticks, Ordering::Relaxed);
+            stats.trace_head.store(head + 1, Ordering::Release);
+        }
+    }
+}
+
+/// Busy and idle statistics of a section of the poll loop.
+#[derive(Debug, Clone, Serialize)]
+pub struct PollSectionStats {
+    /// Number of polls that did some work.
+    pub busy_polls: u64,
+    /// Number of polls that did nothing.
+    pub idle_polls: u64,
+    /// Time spent in busy polls.
+    pub busy_us: u64,
+    /// Time spent in idle polls.
+    pub idle_us: u64,
+    /// Fraction of the time spent in busy polls.
+    pub busy_ratio: f64,
+}
+
+/// Poll statistics of an SPDK thread.
+#[derive(Debug, Clone, Serialize)]
+pub struct ThreadPollStats {
+    /// Id of the SPDK thread.
+    pub id: u64,
+    /// Name of the SPDK thread.
+    pub name: String,
+    #[serde(flatten)]
+    pub stats: PollSectionStats,
+}
+
+/// Iteration of the poll loop longer than the trace threshold.
+#[derive(Debug, Clone, Serialize)]
+pub struct SlowIteration {
+    /// Time elapsed since the iteration started.
+    pub age_us: u64,
+    /// Duration of the iteration.
+    pub duration_us: u64,
+    /// Slowest section of the iteration: "futures", or an SPDK thread.
+    pub section: String,
+    /// Duration of the slowest section.
+    pub section_us: u64,
+}
+
+/// Poll loop statistics of a reactor.
+#[derive(Debug, Clone, Serialize)]
+pub struct ReactorPollStats {
+    /// Core of the reactor.
+    pub core: u32,
+    /// Whole iterations of the poll loop.
+    pub iterations: PollSectionStats,
+    /// Futures run by the reactor.
+    pub futures: PollSectionStats,
+    /// SPDK threads polled by the reactor.
+    pub threads: Vec<ThreadPollStats>,
+    /// Non-empty buckets of the histogram of iteration durations: upper
+    /// bound of the bucket, in microseconds, and number of iterations.
+    pub histogram: Vec<(u64, u64)>,
+    /// Section being run.
+    pub section: String,
+    /// Time elapsed since the current iteration started.
+    pub running_us: u64,
+    /// Number of slow iterations recorded.
+    pub slow_iterations: u64,
+    /// Last slow iterations, most recent first.
+    pub trace: Vec<SlowIteration>,
+}
@@ -1,4 +1,3 @@
-use bit_vec::{BitBlock, BitVec};
 use std::fmt::{Debug, Formatter};
 
 // Returns ceil of an integer division.
@@ -6,14 +5,81 @@ fn div_ceil(a: u64, b: u64) -> u64 {
     (a + b - 1) / b
 }
 
+/// Number of 64-bit words in a leaf bitmap.
+const LEAF_WORDS: usize = 64;
+
+/// Number of segments covered by a single leaf bitmap.
+const LEAF_SEGS: usize = LEAF_WORDS * u64::BITS as usize;
+
+/// Leaf bitmap of a contiguous range of `LEAF_SEGS` segments.
+#[derive(Clone)]
+struct Leaf {
+    /// Segment bits: zeros indicate clean segments, ones mark dirty ones.
+    words: [u64; LEAF_WORDS],
+    /// Number of dirty segments in this leaf.
+    dirty: u32,
+}
+
+impl Leaf {
+    fn new() -> Box<Self> {
+        Box::new(Self {
+            words: [0; LEAF_WORDS],
+            dirty: 0,
+        })
+    }
+
+    /// Sets bits `first ..= last` of this leaf to the given value.
+    /// Returns the change of the number of dirty segments.
+    fn set_range(&mut self, first: usize, last: usize, value: bool) -> i64 {
+        let before = self.dirty;
+        let (first_word, last_word) = (first / 64, last / 64);
+        for w in first_word ..= last_word {
+            let lo = if w == first_word { first % 64 } else { 0 };
+            let hi = if w == last_word { last % 64 } else { 63 };
+            let mask = (u64::MAX >> (63 - hi)) & (u64::MAX << lo);
+
+            let old = self.words[w];
+            let new = if value { old | mask } else { old & !mask };
+            self.words[w] = new;
+            self.dirty = self.dirty + new.count_ones() - old.count_ones();
+        }
+        self.dirty as i64 - before as i64
+    }
+
+    /// Returns the value of the given bit.
+    fn get(&self, bit: usize) -> bool {
+        self.words[bit / 64] & (1 << (bit % 64)) != 0
+    }
+
+    /// Merges (bitwise OR) this leaf with another.
+    /// Returns the change of the number of dirty segments.
+    fn merge(&mut self, other: &Leaf) -> i64 {
+        let before = self.dirty;
+        let mut dirty = 0;
+        for (w, o) in self.words.iter_mut().zip(other.words.iter()) {
+            *w |= *o;
+            dirty += w.count_ones();
+        }
+        self.dirty = dirty;
+        self.dirty as i64 - before as i64
+    }
+}
+
 /// Map of rebuild segments of a block device.
 /// It marks every segment as a clean (no need to rebuild, or already
 /// transferred), or dirty (need to transfer from a healthy device).
+///
+/// The map is two-level: the device is split into ranges of `LEAF_SEGS`
+/// segments, and a leaf bitmap is only allocated for ranges containing dirty
+/// segments. A clean map thus costs one pointer per range regardless of the
+/// device size, merging visits non-empty leaves only, and dirty segments can
+/// be iterated without scanning the clean ranges.
 #[derive(Clone)]
-pub struct SegmentMap<B: BitBlock = u32> {
-    /// Bitmap of rebuild segments of a device. Zeros indicate clean segments,
-    /// ones mark dirty ones.
-    segments: BitVec<B>,
+pub struct SegmentMap {
+    /// Leaf bitmaps; `None` for ranges without dirty segments.
+    leaves: Vec<Option<Box<Leaf>>>,
+    /// Total number of dirty segments.
+    dirty: u64,
     /// Device size in segments.
     num_segments: u64,
     /// Device size in blocks.
@@ -24,7 +90,7 @@ pub struct SegmentMap<B: BitBlock = u32> {
     segment_size: u64,
 }
 
-impl<B: BitBlock> Debug for SegmentMap<B> {
+impl Debug for SegmentMap {
     fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
         write!(
             f,
@@ -37,14 +103,14 @@ impl<B: BitBlock> Debug for SegmentMap<B> {
     }
 }
 
-impl<B: BitBlock> SegmentMap<B> {
+impl SegmentMap {
     /// Creates a new segment map with the given parameters.
     pub fn new(num_blocks: u64, block_len: u64, segment_size: u64) -> Self {
         let num_segments = div_ceil(num_blocks * block_len, segment_size);
-        let mut segments = BitVec::<B>::default();
-        segments.grow(num_segments as usize, false);
+        let num_leaves = div_ceil(num_segments, LEAF_SEGS as u64) as usize;
         Self {
-            segments,
+            leaves: vec![None; num_leaves],
+            dirty: 0,
             num_segments,
             num_blocks,
             block_len,
@@ -53,8 +119,24 @@ impl<B: BitBlock> SegmentMap<B> {
     }
 
     /// Merges (bitwise OR) this map with another.
-    pub(crate) fn merge(mut self, other: &SegmentMap<B>) -> Self {
-        self.segments.or(&other.segments);
+    pub(crate) fn merge(mut self, other: &SegmentMap) -> Self {
+        assert_eq!(self.num_segments, other.num_segments);
+
+        for (leaf, other_leaf) in self.leaves.iter_mut().zip(&other.leaves) {
+            let Some(other_leaf) = other_leaf else {
+                continue;
+            };
+            match leaf {
+                Some(leaf) => {
+                    self.dirty =
+                        (self.dirty as i64 + leaf.merge(other_leaf)) as u64;
+                }
+                None => {
+                    self.dirty += other_leaf.dirty as u64;
+                    *leaf = Some(other_leaf.clone());
+                }
+            }
+        }
         self
     }
 
@@ -66,15 +148,45 @@ impl<B: BitBlock> SegmentMap<B> {
         let start_seg = self.lbn_to_seg(lbn);
         // when `lbn_cnt` is 1 means we write only the `lbn` blk, not `lbn` + 1
         let end_seg = self.lbn_to_seg(lbn + lbn_cnt - 1);
-        for i in start_seg ..= end_seg {
-            self.segments.set(i, value);
+        assert!(
+            (end_seg as u64) < self.num_segments,
+            "segment {end_seg} is out of range ({})",
+            self.num_segments
+        );
+
+        for idx in start_seg / LEAF_SEGS ..= end_seg / LEAF_SEGS {
+            let base = idx * LEAF_SEGS;
+            let first = start_seg.max(base) - base;
+            let last = end_seg.min(base + LEAF_SEGS - 1) - base;
+
+            let slot = &mut self.leaves[idx];
+            if slot.is_none() {
+                if !value {
+                    continue;
+                }
+                *slot = Some(Leaf::new());
+            }
+
+            let leaf = slot.as_mut().unwrap();
+            self.dirty =
+                (self.dirty as i64 + leaf.set_range(first, last, value)) as u64;
+            if leaf.dirty == 0 {
+                *slot = None;
+            }
         }
     }
 
     /// Returns value of segment bit corresponding to the given logical block.
     pub fn get(&self, lbn: u64) -> Option<bool> {
         let seg = self.lbn_to_seg(lbn);
-        self.segments.get(seg)
+        if seg as u64 >= self.num_segments {
+            return None;
+        }
+        Some(
+            self.leaves[seg / LEAF_SEGS]
+                .as_ref()
+                .map_or(false, |leaf| leaf.get(seg % LEAF_SEGS)),
+        )
     }
 
     /// Calculates the index of segment corresponding to the given logical
@@ -85,7 +197,7 @@ impl<B: BitBlock> SegmentMap<B> {
 
     /// Counts the total number of bits set to one.
     fn count_ones(&self) -> u64 {
-        self.segments.iter().filter(|i| *i).count() as u64
+        self.dirty
     }
 
     /// Counts the total number of dirty blocks.
@@ -102,10 +214,85 @@ impl<B: BitBlock> SegmentMap<B> {
     pub(crate) fn size_blks(&self) -> u64 {
         self.num_blocks
     }
+
+    /// Get the size of block in bytes.
+    pub(crate) fn block_len(&self) -> u64 {
+        self.block_len
+    }
+
+    /// Returns the dirty extents of the map, as pairs of first block and
+    /// number of blocks, adjacent dirty segments being coalesced.
+    pub fn dirty_extents(&self) -> Vec<(u64, u64)> {
+        let mut extents: Vec<(u64, u64)> = Vec::new();
+        let seg_blks = self.segment_size_blks();
+
+        for blk in self.clone().into_dirty_blks() {
+            let len = seg_blks.min(self.num_blocks - blk);
+            match extents.last_mut() {
+                Some((start, cnt)) if *start + *cnt == blk => *cnt += len,
+                _ => extents.push((blk, len)),
+            }
+        }
+
+        extents
+    }
+
+    /// Consumes the map and returns an iterator over the first logical blocks
+    /// of its dirty segments, in ascending order.
+    pub(crate) fn into_dirty_blks(self) -> IntoDirtyBlks {
+        IntoDirtyBlks {
+            segment_size_blks: self.segment_size_blks(),
+            leaves: self.leaves.into_iter().enumerate(),
+            leaf: None,
+            word: 0,
+            bits: 0,
+        }
+    }
+}
+
+/// Iterator over the first logical blocks of the dirty segments of a
+/// `SegmentMap`. Clean ranges without a leaf bitmap are skipped at once,
+/// and clean words of a leaf cost a single comparison.
+pub(crate) struct IntoDirtyBlks {
+    /// Remaining leaves of the map.
+    leaves: std::iter::Enumerate<std::vec::IntoIter<Option<Box<Leaf>>>>,
+    /// Index and bitmap of the current leaf.
+    leaf: Option<(usize, Box<Leaf>)>,
+    /// Index of the current word within the current leaf.
+    word: usize,
+    /// Bits of the current word which are yet to be yielded.
+    bits: u64,
+    /// Segment size in blocks.
+    segment_size_blks: u64,
 }
 
-impl From<SegmentMap> for BitVec {
-    fn from(value: SegmentMap) -> Self {
-        value.segments
+impl Iterator for IntoDirtyBlks {
+    type Item = u64;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        loop {
+            if let Some((idx, leaf)) = &self.leaf {
+                if self.bits != 0 {
+                    let bit = self.bits.trailing_zeros() as usize;
+                    self.bits &= self.bits - 1;
+                    let seg = idx * LEAF_SEGS + self.word * 64 + bit;
+                    return Some(seg as u64 * self.segment_size_blks);
+                }
+
+                if self.word + 1 < LEAF_WORDS {
+                    self.word += 1;
+                    self.bits = leaf.words[self.word];
+                    continue;
+                }
+            }
+
+            let (idx, leaf) = self
+                .leaves
+                .by_ref()
+                .find_map(|(idx, leaf)| leaf.map(|leaf| (idx, leaf)))?;
+            self.word = 0;
+            self.bits = leaf.words[0];
+            self.leaf = Some((idx, leaf));
+        }
     }
 }
@@ -69,6 +69,8 @@ pub struct ShareProps {
     allowed_hosts: Vec<String>,
     /// Persistent-Power-Loss settings.
     ptpl: Option<PtplProps>,
+    /// Listen over RDMA as well, if the target has the RDMA transport.
+    rdma: bool,
 }
 impl ShareProps {
     /// Returns a new `Self`.
@@ -93,6 +95,12 @@ impl ShareProps {
         self.ptpl = ptpl.into();
         self
     }
+    /// Modify the RDMA listener.
+    #[must_use]
+    pub fn with_rdma(mut self, rdma: bool) -> Self {
+        self.rdma = rdma;
+        self
+    }
     /// Get the controller id range.
     pub fn cntlid_range(&self) -> Option<(u16, u16)> {
         self.cntlid_range
@@ -119,6 +127,10 @@ impl ShareProps {
     pub fn ptpl(&self) -> &Option<PtplProps> {
         &self.ptpl
     }
+    /// Get the RDMA listener.
+    pub fn rdma(&self) -> bool {
+        self.rdma
+    }
 }
 impl From<Option<ShareProps>> for ShareProps {
     fn from(opts: Option<ShareProps>) -> Self {
@@ -0,0 +1,324 @@
+//!
+//! Shared memory export of I/O statistics.
+//!
+//! Polling I/O statistics over gRPC crosses to the reactors for every
+//! request, which shows up as reactor latency when thousands of volumes are
+//! scraped every few seconds. Instead, I/O channels can own records of a
+//! memory-mapped file, updated by their reactor as their I/Os complete. An
+//! exporter maps the same file read-only and reads the records without any
+//! RPC or reactor involvement.
+//!
+//! The export is enabled by setting `IO_STATS_SHM_PATH` to the path of the
+//! file to create, typically under `/dev/shm`. `IO_STATS_SHM_RECORDS` sets
+//! the number of records of the file (16384 by default). Channels created
+//! while all records are in use are not exported.
+//!
+//! # Layout
+//!
+//! All fields are in native byte order. The file starts with a
+//! `StatsShmHeader`, followed by `num_records` records of `record_size`
+//! bytes, each laid out as a `StatsShmRecord`. A record is in use when its
+//! kind is not zero. Each record accounts the I/Os of one object, nexus or
+//! nexus child, on one core: the statistics of an object are the sum of all
+//! its records. Latencies are in ticks, at the tick rate of the header.
+//!
+//! # Reading a record
+//!
+//! Every record has a single writer, and is protected by a sequence lock.
+//! A consistent snapshot of a record is obtained by:
+//! 1. loading `seq`, and retrying later if it is odd;
+//! 2. copying the record;
+//! 3. issuing an acquire fence and loading `seq` again: the copy is valid if it
+//!    did not change, otherwise the read is retried.
+use std::{
+    cell::UnsafeCell,
+    fs::OpenOptions,
+    mem::size_of,
+    os::fd::AsRawFd,
+    ptr::NonNull,
+    sync::atomic::{fence, AtomicU32, AtomicU64, Ordering},
+};
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+use spdk_rs::libspdk::spdk_get_ticks_hz;
+
+use super::IoType;
+
+/// Magic number of the statistics file.
+const SHM_MAGIC: u64 = u64::from_le_bytes(*b"IOESTATS");
+
+/// Version of the layout of the statistics file.
+const SHM_VERSION: u32 = 1;
+
+/// Maximum length of the name of an object, in bytes.
+const NAME_LEN: usize = 128;
+
+/// Header of the statistics file.
+#[repr(C)]
+pub struct StatsShmHeader {
+    /// `SHM_MAGIC`.
+    pub magic: u64,
+    /// `SHM_VERSION`.
+    pub version: u32,
+    /// Size of a record, in bytes.
+    pub record_size: u32,
+    /// Number of records following the header.
+    pub num_records: u32,
+    /// Reserved.
+    pub reserved: u32,
+    /// Rate of the ticks of the latencies, per second.
+    pub tick_rate: u64,
+    /// PID of the io-engine writing the file.
+    pub pid: u64,
+}
+
+/// Kind of the object of a record.
+#[derive(Debug, Copy, Clone, Eq, PartialEq)]
+#[repr(u32)]
+pub enum StatsShmKind {
+    /// Nexus, named by its name.
+    Nexus = 1,
+    /// NVMe nexus child, named by its device name.
+    NvmeChild = 2,
+}
+
+/// Statistics record of an object on one core.
+#[repr(C)]
+pub struct StatsShmRecord {
+    /// Sequence lock, odd while the record is being written.
+    pub seq: AtomicU64,
+    /// Kind of the object, as a `StatsShmKind`, or zero if the record is not
+    /// in use.
+    pub kind: AtomicU32,
+    /// Core the record is written on.
+    pub core: AtomicU32,
+    /// Name of the object, NUL padded. Written only when the record is
+    /// taken into use.
+    pub name: UnsafeCell<[u8; NAME_LEN]>,
+    pub num_read_ops: AtomicU64,
+    pub num_write_ops: AtomicU64,
+    pub num_unmap_ops: AtomicU64,
+    pub bytes_read: AtomicU64,
+    pub bytes_written: AtomicU64,
+    pub bytes_unmapped: AtomicU64,
+    pub read_latency_ticks: AtomicU64,
+    pub write_latency_ticks: AtomicU64,
+    pub unmap_latency_ticks: AtomicU64,
+    /// Reserved, for the record size to remain a power of 2.
+    pub reserved: [AtomicU64; 5],
+}
+
+const _: () = assert!(size_of::<StatsShmRecord>() == 256);
+
+/// Memory-mapped statistics file.
+struct StatsShm {
+    records: NonNull<StatsShmRecord>,
+    /// Indexes of the free records.
+    free: Mutex<Vec<u32>>,
+}
+
+// Records are written by their owner only, and the free list is locked.
+unsafe impl Send for StatsShm {}
+unsafe impl Sync for StatsShm {}
+
+impl StatsShm {
+    /// Creates and maps the statistics file, if enabled.
+    fn open() -> Option<Self> {
+        let path = std::env::var("IO_STATS_SHM_PATH").ok()?;
+        let num_records = std::env::var("IO_STATS_SHM_RECORDS")
+            .ok()
+            .and_then(|s| s.parse::<u32>().ok())
+            .unwrap_or(16384)
+            .max(1);
+
+        match Self::create(&path, num_records) {
+            Ok(shm) => {
+                info!(
+                    "Exporting I/O statistics to '{path}' \
+                    ({num_records} records)"
+                );
+                Some(shm)
+            }
+            Err(e) => {
+                error!("Failed to create I/O statistics file '{path}': {e}");
+                None
+            }
+        }
+    }
+
+    fn create(path: &str, num_records: u32) -> std::io::Result<Self> {
+        let len = size_of::<StatsShmHeader>()
+            + num_records as usize * size_of::<StatsShmRecord>();
+
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(true)
+            .open(path)?;
+        file.set_len(len as u64)?;
+
+        let base = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            return Err(std::io::Error::last_os_error());
+        }
+
+        // The file is zero filled: all records are free. The header is
+        // written last, for readers to recognize a complete file.
+        unsafe {
+            let hdr = base as *mut StatsShmHeader;
+            std::ptr::write_volatile(
+                hdr,
+                StatsShmHeader {
+                    magic: 0,
+                    version: SHM_VERSION,
+                    record_size: size_of::<StatsShmRecord>() as u32,
+                    num_records,
+                    reserved: 0,
+                    tick_rate: spdk_get_ticks_hz(),
+                    pid: std::process::id() as u64,
+                },
+            );
+            fence(Ordering::Release);
+            std::ptr::write_volatile(
+                std::ptr::addr_of_mut!((*hdr).magic),
+                SHM_MAGIC,
+            );
+        }
+
+        let records = unsafe {
+            (base as *mut u8).add(size_of::<StatsShmHeader>())
+                as *mut StatsShmRecord
+        };
+
+        Ok(Self {
+            records: NonNull::new(records).unwrap(),
+            free: Mutex::new((0 .. num_records).rev().collect()),
+        })
+    }
+
+    #[inline(always)]
+    fn record(&self, idx: u32) -> &StatsShmRecord {
+        unsafe { &*self.records.as_ptr().add(idx as usize) }
+    }
+}
+
+/// Statistics file, mapped for the whole lifetime of the process.
+static STATS_SHM: Lazy<Option<StatsShm>> = Lazy::new(StatsShm::open);
+
+/// Record of the statistics file owned by an I/O channel, and written on
+/// its core only. The record is freed when dropped.
+pub struct StatsShmSlot {
+    idx: u32,
+}
+
+impl Drop for StatsShmSlot {
+    fn drop(&mut self) {
+        let Some(shm) = STATS_SHM.as_ref() else {
+            return;
+        };
+        self.write(|r| r.kind.store(0, Ordering::Relaxed));
+        shm.free.lock().push(self.idx);
+    }
+}
+
+impl StatsShmSlot {
+    /// Takes a free record of the statistics file into use for the given
+    /// object on the current core, with all its counters zeroed. Returns
+    /// None if the export is disabled, or if no record is free.
+    pub fn new(kind: StatsShmKind, name: &str) -> Option<Self> {
+        let shm = STATS_SHM.as_ref()?;
+        let Some(idx) = shm.free.lock().pop() else {
+            warn!("No free I/O statistics record for {kind:?} '{name}'");
+            return None;
+        };
+
+        let slot = Self {
+            idx,
+        };
+        slot.write(|r| {
+            let mut buf = [0u8; NAME_LEN];
+            let n = name.len().min(NAME_LEN);
+            buf[.. n].copy_from_slice(&name.as_bytes()[.. n]);
+            unsafe { *r.name.get() = buf };
+
+            r.core.store(super::Cores::current(), Ordering::Relaxed);
+            [
+                &r.num_read_ops,
+                &r.num_write_ops,
+                &r.num_unmap_ops,
+                &r.bytes_read,
+                &r.bytes_written,
+                &r.bytes_unmapped,
+                &r.read_latency_ticks,
+                &r.write_latency_ticks,
+                &r.unmap_latency_ticks,
+            ]
+            .iter()
+            .for_each(|c| c.store(0, Ordering::Relaxed));
+            r.kind.store(kind as u32, Ordering::Relaxed);
+        });
+        Some(slot)
+    }
+
+    /// Updates the record under its sequence lock.
+    #[inline(always)]
+    fn write<F: FnOnce(&StatsShmRecord)>(&self, f: F) {
+        let r = STATS_SHM.as_ref().unwrap().record(self.idx);
+        let seq = r.seq.load(Ordering::Relaxed);
+        r.seq.store(seq.wrapping_add(1), Ordering::Relaxed);
+        fence(Ordering::Release);
+        f(r);
+        r.seq.store(seq.wrapping_add(2), Ordering::Release);
+    }
+
+    /// Accounts completed I/Os of the given type, size in bytes and total
+    /// latency in ticks. I/O types without counters are ignored.
+    #[inline(always)]
+    pub fn account(
+        &self,
+        io_type: IoType,
+        num_ops: u64,
+        num_bytes: u64,
+        ticks: u64,
+    ) {
+        #[inline(always)]
+        fn add(c: &AtomicU64, v: u64) {
+            // Single writer: no need for an atomic read-modify-write.
+            c.store(
+                c.load(Ordering::Relaxed).wrapping_add(v),
+                Ordering::Relaxed,
+            );
+        }
+
+        self.write(|r| {
+            let (ops, bytes, lat) = match io_type {
+                IoType::Read => {
+                    (&r.num_read_ops, &r.bytes_read, &r.read_latency_ticks)
+                }
+                IoType::Write | IoType::WriteZeros => {
+                    (&r.num_write_ops, &r.bytes_written, &r.write_latency_ticks)
+                }
+                IoType::Unmap => (
+                    &r.num_unmap_ops,
+                    &r.bytes_unmapped,
+                    &r.unmap_latency_ticks,
+                ),
+                _ => return,
+            };
+            add(ops, num_ops);
+            add(bytes, num_bytes);
+            add(lat, ticks);
+        });
+    }
+}
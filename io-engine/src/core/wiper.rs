@@ -1,10 +1,25 @@
-use crate::core::{CoreError, UntypedBdevHandle};
+use crate::core::{CoreError, DmaArenaBuf, IoType, UntypedBdevHandle};
+use futures::{stream::FuturesOrdered, StreamExt};
+use once_cell::sync::Lazy;
 use snafu::Snafu;
 use std::{
     fmt::Debug,
     ops::{Deref, DerefMut},
 };
 
+/// Maximum size of a wipe I/O, in bytes.
+// todo: configurable?
+const WIPE_MAX_IO_SIZE: u64 = 8 * 1024 * 1024;
+
+/// Maximum number of wipe I/Os in flight for a streamed wipe.
+static WIPE_QUEUE_DEPTH: Lazy<usize> = Lazy::new(|| {
+    std::env::var("WIPE_QUEUE_DEPTH")
+        .ok()
+        .and_then(|s| s.parse::<usize>().ok())
+        .unwrap_or(8)
+        .max(1)
+});
+
 /// The Error for the Wiper.
 #[derive(Clone, Debug, Snafu)]
 #[snafu(visibility(pub(crate)), context(suffix(false)))]
@@ -25,6 +40,8 @@ pub enum Error {
     WipeIoFailed { source: Box<CoreError> },
     #[snafu(display("Wipe Method {method:?} not implemented"))]
     MethodUnimplemented { method: WipeMethod },
+    #[snafu(display("Wipe Method {method:?} not supported by the bdev"))]
+    MethodUnsupported { method: WipeMethod },
     #[snafu(display("Failed to post client notification: {error}"))]
     ChunkNotifyFailed { error: String },
 }
@@ -50,6 +67,10 @@ pub(crate) struct Wiper {
     bdev: UntypedBdevHandle,
     /// The method used to wipe the bdev.
     wipe_method: WipeMethod,
+    /// Granularity of the unmaps guaranteed to make the unmapped blocks read
+    /// back as zeroes, if any. Zeroes are then written by unmapping, as far
+    /// as the alignment of the wiped range allows.
+    zeroing_unmap: Option<u64>,
 }
 
 /// Options for the streamed wiper.
@@ -182,57 +203,122 @@ impl Wiper {
         bdev: UntypedBdevHandle,
         wipe_method: WipeMethod,
     ) -> Result<Self, Error> {
+        let wipe_method = Self::supported(wipe_method)?;
+        if matches!(wipe_method, WipeMethod::Unmap)
+            && !bdev.get_bdev().io_type_supported(IoType::Unmap)
+        {
+            return Err(Error::MethodUnsupported {
+                method: wipe_method,
+            });
+        }
         Ok(Self {
             bdev,
-            wipe_method: Self::supported(wipe_method)?,
+            wipe_method,
+            zeroing_unmap: None,
         })
     }
+    /// Write zeroes by unmapping the ranges aligned to the given granularity,
+    /// which the caller guarantees to read back as zeroes once unmapped.
+    /// Ignored if the bdev does not support unmap.
+    pub(crate) fn with_zeroing_unmap(mut self, granularity: u64) -> Self {
+        if granularity > 0
+            && self.bdev.get_bdev().io_type_supported(IoType::Unmap)
+        {
+            self.zeroing_unmap = Some(granularity);
+        }
+        self
+    }
     /// Wipe the bdev at the given byte offset and byte size.
     pub async fn wipe(&mut self, offset: u64, size: u64) -> Result<(), Error> {
-        match &mut self.wipe_method {
-            WipeMethod::None => Ok(()),
+        let data = self.wipe_io(self.wipe_method, offset, size).await?;
+        Self::fold(&mut self.wipe_method, data);
+        Ok(())
+    }
+    /// Issue the I/Os wiping the bdev at the given byte offset and byte size
+    /// with the given method, returning the data read by methods which read.
+    async fn wipe_io(
+        &self,
+        method: WipeMethod,
+        offset: u64,
+        size: u64,
+    ) -> Result<Option<DmaArenaBuf>, Error> {
+        match method {
+            WipeMethod::None => Ok(None),
             WipeMethod::WriteZeroes => {
-                self.bdev.write_zeroes_at(offset, size).await.map_err(
-                    |source| Error::WipeIoFailed {
-                        source: Box::new(source),
-                    },
-                )
+                self.write_zeroes(offset, size).await?;
+                Ok(None)
             }
-            WipeMethod::Unmap | WipeMethod::WritePattern(_) => {
-                Err(Error::MethodUnimplemented {
-                    method: self.wipe_method,
-                })
+            WipeMethod::Unmap => {
+                self.bdev.unmap_at(offset, size).await?;
+                Ok(None)
             }
-            WipeMethod::CkSum(CkSumMethod::Crc32 {
-                crc32c,
-            }) => {
-                let mut buffer = self.bdev.dma_malloc(size).unwrap();
+            WipeMethod::WritePattern(_) => Err(Error::MethodUnimplemented {
+                method,
+            }),
+            WipeMethod::CkSum(_) => {
+                let mut buffer =
+                    DmaArenaBuf::new(size, self.bdev.get_bdev().alignment())
+                        .map_err(|_| CoreError::DmaAllocationFailed {
+                            size,
+                        })?;
                 self.bdev.read_at(offset, &mut buffer).await?;
-
-                *crc32c = unsafe {
-                    spdk_rs::libspdk::spdk_crc32c_update(
-                        buffer.as_ptr(),
-                        size,
-                        *crc32c,
-                    )
-                };
-
-                Ok(())
+                Ok(Some(buffer))
             }
-        }?;
+        }
+    }
+    /// Write zeroes at the given byte offset and byte size, unmapping the
+    /// part of the range aligned to the zeroing unmap granularity, if any.
+    async fn write_zeroes(&self, offset: u64, size: u64) -> Result<(), Error> {
+        let end = offset + size;
+        let (head, tail) = match self.zeroing_unmap {
+            Some(g) => {
+                let head = (offset + g - 1) / g * g;
+                (head.min(end), (end / g * g).max(head.min(end)))
+            }
+            None => (end, end),
+        };
+
+        if head > offset {
+            self.bdev.write_zeroes_at(offset, head - offset).await?;
+        }
+        if tail > head {
+            self.bdev.unmap_at(head, tail - head).await?;
+        }
+        if end > tail {
+            self.bdev.write_zeroes_at(tail, end - tail).await?;
+        }
         Ok(())
     }
+    /// Account the data read by a wipe I/O into the wipe method state.
+    /// Must be called in the order of the wiped ranges.
+    fn fold(method: &mut WipeMethod, data: Option<DmaArenaBuf>) {
+        if let (
+            WipeMethod::CkSum(CkSumMethod::Crc32 {
+                crc32c,
+            }),
+            Some(buffer),
+        ) = (method, data)
+        {
+            *crc32c = unsafe {
+                spdk_rs::libspdk::spdk_crc32c_update(
+                    buffer.as_ptr(),
+                    buffer.len(),
+                    *crc32c,
+                )
+            };
+        }
+    }
     /// Check if the given method is supported.
     pub(crate) fn supported(
         wipe_method: WipeMethod,
     ) -> Result<WipeMethod, Error> {
         match wipe_method {
-            WipeMethod::None | WipeMethod::WriteZeroes => Ok(wipe_method),
-            WipeMethod::Unmap | WipeMethod::WritePattern(_) => {
-                Err(Error::MethodUnimplemented {
-                    method: wipe_method,
-                })
+            WipeMethod::None | WipeMethod::WriteZeroes | WipeMethod::Unmap => {
+                Ok(wipe_method)
             }
+            WipeMethod::WritePattern(_) => Err(Error::MethodUnimplemented {
+                method: wipe_method,
+            }),
             WipeMethod::CkSum(_) => Ok(wipe_method),
         }
     }
@@ -274,9 +360,7 @@ impl<S: NotifyStream> StreamedWiper<S> {
     pub async fn wipe(mut self) -> Result<FinalWipeStats, Error> {
         self.notify()?;
         let start = std::time::Instant::now();
-        while let Some((offset, size)) = self.stats.next() {
-            self.wipe_chunk(start, offset, size).await?;
-        }
+        self.wipe_chunks(start).await?;
         Ok(FinalWipeStats {
             start,
             end: std::time::Instant::now(),
@@ -284,60 +368,101 @@ impl<S: NotifyStream> StreamedWiper<S> {
         })
     }
 
-    /// Wipe a "chunk" using a byte offset and byte length.
-    async fn wipe_chunk(
+    /// Wipe all the chunks with I/Os of at most `WIPE_MAX_IO_SIZE` bytes,
+    /// keeping up to `WIPE_QUEUE_DEPTH` of them in flight. The chunks are
+    /// completed and notified in order, as their I/Os complete.
+    /// Uses the abort checker allowing us to stop early if a client disconnects
+    /// or if the process is being shutdown.
+    async fn wipe_chunks(
         &mut self,
         start: std::time::Instant,
-        offset: u64,
-        size: u64,
     ) -> Result<(), Error> {
-        self.wipe_with_abort(offset, size).await?;
+        let chunks = self.stats.stats.clone();
+        let mut ios =
+            (chunks.wiped_chunks .. chunks.total_chunks).flat_map(move |idx| {
+                let (offset, size) = chunks.chunk(idx);
+                let end = offset + size;
+                (offset .. end).step_by(WIPE_MAX_IO_SIZE as usize).map(
+                    move |offset| {
+                        let len = WIPE_MAX_IO_SIZE.min(end - offset);
+                        // The last I/O of a chunk carries the chunk size.
+                        (offset, len, (offset + len == end).then_some(size))
+                    },
+                )
+            });
+
+        // The wiper is shared by the I/Os in flight: the state of the wipe
+        // method is folded into a copy, stored back once they completed.
+        let wiper = &self.wiper;
+        let mut method = wiper.wipe_method;
+        let mut in_flight = FuturesOrdered::new();
+        let mut result = Ok(());
+
+        loop {
+            while result.is_ok() && in_flight.len() < *WIPE_QUEUE_DEPTH {
+                let Some((offset, size, chunk)) = ios.next() else {
+                    break;
+                };
+                in_flight.push_back(async move {
+                    (wiper.wipe_io(method, offset, size).await, chunk)
+                });
+            }
 
-        self.complete_chunk(start, size);
+            let Some((data, chunk)) = in_flight.next().await else {
+                break;
+            };
 
-        self.notify()
+            // After a failure, only wait for the I/Os in flight to complete,
+            // as they cannot be cancelled.
+            if result.is_err() {
+                continue;
+            }
+
+            result = match data {
+                Ok(data) => {
+                    Wiper::fold(&mut method, data);
+                    match chunk {
+                        Some(size) => {
+                            Self::complete_chunk(
+                                &mut self.stats,
+                                &mut method,
+                                start,
+                                size,
+                            );
+                            self.notify()
+                        }
+                        None => self.check_abort(),
+                    }
+                }
+                Err(error) => Err(error),
+            };
+        }
+
+        drop(in_flight);
+        self.wiper.wipe_method = method;
+        result
     }
 
     /// Complete the current chunk.
-    fn complete_chunk(&mut self, start: std::time::Instant, size: u64) {
-        self.stats.complete_chunk(start, size);
+    fn complete_chunk(
+        stats: &mut WipeStats,
+        method: &mut WipeMethod,
+        start: std::time::Instant,
+        size: u64,
+    ) {
+        stats.complete_chunk(start, size);
         if let WipeMethod::CkSum(CkSumMethod::Crc32 {
             crc32c,
-        }) = &mut self.wiper.wipe_method
+        }) = method
         {
             // Finalize CRC by inverting all bits.
-            if self.stats.remaining_chunks == 0 {
+            if stats.remaining_chunks == 0 {
                 *crc32c ^= spdk_rs::libspdk::SPDK_CRC32C_XOR;
             }
-            self.stats.cksum_crc32c = Some(*crc32c);
+            stats.cksum_crc32c = Some(*crc32c);
         }
     }
 
-    /// Wipe the bdev at the given byte offset and byte size.
-    /// Uses the abort checker allowing us to stop early if a client disconnects
-    /// or if the process is being shutdown.
-    async fn wipe_with_abort(
-        &mut self,
-        offset: u64,
-        size: u64,
-    ) -> Result<(), Error> {
-        // todo: configurable?
-        let max_io_size = 8 * 1024 * 1024;
-        if size > max_io_size {
-            let block_len = self.wiper.bdev.get_bdev().block_len() as u64;
-            let mut iterator =
-                WipeIterator::new(offset, size, max_io_size, block_len)?;
-            while let Some((offset, size)) = iterator.next() {
-                self.wiper.wipe(offset, size).await?;
-                iterator.complete_chunk(size);
-                self.check_abort()?;
-            }
-        } else {
-            self.wiper.wipe(offset, size).await?;
-        }
-        Ok(())
-    }
-
     fn check_abort(&self) -> Result<(), Error> {
         if self.stream.is_closed() {
             return Err(Error::WipeAborted {});
@@ -366,7 +491,7 @@ impl Iterator for WipeStats {
 }
 
 /// Iterator to keep track of a wipe.
-#[derive(Default, Debug)]
+#[derive(Default, Debug, Clone)]
 pub(crate) struct WipeIterator {
     /// The starting offset to wipe.
     start_offset: u64,
@@ -437,6 +562,17 @@ impl WipeIterator {
         self.wiped_bytes += size;
         self.remaining_chunks -= 1;
     }
+    /// Get the byte offset and byte size of the chunk of the given index.
+    fn chunk(&self, idx: u64) -> (u64, u64) {
+        let offset = self.start_offset + (idx * self.chunk_size_bytes);
+        match self.extra_chunk_size_bytes {
+            // the very last chunk might have a different size is the bdev
+            // size is not an exact multiple of the chunk
+            // size.
+            Some(size) if idx + 1 == self.total_chunks => (offset, size),
+            None | Some(_) => (offset, self.chunk_size_bytes),
+        }
+    }
 }
 impl Iterator for WipeIterator {
     type Item = (u64, u64);
@@ -446,17 +582,7 @@ impl Iterator for WipeIterator {
         if self.wiped_chunks >= self.total_chunks {
             None
         } else {
-            let offset =
-                self.start_offset + (self.wiped_chunks * self.chunk_size_bytes);
-            match self.extra_chunk_size_bytes {
-                // the very last chunk might have a different size is the bdev
-                // size is not an exact multiple of the chunk
-                // size.
-                Some(size) if self.remaining_chunks == 1 => {
-                    Some((offset, size))
-                }
-                None | Some(_) => Some((offset, self.chunk_size_bytes)),
-            }
+            Some(self.chunk(self.wiped_chunks))
         }
     }
 }
@@ -1,9 +1,14 @@
 use std::fmt::{Debug, Display};
 
-/// TODO
+use crate::core::mpsc_ring::MpscQueue;
+
+/// Number of preallocated slots of a work queue.
+const WORK_QUEUE_SLOTS: usize = 256;
+
+/// Multi-producer queue of work items, drained by a single consumer.
 #[derive(Debug)]
 pub struct WorkQueue<T: Send + Debug + Display> {
-    incoming: crossbeam::queue::SegQueue<T>,
+    incoming: MpscQueue<T>,
 }
 
 impl<T: Send + Debug + Display> Default for WorkQueue<T> {
@@ -15,7 +20,7 @@ impl<T: Send + Debug + Display> Default for WorkQueue<T> {
 impl<T: Send + Debug + Display> WorkQueue<T> {
     pub fn new() -> Self {
         Self {
-            incoming: crossbeam::queue::SegQueue::new(),
+            incoming: MpscQueue::new(WORK_QUEUE_SLOTS),
         }
     }
 
@@ -29,13 +34,10 @@ impl<T: Send + Debug + Display> WorkQueue<T> {
     }
 
     pub fn is_empty(&self) -> bool {
-        self.incoming.len() == 0
+        self.incoming.is_empty()
     }
 
     pub fn take(&self) -> Option<T> {
-        if let Some(elem) = self.incoming.pop() {
-            return Some(elem);
-        }
-        None
+        self.incoming.pop()
     }
 }
@@ -75,8 +75,10 @@ pub mod v0 {
     pub mod nexus_grpc;
 }
 pub mod v1 {
+    pub mod batch;
     pub mod bdev;
     pub mod host;
+    mod inventory;
     pub mod json;
     pub mod nexus;
     pub mod pool;
@@ -0,0 +1,310 @@
+//!
+//! Batched replica and nexus lifecycle operations.
+//!
+//! After a restart, the control plane recreates, shares and assembles the
+//! replicas and nexuses of a node one gRPC call at a time, and every call
+//! takes the lock of its whole service. With hundreds of volumes this takes
+//! minutes before the node is ready again.
+//!
+//! The json-rpc methods below, also reachable through the gRPC json-rpc
+//! proxy, take many operations of the same kind at once. A batch takes the
+//! service-wide lock once, excluding the non-batched operations of the same
+//! kind, and then runs its operations concurrently on the primary reactor,
+//! where control operations execute, up to `BATCH_CONCURRENCY` (16 by
+//! default) at a time. Operations of a batch only serialize on the lock of
+//! the resource they touch. Each operation has its own result, in the order
+//! of the batch: a failed operation does not fail the others.
+use std::{collections::HashSet, future::Future, pin::Pin};
+
+use futures::{stream, FutureExt, StreamExt};
+use io_engine_api::v1::{
+    nexus::CreateNexusRequest,
+    replica::{CreateReplicaRequest, ShareReplicaRequest},
+};
+use once_cell::sync::Lazy;
+
+use super::{
+    nexus::nexus_create,
+    replica::{replica_create, replica_share},
+};
+use crate::{
+    core::{
+        lock::{ProtectedSubsystems, ResourceLockManager},
+        VerboseError,
+    },
+    jsonrpc::{jsonrpc_register, Code, JsonRpcError, Result},
+};
+
+/// Maximum number of operations of a batch running at once.
+static BATCH_CONCURRENCY: Lazy<usize> = Lazy::new(|| {
+    std::env::var("BATCH_CONCURRENCY")
+        .ok()
+        .and_then(|s| s.parse::<usize>().ok())
+        .unwrap_or(16)
+        .max(1)
+});
+
+/// Replica to create.
+#[derive(Debug, Deserialize)]
+struct ReplicaCreateOp {
+    name: String,
+    uuid: String,
+    /// Uuid or name of the pool.
+    pool: String,
+    size: u64,
+    #[serde(default)]
+    thin: bool,
+    /// Share protocol: 0 for none, 1 for nvmf.
+    #[serde(default)]
+    share: i32,
+    #[serde(default)]
+    allowed_hosts: Vec<String>,
+    #[serde(default)]
+    entity_id: Option<String>,
+}
+
+/// Arguments of the batched replica creation json-rpc method.
+#[derive(Debug, Deserialize)]
+struct ReplicaCreateBatchArgs {
+    replicas: Vec<ReplicaCreateOp>,
+}
+
+/// Replica to share.
+#[derive(Debug, Deserialize)]
+struct ReplicaShareOp {
+    uuid: String,
+    /// Share protocol: 1 for nvmf.
+    share: i32,
+    #[serde(default)]
+    allowed_hosts: Vec<String>,
+}
+
+/// Arguments of the batched replica share json-rpc method.
+#[derive(Debug, Deserialize)]
+struct ReplicaShareBatchArgs {
+    replicas: Vec<ReplicaShareOp>,
+}
+
+/// Nexus to create.
+#[derive(Debug, Deserialize)]
+struct NexusCreateOp {
+    name: String,
+    uuid: String,
+    size: u64,
+    children: Vec<String>,
+    min_cntl_id: u32,
+    max_cntl_id: u32,
+    #[serde(default)]
+    resv_key: u64,
+    #[serde(default)]
+    preempt_key: u64,
+    #[serde(default)]
+    resv_type: Option<i32>,
+    #[serde(default)]
+    preempt_policy: i32,
+    #[serde(default)]
+    nexus_info_key: String,
+}
+
+/// Arguments of the batched nexus creation json-rpc method.
+#[derive(Debug, Deserialize)]
+struct NexusCreateBatchArgs {
+    nexuses: Vec<NexusCreateOp>,
+}
+
+/// Result of an operation of a batch.
+#[derive(Debug, Serialize)]
+struct BatchOpReply {
+    /// Uuid of the replica or nexus.
+    uuid: String,
+    /// Share URI of the replica or nexus, if shared.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    uri: Option<String>,
+    /// Error message if the operation failed.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    error: Option<String>,
+}
+
+/// Checks that no two operations of a batch have the same key.
+fn check_unique<'a>(
+    what: &str,
+    keys: impl Iterator<Item = &'a str>,
+) -> Result<()> {
+    let mut seen = HashSet::new();
+    for k in keys {
+        if !seen.insert(k) {
+            return Err(JsonRpcError {
+                code: Code::InvalidParams,
+                message: format!("{what} '{k}' appears twice in the batch"),
+            });
+        }
+    }
+    Ok(())
+}
+
+/// Runs the operations of a batch concurrently, each under the lock of its
+/// resource in the given subsystem, and returns the results in order. An
+/// operation returns the share URI of its resource.
+async fn run_batch<Op, F, Fut>(
+    subsystem: &str,
+    ops: Vec<Op>,
+    uuid: fn(&Op) -> String,
+    f: F,
+) -> Vec<BatchOpReply>
+where
+    F: Fn(Op) -> Fut,
+    Fut: Future<Output = std::result::Result<String, String>>,
+{
+    let subsystem =
+        ResourceLockManager::get_instance().get_subsystem(subsystem);
+
+    stream::iter(ops.into_iter().map(|op| {
+        let uuid = uuid(&op);
+        let fut = f(op);
+        async move {
+            let _guard = subsystem.lock_resource(&uuid, None).await;
+            let (uri, error) = match fut.await {
+                Ok(uri) => ((!uri.is_empty()).then_some(uri), None),
+                Err(e) => {
+                    error!("Batched operation on '{uuid}' failed: {e}");
+                    (None, Some(e))
+                }
+            };
+            BatchOpReply {
+                uuid,
+                uri,
+                error,
+            }
+        }
+    }))
+    .buffered(*BATCH_CONCURRENCY)
+    .collect()
+    .await
+}
+
+/// Registers the batched json-rpc methods.
+pub fn register() {
+    jsonrpc_register(
+        "replica_create_batch",
+        |args: ReplicaCreateBatchArgs| -> Pin<Box<dyn Future<Output = Result<Vec<BatchOpReply>>>>> {
+            let f = async move {
+                check_unique(
+                    "replica",
+                    args.replicas.iter().map(|r| r.uuid.as_str()),
+                )?;
+                info!("Creating {} replicas", args.replicas.len());
+
+                let _replicas_guard = ResourceLockManager::get_instance()
+                    .get_subsystem(ProtectedSubsystems::REPLICA)
+                    .lock(None)
+                    .await;
+
+                Ok(run_batch(
+                    ProtectedSubsystems::REPLICA,
+                    args.replicas,
+                    |op| op.uuid.clone(),
+                    |op| async move {
+                        replica_create(CreateReplicaRequest {
+                            name: op.name,
+                            uuid: op.uuid,
+                            pooluuid: op.pool,
+                            size: op.size,
+                            thin: op.thin,
+                            share: op.share,
+                            allowed_hosts: op.allowed_hosts,
+                            entity_id: op.entity_id,
+                        })
+                        .await
+                        .map(|r| r.uri)
+                        .map_err(|e| e.verbose())
+                    },
+                )
+                .await)
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "replica_share_batch",
+        |args: ReplicaShareBatchArgs| -> Pin<Box<dyn Future<Output = Result<Vec<BatchOpReply>>>>> {
+            let f = async move {
+                check_unique(
+                    "replica",
+                    args.replicas.iter().map(|r| r.uuid.as_str()),
+                )?;
+                info!("Sharing {} replicas", args.replicas.len());
+
+                let _replicas_guard = ResourceLockManager::get_instance()
+                    .get_subsystem(ProtectedSubsystems::REPLICA)
+                    .lock(None)
+                    .await;
+
+                Ok(run_batch(
+                    ProtectedSubsystems::REPLICA,
+                    args.replicas,
+                    |op| op.uuid.clone(),
+                    |op| async move {
+                        replica_share(ShareReplicaRequest {
+                            uuid: op.uuid,
+                            share: op.share,
+                            allowed_hosts: op.allowed_hosts,
+                        })
+                        .await
+                        .map(|r| r.uri)
+                        .map_err(|e| e.verbose())
+                    },
+                )
+                .await)
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+
+    jsonrpc_register(
+        "nexus_create_batch",
+        |args: NexusCreateBatchArgs| -> Pin<Box<dyn Future<Output = Result<Vec<BatchOpReply>>>>> {
+            let f = async move {
+                check_unique(
+                    "nexus",
+                    args.nexuses.iter().map(|n| n.uuid.as_str()),
+                )?;
+                check_unique(
+                    "nexus",
+                    args.nexuses.iter().map(|n| n.name.as_str()),
+                )?;
+                info!("Creating {} nexuses", args.nexuses.len());
+
+                // Nexus creation is a global operation.
+                let _global_guard =
+                    ResourceLockManager::get_instance().lock(None).await;
+
+                Ok(run_batch(
+                    ProtectedSubsystems::NEXUS,
+                    args.nexuses,
+                    |op| op.uuid.clone(),
+                    |op| async move {
+                        nexus_create(CreateNexusRequest {
+                            name: op.name,
+                            uuid: op.uuid,
+                            size: op.size,
+                            min_cntl_id: op.min_cntl_id,
+                            max_cntl_id: op.max_cntl_id,
+                            resv_key: op.resv_key,
+                            preempt_key: op.preempt_key,
+                            children: op.children,
+                            nexus_info_key: op.nexus_info_key,
+                            resv_type: op.resv_type,
+                            preempt_policy: op.preempt_policy,
+                        })
+                        .await
+                        .map(|n| n.device_uri)
+                        .map_err(|s| s.message().to_string())
+                    },
+                )
+                .await)
+            };
+            Box::pin(f.boxed_local())
+        },
+    );
+}
@@ -0,0 +1,307 @@
+//!
+//! Inventory of the pools, replicas and snapshots of the node, serving the
+//! gRPC list calls.
+//!
+//! Building the list replies walks every lvol and reads its xattrs and space
+//! usage on the reactor, which does not scale to thousands of lvols polled by
+//! the control plane. The inventory keeps the replies of every pool instead,
+//! and serves the list calls from them, filtering by pool and uuid on its
+//! indexes rather than on the converted entries.
+//!
+//! Only the pools the lvol store code reports as changed (lvols created,
+//! destroyed, resized, shared or with changed xattrs) are rebuilt, on the
+//! reactor, by the first list call after the change. The space usage of the
+//! lvols changes with every write though, so the whole inventory is also
+//! rebuilt once it is older than `GRPC_INVENTORY_TTL_SECS` seconds (10 by
+//! default); zero rebuilds it on every list call.
+use std::{
+    collections::{BTreeMap, HashSet},
+    convert::TryFrom,
+    time::{Duration, Instant},
+};
+
+use io_engine_api::v1::{pool::Pool, replica::Replica, snapshot::SnapshotInfo};
+use nix::errno::Errno;
+use once_cell::sync::Lazy;
+use parking_lot::RwLock;
+use tonic::Status;
+
+use crate::{
+    core::{LogicalVolume, SnapshotOps, UntypedBdev},
+    grpc::rpc_submit,
+    lvs::{
+        has_inventory_changes,
+        take_inventory_changes,
+        Error as LvsError,
+        Lvol,
+        Lvs,
+        LvsLvol,
+    },
+};
+
+/// Replies of a pool and of its lvols.
+struct PoolInventory {
+    pool: Pool,
+    /// Replicas of the pool, snapshots included, by uuid.
+    replicas: BTreeMap<String, Replica>,
+    /// Snapshots of the pool, by uuid.
+    snapshots: BTreeMap<String, SnapshotInfo>,
+}
+
+impl PoolInventory {
+    fn new(pool: Pool) -> Self {
+        Self {
+            pool,
+            replicas: BTreeMap::new(),
+            snapshots: BTreeMap::new(),
+        }
+    }
+}
+
+/// Inventory of the node.
+#[derive(Default)]
+struct Inventory {
+    /// Pools by uuid.
+    pools: BTreeMap<String, PoolInventory>,
+    /// Time of the last full rebuild.
+    rebuilt: Option<Instant>,
+}
+
+impl Inventory {
+    /// Returns the selected pools: the given one if any, all of them
+    /// otherwise.
+    fn select_pools(
+        &self,
+        name: Option<&str>,
+        uuid: Option<&str>,
+    ) -> Vec<&PoolInventory> {
+        let pools: Vec<&PoolInventory> = match uuid {
+            Some(uuid) => self.pools.get(uuid).into_iter().collect(),
+            None => self.pools.values().collect(),
+        };
+        pools
+            .into_iter()
+            .filter(|p| name.map_or(true, |n| p.pool.name == n))
+            .collect()
+    }
+
+    /// Finds the replica with the given uuid.
+    fn replica(&self, uuid: &str) -> Option<&Replica> {
+        self.pools.values().find_map(|p| p.replicas.get(uuid))
+    }
+}
+
+/// Rebuilt part of the inventory.
+struct InventoryUpdate {
+    /// Whether all pools were rebuilt.
+    full: bool,
+    /// Rebuilt pools by uuid; none if the pool was removed.
+    pools: Vec<(String, Option<PoolInventory>)>,
+}
+
+impl InventoryUpdate {
+    /// Rebuilds the inventory of the given pools, or of all of them. Must be
+    /// called on the reactor owning the lvol stores.
+    fn collect(changed: Option<HashSet<String>>) -> Self {
+        let mut pools: BTreeMap<String, PoolInventory> = match &changed {
+            None => Lvs::iter()
+                .map(|l| (l.uuid(), PoolInventory::new(l.into())))
+                .collect(),
+            Some(changed) => changed
+                .iter()
+                .filter_map(|u| Lvs::lookup_by_uuid(u))
+                .map(|l| (l.uuid(), PoolInventory::new(l.into())))
+                .collect(),
+        };
+
+        if let Some(bdev) = UntypedBdev::bdev_first() {
+            bdev.into_iter()
+                .filter(|b| b.driver() == "lvol")
+                .filter_map(|b| Lvol::try_from(b).ok())
+                .for_each(|l| {
+                    let Some(pool) = pools.get_mut(&l.pool_uuid()) else {
+                        return;
+                    };
+                    if l.is_snapshot() {
+                        if let Some(s) = l.snapshot_descriptor(None) {
+                            pool.snapshots
+                                .insert(l.uuid(), SnapshotInfo::from(s));
+                        }
+                    }
+                    pool.replicas.insert(l.uuid(), Replica::from(l));
+                });
+        }
+
+        match changed {
+            None => Self {
+                full: true,
+                pools: pools.into_iter().map(|(u, p)| (u, Some(p))).collect(),
+            },
+            Some(changed) => Self {
+                full: false,
+                pools: changed
+                    .into_iter()
+                    .map(|u| {
+                        let p = pools.remove(&u);
+                        (u, p)
+                    })
+                    .collect(),
+            },
+        }
+    }
+
+    /// Applies the update to the inventory.
+    fn apply(self, inventory: &mut Inventory) {
+        if self.full {
+            inventory.pools.clear();
+            inventory.rebuilt = Some(Instant::now());
+        }
+        for (uuid, pool) in self.pools {
+            match pool {
+                Some(pool) => inventory.pools.insert(uuid, pool),
+                None => inventory.pools.remove(&uuid),
+            };
+        }
+    }
+}
+
+static INVENTORY: Lazy<RwLock<Inventory>> = Lazy::new(Default::default);
+
+/// Serializes the rebuilds, so that concurrent list calls share one.
+static REBUILD: Lazy<tokio::sync::Mutex<()>> = Lazy::new(Default::default);
+
+/// Maximum age of the inventory.
+static INVENTORY_TTL: Lazy<Duration> = Lazy::new(|| {
+    Duration::from_secs(
+        std::env::var("GRPC_INVENTORY_TTL_SECS")
+            .ok()
+            .and_then(|s| s.parse().ok())
+            .unwrap_or(10),
+    )
+});
+
+/// Brings the inventory up to date, rebuilding the changed pools on the
+/// reactor, or all of them if the inventory is too old.
+async fn refresh() -> Result<(), Status> {
+    let _rebuild = REBUILD.lock().await;
+
+    let expired = INVENTORY
+        .read()
+        .rebuilt
+        .map_or(true, |t| t.elapsed() >= *INVENTORY_TTL);
+    if !expired && !has_inventory_changes() {
+        return Ok(());
+    }
+
+    let rx = rpc_submit::<_, _, LvsError>(async move {
+        // Taken on the reactor, so that no change is missed by the rebuild.
+        let changes = take_inventory_changes();
+        let changed = (!expired && !changes.all).then_some(changes.pools);
+        Ok(InventoryUpdate::collect(changed))
+    })?;
+    let update = rx
+        .await
+        .map_err(|_| Status::cancelled("cancelled"))?
+        .map_err(Status::from)?;
+
+    update.apply(&mut INVENTORY.write());
+    Ok(())
+}
+
+/// Lists the pools, filtered by name or uuid.
+pub(crate) async fn list_pools(
+    name: Option<String>,
+    uuid: Option<String>,
+) -> Result<Vec<Pool>, Status> {
+    refresh().await?;
+
+    // The name takes precedence over the uuid, as for a lookup.
+    let uuid = uuid.filter(|_| name.is_none());
+    Ok(INVENTORY
+        .read()
+        .select_pools(name.as_deref(), uuid.as_deref())
+        .into_iter()
+        .map(|p| p.pool.clone())
+        .collect())
+}
+
+/// Lists the replicas, filtered by pool name and uuid, and by name or uuid.
+pub(crate) async fn list_replicas(
+    pool_name: Option<String>,
+    pool_uuid: Option<String>,
+    name: Option<String>,
+    uuid: Option<String>,
+) -> Result<Vec<Replica>, Status> {
+    refresh().await?;
+
+    // The name takes precedence over the uuid.
+    let uuid = uuid.filter(|_| name.is_none());
+    let inventory = INVENTORY.read();
+    let pools = inventory
+        .select_pools(pool_name.as_deref(), pool_uuid.as_deref())
+        .into_iter();
+
+    Ok(match (&name, &uuid) {
+        (_, Some(uuid)) => pools
+            .filter_map(|p| p.replicas.get(uuid))
+            .cloned()
+            .collect(),
+        _ => pools
+            .flat_map(|p| p.replicas.values())
+            .filter(|r| name.as_ref().map_or(true, |n| &r.name == n))
+            .cloned()
+            .collect(),
+    })
+}
+
+/// Lists the snapshots: the one with the given uuid, the ones taken from the
+/// given source replica, or all of them.
+pub(crate) async fn list_snapshots(
+    snapshot_uuid: Option<String>,
+    source_uuid: Option<String>,
+) -> Result<Vec<SnapshotInfo>, Status> {
+    refresh().await?;
+
+    let inventory = INVENTORY.read();
+    let not_found = |uuid: &str| {
+        Status::from(LvsError::Invalid {
+            source: Errno::ENOENT,
+            msg: format!("Replica {uuid} not found"),
+        })
+    };
+
+    if let Some(uuid) = snapshot_uuid {
+        inventory.replica(&uuid).ok_or_else(|| not_found(&uuid))?;
+        return Ok(inventory
+            .pools
+            .values()
+            .filter_map(|p| p.snapshots.get(&uuid))
+            .cloned()
+            .collect());
+    }
+
+    if let Some(uuid) = source_uuid {
+        inventory.replica(&uuid).ok_or_else(|| not_found(&uuid))?;
+        // Newest first, as when walking the snapshot chain of the source.
+        let mut snapshots: Vec<SnapshotInfo> = inventory
+            .pools
+            .values()
+            .flat_map(|p| p.snapshots.values())
+            .filter(|s| s.source_uuid == uuid)
+            .cloned()
+            .collect();
+        snapshots.sort_by_key(|s| {
+            std::cmp::Reverse(
+                s.timestamp.as_ref().map(|t| (t.seconds, t.nanos)),
+            )
+        });
+        return Ok(snapshots);
+    }
+
+    Ok(inventory
+        .pools
+        .values()
+        .flat_map(|p| p.snapshots.values())
+        .cloned()
+        .collect())
+}
@@ -148,6 +148,7 @@ fn map_fault_reason(r: FaultReason) -> ChildStateReason {
         FaultReason::RebuildFailed => RebuildFailed,
         FaultReason::AdminCommandFailed => AdminFailed,
         FaultReason::OfflinePermanent => ByClient,
+        FaultReason::IntegrityMismatch => IoFailure,
     }
 }
 
@@ -388,6 +389,62 @@ async fn nexus_add_child(
     Ok(n.into_grpc().await)
 }
 
+/// Creates a nexus. Must be called on the primary reactor.
+pub(crate) async fn nexus_create(
+    args: CreateNexusRequest,
+) -> Result<Nexus, Status> {
+    let resv_type = NvmeReservationConv(args.resv_type).try_into()?;
+    let preempt_policy = NvmePreemptionConv(args.preempt_policy).try_into()?;
+    async move {
+        // check for nexus exists, uuid & name
+        if let Some(_n) = nexus::nexus_lookup(&args.name) {
+            return Err(nexus::Error::NameExists {
+                name: args.name.clone(),
+            });
+        }
+        if let Ok(_n) = nexus_lookup(&args.uuid) {
+            return Err(nexus::Error::UuidExists {
+                uuid: args.uuid.clone(),
+                nexus: args.name.clone(),
+            });
+        }
+
+        // If the control plane has supplied a key, use it to store
+        // the NexusInfo.
+        let nexus_info_key = if args.nexus_info_key.is_empty() {
+            None
+        } else {
+            Some(args.nexus_info_key.to_string())
+        };
+
+        nexus::nexus_create_v2(
+            &args.name,
+            args.size,
+            &args.uuid,
+            nexus::NexusNvmeParams {
+                min_cntlid: args.min_cntl_id as u16,
+                max_cntlid: args.max_cntl_id as u16,
+                resv_key: args.resv_key,
+                preempt_key: match args.preempt_key {
+                    0 => None,
+                    k => std::num::NonZeroU64::new(k),
+                },
+                resv_type,
+                preempt_policy,
+            },
+            &args.children,
+            nexus_info_key,
+        )
+        .await?;
+        let nexus = nexus_lookup(&args.uuid)?;
+        nexus.event(EventAction::Create).generate();
+        info!("Created nexus {}/{}", &args.name, &args.uuid);
+        Ok(nexus.into_grpc().await)
+    }
+    .await
+    .map_err(Status::from)
+}
+
 #[tonic::async_trait]
 impl NexusRpc for NexusService {
     #[named]
@@ -400,58 +457,9 @@ impl NexusRpc for NexusService {
 
         self.serialized(ctx, args.uuid.clone(), true, async move {
             trace!("{:?}", args);
-            let resv_type = NvmeReservationConv(args.resv_type).try_into()?;
-            let preempt_policy =
-                NvmePreemptionConv(args.preempt_policy).try_into()?;
-            let rx = rpc_submit::<_, _, nexus::Error>(async move {
-                // check for nexus exists, uuid & name
-                if let Some(_n) = nexus::nexus_lookup(&args.name) {
-                    return Err(nexus::Error::NameExists {
-                        name: args.name.clone(),
-                    });
-                }
-                if let Ok(_n) = nexus_lookup(&args.uuid) {
-                    return Err(nexus::Error::UuidExists {
-                        uuid: args.uuid.clone(),
-                        nexus: args.name.clone(),
-                    });
-                }
-
-                // If the control plane has supplied a key, use it to store
-                // the NexusInfo.
-                let nexus_info_key = if args.nexus_info_key.is_empty() {
-                    None
-                } else {
-                    Some(args.nexus_info_key.to_string())
-                };
-
-                nexus::nexus_create_v2(
-                    &args.name,
-                    args.size,
-                    &args.uuid,
-                    nexus::NexusNvmeParams {
-                        min_cntlid: args.min_cntl_id as u16,
-                        max_cntlid: args.max_cntl_id as u16,
-                        resv_key: args.resv_key,
-                        preempt_key: match args.preempt_key {
-                            0 => None,
-                            k => std::num::NonZeroU64::new(k),
-                        },
-                        resv_type,
-                        preempt_policy,
-                    },
-                    &args.children,
-                    nexus_info_key,
-                )
-                .await?;
-                let nexus = nexus_lookup(&args.uuid)?;
-                nexus.event(EventAction::Create).generate();
-                info!("Created nexus {}/{}", &args.name, &args.uuid);
-                Ok(nexus.into_grpc().await)
-            })?;
+            let rx = rpc_submit(nexus_create(args))?;
             rx.await
                 .map_err(|_| Status::cancelled("cancelled"))?
-                .map_err(Status::from)
                 .map(|nexus| {
                     Response::new(CreateNexusResponse {
                         nexus: Some(nexus),
@@ -347,28 +347,11 @@ impl PoolRpc for PoolService {
                     ));
                 }
 
-                let rx = rpc_submit::<_, _, LvsError>(async move {
-                    let mut pools = Vec::new();
-                    if let Some(name) = args.name {
-                        if let Some(l) = Lvs::lookup(&name) {
-                            pools.push(l.into());
-                        }
-                    } else if let Some(uuid) = args.uuid {
-                        if let Some(l) = Lvs::lookup_by_uuid(&uuid) {
-                            pools.push(l.into());
-                        }
-                    } else {
-                        Lvs::iter().for_each(|l| pools.push(l.into()));
-                    }
-                    Ok(ListPoolsResponse {
-                        pools,
-                    })
-                })?;
-
-                rx.await
-                    .map_err(|_| Status::cancelled("cancelled"))?
-                    .map_err(Status::from)
-                    .map(Response::new)
+                let pools =
+                    super::inventory::list_pools(args.name, args.uuid).await?;
+                Ok(Response::new(ListPoolsResponse {
+                    pools,
+                }))
             },
         )
         .await
@@ -2,6 +2,7 @@ use crate::{
     bdev::PtplFileOps,
     bdev_api::BdevError,
     core::{
+        lock::{ProtectedSubsystems, ResourceLockManager},
         logical_volume::LogicalVolume,
         Bdev,
         CloneXattrs,
@@ -38,6 +39,18 @@ where
     async fn locked(&self, ctx: GrpcClientContext, f: F) -> Result<T, Status> {
         let mut context_guard = self.client_context.write().await;
 
+        // Exclude batched replica operations, which do not go through the
+        // service.
+        let Some(_replicas_guard) = ResourceLockManager::get_instance()
+            .get_subsystem(ProtectedSubsystems::REPLICA)
+            .lock(Some(ctx.timeout))
+            .await
+        else {
+            return Err(Status::deadline_exceeded(
+                "Failed to acquire access to replicas within given timeout",
+            ));
+        };
+
         // Store context as a marker of to detect abnormal termination of the
         // request. Even though AssertUnwindSafe() allows us to
         // intercept asserts in underlying method strategies, such a
@@ -183,6 +196,136 @@ fn filter_replicas_by_replica_type(
         })
         .collect()
 }
+
+/// Creates a replica, and shares it if the request asks for it. Must be
+/// called on the primary reactor.
+pub(crate) async fn replica_create(
+    args: CreateReplicaRequest,
+) -> Result<Replica, LvsError> {
+    if !matches!(
+        Protocol::try_from(args.share)?,
+        Protocol::Off | Protocol::Nvmf
+    ) {
+        return Err(LvsError::ReplicaShareProtocol {
+            value: args.share,
+        });
+    }
+
+    let lvs = match Lvs::lookup_by_uuid(&args.pooluuid) {
+        Some(lvs) => lvs,
+        None => {
+            // lookup takes care of backward compatibility
+            match Lvs::lookup(&args.pooluuid) {
+                Some(lvs) => lvs,
+                None => {
+                    return Err(LvsError::Invalid {
+                        source: Errno::ENOMEDIUM,
+                        msg: format!("Pool {} not found", args.pooluuid),
+                    })
+                }
+            }
+        }
+    };
+    // if pooltype is not Lvs, the provided replica uuid need to be added as
+    match lvs
+        .create_lvol(
+            &args.name,
+            args.size,
+            Some(&args.uuid),
+            args.thin,
+            args.entity_id,
+        )
+        .await
+    {
+        Ok(mut lvol) if Protocol::try_from(args.share)? == Protocol::Nvmf => {
+            let props = ShareProps::new()
+                .with_allowed_hosts(args.allowed_hosts)
+                .with_ptpl(lvol.ptpl().create().map_err(|source| {
+                    LvsError::LvolShare {
+                        source: crate::core::CoreError::Ptpl {
+                            reason: source.to_string(),
+                        },
+                        name: lvol.name(),
+                    }
+                })?);
+            match Pin::new(&mut lvol).share_nvmf(Some(props)).await {
+                Ok(s) => {
+                    debug!("created and shared {:?} as {}", lvol, s);
+                    Ok(Replica::from(lvol))
+                }
+                Err(e) => {
+                    debug!(
+                        "failed to share created lvol {:?}: {} (destroying)",
+                        lvol,
+                        e.to_string()
+                    );
+                    let _ = lvol.destroy().await;
+                    Err(e)
+                }
+            }
+        }
+        Ok(lvol) => {
+            debug!("created lvol {:?}", lvol);
+            Ok(Replica::from(lvol))
+        }
+        Err(e) => Err(e),
+    }
+}
+
+/// Shares a replica, or updates its allowed hosts if it is already shared
+/// with the requested protocol. Must be called on the primary reactor.
+pub(crate) async fn replica_share(
+    args: ShareReplicaRequest,
+) -> Result<Replica, LvsError> {
+    match Bdev::lookup_by_uuid_str(&args.uuid) {
+        Some(bdev) => {
+            let mut lvol = Lvol::try_from(bdev)?;
+
+            // if we are already shared with the same protocol
+            if lvol.shared() == Some(Protocol::try_from(args.share)?) {
+                Pin::new(&mut lvol)
+                    .update_properties(
+                        UpdateProps::new()
+                            .with_allowed_hosts(args.allowed_hosts),
+                    )
+                    .await?;
+                return Ok(Replica::from(lvol));
+            }
+
+            match Protocol::try_from(args.share)? {
+                Protocol::Off => {
+                    return Err(LvsError::Invalid {
+                        source: Errno::EINVAL,
+                        msg: "invalid share protocol NONE".to_string(),
+                    })
+                }
+                Protocol::Nvmf => {
+                    let props = ShareProps::new()
+                        .with_allowed_hosts(args.allowed_hosts)
+                        .with_ptpl(lvol.ptpl().create().map_err(|source| {
+                            LvsError::LvolShare {
+                                source: crate::core::CoreError::Ptpl {
+                                    reason: source.to_string(),
+                                },
+                                name: lvol.name(),
+                            }
+                        })?);
+                    Pin::new(&mut lvol).share_nvmf(Some(props)).await?;
+                }
+            }
+
+            Ok(Replica::from(lvol))
+        }
+
+        None => Err(LvsError::InvalidBdev {
+            source: BdevError::BdevNotFound {
+                name: args.uuid.clone(),
+            },
+            name: args.uuid,
+        }),
+    }
+}
+
 #[tonic::async_trait]
 impl ReplicaRpc for ReplicaService {
     #[named]
@@ -190,77 +333,19 @@ impl ReplicaRpc for ReplicaService {
         &self,
         request: Request<CreateReplicaRequest>,
     ) -> GrpcResult<Replica> {
-        self.locked(GrpcClientContext::new(&request, function_name!()), async move {
-
-            let args = request.into_inner();
-            info!("{:?}", args);
-            if !matches!(
-                Protocol::try_from(args.share)?,
-                Protocol::Off | Protocol::Nvmf
-            ) {
-                return Err(LvsError::ReplicaShareProtocol {
-                    value: args.share,
-                }).map_err(Status::from);
-            }
-
-            let rx = rpc_submit(async move {
-                let lvs = match Lvs::lookup_by_uuid(&args.pooluuid) {
-                    Some(lvs) => lvs,
-                    None => {
-                        // lookup takes care of backward compatibility
-                        match Lvs::lookup(&args.pooluuid) {
-                            Some(lvs) => lvs,
-                            None => {
-                                return Err(LvsError::Invalid {
-                                    source: Errno::ENOMEDIUM,
-                                    msg: format!("Pool {} not found", args.pooluuid),
-                                })
-                            }
-                        }
-                    }
-                };
-                // if pooltype is not Lvs, the provided replica uuid need to be added as
-                match lvs.create_lvol(&args.name, args.size, Some(&args.uuid), args.thin, args.entity_id).await {
-                    Ok(mut lvol)
-                    if Protocol::try_from(args.share)? == Protocol::Nvmf => {
-                        let props = ShareProps::new()
-                            .with_allowed_hosts(args.allowed_hosts)
-                            .with_ptpl(lvol.ptpl().create().map_err(
-                                |source| LvsError::LvolShare {
-                                    source: crate::core::CoreError::Ptpl {
-                                        reason: source.to_string(),
-                                    },
-                                    name: lvol.name(),
-                                },
-                            )?);
-                        match Pin::new(&mut lvol).share_nvmf(Some(props)).await {
-                            Ok(s) => {
-                                debug!("created and shared {:?} as {}", lvol, s);
-                                Ok(Replica::from(lvol))
-                            }
-                            Err(e) => {
-                                debug!(
-                                    "failed to share created lvol {:?}: {} (destroying)",
-                                    lvol,
-                                    e.to_string()
-                                );
-                                let _ = lvol.destroy().await;
-                                Err(e)
-                            }
-                        }
-                    }
-                    Ok(lvol) => {
-                        debug!("created lvol {:?}", lvol);
-                        Ok(Replica::from(lvol))
-                    }
-                    Err(e) => Err(e),
-                }
-            })?;
-            rx.await
-                .map_err(|_| Status::cancelled("cancelled"))?
-                .map_err(Status::from)
-                .map(Response::new)
-        }).await
+        self.locked(
+            GrpcClientContext::new(&request, function_name!()),
+            async move {
+                let args = request.into_inner();
+                info!("{:?}", args);
+                let rx = rpc_submit(replica_create(args))?;
+                rx.await
+                    .map_err(|_| Status::cancelled("cancelled"))?
+                    .map_err(Status::from)
+                    .map(Response::new)
+            },
+        )
+        .await
     }
 
     #[named]
@@ -343,46 +428,18 @@ impl ReplicaRpc for ReplicaService {
         self.shared(GrpcClientContext::new(&request, function_name!()), async {
             let args = request.into_inner();
             trace!("{:?}", args);
-            let rx = rpc_submit::<_, _, LvsError>(async move {
-                let mut lvols = Vec::new();
-                if let Some(bdev) = UntypedBdev::bdev_first() {
-                    lvols = bdev
-                        .into_iter()
-                        .filter(|b| b.driver() == "lvol")
-                        .map(|b| Lvol::try_from(b).unwrap())
-                        .collect();
-                }
-
-                // perform filtering on lvols
-                if let Some(pool_name) = args.poolname {
-                    lvols.retain(|l| l.pool_name() == pool_name);
-                }
-                // perform filtering on lvols
-                if let Some(pool_uuid) = args.pooluuid {
-                    lvols.retain(|l| l.pool_uuid() == pool_uuid);
-                }
-
-                // convert lvols to replicas
-                let mut replicas: Vec<Replica> =
-                    lvols.into_iter().map(Replica::from).collect();
-
-                // perform the filtering on the replica list
-                if let Some(name) = args.name {
-                    replicas.retain(|r| r.name == name);
-                } else if let Some(uuid) = args.uuid {
-                    replicas.retain(|r| r.uuid == uuid);
-                }
-                let replicas =
-                    filter_replicas_by_replica_type(replicas, args.query);
-                Ok(ListReplicasResponse {
-                    replicas,
-                })
-            })?;
-
-            rx.await
-                .map_err(|_| Status::cancelled("cancelled"))?
-                .map_err(Status::from)
-                .map(Response::new)
+            let replicas = super::inventory::list_replicas(
+                args.poolname,
+                args.pooluuid,
+                args.name,
+                args.uuid,
+            )
+            .await?;
+            let replicas =
+                filter_replicas_by_replica_type(replicas, args.query);
+            Ok(Response::new(ListReplicasResponse {
+                replicas,
+            }))
         })
         .await
     }
@@ -397,61 +454,7 @@ impl ReplicaRpc for ReplicaService {
             async move {
                 let args = request.into_inner();
                 info!("{:?}", args);
-                let rx = rpc_submit(async move {
-                    match Bdev::lookup_by_uuid_str(&args.uuid) {
-                        Some(bdev) => {
-                            let mut lvol = Lvol::try_from(bdev)?;
-
-                            // if we are already shared with the same protocol
-                            if lvol.shared()
-                                == Some(Protocol::try_from(args.share)?)
-                            {
-                                Pin::new(&mut lvol)
-                                    .update_properties(
-                                        UpdateProps::new().with_allowed_hosts(
-                                            args.allowed_hosts,
-                                        ),
-                                    )
-                                    .await?;
-                                return Ok(Replica::from(lvol));
-                            }
-
-                            match Protocol::try_from(args.share)? {
-                                Protocol::Off => {
-                                    return Err(LvsError::Invalid {
-                                        source: Errno::EINVAL,
-                                        msg: "invalid share protocol NONE"
-                                            .to_string(),
-                                    })
-                                }
-                                Protocol::Nvmf => {
-                                    let props = ShareProps::new()
-                                        .with_allowed_hosts(args.allowed_hosts)
-                                        .with_ptpl(lvol.ptpl().create().map_err(
-                                            |source| LvsError::LvolShare {
-                                                source: crate::core::CoreError::Ptpl {
-                                                    reason: source.to_string(),
-                                                },
-                                                name: lvol.name(),
-                                            },
-                                        )?);
-                                    Pin::new(&mut lvol)
-                                        .share_nvmf(Some(props))
-                                        .await?;
-                                }
-                            }
-
-                            Ok(Replica::from(lvol))
-                        }
-
-                        None => Err(LvsError::InvalidBdev {
-                            source: BdevError::BdevNotFound {
-                                name: args.uuid.clone(),
-                            },
-                            name: args.uuid,
-                        }),
-                    }
-                })?;
+                let rx = rpc_submit(replica_share(args))?;
 
                 rx.await
                     .map_err(|_| Status::cancelled("cancelled"))?
@@ -459,7 +462,7 @@ impl ReplicaRpc for ReplicaService {
                     .map(Response::new)
             },
         )
-            .await
+        .await
     }
 
     #[named]
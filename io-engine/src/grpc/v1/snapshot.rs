@@ -464,68 +464,17 @@ impl SnapshotRpc for SnapshotService {
             async move {
                 let args = request.into_inner();
                 trace!("{:?}", args);
-                let rx = rpc_submit(async move {
-                    let snapshots: Vec<SnapshotInfo>;
-                    // if snapshot_uuid is input, get specific snapshot result
-                    if let Some(ref snapshot_uuid) = args.snapshot_uuid {
-                        let lvol = match UntypedBdev::lookup_by_uuid_str(
-                            snapshot_uuid,
-                        ) {
-                            Some(bdev) => Lvol::try_from(bdev)?,
-                            None => {
-                                return Err(LvsError::Invalid {
-                                    source: Errno::ENOENT,
-                                    msg: format!(
-                                        "Replica {snapshot_uuid} not found",
-                                    ),
-                                })
-                            }
-                        };
-                        snapshots = lvol
-                            .list_snapshot_by_snapshot_uuid()
-                            .into_iter()
-                            .map(SnapshotInfo::from)
-                            .collect();
-                    } else if let Some(ref replica_uuid) = args.source_uuid {
-                        // if replica_uuid is valid, filter snapshot based
-                        // on source_uuid
-                        let lvol =
-                            match UntypedBdev::lookup_by_uuid_str(replica_uuid)
-                            {
-                                Some(bdev) => Lvol::try_from(bdev)?,
-                                None => {
-                                    return Err(LvsError::Invalid {
-                                        source: Errno::ENOENT,
-                                        msg: format!(
-                                            "Replica {replica_uuid} not found",
-                                        ),
-                                    })
-                                }
-                            };
-                        snapshots = lvol
-                            .list_snapshot_by_source_uuid()
-                            .into_iter()
-                            .map(SnapshotInfo::from)
-                            .collect();
-                    } else {
-                        // if source_uuid is not input, list all snapshot
-                        // present in system
-                        snapshots = Lvol::list_all_snapshots(None)
-                            .into_iter()
-                            .map(SnapshotInfo::from)
-                            .collect();
-                    }
-                    let snapshots = filter_snapshots_by_snapshot_query_type(
-                        snapshots, args.query,
-                    );
-                    Ok(ListSnapshotsResponse {
-                        snapshots,
-                    })
-                })?;
-                rx.await
-                    .map_err(|_| Status::cancelled("cancelled"))?
-                    .map_err(Status::from)
-                    .map(Response::new)
+                let snapshots = super::inventory::list_snapshots(
+                    args.snapshot_uuid,
+                    args.source_uuid,
+                )
+                .await?;
+                let snapshots = filter_snapshots_by_snapshot_query_type(
+                    snapshots, args.query,
+                );
+                Ok(Response::new(ListSnapshotsResponse {
+                    snapshots,
+                }))
             },
         )
         .await
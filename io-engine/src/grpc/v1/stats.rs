@@ -270,6 +270,9 @@ impl StatsRpc for StatsService {
                             let _ = bdev.reset_bdev_io_stats().await?;
                         }
                     }
+                    for nexus in nexus::nexus_iter() {
+                        nexus.reset_io_latency().await;
+                    }
                     Ok(())
                 })?;
                 rx.await
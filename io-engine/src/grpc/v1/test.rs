@@ -322,6 +322,9 @@ impl From<WipeError> for tonic::Status {
             WipeError::MethodUnimplemented {
                 ..
             } => Self::invalid_argument(value.to_string()),
+            WipeError::MethodUnsupported {
+                ..
+            } => Self::failed_precondition(value.to_string()),
             WipeError::ChunkNotifyFailed {
                 ..
             } => Self::internal(value.to_string()),
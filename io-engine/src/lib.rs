@@ -20,6 +20,8 @@ pub mod bdev;
 pub mod delay;
 pub use spdk_rs::ffihelper;
 pub mod bdev_api;
+#[cfg(feature = "bench-internals")]
+pub mod bench;
 pub mod constants;
 pub mod eventing;
 pub mod grpc;
@@ -49,4 +51,5 @@ pub extern "C" fn cps_init() {
     subsys::register_subsystem();
     bdev::nexus::register_module(true);
     bdev::null_ng::register();
+    grpc::v1::batch::register();
 }
@@ -34,7 +34,7 @@ use std::{
 };
 use strum::{EnumCount, IntoEnumIterator};
 
-use super::Error;
+use super::{pool_changed, Error};
 use futures::future::join_all;
 
 pub trait AsyncParentIterator {
@@ -255,6 +255,7 @@ impl SnapshotOps for Lvol {
             receiver.await.expect("Snapshot done callback disappeared");
         match error {
             0 => {
+                pool_changed(self.pool_uuid());
                 snap_param.event(EventAction::Create).generate();
                 Ok(Lvol::from_inner_ptr(lvol_ptr))
             }
@@ -413,6 +414,7 @@ impl SnapshotOps for Lvol {
             .expect("Snapshot Clone done callback disappeared");
         match error {
             0 => {
+                pool_changed(self.pool_uuid());
                 clone_param.event(EventAction::Create).generate();
                 Ok(Lvol::from_inner_ptr(lvol_ptr))
             }
@@ -531,13 +533,16 @@ impl SnapshotOps for Lvol {
     ) {
         extern "C" fn snapshot_done_cb(
             nvmf_req_ptr: *mut c_void,
-            _lvol_ptr: *mut spdk_lvol,
+            lvol_ptr: *mut spdk_lvol,
             errno: i32,
         ) {
             let nvmf_req = NvmfReq::from(nvmf_req_ptr);
 
             match errno {
-                0 => nvmf_req.complete(),
+                0 => {
+                    pool_changed(Lvol::from_inner_ptr(lvol_ptr).pool_uuid());
+                    nvmf_req.complete();
+                }
                 _ => {
                     error!("vbdev_lvol_create_snapshot_ext errno {}", errno);
                     nvmf_req.complete_error(errno);
@@ -0,0 +1,75 @@
+//!
+//! Blocks written to an lvol since one of its snapshots.
+//!
+//! A nexus snapshot creates a snapshot of every healthy replica with the same
+//! transaction id, while the nexus I/O is frozen: snapshots sharing a
+//! transaction id hold the same data. Snapshots make the clusters of their
+//! lvol read-only, so the blocks written to an lvol since one of its
+//! snapshots are the ones allocated by the blobs above that snapshot in its
+//! chain. Rebuilds use this to only copy the blocks which may differ between
+//! two replicas sharing a snapshot, whether local or remote.
+use super::{
+    lvol_snapshot::AsyncParentIterator,
+    Lvol,
+    LvolSnapshotIter,
+    LvsLvol,
+};
+use crate::core::snapshot::SnapshotDescriptor;
+
+impl Lvol {
+    /// Returns the snapshots of this lvol, newest first, with their
+    /// transaction ids. The id of a snapshot not created by a transaction is
+    /// empty.
+    fn snapshot_chain(&self) -> Vec<(Lvol, String)> {
+        let mut chain = Vec::new();
+        let mut iter = LvolSnapshotIter::new(self.clone());
+        while let Some(snapshot) = iter.parent() {
+            chain.push((
+                snapshot.snapshot_lvol().clone(),
+                snapshot.snapshot_params().txn_id().unwrap_or_default(),
+            ));
+        }
+        chain
+    }
+
+    /// Returns the transaction ids of the snapshots of this lvol, newest
+    /// first. The id of a snapshot not created by a transaction is empty.
+    pub(crate) fn snapshot_txn_ids(&self) -> Vec<String> {
+        self.snapshot_chain()
+            .into_iter()
+            .map(|(_, txn_id)| txn_id)
+            .collect()
+    }
+
+    /// Returns the map of the blocks written to this lvol since its snapshot
+    /// at the given index of `snapshot_txn_ids()`, with one bit per unit of
+    /// `granularity` blocks, the first unit being the lowest bit of the first
+    /// byte. Returns None if there is no such snapshot.
+    pub(crate) fn snapshot_delta_bitmap(
+        &self,
+        snapshot_idx: usize,
+        granularity: u64,
+    ) -> Option<Vec<u8>> {
+        let chain = self.snapshot_chain();
+        if snapshot_idx >= chain.len() || granularity == 0 {
+            return None;
+        }
+
+        let num_blocks = self.as_bdev().num_blocks();
+        let units = (num_blocks + granularity - 1) / granularity;
+        let mut bitmap = vec![0u8; ((units + 7) / 8) as usize];
+
+        std::iter::once(self)
+            .chain(chain[.. snapshot_idx].iter().map(|(lvol, _)| lvol))
+            .flat_map(|lvol| lvol.own_allocated_extents())
+            .filter(|(blk, _)| *blk < num_blocks)
+            .for_each(|(blk, cnt)| {
+                let last = (blk + cnt).min(num_blocks) - 1;
+                for unit in blk / granularity ..= last / granularity {
+                    bitmap[(unit / 8) as usize] |= 1 << (unit % 8);
+                }
+            });
+
+        Some(bitmap)
+    }
+}
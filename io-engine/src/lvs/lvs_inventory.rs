@@ -0,0 +1,63 @@
+//!
+//! Change tracking of the lvol stores and their lvols.
+//!
+//! The lvol store code records here which pools had an lvol created,
+//! destroyed, resized, shared or had its xattrs changed, so that the
+//! inventory caches built on top of the lvol stores (e.g. the one serving the
+//! gRPC list calls) only have to rebuild the entries of the changed pools.
+//! Changes are recorded and taken on the reactor owning the lvol stores, so
+//! that a cache rebuilt right after taking the changes misses none of them.
+use std::collections::HashSet;
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+
+/// Changes of the lvol stores since they were last taken.
+#[derive(Debug, Default)]
+pub struct InventoryChanges {
+    /// The set of pools itself may have changed, or the changes are not
+    /// known: everything has to be rebuilt.
+    pub all: bool,
+    /// UUIDs of the pools whose lvols have changed.
+    pub pools: HashSet<String>,
+}
+
+impl InventoryChanges {
+    /// True if there is no change.
+    pub fn is_empty(&self) -> bool {
+        !self.all && self.pools.is_empty()
+    }
+}
+
+/// Changes not taken yet. Nothing is known at startup.
+static CHANGES: Lazy<Mutex<InventoryChanges>> = Lazy::new(|| {
+    Mutex::new(InventoryChanges {
+        all: true,
+        pools: HashSet::new(),
+    })
+});
+
+/// Records a change of the lvols of the given pool.
+pub fn pool_changed(pool_uuid: String) {
+    let mut changes = CHANGES.lock();
+    if !changes.all {
+        changes.pools.insert(pool_uuid);
+    }
+}
+
+/// Records a change of the set of pools.
+pub fn inventory_changed() {
+    let mut changes = CHANGES.lock();
+    changes.all = true;
+    changes.pools.clear();
+}
+
+/// True if changes were recorded since they were last taken.
+pub fn has_inventory_changes() -> bool {
+    !CHANGES.lock().is_empty()
+}
+
+/// Takes the changes recorded since they were last taken.
+pub fn take_inventory_changes() -> InventoryChanges {
+    std::mem::take(&mut *CHANGES.lock())
+}
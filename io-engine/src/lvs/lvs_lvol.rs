@@ -17,6 +17,8 @@ use std::{
 use spdk_rs::libspdk::{
     spdk_blob,
     spdk_blob_calc_used_clusters,
+    spdk_blob_get_next_allocated_io_unit,
+    spdk_blob_get_next_unallocated_io_unit,
     spdk_blob_get_num_clusters,
     spdk_blob_get_num_clusters_ancestors,
     spdk_blob_get_xattr_value,
@@ -34,7 +36,7 @@ use spdk_rs::libspdk::{
     LVS_CLEAR_WITH_UNMAP,
 };
 
-use super::{Error, Lvs};
+use super::{pool_changed, Error, Lvs};
 
 use crate::{
     bdev::PtplFileOps,
@@ -231,6 +233,7 @@ impl Share for Lvol {
                 source: e,
                 name: self.name(),
             })?;
+        pool_changed(self.pool_uuid());
         Ok(())
     }
 
@@ -337,6 +340,12 @@ impl Lvol {
             })?;
 
         let wiper = Wiper::new(hdl, wipe_method)?;
+
+        // Whole clusters unmapped from a thin provisioned blob are released,
+        // and read back as zeroes unless the blob has a parent.
+        if self.is_thin() && !self.has_parent_blob() {
+            return Ok(wiper.with_zeroing_unmap(self.lvs().blob_cluster_size()));
+        }
         Ok(wiper)
     }
 
@@ -365,6 +374,40 @@ impl Lvol {
         LvolPtpl::from(self)
     }
 
+    /// Determines if the blob of this lvol has a parent blob, i.e. if its
+    /// unallocated clusters read the data of a snapshot or clone source.
+    pub(crate) fn has_parent_blob(&self) -> bool {
+        unsafe { !spdk_bs_get_parent_blob(self.blob_checked()).is_null() }
+    }
+
+    /// Returns the extents allocated by the blob of this lvol itself,
+    /// excluding the clusters of its parent blobs, as pairs of first block
+    /// and number of blocks.
+    pub(crate) fn own_allocated_extents(&self) -> Vec<(u64, u64)> {
+        let blob = self.blob_checked();
+        let num_blocks = self.as_bdev().num_blocks();
+        let mut extents = Vec::new();
+
+        let mut offset = 0;
+        while offset < num_blocks {
+            let start =
+                unsafe { spdk_blob_get_next_allocated_io_unit(blob, offset) };
+            if start >= num_blocks {
+                break;
+            }
+            let end =
+                unsafe { spdk_blob_get_next_unallocated_io_unit(blob, start) }
+                    .min(num_blocks);
+            if end <= start {
+                break;
+            }
+            extents.push((start, end - start));
+            offset = end;
+        }
+
+        extents
+    }
+
     /// Common API to get the xattr from blob.
     pub fn get_blob_xattr(blob: *mut spdk_blob, attr: &str) -> Option<String> {
         if blob.is_null() {
@@ -471,6 +514,7 @@ impl Lvol {
                 name: self.name(),
             });
         }
+        pool_changed(self.pool_uuid());
 
         if !sync_metadata {
             return Ok(());
@@ -895,6 +939,7 @@ impl LvsLvol for Lvol {
         let _ = Pin::new(&mut self).unshare().await;
 
         let name = self.name();
+        let pool_uuid = self.pool_uuid();
         let ptpl = self.ptpl();
 
         let (s, r) = pair::<i32>();
@@ -921,6 +966,7 @@ impl LvsLvol for Lvol {
         }
 
         info!("destroyed lvol {}", name);
+        pool_changed(pool_uuid);
         event.generate();
         Ok(name)
     }
@@ -992,6 +1038,7 @@ impl LvsLvol for Lvol {
                 })?;
             }
         }
+        pool_changed(self.pool_uuid());
         Ok(())
     }
 
@@ -1127,6 +1174,7 @@ impl LvsLvol for Lvol {
         match cb_ret {
             Ok(_) => {
                 info!("Resized {:?} successfully", self);
+                pool_changed(self.pool_uuid());
                 Ok(())
             }
             Err(errno) => {
@@ -7,8 +7,9 @@ use std::{
 };
 
 use byte_unit::Byte;
-use futures::channel::oneshot;
+use futures::{channel::oneshot, stream, StreamExt};
 use nix::errno::Errno;
+use once_cell::sync::Lazy;
 use pin_utils::core_reexport::fmt::Formatter;
 use spdk_rs::libspdk::{
     spdk_blob_store,
@@ -33,7 +34,16 @@ use spdk_rs::libspdk::{
 };
 use url::Url;
 
-use super::{Error, ImportErrorReason, Lvol, LvsIter, PropName, PropValue};
+use super::{
+    inventory_changed,
+    pool_changed,
+    Error,
+    ImportErrorReason,
+    Lvol,
+    LvsIter,
+    PropName,
+    PropValue,
+};
 
 use crate::{
     bdev::{uri, PtplFileOps},
@@ -61,6 +71,14 @@ static ROUND_TO_MB: u32 = 1024 * 1024;
 static DEFAULT_CLUSTER_SIZE: u32 = 4 * 1024 * 1024;
 /// Maximum spdk cluster size can be considered as 1GiB.
 static MAX_CLUSTER_SIZE: u32 = 1024 * 1024 * 1024;
+/// Maximum number of lvols shared at once when importing a pool.
+static POOL_SHARE_CONCURRENCY: Lazy<usize> = Lazy::new(|| {
+    std::env::var("POOL_SHARE_CONCURRENCY")
+        .ok()
+        .and_then(|s| s.parse::<usize>().ok())
+        .unwrap_or(16)
+        .max(1)
+});
 
 impl Debug for Lvs {
     fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
@@ -320,6 +338,7 @@ impl Lvs {
             })
         } else {
             lvs.share_all().await;
+            inventory_changed();
             info!("{:?}: existing lvs imported successfully", lvs);
             Ok(lvs)
         }
@@ -484,6 +503,7 @@ impl Lvs {
 
         match Self::lookup(name) {
             Some(pool) => {
+                inventory_changed();
                 info!("{:?}: new lvs created successfully", pool);
                 Ok(pool)
             }
@@ -604,6 +624,7 @@ impl Lvs {
                 name: pool.clone(),
             })?;
 
+        inventory_changed();
         info!("{}: lvs exported successfully", self_str);
 
         bdev_destroy(&base_bdev.bdev_uri_original_str().unwrap_or_default())
@@ -629,10 +650,16 @@ impl Lvs {
     }
 
     /// share all lvols who have the shared property set, this is implicitly
-    /// shared over nvmf
+    /// shared over nvmf. Up to `POOL_SHARE_CONCURRENCY` lvols are shared at
+    /// once, as creating and starting a subsystem mostly waits for the other
+    /// cores.
     async fn share_all(&self) {
-        if let Some(lvols) = self.lvols() {
-            for mut l in lvols {
+        let Some(lvols) = self.lvols() else {
+            return;
+        };
+
+        stream::iter(lvols.collect::<Vec<_>>())
+            .for_each_concurrent(*POOL_SHARE_CONCURRENCY, |mut l| async move {
                 let allowed_hosts = match l.get(PropName::AllowedHosts).await {
                     Ok(PropValue::AllowedHosts(hosts)) => hosts,
                     _ => vec![],
@@ -663,8 +690,8 @@ impl Lvs {
                         _ => {}
                     }
                 }
-            }
-        }
+            })
+            .await;
     }
 
     /// destroys the given pool deleting the on disk super blob before doing so,
@@ -700,6 +727,7 @@ impl Lvs {
                 name: pool.clone(),
             })?;
 
+        inventory_changed();
         info!("{}: lvs destroyed successfully", self_str);
 
         evt.generate();
@@ -891,6 +919,7 @@ impl Lvs {
             return Err(error);
         }
 
+        pool_changed(self.uuid());
         info!("{lvol:?}: created");
         lvol.event(EventAction::Create).generate();
         Ok(lvol)
@@ -1,13 +1,21 @@
 pub use lvol_snapshot::LvolSnapshotIter;
 pub use lvs_bdev::LvsBdev;
 pub use lvs_error::{Error, ImportErrorReason};
+pub use lvs_inventory::{
+    has_inventory_changes,
+    take_inventory_changes,
+    InventoryChanges,
+};
+pub(crate) use lvs_inventory::{inventory_changed, pool_changed};
 pub use lvs_iter::{LvsBdevIter, LvsIter};
 pub use lvs_lvol::{Lvol, LvolSpaceUsage, LvsLvol, PropName, PropValue};
 pub use lvs_store::Lvs;
 
 mod lvol_snapshot;
+mod lvol_snapshot_delta;
 mod lvs_bdev;
 mod lvs_error;
+mod lvs_inventory;
 mod lvs_iter;
 pub mod lvs_lvol;
 mod lvs_store;
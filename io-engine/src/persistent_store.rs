@@ -20,12 +20,16 @@ use crate::{
         },
     },
 };
-use futures::channel::oneshot;
-use once_cell::sync::OnceCell;
+use futures::{channel::oneshot, future::join_all};
+use once_cell::sync::{Lazy, OnceCell};
 use parking_lot::Mutex;
 use serde_json::Value;
 use snafu::ResultExt;
-use std::{future::Future, time::Duration};
+use std::{
+    collections::{HashMap, VecDeque},
+    future::Future,
+    time::Duration,
+};
 
 /// Persistent store builder.
 pub struct PersistentStoreBuilder {
@@ -107,6 +111,77 @@ pub struct PersistentStore {
 /// Persistent store global instance.
 static PERSISTENT_STORE: OnceCell<Mutex<PersistentStore>> = OnceCell::new();
 
+/// Maximum number of puts of a store transaction, which is the default limit
+/// of etcd servers.
+const MAX_TXN_PUTS: usize = 128;
+
+/// Maximum number of concurrent transactions of a batched put round.
+const MAX_TXN_INFLIGHT: usize = 4;
+
+/// Sender of the result of a batched put.
+type PutSender = oneshot::Sender<Result<(), StoreError>>;
+
+/// Batched puts waiting to be written to the store.
+#[derive(Default)]
+struct PutBatch {
+    /// Keys in the order of their first pending put.
+    order: VecDeque<String>,
+    /// Latest value of every pending key, and the senders of its waiters.
+    pending: HashMap<String, (Value, Vec<PutSender>)>,
+    /// Set while a task writes the pending puts.
+    flushing: bool,
+}
+
+impl PutBatch {
+    /// Adds a put, replacing the pending value of the same key, if any.
+    fn push(&mut self, key: String, value: Value, sender: PutSender) {
+        match self.pending.get_mut(&key) {
+            Some((pending, senders)) => {
+                *pending = value;
+                senders.push(sender);
+            }
+            None => {
+                self.order.push_back(key.clone());
+                self.pending.insert(key, (value, vec![sender]));
+            }
+        }
+    }
+
+    /// Takes the oldest pending puts, split into transactions.
+    fn take_round(&mut self) -> Vec<PutTxn> {
+        let mut txns = Vec::new();
+        while txns.len() < MAX_TXN_INFLIGHT && !self.order.is_empty() {
+            let mut txn = PutTxn::default();
+            while txn.kvs.len() < MAX_TXN_PUTS {
+                let Some(key) = self.order.pop_front() else {
+                    break;
+                };
+                let (value, senders) = self
+                    .pending
+                    .remove(&key)
+                    .expect("Pending put should have a value");
+                txn.senders
+                    .extend(senders.into_iter().map(|s| (key.clone(), s)));
+                txn.kvs.push((key, value));
+            }
+            txns.push(txn);
+        }
+        txns
+    }
+}
+
+/// A transaction of batched puts.
+#[derive(Default)]
+struct PutTxn {
+    /// Key-values to put.
+    kvs: Vec<(String, Value)>,
+    /// Senders of the waiters of the puts, with their keys.
+    senders: Vec<(String, PutSender)>,
+}
+
+/// Batched puts global instance.
+static PUT_BATCH: Lazy<Mutex<PutBatch>> = Lazy::new(Default::default);
+
 impl PersistentStore {
     /// Initialises the persistent store.
     /// If the supplied endpoint is 'None', the store is uninitalised and
@@ -204,6 +279,109 @@ impl PersistentStore {
         })?
     }
 
+    /// Puts a key-value in the store as part of a batch.
+    /// Puts issued while previous ones are being written are coalesced per
+    /// key, only the latest value of a key being written, and are written
+    /// together in a few concurrent store transactions. Returns once the
+    /// value, or a later value of the same key, has been written, so that
+    /// callers can rely on it being persisted as with `put`.
+    pub async fn put_batched(
+        key: &impl StoreKey,
+        value: &impl StoreValue,
+    ) -> Result<(), StoreError> {
+        let put_value = serde_json::to_value(value)
+            .expect("Failed to convert value to a serde_json value");
+
+        let (tx, rx) = oneshot::channel();
+        let start = {
+            let mut batch = PUT_BATCH.lock();
+            batch.push(key.to_string(), put_value.clone(), tx);
+            !std::mem::replace(&mut batch.flushing, true)
+        };
+        if start {
+            core::runtime::spawn(Self::flush_put_batch());
+        }
+
+        rx.await.context(PutWait {
+            key: key.to_string(),
+            value: put_value.to_string(),
+        })?
+    }
+
+    /// Writes the batched puts until none is pending, one round of
+    /// concurrent transactions after the other, so that the same key is
+    /// never written by two transactions at the same time.
+    async fn flush_put_batch() {
+        loop {
+            let txns = {
+                let mut batch = PUT_BATCH.lock();
+                let txns = batch.take_round();
+                if txns.is_empty() {
+                    batch.flushing = false;
+                    return;
+                }
+                txns
+            };
+
+            let num_kvs: usize = txns.iter().map(|t| t.kvs.len()).sum();
+            debug!(
+                "Putting {num_kvs} keys in store in {n} transaction(s).",
+                n = txns.len()
+            );
+
+            let op_timeout = Self::timeout();
+            let results = join_all(txns.into_iter().map(|txn| async move {
+                let result = match tokio::time::timeout(
+                    op_timeout,
+                    Self::backing_store().put_kvs(&txn.kvs),
+                )
+                .await
+                {
+                    Ok(result) => result,
+                    Err(_) => Err(StoreError::OpTimeout {}),
+                };
+                (txn.senders, result)
+            }))
+            .await;
+
+            if results
+                .iter()
+                .any(|(_, r)| matches!(r, Err(StoreError::OpTimeout { .. })))
+            {
+                Self::reconnect().await;
+            }
+
+            // Execute the sending of the results on a "Mayastor thread".
+            let rx = Reactor::spawn_at_primary(async move {
+                for (senders, result) in results {
+                    if let Err(e) = &result {
+                        error!("Failed to put a batch of keys in store: {e}");
+                    }
+                    for (key, tx) in senders {
+                        let result = match &result {
+                            Ok(_) => Ok(()),
+                            Err(StoreError::OpTimeout {
+                                ..
+                            }) => Err(StoreError::OpTimeout {}),
+                            Err(e) => Err(StoreError::BatchPut {
+                                key,
+                                error: e.to_string(),
+                            }),
+                        };
+                        if tx.send(result).is_err() {
+                            tracing::error!(
+                                "Failed to send completion for batched 'put' \
+                                request."
+                            );
+                        }
+                    }
+                }
+            })
+            .expect("Failed to send future to Mayastor thread");
+            let _ = rx.await;
+        }
+    }
+
     /// Retrieves a value, with the given key, from the store.
     pub async fn get(key: &impl StoreKey) -> Result<Value, StoreError> {
         let key_string = key.to_string();
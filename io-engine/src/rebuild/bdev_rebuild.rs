@@ -7,7 +7,7 @@ use super::{
     rebuild_task::{RebuildTasks, TaskResult},
     RebuildJob,
     RebuildJobOptions,
-    SEGMENT_TASKS,
+    SEGMENT_TASKS_MAX,
 };
 
 use crate::{
@@ -69,14 +69,15 @@ impl BdevRebuildJobBuilder {
         src_uri: &str,
         dst_uri: &str,
     ) -> Result<BdevRebuildJob, RebuildError> {
-        let descriptor =
+        let mut descriptor =
             RebuildDescriptor::new(src_uri, dst_uri, self.range, self.options)
                 .await?;
-        let task_pool = RebuildTasks::new(SEGMENT_TASKS, &descriptor)?;
+        let task_pool = RebuildTasks::new(SEGMENT_TASKS_MAX, &descriptor)?;
         let notify_fn = self.notify_fn.unwrap_or(|_, _| {});
         match self.rebuild_map {
             Some(map) => {
                 descriptor.validate_map(&map)?;
+                descriptor.dst_stale = true;
                 let backend = BdevRebuildJobBackend {
                     task_pool,
                     notify_fn,
@@ -1,11 +1,14 @@
 mod bdev_rebuild;
 mod nexus_rebuild;
+mod rebuild_budget;
+mod rebuild_concurrency;
 mod rebuild_descriptor;
 mod rebuild_error;
 mod rebuild_instances;
 mod rebuild_job;
 mod rebuild_job_backend;
 mod rebuild_map;
+mod rebuild_snapshot_delta;
 mod rebuild_state;
 mod rebuild_stats;
 mod rebuild_task;
@@ -13,25 +16,44 @@ mod rebuilders;
 
 pub use bdev_rebuild::BdevRebuildJob;
 pub use nexus_rebuild::{NexusRebuildJob, NexusRebuildJobStarter};
+pub use rebuild_budget::{
+    node_rebuild_budget,
+    set_node_rebuild_budget,
+    RebuildBudget,
+};
+use rebuild_concurrency::TaskConcurrency;
 use rebuild_descriptor::RebuildDescriptor;
 pub(crate) use rebuild_error::RebuildError;
 use rebuild_job::RebuildOperation;
-pub use rebuild_job::{RebuildJob, RebuildJobOptions, RebuildVerifyMode};
+pub use rebuild_job::{
+    RebuildJob,
+    RebuildJobOptions,
+    RebuildVerifyMethod,
+    RebuildVerifyMode,
+};
 use rebuild_job_backend::{
     RebuildFBendChan,
     RebuildJobBackendManager,
     RebuildJobRequest,
 };
 pub use rebuild_map::RebuildMap;
+pub(crate) use rebuild_snapshot_delta::snapshot_delta_map;
 pub use rebuild_state::RebuildState;
 use rebuild_state::RebuildStates;
 pub(crate) use rebuild_stats::HistoryRecord;
 pub use rebuild_stats::RebuildStats;
 use rebuild_task::{RebuildTasks, TaskResult};
 
-/// Number of concurrent copy tasks per rebuild job
+/// Initial number of concurrent copy tasks per rebuild job
 const SEGMENT_TASKS: usize = 16;
 
+/// Minimal number of concurrent copy tasks per rebuild job
+const SEGMENT_TASKS_MIN: usize = 2;
+
+/// Maximal number of concurrent copy tasks per rebuild job; this is also the
+/// number of copy buffers allocated per job
+const SEGMENT_TASKS_MAX: usize = 32;
+
 /// Size of each segment used by the copy task
 pub(crate) const SEGMENT_SIZE: u64 =
     spdk_rs::libspdk::SPDK_BDEV_LARGE_BUF_MAX_SIZE as u64;
@@ -28,7 +28,7 @@ use super::{
     rebuild_job_backend::RebuildBackend,
     rebuild_task::{RebuildTasks, TaskResult},
     RebuildJobOptions,
-    SEGMENT_TASKS,
+    SEGMENT_TASKS_MAX,
 };
 
 /// A Nexus rebuild job is responsible for managing a rebuild (copy) which reads
@@ -92,7 +92,7 @@ impl NexusRebuildJob {
         let descriptor =
             RebuildDescriptor::new(src_uri, dst_uri, Some(range), options)
                 .await?;
-        let tasks = RebuildTasks::new(SEGMENT_TASKS, &descriptor)?;
+        let tasks = RebuildTasks::new(SEGMENT_TASKS_MAX, &descriptor)?;
 
         let backend = NexusRebuildJobBackendStarter::new(
             nexus_name, tasks, notify_fn, descriptor,
@@ -223,12 +223,13 @@ impl NexusRebuildJobBackendStarter {
     }
 
     fn into_partial_seq(
-        self,
+        mut self,
         map: RebuildMap,
     ) -> NexusRebuildJobBackend<
         PartialSeqCopier<NexusRebuildDescriptor>,
         PartialSeqRebuild<NexusRebuildDescriptor>,
     > {
+        self.descriptor.common.dst_stale = true;
         NexusRebuildJobBackend {
             task_pool: self.task_pool,
             notify_fn: self.notify_fn,
@@ -0,0 +1,257 @@
+use std::time::{Duration, Instant};
+
+use once_cell::sync::Lazy;
+use parking_lot::Mutex;
+use serde::{Deserialize, Serialize};
+
+/// Bandwidth and IOPS budget of rebuild copies. A zero value means no limit.
+#[derive(
+    Debug, Default, Clone, Copy, PartialEq, Eq, Serialize, Deserialize,
+)]
+#[serde(default)]
+pub struct RebuildBudget {
+    /// Maximum number of bytes copied per second.
+    pub bytes_per_sec: u64,
+    /// Maximum number of segment copies per second.
+    pub iops: u64,
+}
+
+impl RebuildBudget {
+    /// Creates a new budget.
+    pub fn new(bytes_per_sec: u64, iops: u64) -> Self {
+        Self {
+            bytes_per_sec,
+            iops,
+        }
+    }
+
+    /// True if the budget does not limit anything.
+    pub fn is_unlimited(&self) -> bool {
+        self.bytes_per_sec == 0 && self.iops == 0
+    }
+}
+
+/// A single-rate token bucket. Tokens may go negative: a reservation that
+/// exceeds the available tokens is granted immediately but the caller is told
+/// how long to wait before issuing it. Subsequent reservations queue behind
+/// the debt, so the long term rate never exceeds the configured one.
+#[derive(Debug)]
+struct Bucket {
+    /// Tokens added per second; zero means unlimited.
+    rate: u64,
+    /// Current number of tokens.
+    tokens: i64,
+    /// Time up to which tokens have been added.
+    refilled: Instant,
+}
+
+impl Bucket {
+    fn new(rate: u64, now: Instant) -> Self {
+        Self {
+            rate,
+            tokens: rate as i64,
+            refilled: now,
+        }
+    }
+
+    /// Refills the bucket up to the given time, capped at one second worth
+    /// of tokens (the burst size).
+    fn refill(&mut self, now: Instant) {
+        if self.rate == 0 {
+            return;
+        }
+
+        let elapsed = now.saturating_duration_since(self.refilled).as_nanos();
+        let add = elapsed * self.rate as u128 / 1_000_000_000;
+        if add == 0 {
+            return;
+        }
+
+        let tokens = self.tokens.saturating_add(add as i64);
+        if tokens >= self.rate as i64 {
+            self.tokens = self.rate as i64;
+            self.refilled = now;
+        } else {
+            // Only the time of the added tokens is consumed, so that no
+            // fraction of a token is lost between refills.
+            let used = add * 1_000_000_000 / self.rate as u128;
+            self.tokens = tokens;
+            self.refilled += Duration::from_nanos(used as u64);
+        }
+    }
+
+    /// Takes the given number of tokens and returns how long the caller must
+    /// wait until they are actually available.
+    fn take(&mut self, n: u64) -> Duration {
+        if self.rate == 0 {
+            return Duration::ZERO;
+        }
+        self.tokens -= n as i64;
+        if self.tokens >= 0 {
+            Duration::ZERO
+        } else {
+            Duration::from_micros((-self.tokens) as u64 * 1_000_000 / self.rate)
+        }
+    }
+
+    /// Gives back the given number of tokens, up to the burst size.
+    fn give(&mut self, n: u64) {
+        if self.rate == 0 {
+            return;
+        }
+        self.tokens =
+            (self.tokens.saturating_add(n as i64)).min(self.rate as i64);
+    }
+}
+
+/// Token bucket enforcing a `RebuildBudget`.
+#[derive(Debug)]
+pub(super) struct BudgetBucket {
+    budget: RebuildBudget,
+    bytes: Bucket,
+    ops: Bucket,
+}
+
+impl Default for BudgetBucket {
+    fn default() -> Self {
+        Self::new(RebuildBudget::default())
+    }
+}
+
+impl BudgetBucket {
+    /// Creates a new bucket for the given budget.
+    pub(super) fn new(budget: RebuildBudget) -> Self {
+        let now = Instant::now();
+        Self {
+            budget,
+            bytes: Bucket::new(budget.bytes_per_sec, now),
+            ops: Bucket::new(budget.iops, now),
+        }
+    }
+
+    /// Returns the budget enforced by this bucket.
+    pub(super) fn budget(&self) -> RebuildBudget {
+        self.budget
+    }
+
+    /// Sets a new budget, resetting the bucket.
+    pub(super) fn set_budget(&mut self, budget: RebuildBudget) {
+        *self = Self::new(budget);
+    }
+
+    /// Reserves a copy of the given number of bytes and returns how long the
+    /// copy must be delayed to stay within the budget.
+    pub(super) fn reserve(&mut self, bytes: u64) -> Duration {
+        self.reserve_at(bytes, Instant::now())
+    }
+
+    /// Reserves a copy of the given number of bytes at the given time.
+    fn reserve_at(&mut self, bytes: u64, now: Instant) -> Duration {
+        if self.budget.is_unlimited() {
+            return Duration::ZERO;
+        }
+
+        self.bytes.refill(now);
+        self.ops.refill(now);
+
+        self.bytes.take(bytes).max(self.ops.take(1))
+    }
+
+    /// Gives back a reservation of the given number of bytes, for a copy
+    /// which did not transfer any data.
+    pub(super) fn refund(&mut self, bytes: u64) {
+        if self.budget.is_unlimited() {
+            return;
+        }
+        self.bytes.give(bytes);
+        self.ops.give(1);
+    }
+}
+
+/// Budget shared by all rebuild jobs of this node.
+static NODE_BUDGET: Lazy<Mutex<BudgetBucket>> =
+    Lazy::new(|| Mutex::new(BudgetBucket::default()));
+
+/// Sets the budget shared by all rebuild jobs running on this node.
+pub fn set_node_rebuild_budget(budget: RebuildBudget) {
+    info!("Setting node rebuild budget to {budget:?}");
+    NODE_BUDGET.lock().set_budget(budget);
+}
+
+/// Returns the budget shared by all rebuild jobs running on this node.
+pub fn node_rebuild_budget() -> RebuildBudget {
+    NODE_BUDGET.lock().budget()
+}
+
+/// Reserves a copy of the given number of bytes in both the job and the node
+/// budgets, and returns how long the copy must be delayed.
+pub(super) fn reserve_copy(job: &Mutex<BudgetBucket>, bytes: u64) -> Duration {
+    let job_delay = job.lock().reserve(bytes);
+    let node_delay = NODE_BUDGET.lock().reserve(bytes);
+    job_delay.max(node_delay)
+}
+
+/// Gives back a reservation of the given number of bytes to both the job and
+/// the node budgets, for a copy which did not transfer any data.
+pub(super) fn refund_copy(job: &Mutex<BudgetBucket>, bytes: u64) {
+    job.lock().refund(bytes);
+    NODE_BUDGET.lock().refund(bytes);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Reserves a copy every `interval` for `duration`, and returns the
+    /// delay of the last one.
+    fn reserve_every(
+        bucket: &mut BudgetBucket,
+        bytes: u64,
+        interval: Duration,
+        duration: Duration,
+    ) -> Duration {
+        let start = bucket.ops.refilled;
+        let n = duration.as_nanos() / interval.as_nanos();
+        (1 ..= n)
+            .map(|i| bucket.reserve_at(bytes, start + interval * i as u32))
+            .last()
+            .unwrap()
+    }
+
+    #[test]
+    fn sub_token_refills_keep_rate() {
+        // Half a token accrues between reservations.
+        let mut bucket = BudgetBucket::new(RebuildBudget::new(0, 1000));
+        let delay = reserve_every(
+            &mut bucket,
+            4096,
+            Duration::from_micros(500),
+            Duration::from_secs(10),
+        );
+
+        // 20000 copies are reserved, 1000 from the burst and 10000 from the
+        // refills: the last one waits for the other 9000 at 1000/s.
+        let expected = Duration::from_secs(9);
+        let diff = delay.max(expected) - delay.min(expected);
+        assert!(
+            diff < Duration::from_millis(10),
+            "last copy delayed by {:?}",
+            delay
+        );
+    }
+
+    #[test]
+    fn idle_bucket_caps_at_burst() {
+        let mut bucket = BudgetBucket::new(RebuildBudget::new(1024 * 1024, 0));
+        let start = bucket.bytes.refilled;
+
+        // After a long idle time, only one second worth of bytes is
+        // available.
+        let now = start + Duration::from_secs(60);
+        assert_eq!(bucket.reserve_at(1024 * 1024, now), Duration::ZERO);
+        assert_eq!(
+            bucket.reserve_at(512 * 1024, now),
+            Duration::from_millis(500)
+        );
+    }
+}
@@ -0,0 +1,178 @@
+use std::time::{Duration, Instant};
+
+use super::{SEGMENT_TASKS, SEGMENT_TASKS_MAX, SEGMENT_TASKS_MIN};
+
+/// Length of a measurement window.
+const WINDOW: Duration = Duration::from_millis(500);
+
+/// Minimal relative throughput gain (in %) for a concurrency change to be
+/// considered an improvement.
+const MIN_GAIN_PCT: u64 = 5;
+
+/// When the average segment copy latency of a window exceeds the best
+/// latency observed so far by this factor, the children are considered
+/// congested and the concurrency is halved, regardless of throughput. Segment
+/// copies share the children queues with the nexus front-end I/Os, so this is
+/// what front-end I/Os experience as well.
+const CONGESTION_FACTOR: u32 = 4;
+
+/// The best latency is aged by moving it towards the latency of each window by
+/// this fraction of their difference, so that the baseline follows lasting
+/// changes of the children, e.g. a busier front-end.
+const BEST_LATENCY_AGING: u32 = 8;
+
+/// Adaptive controller of the number of concurrently running rebuild tasks.
+///
+/// Rebuild tasks copy segments independently, so reads of some segments are
+/// naturally pipelined with writes of others. The controller measures the
+/// copy throughput over fixed windows and hill-climbs the number of in-flight
+/// tasks between `SEGMENT_TASKS_MIN` and `SEGMENT_TASKS_MAX`: the step
+/// direction is kept while throughput improves and reversed otherwise.
+/// A latency spike above the congestion threshold halves the concurrency
+/// to give way to the front-end I/O.
+#[derive(Debug)]
+pub(super) struct TaskConcurrency {
+    /// Current limit of concurrently running tasks.
+    limit: usize,
+    /// Direction of the next change: true to grow, false to shrink.
+    grow: bool,
+    /// Start of the current measurement window.
+    window_start: Instant,
+    /// Number of segment copies completed during the current window.
+    window_segments: u64,
+    /// Total copy time of the segments completed during the window.
+    window_busy: Duration,
+    /// Throughput of the previous window, in segments per second.
+    prev_rate: u64,
+    /// Lowest average segment copy latency observed so far, aged towards
+    /// the latency of the recent windows.
+    best_latency: Option<Duration>,
+}
+
+impl Default for TaskConcurrency {
+    fn default() -> Self {
+        Self::new(SEGMENT_TASKS)
+    }
+}
+
+impl TaskConcurrency {
+    /// Creates a new controller with the given initial limit.
+    pub(super) fn new(limit: usize) -> Self {
+        Self {
+            limit: limit.clamp(SEGMENT_TASKS_MIN, SEGMENT_TASKS_MAX),
+            grow: true,
+            window_start: Instant::now(),
+            window_segments: 0,
+            window_busy: Duration::ZERO,
+            prev_rate: 0,
+            best_latency: None,
+        }
+    }
+
+    /// Returns the current limit of concurrently running tasks.
+    #[inline(always)]
+    pub(super) fn limit(&self) -> usize {
+        self.limit
+    }
+
+    /// Restarts the measurements, e.g. after the rebuild was paused.
+    pub(super) fn restart(&mut self) {
+        self.window_start = Instant::now();
+        self.window_segments = 0;
+        self.window_busy = Duration::ZERO;
+        self.prev_rate = 0;
+    }
+
+    /// Accounts a completed segment copy which took `elapsed` time. Only
+    /// copies which transferred data must be accounted: skipped segments
+    /// complete almost instantly and would hide the actual copy latency.
+    /// Returns the new limit if it has been changed.
+    pub(super) fn segment_done(&mut self, elapsed: Duration) -> Option<usize> {
+        self.window_segments += 1;
+        self.window_busy += elapsed;
+
+        let now = Instant::now();
+        let window = now.duration_since(self.window_start);
+        if window < WINDOW {
+            return None;
+        }
+
+        let rate = self.window_segments * 1_000_000
+            / (window.as_micros() as u64).max(1);
+        let latency = self.window_busy / self.window_segments as u32;
+
+        let best = *self.best_latency.get_or_insert(latency);
+        self.best_latency = Some(if latency < best {
+            latency
+        } else {
+            best + (latency - best) / BEST_LATENCY_AGING
+        });
+
+        let prev = self.limit;
+
+        if latency > best * CONGESTION_FACTOR {
+            self.limit = (self.limit / 2).max(SEGMENT_TASKS_MIN);
+            self.grow = false;
+        } else {
+            if rate * 100 < self.prev_rate * (100 + MIN_GAIN_PCT) {
+                // The last change did not pay off: reverse the direction.
+                self.grow = !self.grow;
+            }
+
+            self.limit = if self.grow {
+                (self.limit + 1).min(SEGMENT_TASKS_MAX)
+            } else {
+                (self.limit - 1).max(SEGMENT_TASKS_MIN)
+            };
+        }
+
+        self.prev_rate = rate;
+        self.window_start = now;
+        self.window_segments = 0;
+        self.window_busy = Duration::ZERO;
+
+        (self.limit != prev).then_some(self.limit)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Completes a full measurement window of segment copies of the given
+    /// latency, and returns the new limit if it has been changed.
+    fn window(ctl: &mut TaskConcurrency, latency: Duration) -> Option<usize> {
+        (0 .. 9).for_each(|_| assert_eq!(ctl.segment_done(latency), None));
+        ctl.window_start -= WINDOW;
+        ctl.segment_done(latency)
+    }
+
+    #[test]
+    fn congestion_halves_limit() {
+        let mut ctl = TaskConcurrency::new(SEGMENT_TASKS);
+        window(&mut ctl, Duration::from_millis(1));
+        assert_eq!(
+            window(&mut ctl, Duration::from_millis(10)),
+            Some(ctl.limit())
+        );
+        assert!(ctl.limit() <= SEGMENT_TASKS / 2);
+    }
+
+    #[test]
+    fn best_latency_ages() {
+        let mut ctl = TaskConcurrency::new(SEGMENT_TASKS);
+        window(&mut ctl, Duration::from_millis(1));
+
+        // A lasting latency increase below the congestion factor moves the
+        // baseline, which then tolerates a larger latency.
+        (0 .. 20).for_each(|_| {
+            window(&mut ctl, Duration::from_millis(3));
+        });
+        let best = ctl.best_latency.unwrap();
+        assert!(best > Duration::from_millis(2), "best latency: {:?}", best);
+
+        let limit = ctl.limit();
+        window(&mut ctl, Duration::from_millis(6));
+        assert!(ctl.limit() + 1 >= limit, "limit halved from {}", limit);
+    }
+}
@@ -1,7 +1,11 @@
 use chrono::{DateTime, Utc};
 use snafu::ResultExt;
 use spdk_rs::{
-    libspdk::SPDK_NVME_SC_COMPARE_FAILURE,
+    libspdk::{
+        spdk_crc32c_update,
+        SPDK_CRC32C_INITIAL,
+        SPDK_NVME_SC_COMPARE_FAILURE,
+    },
     DmaBuf,
     IoVec,
     NvmeStatus,
@@ -15,7 +19,9 @@ use crate::{
         BlockDeviceDescriptor,
         BlockDeviceHandle,
         CoreError,
+        DmaArenaBuf,
         IoCompletionStatus,
+        IoType,
         ReadOptions,
         SegmentMap,
     },
@@ -26,7 +32,12 @@ use crate::{
     },
 };
 
-use super::{RebuildError, RebuildJobOptions, RebuildVerifyMode};
+use super::{
+    RebuildError,
+    RebuildJobOptions,
+    RebuildVerifyMethod,
+    RebuildVerifyMode,
+};
 
 /// Contains all descriptors and their associated information which allows the
 /// tasks to copy/rebuild data from source to destination.
@@ -51,6 +62,14 @@ pub(super) struct RebuildDescriptor {
     /// Pre-opened descriptor for destination block device.
     #[allow(clippy::non_send_fields_in_send_ty)]
     pub(super) dst_descriptor: Box<dyn BlockDeviceDescriptor>,
+    /// Segments of the rebuild range which hold data on the source, if the
+    /// source can report its allocation. Other segments are zeroed on the
+    /// destination rather than copied.
+    pub(super) populated: Option<SegmentMap>,
+    /// Whether the destination may hold stale data where the source has
+    /// none, which is the case of partial rebuilds. The destination of a
+    /// full rebuild is a new replica: its unallocated segments are not zeroed.
+    pub(super) dst_stale: bool,
     /// Start time of this rebuild.
     pub(super) start_time: DateTime<Utc>,
 }
@@ -115,6 +134,31 @@ impl RebuildDescriptor {
         let block_size = dst_descriptor.get_device().block_len();
         let segment_size_blks = SEGMENT_SIZE / block_size;
 
+        let populated =
+            match Self::scan_src_allocation(&*source_hdl, &range, block_size)
+                .await
+            {
+                Ok(map) => {
+                    info!(
+                        "{src_uri}: {blks} blocks of {total} are allocated, \
+                        only these will be copied",
+                        blks = map.count_dirty_blks(),
+                        total = range.end - range.start,
+                    );
+                    Some(map)
+                }
+                Err(CoreError::NotSupported {
+                    ..
+                }) => None,
+                Err(err) => {
+                    warn!(
+                        "{src_uri}: failed to get the allocation map of the \
+                        source, every segment will be read: {err}"
+                    );
+                    None
+                }
+            };
+
         Ok(Self {
             src_uri: src_uri.to_string(),
             dst_uri: dst_uri.to_string(),
@@ -124,10 +168,35 @@ impl RebuildDescriptor {
             segment_size_blks,
             src_descriptor,
             dst_descriptor,
+            populated,
+            dst_stale: false,
             start_time: Utc::now(),
         })
     }
 
+    /// Builds the map of the segments of the given range which hold data on
+    /// the source, by seeking its allocated and unallocated extents.
+    async fn scan_src_allocation(
+        source: &dyn BlockDeviceHandle,
+        range: &std::ops::Range<u64>,
+        block_size: u64,
+    ) -> Result<SegmentMap, CoreError> {
+        let mut map = SegmentMap::new(range.end, block_size, SEGMENT_SIZE);
+        let mut blk = range.start;
+
+        while blk < range.end {
+            let data = source.seek_data(blk).await?;
+            if data >= range.end {
+                break;
+            }
+            let hole = source.seek_hole(data).await?.clamp(data + 1, range.end);
+            map.set(data, hole - data, true);
+            blk = hole;
+        }
+
+        Ok(map)
+    }
+
     /// Check if the source and destination block devices are compatible for
     /// rebuild.
     fn validate(
@@ -163,12 +232,15 @@ impl RebuildDescriptor {
         self.segment_size_blks
     }
 
-    /// Allocate memory from the memory pool (the mem is zeroed out)
-    /// with given size and proper alignment for the bdev.
-    pub(super) fn dma_malloc(&self, size: u64) -> Result<DmaBuf, RebuildError> {
+    /// Allocate memory from the DMA arena of the current core with given size
+    /// and proper alignment for the bdev. The memory is not zeroed out.
+    pub(super) fn dma_malloc(
+        &self,
+        size: u64,
+    ) -> Result<DmaArenaBuf, RebuildError> {
         let src_align = self.src_descriptor.get_device().alignment();
         let dst_align = self.dst_descriptor.get_device().alignment();
-        DmaBuf::new(size, src_align.max(dst_align)).context(NoCopyBuffer)
+        DmaArenaBuf::new(size, src_align.max(dst_align)).context(NoCopyBuffer)
     }
 
     /// Get a `BlockDeviceHandle` for the source.
@@ -220,6 +292,34 @@ impl RebuildDescriptor {
         iov
     }
 
+    /// Checks whether the segment at the given offset is known to be
+    /// unallocated on the source. The allocation map is checked first, and
+    /// a hole is confirmed against the source, as the segment may have been
+    /// written since the map was built.
+    pub(super) async fn is_src_hole(
+        &self,
+        offset_blk: u64,
+    ) -> Result<bool, RebuildError> {
+        let populated = match &self.populated {
+            Some(map) => map.get(offset_blk).unwrap_or(true),
+            None => true,
+        };
+        if populated {
+            return Ok(false);
+        }
+
+        let data = self
+            .src_io_handle()
+            .await?
+            .seek_data(offset_blk)
+            .await
+            .map_err(|err| RebuildError::ReadIoFailed {
+                source: err,
+                bdev: self.src_uri.clone(),
+            })?;
+        Ok(data >= offset_blk + self.get_segment_size_blks(offset_blk))
+    }
+
     /// Reads a rebuild segment at the given offset from the source replica.
     /// In the case the segment is not allocated on the source, returns false,
     /// and true otherwise.
@@ -281,28 +381,74 @@ impl RebuildDescriptor {
             })
     }
 
-    /// Verify segment copy operation by reading destination, and comparing with
-    /// the source.
+    /// Zeroes the segment at the given offset on the destination replica, in
+    /// place of copying a segment which is not allocated on the source.
+    /// Nothing is written if the destination cannot hold stale data, or if it
+    /// reports the segment as unallocated, as it then already reads zeroes.
+    /// Destinations which support neither write-zeroes nor unmap are left
+    /// untouched.
+    pub(super) async fn zero_dst_segment(
+        &self,
+        offset_blk: u64,
+    ) -> Result<(), RebuildError> {
+        if !self.dst_stale {
+            return Ok(());
+        }
+
+        let dst = self.dst_descriptor.get_device();
+        let handle = self.dst_io_handle().await?;
+        let num_blocks = self.get_segment_size_blks(offset_blk);
+
+        if matches!(
+            handle.seek_data(offset_blk).await,
+            Ok(data) if data >= offset_blk + num_blocks
+        ) {
+            return Ok(());
+        }
+
+        let res = if dst.io_type_supported(IoType::WriteZeros) {
+            handle.write_zeroes_async(offset_blk, num_blocks).await
+        } else if dst.io_type_supported(IoType::Unmap) {
+            handle.unmap_blocks_async(offset_blk, num_blocks).await
+        } else {
+            return Ok(());
+        };
+
+        res.map_err(|err| RebuildError::WriteIoFailed {
+            source: err,
+            bdev: self.dst_uri.clone(),
+        })
+    }
+
+    /// Verifies segment copy operation, if the segment is selected for
+    /// verification. The given buffer must still hold the data read from the
+    /// source for the copy: the source is not read again.
     pub(super) async fn verify_segment(
         &self,
         offset_blk: u64,
         iovs: &mut [IoVec],
     ) -> Result<(), RebuildError> {
-        // Read the source again.
-        self.src_io_handle()
-            .await?
-            .readv_blocks_async(
-                iovs,
-                offset_blk,
-                self.get_segment_size_blks(offset_blk),
-                ReadOptions::None,
-            )
-            .await
-            .map_err(|err| RebuildError::VerifyIoFailed {
-                source: err,
-                bdev: self.dst_uri.clone(),
-            })?;
+        let interval = self.options.verify_interval.max(1);
+        if (offset_blk / self.segment_size_blks) % interval != 0 {
+            return Ok(());
+        }
+
+        match self.options.verify_method {
+            RebuildVerifyMethod::Compare => {
+                self.compare_dst_segment(offset_blk, iovs).await
+            }
+            RebuildVerifyMethod::Crc32c => {
+                self.crc32c_dst_segment(offset_blk, iovs).await
+            }
+        }
+    }
 
+    /// Compares the destination segment with the given buffer.
+    async fn compare_dst_segment(
+        &self,
+        offset_blk: u64,
+        iovs: &[IoVec],
+    ) -> Result<(), RebuildError> {
         match self
             .dst_io_handle()
             .await?
@@ -332,6 +478,35 @@ impl RebuildDescriptor {
         }
     }
 
+    /// Reads the destination segment back into the given buffer, and compares
+    /// its checksum with the checksum of the buffer's original content.
+    async fn crc32c_dst_segment(
+        &self,
+        offset_blk: u64,
+        iovs: &mut [IoVec],
+    ) -> Result<(), RebuildError> {
+        let src_crc = iovs_crc32c(iovs);
+
+        self.dst_io_handle()
+            .await?
+            .readv_blocks_async(
+                iovs,
+                offset_blk,
+                self.get_segment_size_blks(offset_blk),
+                ReadOptions::None,
+            )
+            .await
+            .map_err(|err| RebuildError::VerifyIoFailed {
+                source: err,
+                bdev: self.dst_uri.clone(),
+            })?;
+
+        if iovs_crc32c(iovs) != src_crc {
+            return self.verify_failure(offset_blk);
+        }
+        Ok(())
+    }
+
     /// Handles verification failure.
     fn verify_failure(&self, offset_blk: u64) -> Result<(), RebuildError> {
         let msg = format!(
@@ -360,3 +535,10 @@ impl RebuildDescriptor {
         }
     }
 }
+
+/// Computes CRC32C of the given buffers.
+fn iovs_crc32c(iovs: &[IoVec]) -> u32 {
+    iovs.iter().fold(SPDK_CRC32C_INITIAL, |crc, iov| unsafe {
+        spdk_crc32c_update(iov.as_ptr().cast(), iov.len() as u64, crc)
+    })
+}
@@ -5,6 +5,7 @@ use futures::channel::oneshot;
 
 use super::{
     HistoryRecord,
+    RebuildBudget,
     RebuildError,
     RebuildJobBackendManager,
     RebuildJobRequest,
@@ -32,10 +33,28 @@ pub enum RebuildVerifyMode {
     Panic,
 }
 
+/// Rebuild I/O verification method.
+#[derive(Debug, Clone, Copy, Default)]
+pub enum RebuildVerifyMethod {
+    /// Compare the destination against the data read from the source for the
+    /// copy, using the device compare command. The source is not re-read.
+    #[default]
+    Compare,
+    /// Read the destination back and compare its CRC32C against the CRC32C
+    /// of the data read from the source for the copy. Suitable for devices
+    /// which do not support the compare command.
+    Crc32c,
+}
+
 /// Rebuild job options.
 #[derive(Debug, Clone, Default)]
 pub struct RebuildJobOptions {
     pub verify_mode: RebuildVerifyMode,
+    /// Verification method, used unless `verify_mode` is `None`.
+    pub verify_method: RebuildVerifyMethod,
+    /// Verify only every Nth segment of the device; zero or one verifies
+    /// every copied segment.
+    pub verify_interval: u64,
 }
 
 /// Operations used to control the state of the job.
@@ -153,6 +172,15 @@ impl RebuildJob {
         self.exec_client_op(RebuildOperation::Resume)
     }
 
+    /// Sets the bandwidth and IOPS budget of the job. The new budget applies
+    /// to the segment copies scheduled after the backend received it.
+    pub async fn set_budget(
+        &self,
+        budget: RebuildBudget,
+    ) -> Result<(), RebuildError> {
+        self.comms.send(RebuildJobRequest::SetBudget(budget)).await
+    }
+
     /// Forcefully stops the job, overriding any pending client operation
     /// returns an async channel which can be used to await for termination.
     pub(crate) fn force_stop(&self) -> oneshot::Receiver<RebuildState> {
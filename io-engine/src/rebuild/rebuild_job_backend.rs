@@ -10,12 +10,14 @@ use crossbeam::channel::{unbounded, Receiver, Sender};
 use futures::{channel::oneshot, FutureExt, StreamExt};
 
 use super::{
+    RebuildBudget,
     RebuildDescriptor,
     RebuildError,
     RebuildState,
     RebuildStates,
     RebuildStats,
     RebuildTasks,
+    TaskConcurrency,
     TaskResult,
 };
 
@@ -28,6 +30,8 @@ pub(super) enum RebuildJobRequest {
     WakeUp,
     /// Get the rebuild stats from the backend.
     GetStats(oneshot::Sender<RebuildStats>),
+    /// Set the bandwidth and IOPS budget of the rebuild.
+    SetBudget(RebuildBudget),
 }
 
 /// Channel to share information between frontend and backend.
@@ -103,6 +107,10 @@ pub(super) struct RebuildJobManager {
         Arc<parking_lot::Mutex<Vec<oneshot::Sender<RebuildState>>>>,
     /// Channel to share information between frontend and backend.
     pub(super) info_chan: RebuildFBendChan,
+    /// Adaptive limit of concurrently running tasks.
+    concurrency: TaskConcurrency,
+    /// Ids of the tasks not running due to the concurrency limit.
+    idle_tasks: Vec<usize>,
     /// Job serial number.
     serial: u64,
 }
@@ -164,6 +172,8 @@ impl RebuildJobManager {
             states: Default::default(),
             complete_chan: Default::default(),
             info_chan: RebuildFBendChan::new(),
+            concurrency: TaskConcurrency::default(),
+            idle_tasks: Vec::new(),
             serial,
         }
     }
@@ -332,6 +342,7 @@ impl RebuildJobBackendManager {
             block_size: descriptor.block_size,
             tasks_total: self.task_pool().total as u64,
             tasks_active: self.task_pool().active as u64,
+            budget: self.task_pool().budget(),
         }
     }
 
@@ -362,8 +373,8 @@ impl RebuildJobBackendManager {
         self.backend.task_pool()
     }
 
-    /// Kicks off all rebuild tasks in the background, or as many as necessary
-    /// to complete the rebuild.
+    /// Kicks off rebuild tasks in the background, as many as allowed by the
+    /// current concurrency limit or as necessary to complete the rebuild.
     fn start_all_tasks(&mut self) {
         assert_eq!(
             self.task_pool().active,
@@ -372,7 +383,13 @@ impl RebuildJobBackendManager {
             self.task_pool().active
         );
 
-        for n in 0 .. self.task_pool().total {
+        let total = self.task_pool().total;
+        let limit = self.concurrency.limit().min(total);
+
+        self.concurrency.restart();
+        self.idle_tasks = (limit .. total).rev().collect();
+
+        for n in 0 .. limit {
             if !self.start_task_by_id(n) {
                 break;
             }
@@ -384,7 +401,49 @@ impl RebuildJobBackendManager {
         }
 
         let s = self.stats();
-        debug!("{self}: started all tasks; current stats: {s:?}");
+        debug!(
+            "{self}: started all tasks (limit {limit}); current stats: {s:?}"
+        );
+    }
+
+    /// Re-schedules the task which just completed, and starts or parks tasks
+    /// so that the number of active tasks follows the concurrency limit.
+    fn restart_tasks(&mut self, completed: &TaskResult) {
+        // Segments which transferred no data, such as the clean segments of a
+        // partial rebuild, tell nothing about the copy throughput.
+        let changed = if completed.is_transferred {
+            self.concurrency.segment_done(completed.elapsed)
+        } else {
+            None
+        };
+        let limit = match changed {
+            Some(limit) => {
+                debug!("{self}: rebuild task limit changed to {limit}");
+                limit
+            }
+            None => self.concurrency.limit(),
+        };
+
+        if self.task_pool().active >= limit {
+            self.idle_tasks.push(completed.id);
+            return;
+        }
+
+        if !self.start_task_by_id(completed.id) {
+            return;
+        }
+
+        while self.task_pool().active < limit {
+            match self.idle_tasks.pop() {
+                Some(id) => {
+                    if !self.start_task_by_id(id) {
+                        self.idle_tasks.push(id);
+                        break;
+                    }
+                }
+                None => break,
+            }
+        }
     }
 
     /// Tries to kick off a task by its identifier and returns result.
@@ -435,7 +494,7 @@ impl RebuildJobBackendManager {
                         let state = self.states.read().clone();
                         match state.pending {
                             None | Some(RebuildState::Running) => {
-                                self.start_task_by_id(r.id);
+                                self.restart_tasks(&r);
                             }
                             _ => {
                                 // await all active tasks as we might still have
@@ -477,6 +536,10 @@ impl RebuildJobBackendManager {
             Some(RebuildJobRequest::GetStats(reply)) => {
                 self.reply_stats(reply).await.ok();
             }
+            Some(RebuildJobRequest::SetBudget(budget)) => {
+                info!("{self}: setting rebuild budget to {budget:?}");
+                self.task_pool().set_budget(budget);
+            }
             None => {
                 self.fail_with(RebuildError::FrontendGone);
                 return false;
@@ -1,4 +1,3 @@
-use bit_vec::BitVec;
 use std::fmt::{Debug, Formatter};
 
 use crate::core::SegmentMap;
@@ -63,9 +62,3 @@ impl RebuildMap {
         self.segments.count_dirty_blks()
     }
 }
-
-impl From<RebuildMap> for BitVec {
-    fn from(value: RebuildMap) -> Self {
-        value.segments.into()
-    }
-}
@@ -0,0 +1,111 @@
+//!
+//! Snapshot delta rebuild maps.
+//!
+//! A nexus snapshot creates a snapshot of every healthy replica with the same
+//! transaction id, while the nexus I/O is frozen: snapshots sharing a
+//! transaction id hold the same data. When the source and destination of a
+//! rebuild share such a snapshot, only the blocks written on either side
+//! since that snapshot may differ. Each replica reports those blocks through
+//! its block device handle, directly for a local lvol, and with custom NVMe
+//! admin commands for a remote one.
+use super::{RebuildMap, SEGMENT_SIZE};
+use crate::core::{BlockDeviceHandle, SegmentMap};
+
+/// Maximal size of the map of written blocks fetched from each replica.
+const MAX_DELTA_BITMAP_BITS: u64 = 16 * 4096 * 8;
+
+/// Returns the snapshot transaction ids of the replica behind the given
+/// handle, or None if it does not report them.
+async fn txn_ids(hdl: &dyn BlockDeviceHandle) -> Option<Vec<String>> {
+    match hdl.snapshot_txn_ids().await {
+        Ok(ids) => Some(ids),
+        Err(e) => {
+            debug!(
+                "'{dev}': no snapshot chain: {e}",
+                dev = hdl.get_device().device_name()
+            );
+            None
+        }
+    }
+}
+
+/// Marks the blocks of the given map of written blocks, with one bit per
+/// unit of `granularity` blocks.
+fn mark_delta(bitmap: &[u8], granularity: u64, map: &mut SegmentMap) {
+    let size = map.size_blks();
+    bitmap
+        .iter()
+        .enumerate()
+        .flat_map(|(i, byte)| {
+            (0 .. 8)
+                .filter(move |bit| byte & (1 << bit) != 0)
+                .map(move |bit| (i as u64 * 8 + bit) * granularity)
+        })
+        .take_while(|blk| *blk < size)
+        .for_each(|blk| map.set(blk, granularity.min(size - blk), true));
+}
+
+/// Creates the map of the blocks which may differ between the replicas behind
+/// the source and destination handles, if they share a snapshot taken by the
+/// same transaction. The newest such snapshot is used. The writes to the
+/// replicas must reach both of them already, so that the map does not miss
+/// any later write. Returns None if there is no such snapshot, or if either
+/// snapshot chain changes meanwhile.
+pub(crate) async fn snapshot_delta_map(
+    src: &dyn BlockDeviceHandle,
+    dst: &dyn BlockDeviceHandle,
+) -> Option<RebuildMap> {
+    let src_dev = src.get_device();
+    let dst_dev = dst.get_device();
+    if src_dev.block_len() != dst_dev.block_len() {
+        return None;
+    }
+
+    let src_ids = txn_ids(src).await?;
+    let dst_ids = txn_ids(dst).await?;
+
+    let (src_idx, dst_idx, txn_id) =
+        src_ids.iter().enumerate().find_map(|(i, t)| {
+            if t.is_empty() {
+                return None;
+            }
+            let d = dst_ids.iter().position(|d| d == t)?;
+            Some((i as u32, d as u32, t.clone()))
+        })?;
+
+    let block_len = dst_dev.block_len();
+    let num_blocks = src_dev.num_blocks().max(dst_dev.num_blocks());
+    let granularity = (SEGMENT_SIZE / block_len)
+        .max((num_blocks + MAX_DELTA_BITMAP_BITS - 1) / MAX_DELTA_BITMAP_BITS)
+        as u32;
+
+    let src_delta = src.snapshot_delta(src_idx, granularity).await.ok()?;
+    let dst_delta = dst.snapshot_delta(dst_idx, granularity).await.ok()?;
+
+    // A snapshot taken meanwhile shifts the snapshot indices.
+    if txn_ids(src).await? != src_ids || txn_ids(dst).await? != dst_ids {
+        warn!(
+            "Snapshot chain of '{src}' or '{dst}' changed while computing \
+            their snapshot delta",
+            src = src_dev.device_name(),
+            dst = dst_dev.device_name(),
+        );
+        return None;
+    }
+
+    let mut map =
+        SegmentMap::new(dst_dev.num_blocks(), block_len, SEGMENT_SIZE);
+    mark_delta(&src_delta, granularity as u64, &mut map);
+    mark_delta(&dst_delta, granularity as u64, &mut map);
+
+    info!(
+        "Snapshot delta from '{src}' to '{dst}' since snapshot transaction \
+        '{txn_id}': {dirty} of {total} blocks to rebuild",
+        src = src_dev.device_name(),
+        dst = dst_dev.device_name(),
+        dirty = map.count_dirty_blks(),
+        total = map.size_blks(),
+    );
+
+    Some(RebuildMap::new(&dst_dev.device_name(), map))
+}
@@ -1,4 +1,4 @@
-use super::RebuildState;
+use super::{RebuildBudget, RebuildState};
 use chrono::{DateTime, Utc};
 use std::ops::Deref;
 
@@ -27,6 +27,8 @@ pub struct RebuildStats {
     pub start_time: DateTime<Utc>,
     /// Is this a partial rebuild?
     pub is_partial: bool,
+    /// Bandwidth and IOPS budget of the rebuild.
+    pub budget: RebuildBudget,
 }
 
 impl Default for RebuildStats {
@@ -43,6 +45,7 @@ impl Default for RebuildStats {
             tasks_active: 0,
             start_time: Utc::now(),
             is_partial: false,
+            budget: RebuildBudget::default(),
         }
     }
 }
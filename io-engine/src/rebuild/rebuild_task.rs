@@ -1,15 +1,25 @@
 use futures::{channel::mpsc, stream::FusedStream, SinkExt, StreamExt};
 use parking_lot::Mutex;
 
-use spdk_rs::DmaBuf;
-use std::{rc::Rc, sync::Arc};
+use std::{
+    rc::Rc,
+    sync::Arc,
+    time::{Duration, Instant},
+};
 
 use crate::{
-    core::{Reactors, VerboseError},
+    core::{DmaArenaBuf, Reactors, VerboseError},
     rebuild::SEGMENT_SIZE,
+    sleep::mayastor_sleep,
 };
 
-use super::{RebuildDescriptor, RebuildError, RebuildVerifyMode};
+use super::{
+    rebuild_budget::{refund_copy, reserve_copy, BudgetBucket},
+    RebuildBudget,
+    RebuildDescriptor,
+    RebuildError,
+    RebuildVerifyMode,
+};
 
 /// Result returned by each segment task worker.
 /// Used to communicate with the management task indicating that the
@@ -24,7 +34,9 @@ pub(super) struct TaskResult {
     pub(super) error: Option<RebuildError>,
     /// Indicates if the segment was actually transferred (partial rebuild may
     /// skip segments).
-    is_transferred: bool,
+    pub(super) is_transferred: bool,
+    /// Time it took to rebuild the segment.
+    pub(super) elapsed: Duration,
 }
 
 /// Each rebuild task needs a unique buffer to read/write from source to target.
@@ -32,7 +44,7 @@ pub(super) struct TaskResult {
 #[derive(Debug)]
 pub(super) struct RebuildTask {
     /// The pre-allocated buffers used to read/write.
-    buffer: DmaBuf,
+    buffer: DmaArenaBuf,
     /// The channel used to notify when the task completes/fails.
     sender: mpsc::Sender<TaskResult>,
     /// Last error seen by this particular task.
@@ -41,7 +53,7 @@ pub(super) struct RebuildTask {
 
 impl RebuildTask {
     pub(super) fn new(
-        buffer: DmaBuf,
+        buffer: DmaArenaBuf,
         sender: mpsc::Sender<TaskResult>,
     ) -> Self {
         Self {
@@ -61,12 +73,18 @@ impl RebuildTask {
         let iov = desc.adjusted_iov(&self.buffer, offset_blk);
         let iovs = &mut [iov];
 
-        if !desc.read_src_segment(offset_blk, iovs).await? {
-            // Segment is not allocated in the source, skip the write.
+        if desc.is_src_hole(offset_blk).await?
+            || !desc.read_src_segment(offset_blk, iovs).await?
+        {
+            // Segment is not allocated in the source: zero it on the
+            // destination, if needed, instead of transferring data.
+            desc.zero_dst_segment(offset_blk).await?;
             return Ok(false);
         }
         desc.write_dst_segment(offset_blk, iovs).await?;
 
+        // The buffer still holds the source data: verify the destination
+        // against it.
         if !matches!(desc.options.verify_mode, RebuildVerifyMode::None) {
             desc.verify_segment(offset_blk, iovs).await?;
         }
@@ -95,6 +113,8 @@ pub(super) struct RebuildTasks {
     pub(super) segments_done: u64,
     /// How many segments have been actually transferred so far.
     pub(super) segments_transferred: u64,
+    /// Bandwidth and IOPS budget of this rebuild job.
+    budget: Arc<Mutex<BudgetBucket>>,
 }
 
 impl std::fmt::Debug for RebuildTasks {
@@ -110,7 +130,8 @@ impl std::fmt::Debug for RebuildTasks {
 impl RebuildTasks {
     /// Create a rebuild tasks pool for the given rebuild descriptor.
     /// Each task can be schedule to run concurrently, and each task
-    /// gets its own `DmaBuf` from where it reads and writes from.
+    /// gets its own DMA buffer from where it reads and writes from, drawn
+    /// from the DMA arena of the current core.
     pub(super) fn new(
         task_count: usize,
         desc: &RebuildDescriptor,
@@ -132,9 +153,20 @@ impl RebuildTasks {
             active: 0,
             segments_done: 0,
             segments_transferred: 0,
+            budget: Default::default(),
         })
     }
 
+    /// Returns the budget of this rebuild job.
+    pub(super) fn budget(&self) -> RebuildBudget {
+        self.budget.lock().budget()
+    }
+
+    /// Sets the budget of this rebuild job.
+    pub(super) fn set_budget(&self, budget: RebuildBudget) {
+        self.budget.lock().set_budget(budget);
+    }
+
     /// Check if there's at least one task still running.
     pub(super) fn running(&self) -> bool {
         self.active > 0 && !self.channel.1.is_terminated()
@@ -154,6 +186,9 @@ impl RebuildTasks {
     }
     /// Schedules the run of a task by its id. It will copy the segment size
     /// starting at the given block address from source to destination.
+    /// The copy is delayed as necessary to keep the job and the node within
+    /// their rebuild budgets. Segments which the copier skips, and copies
+    /// which transfer no data, do not consume the budgets.
     /// todo: don't use a specific task, simply get the next from the pool.
     pub(super) fn schedule_segment_rebuild(
         &mut self,
@@ -162,13 +197,30 @@ impl RebuildTasks {
         copier: Rc<impl RebuildTaskCopier + 'static>,
     ) {
         let task = self.tasks[id].clone();
+        let budget = self.budget.clone();
 
         Reactors::current().send_future(async move {
             // No other thread/task will acquire the mutex at the same time.
             let mut task = task.lock();
 
+            let desc = copier.descriptor();
+            let bytes = desc.get_segment_size_blks(blk) * desc.block_size;
+            let charged = copier.needs_copy(blk);
+            if charged {
+                let delay = reserve_copy(&budget, bytes);
+                if !delay.is_zero() {
+                    mayastor_sleep(delay).await.ok();
+                }
+            }
+
             // Could we make this the option, rather than the descriptor itself?
+            let start = Instant::now();
             let result = copier.copy_segment(blk, &mut task).await;
+            let elapsed = start.elapsed();
+
+            if charged && matches!(result, Ok(false)) {
+                refund_copy(&budget, bytes);
+            }
 
             let is_transferred = *result.as_ref().unwrap_or(&false);
             let error = TaskResult {
@@ -176,6 +228,7 @@ impl RebuildTasks {
                 blk,
                 error: result.err(),
                 is_transferred,
+                elapsed,
             };
             task.error = Some(error.clone());
             if let Err(e) = task.sender.send(error).await {
@@ -196,6 +249,11 @@ impl RebuildTasks {
 #[async_trait::async_trait(?Send)]
 pub(super) trait RebuildTaskCopier {
     fn descriptor(&self) -> &RebuildDescriptor;
+    /// Checks if the segment at the given block address may have to be
+    /// copied, rather than being skipped as already in sync.
+    fn needs_copy(&self, _blk: u64) -> bool {
+        true
+    }
     /// Copies an entire segment at the given block address, from source to
     /// target using a `DmaBuf`.
     async fn copy_segment(
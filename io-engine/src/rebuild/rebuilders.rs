@@ -1,5 +1,5 @@
 use crate::{
-    core::SegmentMap,
+    core::{segment_map::IntoDirtyBlks, SegmentMap},
     rebuild::{
         rebuild_descriptor::RebuildDescriptor,
         rebuild_task::{RebuildTask, RebuildTaskCopier},
@@ -7,7 +7,6 @@ use crate::{
         RebuildMap,
     },
 };
-use bit_vec::BitVec;
 use std::{ops::Range, rc::Rc};
 
 /// A rebuild may rebuild a device by walking it differently, for example:
@@ -74,10 +73,10 @@ impl<T: RebuildTaskCopier> RangeRebuilder<T> for FullRebuild<T> {
     }
 }
 
-/// A partial rebuild range which steps through each segment but triggers
-/// the copy only if the segment dirty bit is set.
+/// A partial rebuild range which steps through the dirty segments only,
+/// jumping over the clean ranges of the segment map.
 pub(super) struct PartialRebuild<T: RebuildTaskCopier> {
-    range: PeekableIterator<std::iter::Enumerate<bit_vec::IntoIter>>,
+    range: PeekableIterator<IntoDirtyBlks>,
     segment_size_blks: u64,
     total_blks: u64,
     rebuilt_blks: u64,
@@ -90,9 +89,8 @@ impl<T: RebuildTaskCopier> PartialRebuild<T> {
     pub(super) fn new(map: SegmentMap, copier: T) -> Self {
         let total_blks = map.count_dirty_blks();
         let segment_size_blks = map.segment_size_blks();
-        let bit_vec: BitVec = map.into();
         Self {
-            range: PeekableIterator::new(bit_vec.into_iter().enumerate()),
+            range: PeekableIterator::new(map.into_dirty_blks()),
             total_blks,
             rebuilt_blks: 0,
             segment_size_blks,
@@ -102,17 +100,12 @@ impl<T: RebuildTaskCopier> PartialRebuild<T> {
 }
 impl<T: RebuildTaskCopier> RangeRebuilder<T> for PartialRebuild<T> {
     fn next(&mut self) -> Option<u64> {
-        for (blk, is_set) in self.range.by_ref() {
-            if is_set {
-                self.rebuilt_blks += self.segment_size_blks;
-                return Some(blk as u64);
-            }
-        }
-        None
+        let blk = self.range.next()?;
+        self.rebuilt_blks += self.segment_size_blks;
+        Some(blk)
     }
     fn peek_next(&self) -> Option<u64> {
-        // todo: should we add a wrapper to ensure we peek only set bits?
-        self.range.peek().map(|(blk, _)| *blk as u64)
+        self.range.peek().cloned()
     }
 
     fn blocks_remaining(&self) -> u64 {
@@ -208,6 +201,10 @@ impl<T: RebuildTaskCopier> RebuildTaskCopier for PartialSeqCopier<T> {
         self.copier.descriptor()
     }
 
+    fn needs_copy(&self, blk: u64) -> bool {
+        !self.is_blk_sync(blk) && self.copier.needs_copy(blk)
+    }
+
     /// Copies one segment worth of data from source into destination.
     async fn copy_segment(
         &self,
@@ -12,10 +12,11 @@ use crate::store::store_defs::{
     StoreError::MissingEntry,
     StoreKey,
     StoreValue,
+    TxnPut,
     ValueString,
 };
 use async_trait::async_trait;
-use etcd_client::Client;
+use etcd_client::{Client, Txn, TxnOp};
 use serde_json::Value;
 use snafu::ResultExt;
 
@@ -59,6 +60,25 @@ impl Store for Etcd {
         Ok(())
     }
 
+    /// 'Put' key-value pairs into etcd in a single transaction.
+    async fn put_kvs<K: StoreKey, V: StoreValue>(
+        &mut self,
+        kvs: &[(K, V)],
+    ) -> Result<(), StoreError> {
+        let ops = kvs
+            .iter()
+            .map(|(key, value)| {
+                let vec_value =
+                    serde_json::to_vec(value).context(SerialiseValue)?;
+                Ok(TxnOp::put(key.to_string(), vec_value, None))
+            })
+            .collect::<Result<Vec<_>, StoreError>>()?;
+        self.0.txn(Txn::new().and_then(ops)).await.context(TxnPut {
+            count: kvs.len(),
+        })?;
+        Ok(())
+    }
+
     /// 'Get' the value for the given key from etcd.
     async fn get_kv<K: StoreKey>(
         &mut self,
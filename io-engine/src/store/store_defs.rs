@@ -35,6 +35,20 @@ pub enum StoreError {
         value: String,
         source: futures::channel::oneshot::Canceled,
     },
+    /// Failed to 'put' entries in a store transaction.
+    #[snafu(display(
+        "Failed to 'put' {} entries in a transaction. Error {}",
+        count,
+        source
+    ))]
+    TxnPut { count: usize, source: Error },
+    /// Failed to 'put' an entry as part of a batch of entries.
+    #[snafu(display(
+        "Failed to 'put' entry with key {} as part of a batch. Error {}",
+        key,
+        error
+    ))]
+    BatchPut { key: String, error: String },
     /// Failed to 'get' an entry from the store.
     #[snafu(display(
         "Failed to 'get' entry with key {}. Error {}",
@@ -115,6 +129,12 @@ pub trait Store: Sync + Send + Clone {
         value: &V,
     ) -> Result<(), StoreError>;
 
+    /// Put entries into the store in a single transaction.
+    async fn put_kvs<K: StoreKey, V: StoreValue>(
+        &mut self,
+        kvs: &[(K, V)],
+    ) -> Result<(), StoreError>;
+
     /// Get an entry from the store.
     async fn get_kv<K: StoreKey>(
         &mut self,
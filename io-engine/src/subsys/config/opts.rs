@@ -52,6 +52,10 @@ pub struct NexusOpts {
     /// NOTE: we do not (yet) differentiate between
     /// the nexus and replica nvmf target
     pub nvmf_replica_port: u16,
+    /// Number of I/O qpairs, i.e. of connections, per I/O channel of the
+    /// nvmf children. I/O is spread over them, and the I/O of a failed
+    /// qpair is resubmitted to the others.
+    pub nvme_io_qpairs: u32,
 }
 
 /// Default nvmf port used for replicas.
@@ -67,6 +71,7 @@ impl Default for NexusOpts {
             nvmf_discovery_enable: true,
             nvmf_nexus_port: NVMF_PORT_NEXUS,
             nvmf_replica_port: NVMF_PORT_REPLICA,
+            nvme_io_qpairs: try_from_env("NVME_IO_QPAIRS", 1).clamp(1, 16),
         }
     }
 }
@@ -92,6 +97,15 @@ pub struct NvmfTgtConfig {
     pub crdt: [u16; TARGET_CRDT_LEN],
     /// TCP transport options
     pub opts: NvmfTcpTransportOpts,
+    /// Create the poll groups only on the cores of the NUMA node of the
+    /// target's network interface, so that the connections are served next
+    /// to the NIC.
+    pub numa_local_poll_groups: bool,
+    /// Add the RDMA transport to the target, next to the TCP one. Shares
+    /// are served over RDMA only when requested.
+    pub rdma: bool,
+    /// RDMA transport options
+    pub rdma_opts: NvmfRdmaTransportOpts,
 }
 
 impl From<NvmfTgtConfig> for Box<spdk_nvmf_target_opts> {
@@ -112,6 +126,12 @@ impl Default for NvmfTgtConfig {
             max_namespaces: 2048,
             crdt: args.nvmf_tgt_crdt,
             opts: NvmfTcpTransportOpts::default(),
+            numa_local_poll_groups: try_from_env(
+                "NVMF_NUMA_LOCAL_POLL_GROUPS",
+                false,
+            ),
+            rdma: try_from_env("NVMF_RDMA", false),
+            rdma_opts: NvmfRdmaTransportOpts::default(),
         }
     }
 }
@@ -243,11 +263,92 @@ where
     }
 }
 
+/// Named tuning profile of the NVMe-oF TCP transport, selected with the
+/// `NVMF_TCP_PROFILE` env variable. A profile only changes the defaults of
+/// the transport and socket options: the env variables of the individual
+/// options still take precedence.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum NvmfTcpProfile {
+    /// Balanced settings, as used when no profile is selected.
+    Default,
+    /// Favours small I/O latency: writes up to 8KiB are carried in the
+    /// command capsule, sparing the ready-to-transfer round trip, ACKs are
+    /// sent immediately, and responses are copied rather than sent with
+    /// zero-copy, whose completion notifications cost more than copying a
+    /// small buffer.
+    Latency,
+    /// Favours bandwidth: zero-copy sends and delayed ACKs.
+    Throughput,
+}
+
+impl FromStr for NvmfTcpProfile {
+    type Err = String;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s.to_lowercase().as_str() {
+            "default" => Ok(Self::Default),
+            "latency" => Ok(Self::Latency),
+            "throughput" => Ok(Self::Throughput),
+            _ => Err(format!("unknown NVMe-oF TCP profile '{s}'")),
+        }
+    }
+}
+
+impl Display for NvmfTcpProfile {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let s = match self {
+            Self::Default => "default",
+            Self::Latency => "latency",
+            Self::Throughput => "throughput",
+        };
+        write!(f, "{s}")
+    }
+}
+
+impl NvmfTcpProfile {
+    /// Returns the profile selected by the environment.
+    pub fn from_env() -> Self {
+        try_from_env("NVMF_TCP_PROFILE", Self::Default)
+    }
+
+    /// Default in-capsule data size.
+    fn in_capsule_data_size(&self) -> u32 {
+        match self {
+            Self::Latency => 8192,
+            Self::Default | Self::Throughput => 4096,
+        }
+    }
+
+    /// Default immediate ACK setting.
+    fn quickack(&self) -> bool {
+        !matches!(self, Self::Throughput)
+    }
+
+    /// Default server side zero-copy send setting.
+    fn zerocopy_send_server(&self) -> bool {
+        !matches!(self, Self::Latency)
+    }
+
+    /// Default socket placement: the tuned profiles group the connections
+    /// by the NIC queue they are received on (NAPI id), so that a poll group
+    /// polls the sockets of the same queues.
+    fn placement_id(&self) -> u32 {
+        match self {
+            Self::Default => 0,
+            Self::Latency | Self::Throughput => 1,
+        }
+    }
+}
+
 impl Default for NvmfTcpTransportOpts {
     fn default() -> Self {
+        let profile = NvmfTcpProfile::from_env();
         Self {
             max_queue_depth: try_from_env("NVMF_TCP_MAX_QUEUE_DEPTH", 32),
-            in_capsule_data_size: 4096,
+            in_capsule_data_size: try_from_env(
+                "NVMF_TCP_IN_CAPSULE_DATA_SIZE",
+                profile.in_capsule_data_size(),
+            ),
             max_io_size: 131_072,
             io_unit_size: 131_072,
             max_qpairs_per_ctrl: try_from_env(
@@ -292,6 +393,80 @@ impl From<NvmfTcpTransportOpts> for spdk_nvmf_transport_opts {
     }
 }
 
+/// Settings for the RDMA transport. The RDMA specific settings, such as the
+/// shared receive queue depth, are left to the SPDK defaults.
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+#[serde(default, deny_unknown_fields)]
+pub struct NvmfRdmaTransportOpts {
+    /// max queue depth
+    max_queue_depth: u16,
+    /// max qpairs per controller
+    max_qpairs_per_ctrl: u16,
+    /// encapsulated data size
+    in_capsule_data_size: u32,
+    /// max IO size
+    max_io_size: u32,
+    /// IO unit size
+    io_unit_size: u32,
+    /// max admin queue depth per admin queue
+    max_aq_depth: u32,
+    /// num of shared buffers
+    num_shared_buf: u32,
+    /// cache size
+    buf_cache_size: u32,
+    /// abort execution timeout
+    abort_timeout_sec: u32,
+    /// acceptor poll rate, microseconds
+    acceptor_poll_rate: u32,
+}
+
+impl Default for NvmfRdmaTransportOpts {
+    fn default() -> Self {
+        Self {
+            max_queue_depth: try_from_env("NVMF_RDMA_MAX_QUEUE_DEPTH", 128),
+            in_capsule_data_size: try_from_env(
+                "NVMF_RDMA_IN_CAPSULE_DATA_SIZE",
+                4096,
+            ),
+            max_io_size: 131_072,
+            io_unit_size: 8192,
+            max_qpairs_per_ctrl: try_from_env(
+                "NVMF_RDMA_MAX_QPAIRS_PER_CTRL",
+                32,
+            ),
+            num_shared_buf: try_from_env("NVMF_RDMA_NUM_SHARED_BUF", 4095),
+            buf_cache_size: try_from_env("NVMF_RDMA_BUF_CACHE_SIZE", 32),
+            max_aq_depth: 32,
+            abort_timeout_sec: 1,
+            acceptor_poll_rate: try_from_env("NVMF_ACCEPTOR_POLL_RATE", 10_000),
+        }
+    }
+}
+
+impl From<NvmfRdmaTransportOpts> for spdk_nvmf_transport_opts {
+    fn from(o: NvmfRdmaTransportOpts) -> Self {
+        Self {
+            max_queue_depth: o.max_queue_depth,
+            max_qpairs_per_ctrlr: o.max_qpairs_per_ctrl,
+            in_capsule_data_size: o.in_capsule_data_size,
+            max_io_size: o.max_io_size,
+            io_unit_size: o.io_unit_size,
+            max_aq_depth: o.max_aq_depth,
+            num_shared_buffers: o.num_shared_buf,
+            buf_cache_size: o.buf_cache_size,
+            dif_insert_or_strip: false,
+            reserved29: Default::default(),
+            abort_timeout_sec: o.abort_timeout_sec,
+            association_timeout: 120000,
+            transport_specific: std::ptr::null(),
+            opts_size: std::mem::size_of::<spdk_nvmf_transport_opts>() as u64,
+            acceptor_poll_rate: o.acceptor_poll_rate,
+            zcopy: false,
+            reserved61: Default::default(),
+        }
+    }
+}
+
 /// generic settings for the NVMe bdev (all our replicas)
 #[derive(Debug, PartialEq, Serialize, Deserialize)]
 #[serde(default, deny_unknown_fields)]
@@ -548,16 +723,23 @@ pub struct PosixSocketOpts {
 
 impl Default for PosixSocketOpts {
     fn default() -> Self {
+        let profile = NvmfTcpProfile::from_env();
         Self {
             recv_buf_size: try_from_env("SOCK_RECV_BUF_SIZE", 2097152),
             send_buf_size: try_from_env("SOCK_SEND_BUF_SIZE", 2097152),
             enable_recv_pipe: try_from_env("SOCK_ENABLE_RECV_PIPE", true),
             enable_zero_copy_send: true,
-            enable_quickack: try_from_env("SOCK_ENABLE_QUICKACK", true),
-            enable_placement_id: try_from_env("SOCK_ENABLE_PLACEMENT_ID", 0),
+            enable_quickack: try_from_env(
+                "SOCK_ENABLE_QUICKACK",
+                profile.quickack(),
+            ),
+            enable_placement_id: try_from_env(
+                "SOCK_ENABLE_PLACEMENT_ID",
+                profile.placement_id(),
+            ),
             enable_zerocopy_send_server: try_from_env(
                 "SOCK_ZEROCOPY_SEND_SERVER",
-                true,
+                profile.zerocopy_send_server(),
             ),
             enable_zerocopy_send_client: try_from_env(
                 "SOCK_ZEROCOPY_SEND_CLIENT",
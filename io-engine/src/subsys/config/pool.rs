@@ -1,6 +1,6 @@
-use std::{fmt::Display, fs, path::Path, sync::Mutex};
+use std::{fmt::Display, fs, path::Path, sync::Mutex, time::Instant};
 
-use futures::channel::oneshot;
+use futures::{channel::oneshot, future};
 use once_cell::sync::{Lazy, OnceCell};
 use serde::{Deserialize, Serialize};
 use tonic::Status;
@@ -120,23 +120,39 @@ impl PoolConfig {
         }
     }
 
-    /// Create pools specified in this configuration
+    /// Create pools specified in this configuration. Pools are imported
+    /// concurrently, as loading a pool mostly waits for its device.
     async fn create_pools(&self) -> usize {
-        let mut failures = 0;
-        if let Some(pools) = self.pools.as_ref() {
-            for pool in pools.iter() {
-                info!("creating pool {}", pool.name);
-                if let Err(error) = create_pool(pool.into()).await {
+        let Some(pools) = self.pools.as_ref() else {
+            return 0;
+        };
+
+        future::join_all(pools.iter().map(|pool| async move {
+            info!("creating pool {}", pool.name);
+            let started = Instant::now();
+            match create_pool(pool.into()).await {
+                Ok(_) => {
+                    info!(
+                        "pool {} created in {:?}",
+                        pool.name,
+                        started.elapsed()
+                    );
+                    false
+                }
+                Err(error) => {
                     error!(
                         "failed to create pool {}: {}",
                         pool.name,
                         error.verbose()
                     );
-                    failures += 1;
+                    true
                 }
             }
-        }
-        failures
+        }))
+        .await
+        .into_iter()
+        .filter(|failed| *failed)
+        .count()
     }
 
     /// Import pools
@@ -8,7 +8,17 @@ use std::{
 };
 
 use crate::{
-    bdev::{nexus, nvmx::NvmeSnapshotMessage},
+    bdev::{
+        nexus,
+        nvmx::{
+            NvmeSnapshotChainMessage,
+            NvmeSnapshotChainMessageV1,
+            NvmeSnapshotMessage,
+            NVME_ADMIN_SNAPSHOT_CHAIN,
+            NVME_ADMIN_SNAPSHOT_DELTA,
+            NVME_SNAPSHOT_PAGE_SIZE,
+        },
+    },
     core::{
         logical_volume::LogicalVolume,
         snapshot::SnapshotOps,
@@ -90,6 +100,25 @@ impl NvmfReq {
         }
     }
 
+    /// Returns the data buffer of the NVMf request.
+    pub fn data(&mut self) -> &mut [u8] {
+        unsafe {
+            let mut val = std::ptr::null_mut();
+            let mut size: u32 = 0;
+
+            spdk_nvmf_request_get_data(
+                self.0.as_ptr(),
+                &mut val as *mut *mut c_void,
+                &mut size as *mut u32,
+            );
+
+            if val.is_null() {
+                return &mut [];
+            }
+            std::slice::from_raw_parts_mut(val as *mut u8, size as usize)
+        }
+    }
+
     /// Complete NVMf request with error.
     pub fn complete_error(&self, errno: i32) {
         let mut rsp = self.response();
@@ -229,6 +258,118 @@ extern "C" fn nvmf_create_snapshot_hdlr(req: *mut spdk_nvmf_request) -> i32 {
     }
 }
 
+/// Returns the lvol shared as the only namespace of the subsystem of the
+/// given NVMf request, if any.
+fn request_replica(req: *mut spdk_nvmf_request) -> Option<Lvol> {
+    let subsys = unsafe { spdk_nvmf_request_get_subsystem(req) };
+    if subsys.is_null() {
+        debug!("subsystem is null");
+        return None;
+    }
+
+    /* Only process this request if it has exactly one namespace */
+    if unsafe { spdk_nvmf_subsystem_get_max_nsid(subsys) } != 1 {
+        debug!("multiple namespaces");
+        return None;
+    }
+
+    let mut bdev: *mut spdk_bdev = std::ptr::null_mut();
+    let mut desc: *mut spdk_bdev_desc = std::ptr::null_mut();
+    let mut ch: *mut spdk_io_channel = std::ptr::null_mut();
+    let rc = unsafe {
+        spdk_nvmf_request_get_bdev(1, req, &mut bdev, &mut desc, &mut ch)
+    };
+    if rc != 0 {
+        debug!("no bdev found");
+        return None;
+    }
+
+    Lvol::try_from(Bdev::checked_from_ptr(bdev)?).ok()
+}
+
+/// Encodes the transaction ids of the snapshots of the given lvol into the
+/// given buffer. The oldest snapshots are left out when they do not all fit.
+fn encode_snapshot_chain(lvol: &Lvol, buf: &mut [u8]) -> Result<(), i32> {
+    let mut txn_ids = lvol.snapshot_txn_ids();
+    loop {
+        let msg = NvmeSnapshotChainMessage::V1(
+            NvmeSnapshotChainMessageV1::new(txn_ids.clone()),
+        );
+        let encoded_msg = bincode::serialize(&msg).map_err(|e| {
+            error!("Failed to serialize snapshot chain message: {}", e);
+            libc::EINVAL
+        })?;
+
+        if encoded_msg.len() <= buf.len() {
+            buf[.. encoded_msg.len()].copy_from_slice(&encoded_msg);
+            return Ok(());
+        }
+        if txn_ids.pop().is_none() {
+            return Err(libc::ENOSPC);
+        }
+    }
+}
+
+/// NVMf custom command handler for opcode c2h: returns the transaction ids of
+/// the snapshots of a shared replica, newest first.
+/// Return: <0 for any error, caller handles it as unsupported opcode
+extern "C" fn nvmf_snapshot_chain_hdlr(req: *mut spdk_nvmf_request) -> i32 {
+    let Some(lvol) = request_replica(req) else {
+        return -1;
+    };
+    let mut nvmf_req = NvmfReq(NonNull::new(req).unwrap());
+
+    // Blobfs operations must be on md_thread
+    Reactors::master().send_future(async move {
+        match encode_snapshot_chain(&lvol, nvmf_req.data()) {
+            Ok(()) => nvmf_req.complete(),
+            Err(errno) => nvmf_req.complete_error(errno),
+        }
+    });
+    1 // SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS
+}
+
+/// NVMf custom command handler for opcode c6h: returns one page of the map
+/// of the blocks written to a shared replica since one of its snapshots.
+/// cdw10: index of the snapshot, as returned by opcode c2h
+/// cdw11: number of blocks per bit of the map
+/// cdw12: index of the page of the map
+/// Return: <0 for any error, caller handles it as unsupported opcode
+extern "C" fn nvmf_snapshot_delta_hdlr(req: *mut spdk_nvmf_request) -> i32 {
+    let Some(lvol) = request_replica(req) else {
+        return -1;
+    };
+    let (snapshot_idx, granularity, page) = unsafe {
+        let cmd = &*spdk_nvmf_request_get_cmd(req);
+        (
+            cmd.__bindgen_anon_1.cdw10,
+            cmd.__bindgen_anon_2.cdw11,
+            cmd.__bindgen_anon_3.cdw12 as u64,
+        )
+    };
+    let mut nvmf_req = NvmfReq(NonNull::new(req).unwrap());
+
+    // Blobfs operations must be on md_thread
+    Reactors::master().send_future(async move {
+        let Some(bitmap) = lvol
+            .snapshot_delta_bitmap(snapshot_idx as usize, granularity as u64)
+        else {
+            nvmf_req.complete_error(libc::ENOENT);
+            return;
+        };
+
+        let data = nvmf_req.data();
+        data.fill(0);
+        let start = (page * NVME_SNAPSHOT_PAGE_SIZE) as usize;
+        if start < bitmap.len() {
+            let end = bitmap.len().min(start + data.len());
+            data[.. end - start].copy_from_slice(&bitmap[start .. end]);
+        }
+        nvmf_req.complete();
+    });
+    1 // SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS
+}
+
 pub fn create_snapshot(
     lvol: Lvol,
     cmd: &spdk_nvme_cmd,
@@ -270,3 +411,18 @@ pub fn setup_create_snapshot_hdlr() {
         );
     }
 }
+
+/// Register the custom NVMe admin command handlers returning the snapshot
+/// delta of shared replicas
+pub fn setup_snapshot_delta_hdlrs() {
+    unsafe {
+        spdk_nvmf_set_custom_admin_cmd_hdlr(
+            NVME_ADMIN_SNAPSHOT_CHAIN,
+            Some(nvmf_snapshot_chain_hdlr),
+        );
+        spdk_nvmf_set_custom_admin_cmd_hdlr(
+            NVME_ADMIN_SNAPSHOT_DELTA,
+            Some(nvmf_snapshot_delta_hdlr),
+        );
+    }
+}
@@ -100,6 +100,7 @@ impl Nvmf {
 
         // set up custom NVMe Admin command handler
         admin_cmd::setup_create_snapshot_hdlr();
+        admin_cmd::setup_snapshot_delta_hdlrs();
 
         if Config::get().nexus_opts.nvmf_enable {
             NVMF_TGT.with(|tgt| tgt.borrow_mut().next_state());
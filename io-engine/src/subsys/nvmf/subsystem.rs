@@ -789,8 +789,9 @@ impl NvmfSubsystem {
         Ok(())
     }
 
-    // we currently allow all listeners to the subsystem
-    async fn add_listener(&self) -> Result<(), Error> {
+    // we currently allow all listeners to the subsystem; RDMA only when
+    // requested
+    async fn add_listener(&self, rdma: bool) -> Result<(), Error> {
         extern "C" fn listen_cb(arg: *mut c_void, status: i32) {
             let s = unsafe { Box::from_raw(arg as *mut oneshot::Sender<i32>) };
             s.send(status).unwrap();
@@ -798,26 +799,30 @@ impl NvmfSubsystem {
 
         let cfg = Config::get();
 
-        // dont yet enable both ports, IOW just add one transportID now
+        // dont yet enable both ports, IOW just add the replica port of
+        // every transport now
 
-        let trid_replica = TransportId::new(cfg.nexus_opts.nvmf_replica_port);
+        for trid_replica in
+            TransportId::share(cfg.nexus_opts.nvmf_replica_port, rdma)
+        {
+            let (s, r) = oneshot::channel::<i32>();
+            unsafe {
+                spdk_nvmf_subsystem_add_listener(
+                    self.0.as_ptr(),
+                    trid_replica.as_ptr(),
+                    Some(listen_cb),
+                    cb_arg(s),
+                );
+            }
 
-        let (s, r) = oneshot::channel::<i32>();
-        unsafe {
-            spdk_nvmf_subsystem_add_listener(
-                self.0.as_ptr(),
-                trid_replica.as_ptr(),
-                Some(listen_cb),
-                cb_arg(s),
-            );
+            r.await.expect("listener callback gone").to_result(|e| {
+                Error::Transport {
+                    source: Errno::from_i32(e),
+                    msg: format!("Failed to add listener {trid_replica}"),
+                }
+            })?;
         }
-
-        r.await.expect("listener callback gone").to_result(|e| {
-            Error::Transport {
-                source: Errno::from_i32(e),
-                msg: "Failed to add listener".to_string(),
-            }
-        })
+        Ok(())
     }
 
     /// TODO
@@ -900,7 +905,13 @@ impl NvmfSubsystem {
     /// failure to ensure the state is not in limbo and to avoid leaking
     /// resources
     pub async fn start(self) -> Result<String, Error> {
-        self.add_listener().await?;
+        self.start_with(false).await
+    }
+
+    /// start the subsystem previously created, listening over RDMA as well
+    /// if requested and the target has the RDMA transport
+    pub async fn start_with(self, rdma: bool) -> Result<String, Error> {
+        self.add_listener(rdma).await?;
 
         if let Err(e) = self
             .change_state("start", |ss, cb, arg| unsafe {
@@ -973,29 +984,30 @@ impl NvmfSubsystem {
             let s = unsafe { Box::from_raw(arg as *mut oneshot::Sender<i32>) };
             s.send(status).unwrap();
         }
-        let cfg = Config::get();
-        let trid_replica = TransportId::new(cfg.nexus_opts.nvmf_replica_port);
+        // The ANA state is per listener: set it on all of them.
+        for trid_replica in self.listeners_to_vec().unwrap_or_default() {
+            let (s, r) = oneshot::channel::<i32>();
 
-        let (s, r) = oneshot::channel::<i32>();
+            unsafe {
+                nvmf_subsystem_set_ana_state(
+                    self.0.as_ptr(),
+                    trid_replica.as_ptr(),
+                    ana_state,
+                    0,
+                    Some(set_ana_state_cb),
+                    cb_arg(s),
+                );
+            }
 
-        unsafe {
-            nvmf_subsystem_set_ana_state(
-                self.0.as_ptr(),
-                trid_replica.as_ptr(),
-                ana_state,
-                0,
-                Some(set_ana_state_cb),
-                cb_arg(s),
-            );
+            r.await
+                .expect("Cancellation is not supported")
+                .to_result(|e| Error::Subsystem {
+                    source: Errno::from_i32(-e),
+                    nqn: self.get_nqn(),
+                    msg: "failed to set_ana_state of the subsystem".to_string(),
+                })?;
         }
-
-        r.await
-            .expect("Cancellation is not supported")
-            .to_result(|e| Error::Subsystem {
-                source: Errno::from_i32(-e),
-                nqn: self.get_nqn(),
-                msg: "failed to set_ana_state of the subsystem".to_string(),
-            })
+        Ok(())
     }
 
     /// destroy all subsystems associated with our target, subsystems must be in
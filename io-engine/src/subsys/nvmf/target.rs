@@ -7,7 +7,7 @@ use std::{
 use nix::errno::Errno;
 
 use spdk_rs::libspdk::{
-    spdk_env_get_core_count,
+    spdk_env_get_socket_id,
     spdk_nvmf_listen_opts,
     spdk_nvmf_listen_opts_init,
     spdk_nvmf_poll_group_destroy,
@@ -27,8 +27,8 @@ use spdk_rs::libspdk::{
 
 use crate::{
     constants::NVME_CONTROLLER_MODEL_ID,
-    core::{Cores, Mthread, Reactor, Reactors},
-    ffihelper::{AsStr, FfiResult},
+    core::{Cores, MayastorEnvironment, Mthread, Reactor, Reactors},
+    ffihelper::FfiResult,
     subsys::{
         nvmf::{
             poll_groups::PollGroup,
@@ -54,6 +54,8 @@ pub struct Target {
     pub(crate) tgt: NonNull<spdk_nvmf_tgt>,
     /// the number of poll groups created for this target
     poll_group_count: u16,
+    /// the number of poll groups to be created for this target
+    poll_group_expected: u16,
     /// The current state of the target
     next_state: TargetState,
 }
@@ -100,6 +102,7 @@ impl Target {
         Self {
             tgt: NonNull::dangling(),
             poll_group_count: 0,
+            poll_group_expected: 0,
             next_state: TargetState::Init,
         }
     }
@@ -175,6 +178,14 @@ impl Target {
     fn add_transport(&self) {
         Reactors::master().send_future(async {
             let result = transport::add_tcp_transport().await;
+            if result.is_ok() && Config::get().nvmf_tcp_tgt_conf.rdma {
+                if let Err(error) = transport::add_rdma_transport().await {
+                    warn!(
+                        "Failed to add the RDMA nvmf transport, \
+                        serving over TCP only: {error}"
+                    );
+                }
+            }
             NVMF_TGT.with(|t| {
                 if result.is_err() {
                     t.borrow_mut().next_state = TargetState::Invalid;
@@ -184,16 +195,58 @@ impl Target {
         })
     }
 
+    /// Returns the reactors to create poll groups on: all of them, unless
+    /// the poll groups are confined to the NUMA node of the target's network
+    /// interface and that node has cores. The NVMf target spreads the new
+    /// qpairs over its poll groups only, so that they are then all served by
+    /// cores next to the NIC.
+    fn poll_group_reactors() -> Vec<&'static Reactor> {
+        let all: Vec<&'static Reactor> = Reactors::iter().collect();
+        if !Config::get().nvmf_tcp_tgt_conf.numa_local_poll_groups {
+            return all;
+        }
+
+        let Some(node) = MayastorEnvironment::get_nvmf_tgt_numa_node() else {
+            warn!(
+                "NUMA node of the nvmf target network interface is unknown, \
+                creating poll groups on all cores"
+            );
+            return all;
+        };
+
+        let local: Vec<_> = all
+            .iter()
+            .copied()
+            .filter(|r| unsafe { spdk_env_get_socket_id(r.core()) } == node)
+            .collect();
+        if local.is_empty() {
+            warn!(
+                "No core on NUMA node {node} of the nvmf target network \
+                interface, creating poll groups on all cores"
+            );
+            return all;
+        }
+
+        info!(
+            "Creating nvmf poll groups on the {n} cores of NUMA node {node}",
+            n = local.len()
+        );
+        local
+    }
+
     /// init the poll groups per core
-    fn init_poll_groups(&self) {
-        Reactors::iter().for_each(|r| {
+    fn init_poll_groups(&mut self) {
+        let mut expected = 0;
+        Self::poll_group_reactors().into_iter().for_each(|r| {
             if let Some(t) = Mthread::new(
                 format!("mayastor_nvmf_tcp_pg_core_{}", r.core()),
                 r.core(),
             ) {
                 r.send_future(Self::create_poll_group(self.tgt.as_ptr(), t));
+                expected += 1;
             }
         });
+        self.poll_group_expected = expected;
     }
 
     /// init the poll groups implementation
@@ -206,9 +259,7 @@ impl Target {
                     let mut tgt = tgt.borrow_mut();
                     NVMF_PGS.with(|p| p.borrow_mut().push(pg));
                     tgt.poll_group_count += 1;
-                    if tgt.poll_group_count
-                        == unsafe { spdk_env_get_core_count() as u16 }
-                    {
+                    if tgt.poll_group_count == tgt.poll_group_expected {
                         Reactors::master().send_future(async {
                             NVMF_TGT.with(|tgt| {
                                 tgt.borrow_mut().next_state();
@@ -224,7 +275,6 @@ impl Target {
     /// port
     fn listen(&mut self) -> Result<()> {
         let cfg = Config::get();
-        let trid_nexus = TransportId::new(cfg.nexus_opts.nvmf_nexus_port);
         let mut opts = spdk_nvmf_listen_opts::default();
         unsafe {
             spdk_nvmf_listen_opts_init(
@@ -232,39 +282,49 @@ impl Target {
                 std::mem::size_of::<spdk_nvmf_listen_opts>() as u64,
             );
         }
-        let rc = unsafe {
-            spdk_nvmf_tgt_listen_ext(
-                self.tgt.as_ptr(),
-                trid_nexus.as_ptr(),
-                &mut opts,
-            )
-        };
 
-        if rc != 0 {
-            return Err(Error::CreateTarget {
-                msg: "failed to back target".into(),
-            });
+        for trid_nexus in TransportId::all(cfg.nexus_opts.nvmf_nexus_port) {
+            let rc = unsafe {
+                spdk_nvmf_tgt_listen_ext(
+                    self.tgt.as_ptr(),
+                    trid_nexus.as_ptr(),
+                    &mut opts,
+                )
+            };
+
+            if rc != 0 {
+                return Err(Error::CreateTarget {
+                    msg: format!("failed to back target on {trid_nexus}"),
+                });
+            }
         }
 
-        let trid_replica = TransportId::new(cfg.nexus_opts.nvmf_replica_port);
-        let rc = unsafe {
-            spdk_nvmf_tgt_listen_ext(
-                self.tgt.as_ptr(),
-                trid_replica.as_ptr(),
-                &mut opts,
-            )
-        };
+        for trid_replica in TransportId::all(cfg.nexus_opts.nvmf_replica_port) {
+            let rc = unsafe {
+                spdk_nvmf_tgt_listen_ext(
+                    self.tgt.as_ptr(),
+                    trid_replica.as_ptr(),
+                    &mut opts,
+                )
+            };
 
-        if rc != 0 {
-            return Err(Error::CreateTarget {
-                msg: "failed to front target".into(),
-            });
+            if rc != 0 {
+                return Err(Error::CreateTarget {
+                    msg: format!("failed to front target on {trid_replica}"),
+                });
+            }
         }
+
         info!(
-            "nvmf target listening on {}:({},{})",
+            "nvmf target listening on {}:({},{}){}",
             get_ipv4_address().unwrap(),
-            trid_nexus.trsvcid.as_str(),
-            trid_replica.trsvcid.as_str(),
+            cfg.nexus_opts.nvmf_nexus_port,
+            cfg.nexus_opts.nvmf_replica_port,
+            if transport::rdma_enabled() {
+                " over TCP and RDMA"
+            } else {
+                ""
+            },
         );
         self.next_state();
         Ok(())
@@ -382,23 +442,21 @@ impl Target {
             );
         } else {
             let cfg = Config::get();
-            let trid_nexus = TransportId::new(cfg.nexus_opts.nvmf_nexus_port);
+            let trid_nexus = TransportId::all(cfg.nexus_opts.nvmf_nexus_port);
             let trid_replica =
-                TransportId::new(cfg.nexus_opts.nvmf_replica_port);
-
-            unsafe {
-                spdk_nvmf_tgt_stop_listen(
-                    self.tgt.as_ptr(),
-                    trid_replica.as_ptr(),
-                )
-            };
-
-            unsafe {
-                spdk_nvmf_tgt_stop_listen(
-                    self.tgt.as_ptr(),
-                    trid_nexus.as_ptr(),
-                )
-            };
+                TransportId::all(cfg.nexus_opts.nvmf_replica_port);
+
+            trid_replica
+                .iter()
+                .chain(trid_nexus.iter())
+                .for_each(|trid| {
+                    unsafe {
+                        spdk_nvmf_tgt_stop_listen(
+                            self.tgt.as_ptr(),
+                            trid.as_ptr(),
+                        )
+                    };
+                });
         }
 
         unsafe {
@@ -2,6 +2,7 @@ use std::{
     ffi::CString,
     fmt::{Debug, Display, Formatter},
     ops::{Deref, DerefMut},
+    sync::atomic::{AtomicBool, Ordering},
 };
 
 use futures::channel::oneshot;
@@ -12,8 +13,11 @@ use spdk_rs::{
     ffihelper::{copy_cstr_with_null, copy_str_with_null},
     libspdk::{
         spdk_nvme_transport_id,
+        spdk_nvme_transport_type,
         spdk_nvmf_tgt_add_transport,
         spdk_nvmf_transport_create,
+        spdk_nvmf_transport_opts,
+        SPDK_NVME_TRANSPORT_RDMA,
         SPDK_NVME_TRANSPORT_TCP,
         SPDK_NVMF_ADRFAM_IPV4,
         SPDK_NVMF_TRSVCID_MAX_LEN,
@@ -32,16 +36,42 @@ use crate::{
 static TCP_TRANSPORT: Lazy<CString> =
     Lazy::new(|| CString::new("TCP").unwrap());
 
+static RDMA_TRANSPORT: Lazy<CString> =
+    Lazy::new(|| CString::new("RDMA").unwrap());
+
+/// Set once the RDMA transport has been added to the target.
+static RDMA_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// Determines if the target has the RDMA transport, for the shares requesting
+/// it.
+pub(crate) fn rdma_enabled() -> bool {
+    RDMA_ENABLED.load(Ordering::SeqCst)
+}
+
 pub async fn add_tcp_transport() -> Result<(), Error> {
-    let cfg = Config::get();
-    let mut opts = cfg.nvmf_tcp_tgt_conf.opts.into();
-    let transport = unsafe {
-        spdk_nvmf_transport_create(TCP_TRANSPORT.as_ptr(), &mut opts)
-    };
+    let opts = Config::get().nvmf_tcp_tgt_conf.opts.into();
+    add_transport(&TCP_TRANSPORT, opts).await
+}
+
+/// Adds the RDMA transport, with its own options. It fails when the node has
+/// no RDMA capable device.
+pub async fn add_rdma_transport() -> Result<(), Error> {
+    let opts = Config::get().nvmf_tcp_tgt_conf.rdma_opts.into();
+    add_transport(&RDMA_TRANSPORT, opts).await?;
+    RDMA_ENABLED.store(true, Ordering::SeqCst);
+    Ok(())
+}
+
+async fn add_transport(
+    name: &CString,
+    mut opts: spdk_nvmf_transport_opts,
+) -> Result<(), Error> {
+    let transport =
+        unsafe { spdk_nvmf_transport_create(name.as_ptr(), &mut opts) };
 
     transport.to_result(|_| Error::Transport {
         source: Errno::UnknownErrno,
-        msg: "failed to create transport".into(),
+        msg: format!("failed to create {} transport", name.to_string_lossy()),
     })?;
 
     let (s, r) = oneshot::channel::<ErrnoResult<()>>();
@@ -56,9 +86,12 @@ pub async fn add_tcp_transport() -> Result<(), Error> {
         })
     };
 
-    let _result = r.await.unwrap();
+    r.await.unwrap().map_err(|source| Error::Transport {
+        source,
+        msg: format!("failed to add {} transport", name.to_string_lossy()),
+    })?;
 
-    debug!("Added TCP nvmf transport");
+    debug!("Added {} nvmf transport", name.to_string_lossy());
     Ok(())
 }
 
@@ -78,11 +111,41 @@ impl DerefMut for TransportId {
 }
 
 impl TransportId {
+    /// Returns the TCP transport id of the target for the given port.
     pub fn new(port: u16) -> Self {
+        Self::with_transport(port, SPDK_NVME_TRANSPORT_TCP, &TCP_TRANSPORT)
+    }
+
+    /// Returns the RDMA transport id of the target for the given port.
+    pub fn new_rdma(port: u16) -> Self {
+        Self::with_transport(port, SPDK_NVME_TRANSPORT_RDMA, &RDMA_TRANSPORT)
+    }
+
+    /// Returns the transport ids the target listens on for the given port:
+    /// TCP, and RDMA when it is enabled.
+    pub fn all(port: u16) -> Vec<Self> {
+        Self::share(port, true)
+    }
+
+    /// Returns the transport ids a share listens on for the given port:
+    /// TCP, and RDMA when requested by the share and enabled.
+    pub fn share(port: u16, rdma: bool) -> Vec<Self> {
+        let mut ids = vec![Self::new(port)];
+        if rdma && rdma_enabled() {
+            ids.push(Self::new_rdma(port));
+        }
+        ids
+    }
+
+    fn with_transport(
+        port: u16,
+        trtype: spdk_nvme_transport_type,
+        trstring: &CString,
+    ) -> Self {
         let address = get_ipv4_address().unwrap();
 
         let mut trid = spdk_nvme_transport_id {
-            trtype: SPDK_NVME_TRANSPORT_TCP,
+            trtype,
             adrfam: SPDK_NVMF_ADRFAM_IPV4,
             ..Default::default()
         };
@@ -90,7 +153,7 @@ impl TransportId {
         let port = format!("{port}");
         assert!(port.len() < SPDK_NVMF_TRSVCID_MAX_LEN as usize);
 
-        copy_cstr_with_null(&TCP_TRANSPORT, &mut trid.trstring);
+        copy_cstr_with_null(trstring, &mut trid.trstring);
         copy_str_with_null(&address, &mut trid.traddr);
         copy_str_with_null(&port, &mut trid.trsvcid);
 
@@ -104,9 +167,14 @@ impl TransportId {
 
 impl Display for TransportId {
     fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        let scheme = if self.0.trtype == SPDK_NVME_TRANSPORT_RDMA {
+            "nvmf+rdma"
+        } else {
+            "nvmf"
+        };
         write!(
             f,
-            "nvmf://{}:{}",
+            "{scheme}://{}:{}",
             self.0.traddr.as_str(),
             self.0.trsvcid.as_str()
         )
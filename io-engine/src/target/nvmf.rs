@@ -36,8 +36,13 @@ pub async fn unshare(uuid: &str) -> Result<(), NvmfError> {
 pub fn get_uri(uuid: &str) -> Option<String> {
     if let Some(ss) = NvmfSubsystem::nqn_lookup(uuid) {
         // for now we only pop the first but we can share a bdev
-        // over multiple nqn's
-        ss.uri_endpoints().unwrap().pop()
+        // over multiple nqn's; the share listens over RDMA only when it
+        // asked for it, in which case its URI is the RDMA one
+        let mut uris = ss.uri_endpoints().unwrap();
+        match uris.iter().position(|u| u.starts_with("nvmf+rdma://")) {
+            Some(i) => Some(uris.swap_remove(i)),
+            None => uris.pop(),
+        }
     } else {
         None
     }
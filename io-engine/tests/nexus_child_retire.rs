@@ -40,6 +40,7 @@ use io_engine::{
         NexusInfo,
     },
     core::{
+        device_monitor_loop,
         fault_injection::{
             add_fault_injection,
             FaultDomain,
@@ -48,10 +49,12 @@ use io_engine::{
             FaultMethod,
             InjectionBuilder,
         },
+        runtime,
         CoreError,
         IoCompletionStatus,
         MayastorCliArgs,
         Protocol,
+        UntypedBdev,
     },
     lvs::Lvs,
     persistent_store::PersistentStoreBuilder,
@@ -522,6 +525,79 @@ async fn nexus_child_retire_persist_failure_with_bdev_io() {
     deinit_ms_etcd_test().await;
 }
 
+#[tokio::test]
+/// Retire a child with no I/O in flight: its device is destroyed without
+/// pausing the nexus, and the freeze durations of the nexus record no pause.
+async fn nexus_child_retire_idle_without_pause() {
+    const NEXUS: &str = "retire_idle_nexus";
+    const CHILD_0: &str = "malloc:///retire_idle_0?size_mb=32";
+    const CHILD_1: &str = "malloc:///retire_idle_1?size_mb=32";
+
+    // Retired devices are destroyed by the device monitor.
+    runtime::spawn(device_monitor_loop());
+
+    get_ms()
+        .spawn(async {
+            nexus_create(
+                NEXUS,
+                16 * 1024 * 1024,
+                None,
+                &[CHILD_0.to_string(), CHILD_1.to_string()],
+            )
+            .await
+            .unwrap();
+            bdev_io::write_some(NEXUS, 0, 8, 0xaa).await.unwrap();
+
+            let mut nex = nexus_lookup_mut(NEXUS).unwrap();
+            nex.reset_io_latency().await;
+            nex.as_mut()
+                .fault_child(CHILD_1, FaultReason::OfflinePermanent)
+                .await
+                .unwrap();
+        })
+        .await;
+
+    // Wait until the retired device is destroyed.
+    tokio::time::timeout(Duration::from_secs(5), async {
+        while get_ms()
+            .spawn(async {
+                UntypedBdev::lookup_by_name("retire_idle_1").is_some()
+            })
+            .await
+        {
+            tokio::time::sleep(Duration::from_millis(100)).await;
+        }
+    })
+    .await
+    .expect("Retired device must be destroyed");
+
+    get_ms()
+        .spawn(async {
+            let mut nex = nexus_lookup_mut(NEXUS).unwrap();
+            assert!(matches!(
+                nex.child(CHILD_1).unwrap().state(),
+                ChildState::Faulted(FaultReason::OfflinePermanent)
+            ));
+            assert_eq!(
+                nex.io_latency().await.freeze.pause.count(),
+                0,
+                "Retiring an idle child must not pause the nexus"
+            );
+
+            // The nexus keeps serving I/O from the remaining child.
+            bdev_io::write_some(NEXUS, 0, 8, 0xbb).await.unwrap();
+            bdev_io::read_some(NEXUS, 0, 8, 0xbb).await.unwrap();
+
+            // An explicit pause is recorded.
+            nex.as_mut().pause().await.unwrap();
+            nex.as_mut().resume().await.unwrap();
+            assert_eq!(nex.io_latency().await.freeze.pause.count(), 1);
+
+            nex.destroy().await.unwrap();
+        })
+        .await;
+}
+
 async fn init_ms_etcd_test() -> ComposeTest {
     common::composer_init();
 
@@ -0,0 +1,160 @@
+#![cfg(feature = "fault-injection")]
+
+pub mod common;
+
+use std::time::Duration;
+
+use common::{
+    compose::{
+        rpc::v1::{
+            nexus::{ChildState, ChildStateReason},
+            GrpcConnect,
+        },
+        Binary,
+        Builder,
+    },
+    file_io::DataSize,
+    fio::{FioBuilder, FioJobBuilder},
+    nexus::{test_fio_to_nexus, NexusBuilder},
+    pool::PoolBuilder,
+    replica::ReplicaBuilder,
+    test::add_fault_injection,
+};
+
+use io_engine::core::fault_injection::{
+    FaultDomain,
+    FaultIoOperation,
+    FaultIoStage,
+    FaultMethod,
+    InjectionBuilder,
+};
+
+const POOL_SIZE: u64 = 80;
+const REPL_SIZE: u64 = 60;
+const NEXUS_SIZE: u64 = REPL_SIZE;
+
+#[tokio::test]
+async fn nexus_integrity_retry_other_replica() {
+    common::composer_init();
+
+    let test = Builder::new()
+        .name("cargo-test")
+        .network("10.1.0.0/16")
+        .unwrap()
+        .add_container_bin(
+            "ms_0",
+            Binary::from_dbg("io-engine").with_args(vec!["-l", "1"]),
+        )
+        .add_container_bin(
+            "ms_1",
+            Binary::from_dbg("io-engine").with_args(vec!["-l", "2"]),
+        )
+        .add_container_bin(
+            "ms_nex",
+            Binary::from_dbg("io-engine")
+                // Verify the reads against the checksums of the writes.
+                .with_env("NEXUS_INTEGRITY", "1")
+                .with_args(vec!["-l", "3", "-Fcolor,compact"]),
+        )
+        .with_clean(true)
+        .build()
+        .await
+        .unwrap();
+
+    let conn = GrpcConnect::new(&test);
+
+    let ms_0 = conn.grpc_handle_shared("ms_0").await.unwrap();
+    let ms_1 = conn.grpc_handle_shared("ms_1").await.unwrap();
+    let ms_nex = conn.grpc_handle_shared("ms_nex").await.unwrap();
+
+    let mut pool_0 = PoolBuilder::new(ms_0.clone())
+        .with_name("pool0")
+        .with_new_uuid()
+        .with_malloc("mem0", POOL_SIZE);
+
+    let mut repl_0 = ReplicaBuilder::new(ms_0.clone())
+        .with_pool(&pool_0)
+        .with_name("r0")
+        .with_new_uuid()
+        .with_size_mb(REPL_SIZE)
+        .with_thin(false);
+
+    pool_0.create().await.unwrap();
+    repl_0.create().await.unwrap();
+    repl_0.share().await.unwrap();
+
+    let mut pool_1 = PoolBuilder::new(ms_1.clone())
+        .with_name("pool1")
+        .with_new_uuid()
+        .with_malloc("mem1", POOL_SIZE);
+
+    let mut repl_1 = ReplicaBuilder::new(ms_1.clone())
+        .with_pool(&pool_1)
+        .with_name("r1")
+        .with_new_uuid()
+        .with_size_mb(REPL_SIZE)
+        .with_thin(false);
+
+    pool_1.create().await.unwrap();
+    repl_1.create().await.unwrap();
+    repl_1.share().await.unwrap();
+
+    let mut nex_0 = NexusBuilder::new(ms_nex.clone())
+        .with_name("nexus0")
+        .with_new_uuid()
+        .with_size_mb(NEXUS_SIZE)
+        .with_replica(&repl_0)
+        .with_replica(&repl_1);
+
+    nex_0.create().await.unwrap();
+    nex_0.publish().await.unwrap();
+
+    let child = nex_0.get_nexus_replica_child(&repl_0).await.unwrap();
+    let dev_name = child.device_name.as_ref().unwrap();
+
+    // Corrupt all the data read from the first replica.
+    let inj_uri = InjectionBuilder::default()
+        .with_device_name(dev_name.clone())
+        .with_domain(FaultDomain::NexusChild)
+        .with_io_operation(FaultIoOperation::Read)
+        .with_io_stage(FaultIoStage::Completion)
+        .with_method(FaultMethod::Data)
+        .build_uri()
+        .unwrap();
+    add_fault_injection(nex_0.rpc(), &inj_uri).await.unwrap();
+
+    // Write and read back the data: the reads returning corrupted data from
+    // the first replica must be retried on the second one.
+    test_fio_to_nexus(
+        &nex_0,
+        FioBuilder::new()
+            .with_job(
+                FioJobBuilder::new()
+                    .with_rw("write")
+                    .with_bs(4096)
+                    .with_iodepth(8)
+                    .with_size(DataSize::from_mb(4))
+                    .with_verify("crc32")
+                    .with_verify_fatal(true)
+                    .build(),
+            )
+            .build(),
+    )
+    .await
+    .unwrap();
+
+    // The replica returning corrupted data is retired, the other one is
+    // kept.
+    nex_0
+        .wait_replica_state(
+            &repl_0,
+            ChildState::Faulted,
+            Some(ChildStateReason::IoFailure),
+            Duration::from_secs(5),
+        )
+        .await
+        .unwrap();
+
+    let child = nex_0.get_nexus_replica_child(&repl_1).await.unwrap();
+    assert_eq!(child.state(), ChildState::Online);
+}
@@ -0,0 +1,157 @@
+#![cfg(feature = "fault-injection")]
+
+use once_cell::sync::OnceCell;
+
+use common::{bdev_io, MayastorTest};
+use io_engine::{
+    bdev::nexus::{
+        nexus_create,
+        nexus_lookup_mut,
+        set_read_policy,
+        ChildState,
+        ReadPolicy,
+    },
+    core::{
+        fault_injection::{
+            add_fault_injection,
+            FaultDomain,
+            FaultIoOperation,
+            FaultIoStage,
+            FaultMethod,
+            InjectionBuilder,
+        },
+        IoCompletionStatus,
+        IoSubmissionFailure,
+        MayastorCliArgs,
+        UntypedBdev,
+    },
+};
+
+pub mod common;
+
+static MS: OnceCell<MayastorTest> = OnceCell::new();
+
+const NEXUS_NAME: &str = "nomem_nexus";
+const NEXUS_SIZE: u64 = 16 * 1024 * 1024;
+/// Number of submissions failing with ENOMEM, per injection.
+const NOMEM_HITS: u64 = 4;
+
+fn mayastor() -> &'static MayastorTest<'static> {
+    MS.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Returns the number of read operations of the given bdev.
+async fn num_read_ops(name: &str) -> u64 {
+    UntypedBdev::lookup_by_name(name)
+        .expect("child bdev not found")
+        .stats_async()
+        .await
+        .expect("failed to get child bdev stats")
+        .num_read_ops
+}
+
+/// Fails the first `NOMEM_HITS` submissions of the given operation to the
+/// given device for lack of resources.
+fn inject_nomem(device_name: String, op: FaultIoOperation) {
+    add_fault_injection(
+        InjectionBuilder::default()
+            .with_domain(FaultDomain::NexusChild)
+            .with_device_name(device_name)
+            .with_io_operation(op)
+            .with_io_stage(FaultIoStage::Submission)
+            .with_method(FaultMethod::Status(
+                IoCompletionStatus::IoSubmissionError(
+                    IoSubmissionFailure::NoMem,
+                ),
+            ))
+            .with_retries(NOMEM_HITS)
+            .build()
+            .unwrap(),
+    )
+    .unwrap();
+}
+
+#[tokio::test]
+/// Submissions failing with ENOMEM park the nexus I/Os until they can be
+/// resubmitted: the I/Os complete successfully, and no child is retired.
+async fn nexus_io_nomem_park() {
+    mayastor()
+        .spawn(async {
+            // Readers with failed submissions are not selected by this
+            // policy: lacking resources must not count as such a failure.
+            set_read_policy(ReadPolicy::LeastOutstanding);
+
+            let children: Vec<String> = (0 .. 2)
+                .map(|i| format!("malloc:///nomem{i}?size_mb=32"))
+                .collect();
+            nexus_create(NEXUS_NAME, NEXUS_SIZE, None, &children)
+                .await
+                .expect("failed to create the nexus");
+
+            let nex = nexus_lookup_mut(NEXUS_NAME).unwrap();
+            let dev_0 = nex.child_at(0).get_device_name().unwrap();
+            let dev_1 = nex.child_at(1).get_device_name().unwrap();
+
+            // Writes lacking resources on one child are retried on all of
+            // them.
+            inject_nomem(dev_1.clone(), FaultIoOperation::Write);
+            for i in 0 .. NOMEM_HITS {
+                bdev_io::write_some(NEXUS_NAME, i * 4096, 8, 0xaa)
+                    .await
+                    .expect("parked nexus write failed");
+            }
+
+            // Reads lacking resources on all the children are parked.
+            inject_nomem(dev_0, FaultIoOperation::Read);
+            inject_nomem(dev_1, FaultIoOperation::Read);
+            for i in 0 .. NOMEM_HITS {
+                bdev_io::read_some(NEXUS_NAME, i * 4096, 8, 0xaa)
+                    .await
+                    .expect("parked nexus read failed");
+            }
+
+            let nex = nexus_lookup_mut(NEXUS_NAME).unwrap();
+            for child in nex.children() {
+                assert!(
+                    matches!(child.state(), ChildState::Open),
+                    "child {} retired on ENOMEM: {:?}",
+                    child.uri(),
+                    child.state()
+                );
+            }
+
+            // Once the parked reads are resubmitted, both readers are still
+            // selected.
+            let before =
+                [num_read_ops("nomem0").await, num_read_ops("nomem1").await];
+            for i in 0 .. 2 * NOMEM_HITS {
+                bdev_io::read_some(
+                    NEXUS_NAME,
+                    (i % NOMEM_HITS) * 4096,
+                    8,
+                    0xaa,
+                )
+                .await
+                .expect("nexus read failed");
+            }
+            for (i, n) in before.iter().enumerate() {
+                let name = format!("nomem{i}");
+                assert!(
+                    num_read_ops(&name).await > *n,
+                    "reader {} no longer selected after ENOMEM",
+                    name
+                );
+            }
+
+            // Both children got the writes.
+            for i in 0 .. 2 {
+                bdev_io::read_some(&format!("nomem{i}"), 0, 8, 0xaa)
+                    .await
+                    .expect("child write missing");
+            }
+
+            nex.destroy().await.unwrap();
+            set_read_policy(ReadPolicy::RoundRobin);
+        })
+        .await;
+}
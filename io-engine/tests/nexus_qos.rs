@@ -0,0 +1,115 @@
+use std::time::{Duration, Instant};
+
+use futures::future::join_all;
+use once_cell::sync::OnceCell;
+
+use common::MayastorTest;
+use io_engine::{
+    bdev::nexus::{nexus_create, nexus_lookup_mut, NexusQos},
+    core::{MayastorCliArgs, UntypedBdevHandle},
+};
+
+pub mod common;
+
+static MS: OnceCell<MayastorTest> = OnceCell::new();
+
+const NEXUS_NAME: &str = "qos_nexus";
+const NEXUS_SIZE: u64 = 32 * 1024 * 1024;
+const IO_SIZE: u64 = 4096;
+/// Write limit of the nexus, and the number of I/Os of the test.
+const WRITE_IOPS: u64 = 200;
+const BURST_MS: u64 = 100;
+const NUM_IOS: u64 = 120;
+
+fn mayastor() -> &'static MayastorTest<'static> {
+    MS.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Runs `NUM_IOS` reads or writes on the nexus, 16 at a time, and returns
+/// how long they took.
+async fn run_ios(write: bool) -> Duration {
+    let h = UntypedBdevHandle::open(NEXUS_NAME, true, false)
+        .expect("failed to open the nexus");
+    let start = Instant::now();
+
+    for batch in (0 .. NUM_IOS).collect::<Vec<_>>().chunks(16) {
+        join_all(batch.iter().map(|&i| {
+            let mut buf = h.dma_malloc(IO_SIZE).unwrap();
+            let h = &h;
+            async move {
+                if write {
+                    h.write_at(i * IO_SIZE, &buf).await
+                } else {
+                    h.read_at(i * IO_SIZE, &mut buf).await
+                }
+            }
+        }))
+        .await
+        .into_iter()
+        .for_each(|r| {
+            r.expect("nexus I/O failed");
+        });
+    }
+
+    start.elapsed()
+}
+
+#[tokio::test]
+async fn nexus_qos_write_iops() {
+    mayastor()
+        .spawn(async {
+            nexus_create(
+                NEXUS_NAME,
+                NEXUS_SIZE,
+                None,
+                &["malloc:///qos0?size_mb=64".to_string()],
+            )
+            .await
+            .expect("failed to create the nexus");
+
+            let qos = NexusQos {
+                write_iops: WRITE_IOPS,
+                burst_ms: BURST_MS,
+                ..Default::default()
+            };
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .set_qos(Some(qos))
+                .await
+                .expect("failed to set the QoS limits");
+
+            // Past the burst credits, the writes are released at the limit.
+            let burst = WRITE_IOPS * BURST_MS / 1000;
+            let min = Duration::from_millis(
+                (NUM_IOS - burst) * 1000 / WRITE_IOPS * 8 / 10,
+            );
+            let elapsed = run_ios(true).await;
+            assert!(elapsed >= min, "{} writes took {:?}", NUM_IOS, elapsed);
+
+            let nexus = nexus_lookup_mut(NEXUS_NAME).unwrap();
+            assert_eq!(nexus.qos(), Some(qos));
+            let stats = nexus.qos_stats();
+            assert!(stats.throttled_ios > 0, "no write throttled");
+            assert!(stats.throttled_us > 0);
+            assert_eq!(stats.queued_ios, 0);
+
+            // Reads are not limited.
+            run_ios(false).await;
+            let nexus = nexus_lookup_mut(NEXUS_NAME).unwrap();
+            assert_eq!(nexus.qos_stats().throttled_ios, stats.throttled_ios);
+
+            // Settings without any limit remove the limits.
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .set_qos(Some(NexusQos::default()))
+                .await
+                .expect("failed to remove the QoS limits");
+            let nexus = nexus_lookup_mut(NEXUS_NAME).unwrap();
+            assert_eq!(nexus.qos(), None);
+            run_ios(true).await;
+            assert_eq!(nexus.qos_stats().throttled_ios, 0);
+
+            nexus.destroy().await.unwrap();
+        })
+        .await;
+}
@@ -0,0 +1,140 @@
+use futures::future::join_all;
+use once_cell::sync::OnceCell;
+
+use common::MayastorTest;
+use io_engine::{
+    bdev::nexus::{nexus_create, nexus_lookup_mut},
+    core::{MayastorCliArgs, UntypedBdevHandle},
+};
+
+pub mod common;
+
+static MS: OnceCell<MayastorTest> = OnceCell::new();
+
+const NEXUS_NAME: &str = "read_cache_nexus";
+const NEXUS_SIZE: u64 = 32 * 1024 * 1024;
+const BLOCK_SIZE: u64 = 512;
+/// Blocks per cache line.
+const LINE_BLOCKS: u64 = 8;
+/// Number of blocks the test reads and writes.
+const NUM_BLOCKS: u64 = 16 * LINE_BLOCKS;
+
+fn mayastor() -> &'static MayastorTest<'static> {
+    MS.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Writes the given blocks with the given byte.
+async fn write_blocks(offset: u64, num_blocks: u64, fill: u8) {
+    let h = UntypedBdevHandle::open(NEXUS_NAME, true, false).unwrap();
+    let mut buf = h.dma_malloc(num_blocks * BLOCK_SIZE).unwrap();
+    buf.fill(fill);
+    h.write_at(offset * BLOCK_SIZE, &buf)
+        .await
+        .expect("nexus write failed");
+}
+
+/// Reads the given blocks of the given bdev, and returns the first byte of
+/// each of them, checking that it fills the block.
+async fn read_bdev_blocks(name: &str, offset: u64, num_blocks: u64) -> Vec<u8> {
+    let h = UntypedBdevHandle::open(name, true, false).unwrap();
+    let mut buf = h.dma_malloc(num_blocks * BLOCK_SIZE).unwrap();
+    h.read_at(offset * BLOCK_SIZE, &mut buf)
+        .await
+        .expect("read failed");
+
+    buf.as_slice()
+        .chunks(BLOCK_SIZE as usize)
+        .enumerate()
+        .map(|(i, b)| {
+            assert!(
+                b.iter().all(|&v| v == b[0]),
+                "block {} is torn",
+                offset + i as u64
+            );
+            b[0]
+        })
+        .collect()
+}
+
+/// Reads the given blocks of the nexus.
+async fn read_blocks(offset: u64, num_blocks: u64) -> Vec<u8> {
+    read_bdev_blocks(NEXUS_NAME, offset, num_blocks).await
+}
+
+/// Reads all the test blocks, one line at a time, so that they are cached.
+async fn read_lines() -> Vec<u8> {
+    let mut data = Vec::new();
+    for line in 0 .. NUM_BLOCKS / LINE_BLOCKS {
+        data.extend(read_blocks(line * LINE_BLOCKS, LINE_BLOCKS).await);
+    }
+    data
+}
+
+#[tokio::test]
+async fn nexus_read_cache_overlapping_writes() {
+    mayastor()
+        .spawn(async {
+            let children: Vec<String> = (0 .. 2)
+                .map(|i| format!("malloc:///rc{i}?size_mb=64"))
+                .collect();
+            nexus_create(NEXUS_NAME, NEXUS_SIZE, None, &children)
+                .await
+                .expect("failed to create the nexus");
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .set_read_cache(16)
+                .await
+                .expect("failed to set the read cache");
+
+            let mut expected = vec![0xaa; NUM_BLOCKS as usize];
+            write_blocks(0, NUM_BLOCKS, 0xaa).await;
+            assert_eq!(read_lines().await, expected);
+            assert_eq!(read_lines().await, expected);
+
+            let stats = nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .read_cache_stats()
+                .unwrap();
+            assert!(stats.hits > 0, "no read served from the cache");
+
+            // Writes covering part of a line, several lines, and the end of
+            // a line and the start of the next one.
+            let writes = [(2, 3, 0xb1), (16, 16, 0xb2), (45, 6, 0xb3)];
+            for (offset, num_blocks, fill) in writes {
+                write_blocks(offset, num_blocks, fill).await;
+                expected[offset as usize .. (offset + num_blocks) as usize]
+                    .fill(fill);
+            }
+            assert_eq!(read_lines().await, expected);
+
+            // Overlapping writes racing with reads of the same lines: once
+            // they completed, no stale line is left in the cache.
+            let writes = [(0, 9, 0xc1), (4, 8, 0xc2), (60, 20, 0xc3)];
+            futures::join!(
+                join_all(writes.iter().map(|&(offset, num_blocks, fill)| {
+                    write_blocks(offset, num_blocks, fill)
+                })),
+                join_all((0 .. 4).map(|_| read_lines()))
+            );
+
+            // The order of the overlapping writes is not defined: the blocks
+            // they share are read from a child, bypassing the cache.
+            for (offset, num_blocks, fill) in writes {
+                expected[offset as usize .. (offset + num_blocks) as usize]
+                    .fill(fill);
+            }
+            let shared = read_bdev_blocks("rc0", 4, 5).await;
+            assert!(shared.iter().all(|&v| v == 0xc1 || v == 0xc2));
+            expected[4 .. 9].copy_from_slice(&shared);
+
+            assert_eq!(read_lines().await, expected);
+            assert_eq!(read_lines().await, expected);
+
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .destroy()
+                .await
+                .unwrap();
+        })
+        .await;
+}
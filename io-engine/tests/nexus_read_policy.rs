@@ -0,0 +1,109 @@
+use futures::future::join_all;
+use once_cell::sync::OnceCell;
+
+use common::MayastorTest;
+use io_engine::{
+    bdev::nexus::{
+        nexus_create,
+        nexus_lookup_mut,
+        set_read_policy,
+        ReadPolicy,
+    },
+    core::{MayastorCliArgs, UntypedBdev, UntypedBdevHandle},
+};
+
+pub mod common;
+
+static MS: OnceCell<MayastorTest> = OnceCell::new();
+
+const NEXUS_NAME: &str = "read_policy_nexus";
+const NEXUS_SIZE: u64 = 32 * 1024 * 1024;
+const BLOCK_SIZE: u64 = 512;
+
+fn mayastor() -> &'static MayastorTest<'static> {
+    MS.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Returns the number of read operations of the given bdev.
+async fn num_read_ops(name: &str) -> u64 {
+    UntypedBdev::lookup_by_name(name)
+        .expect("child bdev not found")
+        .stats_async()
+        .await
+        .expect("failed to get child bdev stats")
+        .num_read_ops
+}
+
+/// Reads `count` blocks of the nexus, `depth` at a time.
+async fn read_nexus(count: u64, depth: usize) {
+    let h = UntypedBdevHandle::open(NEXUS_NAME, true, false)
+        .expect("failed to open the nexus");
+
+    let mut offset = 0;
+    while offset < count {
+        let reads = (0 .. depth as u64)
+            .map(|i| offset + i)
+            .take_while(|&blk| blk < count)
+            .map(|blk| {
+                let mut buf = h
+                    .dma_malloc(BLOCK_SIZE)
+                    .expect("failed to allocate buffer");
+                let h = &h;
+                async move { h.read_at(blk * BLOCK_SIZE, &mut buf).await }
+            });
+        let n = join_all(reads)
+            .await
+            .into_iter()
+            .map(|r| r.expect("nexus read failed"))
+            .count();
+        offset += n as u64;
+    }
+}
+
+#[tokio::test]
+async fn nexus_read_policy_after_child_removal() {
+    mayastor()
+        .spawn(async {
+            let children: Vec<String> = (0 .. 3)
+                .map(|i| format!("malloc:///rp{i}?size_mb=64"))
+                .collect();
+            nexus_create(NEXUS_NAME, NEXUS_SIZE, None, &children)
+                .await
+                .expect("failed to create the nexus");
+
+            set_read_policy(ReadPolicy::LeastOutstanding);
+
+            // Remove a child while reads are in flight on all of them.
+            let (_, removed) = futures::join!(read_nexus(1024, 32), async {
+                nexus_lookup_mut(NEXUS_NAME)
+                    .unwrap()
+                    .remove_child(&children[2])
+                    .await
+            });
+            removed.expect("failed to remove a child");
+
+            // Reads issued one at a time find no outstanding read on any
+            // reader: the remaining readers must be used evenly. A reader
+            // still accounting reads of the former readers list would never
+            // be selected.
+            let before = [num_read_ops("rp0").await, num_read_ops("rp1").await];
+            read_nexus(256, 1).await;
+            let after = [num_read_ops("rp0").await, num_read_ops("rp1").await];
+
+            for (i, (b, a)) in before.iter().zip(after.iter()).enumerate() {
+                assert!(
+                    a - b >= 64,
+                    "reader rp{i} served {} reads out of 256",
+                    a - b
+                );
+            }
+
+            set_read_policy(ReadPolicy::default());
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .destroy()
+                .await
+                .unwrap();
+        })
+        .await;
+}
@@ -3,6 +3,7 @@ pub mod common;
 use common::{
     compose::{
         rpc::v1::{
+            json::JsonRpcRequest,
             nexus::{ChildState, ChildStateReason},
             GrpcConnect,
         },
@@ -405,6 +406,65 @@ async fn nexus_partial_rebuild_offline_online() {
     assert_eq!(hist[1].blocks_transferred, 3 * SEG_BLK);
 }
 
+#[tokio::test]
+/// 1. Create a nexus with two replicas, and limit the rebuilds of the nexus
+///    node to 2 segment copies per second.
+/// 2. Offline a replica, and write 3 segments.
+/// 3. Online the offlined replica: the partial rebuild walks all the 112
+///    segments, but only the 3 dirty ones consume the budget, so the rebuild
+///    completes in about a second rather than in about a minute.
+/// 4. Verify replica data.
+async fn nexus_partial_rebuild_budget() {
+    let test = create_compose_test().await;
+
+    let StorageBuilder {
+        pool_0: _,
+        pool_1: _,
+        repl_0,
+        repl_1,
+        nex_0,
+    } = create_test_storage(&test).await;
+
+    nex_0
+        .rpc()
+        .lock()
+        .await
+        .json
+        .json_rpc_call(JsonRpcRequest {
+            method: "nexus_rebuild_budget".to_string(),
+            params: "{\"budget\": {\"iops\": 2}}".to_string(),
+        })
+        .await
+        .unwrap();
+
+    nex_0
+        .offline_child_replica_wait(&repl_0, Duration::from_secs(1))
+        .await
+        .unwrap();
+
+    test_write_to_nexus(
+        &nex_0,
+        DataSize::from_bytes(0),
+        3,
+        DataSize::from_kb(64),
+    )
+    .await
+    .unwrap();
+
+    nex_0.online_child_replica(&repl_0).await.unwrap();
+    nex_0
+        .wait_children_online(Duration::from_secs(10))
+        .await
+        .unwrap();
+
+    validate_replicas(&vec![repl_0.clone(), repl_1.clone()]).await;
+
+    let hist = nex_0.get_rebuild_history().await.unwrap();
+    assert_eq!(hist.len(), 1);
+    assert!(hist[0].is_partial);
+    assert_eq!(hist[0].blocks_transferred, 3 * SEG_BLK);
+}
+
 #[tokio::test(flavor = "multi_thread", worker_threads = 4)]
 #[cfg(feature = "fault-injection")]
 /// I/O failure during rebuild.
@@ -0,0 +1,107 @@
+use std::{sync::atomic::Ordering, time::Duration};
+
+use futures::future::join_all;
+use once_cell::sync::OnceCell;
+
+use common::{bdev_io, MayastorTest};
+use io_engine::{
+    bdev::nexus::{nexus_create, nexus_lookup_mut, NEXUS_WRITE_BATCH},
+    core::{MayastorCliArgs, UntypedBdevHandle},
+};
+
+pub mod common;
+
+static MS: OnceCell<MayastorTest> = OnceCell::new();
+
+const BLOCK_SIZE: u64 = 512;
+/// Number of adjacent one-block writes submitted at once.
+const NUM_WRITES: u64 = 64;
+
+fn mayastor() -> &'static MayastorTest<'static> {
+    MS.get_or_init(|| {
+        NEXUS_WRITE_BATCH.store(8, Ordering::SeqCst);
+        MayastorTest::new(MayastorCliArgs::default())
+    })
+}
+
+/// Creates a nexus of two malloc children, named after the nexus.
+async fn create_nexus(name: &str) {
+    let children: Vec<String> = (0 .. 2)
+        .map(|i| format!("malloc:///{name}_{i}?size_mb=32"))
+        .collect();
+    nexus_create(name, 16 * 1024 * 1024, None, &children)
+        .await
+        .expect("failed to create the nexus");
+}
+
+/// Submits `NUM_WRITES` adjacent one-block writes to the nexus all at once,
+/// so that the ones submitted while others are in flight are batched, and
+/// returns their results.
+async fn write_adjacent(name: &str, fill: u8) -> Vec<Result<u64, String>> {
+    let h = UntypedBdevHandle::open(name, true, false).unwrap();
+
+    join_all((0 .. NUM_WRITES).map(|blk| {
+        let mut buf = h.dma_malloc(BLOCK_SIZE).unwrap();
+        buf.fill(fill);
+        let h = &h;
+        async move {
+            h.write_at(blk * BLOCK_SIZE, &buf)
+                .await
+                .map_err(|e| e.to_string())
+        }
+    }))
+    .await
+}
+
+#[tokio::test]
+async fn nexus_write_batch_coalesce() {
+    mayastor()
+        .spawn(async {
+            const NEXUS: &str = "batch_nexus";
+            create_nexus(NEXUS).await;
+
+            write_adjacent(NEXUS, 0xaa).await.into_iter().for_each(|r| {
+                r.expect("batched nexus write failed");
+            });
+
+            // The batched writes reached every child.
+            for name in [NEXUS, "batch_nexus_0", "batch_nexus_1"] {
+                bdev_io::read_some(name, 0, NUM_WRITES as u32, 0xaa)
+                    .await
+                    .expect("batched write missing");
+                bdev_io::read_some(
+                    name,
+                    (NUM_WRITES - 2) * BLOCK_SIZE,
+                    2,
+                    0xaa,
+                )
+                .await
+                .expect("batched write missing");
+            }
+
+            nexus_lookup_mut(NEXUS).unwrap().destroy().await.unwrap();
+        })
+        .await;
+}
+
+#[tokio::test]
+/// Destroy the nexus while writes are held in a batch: the writes must all
+/// complete, successfully or not, before its channel is gone.
+async fn nexus_write_batch_destroy() {
+    tokio::time::timeout(
+        Duration::from_secs(10),
+        mayastor().spawn(async {
+            const NEXUS: &str = "batch_destroy_nexus";
+            create_nexus(NEXUS).await;
+
+            let (results, destroyed) = futures::join!(
+                write_adjacent(NEXUS, 0xbb),
+                nexus_lookup_mut(NEXUS).unwrap().destroy()
+            );
+            assert_eq!(results.len(), NUM_WRITES as usize);
+            destroyed.expect("failed to destroy the nexus");
+        }),
+    )
+    .await
+    .expect("writes held in a batch never completed");
+}
@@ -0,0 +1,114 @@
+use futures::future::join_all;
+
+use io_engine::{
+    bdev::nexus::{nexus_create, nexus_lookup_mut},
+    core::{MayastorCliArgs, UntypedBdevHandle},
+};
+
+pub mod common;
+use common::{
+    bdev_io,
+    compose,
+    compose::rpc::v0::{
+        mayastor::{BdevShareRequest, BdevUri},
+        GrpcConnect,
+    },
+    MayastorTest,
+};
+
+const NEXUS_NAME: &str = "io_qpairs_nexus";
+const NEXUS_SIZE: u64 = 50 * 1024 * 1024;
+const BLOCK_SIZE: u64 = 512;
+
+/// Writes and reads back one block at each of the given offsets, all at
+/// once, so that they are spread over the qpairs of the child.
+async fn write_read_blocks(offsets: &[u64], fill: u8) {
+    join_all(
+        offsets
+            .iter()
+            .map(|&o| bdev_io::write_some(NEXUS_NAME, o * BLOCK_SIZE, 1, fill)),
+    )
+    .await
+    .into_iter()
+    .for_each(|r| r.expect("nexus write failed"));
+
+    join_all(
+        offsets
+            .iter()
+            .map(|&o| bdev_io::read_some(NEXUS_NAME, o * BLOCK_SIZE, 1, fill)),
+    )
+    .await
+    .into_iter()
+    .for_each(|r| r.expect("nexus read failed"));
+}
+
+#[tokio::test]
+async fn nvmx_io_qpairs_reset() {
+    common::composer_init();
+
+    let test = compose::Builder::new()
+        .name("cargo-test")
+        .network("10.1.0.0/16")
+        .unwrap()
+        .add_container_dbg("ms1")
+        .with_clean(true)
+        .build()
+        .await
+        .unwrap();
+
+    let grpc = GrpcConnect::new(&test);
+    let mut hdl = grpc.grpc_handle("ms1").await.unwrap();
+
+    hdl.bdev
+        .create(BdevUri {
+            uri: "malloc:///disk0?size_mb=100".into(),
+        })
+        .await
+        .unwrap();
+    let child = hdl
+        .bdev
+        .share(BdevShareRequest {
+            name: "disk0".into(),
+            proto: "nvmf".into(),
+            ..Default::default()
+        })
+        .await
+        .unwrap()
+        .into_inner()
+        .uri;
+
+    // Several qpairs per I/O channel of the child.
+    std::env::set_var("NVME_IO_QPAIRS", "4");
+    let mayastor = MayastorTest::new(MayastorCliArgs::default());
+
+    mayastor
+        .spawn(async move {
+            nexus_create(NEXUS_NAME, NEXUS_SIZE, None, &[child])
+                .await
+                .unwrap();
+
+            let offsets: Vec<u64> = (0 .. 64).collect();
+            write_read_blocks(&offsets, 0xaa).await;
+
+            // Reset the child while I/O is in flight on all of its qpairs:
+            // the aborted requests must complete, with an error or not,
+            // without any failover to the dropped qpairs.
+            let h = UntypedBdevHandle::open(NEXUS_NAME, true, false).unwrap();
+            let writes = join_all(offsets.iter().map(|&o| {
+                bdev_io::write_some(NEXUS_NAME, o * BLOCK_SIZE, 1, 0xbb)
+            }));
+            let (_, reset) = futures::join!(writes, h.reset());
+            reset.expect("nexus reset failed");
+
+            // All the qpairs are recreated after the reset.
+            write_read_blocks(&offsets, 0xcc).await;
+
+            drop(h);
+            nexus_lookup_mut(NEXUS_NAME)
+                .unwrap()
+                .destroy()
+                .await
+                .unwrap();
+        })
+        .await;
+}
@@ -0,0 +1,210 @@
+pub mod common;
+
+use chrono::Utc;
+use once_cell::sync::OnceCell;
+use uuid::Uuid;
+
+use common::{bdev_io, compose::MayastorTest};
+use io_engine::{
+    core::{
+        segment_map::SegmentMap,
+        CloneParams,
+        LogicalVolume,
+        MayastorCliArgs,
+        SnapshotOps,
+        SnapshotParams,
+    },
+    lvs::{Lvol, Lvs, LvsLvol},
+    pool_backend::PoolArgs,
+    rebuild::{BdevRebuildJob, RebuildState},
+};
+
+static MAYASTOR: OnceCell<MayastorTest> = OnceCell::new();
+
+const LVOL_SIZE: u64 = 16 * 1024 * 1024;
+const BLOCK_SIZE: u64 = 512;
+const SEGMENT_SIZE: u64 = 64 * 1024;
+
+fn get_ms() -> &'static MayastorTest<'static> {
+    MAYASTOR.get_or_init(|| MayastorTest::new(MayastorCliArgs::default()))
+}
+
+/// Must be called only in Mayastor context.
+async fn create_test_pool(pool_name: &str, disk: String) -> Lvs {
+    Lvs::create_or_import(PoolArgs {
+        name: pool_name.to_string(),
+        disks: vec![disk],
+        uuid: None,
+        cluster_size: None,
+    })
+    .await
+    .expect("Failed to create test pool");
+
+    Lvs::lookup(pool_name).expect("Failed to lookup test pool")
+}
+
+/// Must be called only in Mayastor context.
+async fn create_thin_lvol(pool: &Lvs, name: &str) -> Lvol {
+    pool.create_lvol(
+        name,
+        LVOL_SIZE,
+        Some(&Uuid::new_v4().to_string()),
+        true,
+        None,
+    )
+    .await
+    .expect("Failed to create test lvol")
+}
+
+/// Rebuilds the given source lvol into the given destination lvol, with the
+/// given rebuild map, if any.
+async fn rebuild(src: &str, dst: &str, map: Option<SegmentMap>) {
+    let builder = BdevRebuildJob::builder();
+    let builder = match map {
+        Some(map) => builder.with_bitmap(map),
+        None => builder,
+    };
+    let job = builder
+        .build(&format!("bdev:///{src}"), &format!("bdev:///{dst}"))
+        .await
+        .expect("Failed to create rebuild job");
+    let state = job.start().await.unwrap().await.unwrap();
+    assert_eq!(state, RebuildState::Completed, "Rebuild should succeed");
+}
+
+#[tokio::test]
+async fn rebuild_thin_source_holes() {
+    let ms = get_ms();
+
+    ms.spawn(async move {
+        let pool =
+            create_test_pool("pool_holes", "malloc:///disk0?size_mb=64".into())
+                .await;
+        let cluster_size = pool.blob_cluster_size();
+
+        let src = create_thin_lvol(&pool, "holes_src").await;
+        let dst = create_thin_lvol(&pool, "holes_dst").await;
+
+        bdev_io::write_some("holes_src", 0, 16, 0xaa)
+            .await
+            .expect("Failed to write to the source");
+
+        rebuild("holes_src", "holes_dst", None).await;
+
+        // Only the data of the source is copied: the holes of the source
+        // are neither copied nor zeroed, and stay unallocated.
+        bdev_io::read_some("holes_dst", 0, 16, 0xaa)
+            .await
+            .expect("Data of the source should be rebuilt");
+        assert_eq!(
+            dst.usage().allocated_bytes,
+            cluster_size,
+            "Holes of the source should not be allocated on the destination"
+        );
+
+        src.destroy().await.unwrap();
+        dst.destroy().await.unwrap();
+        pool.destroy().await.unwrap();
+    })
+    .await;
+}
+
+#[tokio::test]
+async fn rebuild_thin_source_holes_partial() {
+    let ms = get_ms();
+
+    ms.spawn(async move {
+        let pool =
+            create_test_pool("pool_stale", "malloc:///disk1?size_mb=64".into())
+                .await;
+
+        let src = create_thin_lvol(&pool, "stale_src").await;
+        let dst = create_thin_lvol(&pool, "stale_dst").await;
+
+        // The destination holds data the source does not have anymore.
+        bdev_io::write_some("stale_dst", 0, 16, 0xdd)
+            .await
+            .expect("Failed to write to the destination");
+
+        let mut map =
+            SegmentMap::new(LVOL_SIZE / BLOCK_SIZE, BLOCK_SIZE, SEGMENT_SIZE);
+        map.set(0, SEGMENT_SIZE / BLOCK_SIZE, true);
+        rebuild("stale_src", "stale_dst", Some(map)).await;
+
+        // The dirty segment is a hole on the source: it must be zeroed on
+        // the destination.
+        bdev_io::read_some("stale_dst", 0, 16, 0)
+            .await
+            .expect("Stale data of the destination should be zeroed");
+
+        src.destroy().await.unwrap();
+        dst.destroy().await.unwrap();
+        pool.destroy().await.unwrap();
+    })
+    .await;
+}
+
+#[tokio::test]
+async fn rebuild_clone_source() {
+    let ms = get_ms();
+
+    ms.spawn(async move {
+        let pool = create_test_pool(
+            "pool_clone",
+            "malloc:///disk2?size_mb=128".into(),
+        )
+        .await;
+
+        let lvol = create_thin_lvol(&pool, "clone_origin").await;
+        bdev_io::write_some("clone_origin", 0, 16, 0xaa)
+            .await
+            .expect("Failed to write to the origin");
+
+        let snapshot = lvol
+            .create_snapshot(SnapshotParams::new(
+                Some("clone_origin_e1".to_string()),
+                Some(lvol.uuid()),
+                Some(Uuid::new_v4().to_string()),
+                Some("clone_origin_snap1".to_string()),
+                Some(Uuid::new_v4().to_string()),
+                Some(Utc::now().to_string()),
+                false,
+            ))
+            .await
+            .expect("Failed to create a snapshot");
+
+        let clone = snapshot
+            .create_clone(CloneParams::new(
+                Some("clone_src".to_string()),
+                Some(Uuid::new_v4().to_string()),
+                Some(snapshot.uuid()),
+                Some(Utc::now().to_string()),
+            ))
+            .await
+            .expect("Failed to create a clone");
+
+        // The clone owns the cluster at 8 MiB, and reads the first one from
+        // the snapshot.
+        bdev_io::write_some("clone_src", 8 * 1024 * 1024, 16, 0xcc)
+            .await
+            .expect("Failed to write to the clone");
+
+        let dst = create_thin_lvol(&pool, "clone_dst").await;
+        rebuild("clone_src", "clone_dst", None).await;
+
+        // The blocks the clone reads from its snapshot are not holes.
+        bdev_io::read_some("clone_dst", 0, 16, 0xaa)
+            .await
+            .expect("Snapshot-backed data of the clone should be rebuilt");
+        bdev_io::read_some("clone_dst", 8 * 1024 * 1024, 16, 0xcc)
+            .await
+            .expect("Data of the clone should be rebuilt");
+
+        dst.destroy().await.unwrap();
+        clone.destroy().await.unwrap();
+        lvol.destroy().await.unwrap();
+        snapshot.destroy().await.unwrap();
+        pool.destroy().await.unwrap();
+    })
+    .await;
+}